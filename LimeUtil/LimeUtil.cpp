@@ -13,12 +13,16 @@
 #include <ciso646>
 #include <getopt.h>
 #include <fstream>
+#include <algorithm>
 #include "ErrorReporting.h"
 #include "LMS64CProtocol.h"
 
 using namespace lime;
 
 int deviceTestTiming(const std::string &argStr);
+int deviceBenchmark(const std::string &argStr, const size_t iterations, const std::string &outputFile);
+int deviceTraceReport(const std::string &filename);
+int deviceTraceReplay(const std::string &argStr, const std::string &filename);
 int deviceCalSweep(
     const std::string &argStr,
     const double start,
@@ -26,7 +30,29 @@ int deviceCalSweep(
     const double step,
     const double bw,
     const std::string &dir,
-    const std::string &chans);
+    const std::string &chans,
+    const int tolerance,
+    const bool hostCal);
+int deviceRecord(
+    const std::string &argStr,
+    const std::string &filename,
+    const std::string &chansStr,
+    const double duration,
+    const bool pack);
+int devicePlay(
+    const std::string &argStr,
+    const std::string &filename,
+    const std::string &chansStr,
+    const double duration,
+    const bool loop);
+int deviceShare(
+    const std::string &argStr,
+    const std::string &name,
+    const std::string &chansStr,
+    const double duration);
+#ifdef ENABLE_REMOTE
+int deviceServe(const std::string &argStr, const int port, const std::string &host);
+#endif
 
 /***********************************************************************
  * print help
@@ -47,6 +73,13 @@ static int printHelp(void)
     std::cout << "    --fw=\"filename\"   \t\t\t Program FX3  firmware to flash" << std::endl;
     std::cout << "    --timing          \t\t\t Time interfaces and operations" << std::endl;
     std::cout << std::endl;
+    std::cout << "  Control-plane benchmark:" << std::endl;
+    std::cout << "    --bench[=\"filename\", default=benchmark.json] Measure latency of tuning, gain, rate, calibration, streaming" << std::endl;
+    std::cout << "    --iters[=count, default=100]       \t Iterations of fast operations, slow ones run a tenth" << std::endl;
+    std::cout << "    --trace-report=\"filename\"        \t Summarize control trace, LIMESUITE_CONTROL_TRACE=filename records it" << std::endl;
+    std::cout << "    --trace-replay=\"filename\"        \t Replay control trace on device from --args, compare timing and reads" << std::endl;
+    std::cout << "                                       \t reads match only if the board starts in the traced state" << std::endl;
+    std::cout << std::endl;
     std::cout << "  Calibrations sweep:" << std::endl;
     std::cout << "    --cal[=\"module=foo,serial=bar\"]  \t Calibrate device, optional device args..." << std::endl;
     std::cout << "    --start[=freqStart]                \t Frequency start for the sweep(Hz)" << std::endl;
@@ -55,7 +88,25 @@ static int printHelp(void)
     std::cout << "    --bw[=bandwidth, default=30MHz]    \t Desired calibration bandwidth(Hz)" << std::endl;
     std::cout << "    --dir[=direction, default=BOTH]    \t Calibration direction, RX, TX, BOTH" << std::endl;
     std::cout << "    --chans[=channels, default=ALL]    \t Calibration channels, 0, 1, ALL" << std::endl;
+    std::cout << "    --tol[=codes, default=2]           \t Interpolate points when neighbors agree within tolerance" << std::endl;
+    std::cout << "    --host                             \t Run warm started DC/IQ searches on host instead of MCU" << std::endl;
+    std::cout << std::endl;
+    std::cout << "  Streaming to/from disk and local processes:" << std::endl;
+    std::cout << "    --record=\"filename\"               \t Record Rx channels to SigMF file" << std::endl;
+    std::cout << "    --play=\"filename\"                 \t Transmit waveform file on Tx channels" << std::endl;
+    std::cout << "    --share=\"name\"                    \t Publish Rx channels to shared memory ring for local readers" << std::endl;
+    std::cout << "    --chans[=channels, default=ALL]    \t Stream channels, comma separated list or ALL" << std::endl;
+    std::cout << "    --duration[=seconds, default=0]    \t Stop after given time, 0 runs until Ctrl+C" << std::endl;
+    std::cout << "    --pack                             \t Store recorded samples as packed 12 bit values" << std::endl;
+    std::cout << "    --loop                             \t Repeat played file until stopped" << std::endl;
+    std::cout << std::endl;
+#ifdef ENABLE_REMOTE
+    std::cout << "  Network sharing:" << std::endl;
+    std::cout << "    --serve[=port, default=55132]      \t Share device with remote clients (addr=udp://host:port)" << std::endl;
+    std::cout << "    --serve-bind=\"address\"             \t Local address to serve on, default 127.0.0.1, \"\" for all interfaces" << std::endl;
+    std::cout << "                                       \t clients are not authenticated, expose only to trusted networks" << std::endl;
     std::cout << std::endl;
+#endif
     return EXIT_SUCCESS;
 }
 
@@ -321,12 +372,27 @@ int main(int argc, char *argv[])
         {"bw",      required_argument, 0, 'b'},
         {"dir",     required_argument, 0, 'd'},
         {"chans",   required_argument, 0, 'c'},
+        {"tol",     required_argument, 0, 'o'},
+        {"host",    no_argument, 0, 'x'},
+        {"record",  required_argument, 0, 'r'},
+        {"play",    required_argument, 0, 'y'},
+        {"share",   required_argument, 0, 'S'},
+        {"duration", required_argument, 0, 'n'},
+        {"pack",    no_argument, 0, 'k'},
+        {"loop",    no_argument, 0, 'z'},
+        {"serve",   optional_argument, 0, 'v'},
+        {"serve-bind", required_argument, 0, 'V'},
+        {"bench",   optional_argument, 0, 'j'},
+        {"iters",   required_argument, 0, 'q'},
+        {"trace-report", required_argument, 0, 'T'},
+        {"trace-replay", required_argument, 0, 'R'},
         {0, 0, 0,  0}
     };
 
-    std::string argStr, dir("BOTH"), chans("ALL");
-    double start(0.0), stop(0.0), step(1e6), bw(30e6);
-    bool testTiming(false), calSweep(false);
+    std::string argStr, dir("BOTH"), chans("ALL"), recordFile, playFile, shareName, benchFile, traceReport, traceReplay, serveHost("127.0.0.1");
+    double start(0.0), stop(0.0), step(1e6), bw(30e6), duration(0.0);
+    int tolerance(2), servePort(0), iterations(100);
+    bool testTiming(false), calSweep(false), hostCal(false), pack(false), loop(false);
     int long_index = 0;
     int option = 0;
     while ((option = getopt_long_only(argc, argv, "", long_options, &long_index)) != -1)
@@ -354,11 +420,34 @@ int main(int argc, char *argv[])
         case 'b': if (optarg != NULL) bw = std::stod(optarg); break;
         case 'd': if (optarg != NULL) dir = optarg; break;
         case 'c': if (optarg != NULL) chans = optarg; break;
+        case 'o': if (optarg != NULL) tolerance = std::stoi(optarg); break;
+        case 'x': hostCal = true; break;
+        case 'r': if (optarg != NULL) recordFile = optarg; break;
+        case 'y': if (optarg != NULL) playFile = optarg; break;
+        case 'S': if (optarg != NULL) shareName = optarg; break;
+        case 'n': if (optarg != NULL) duration = std::stod(optarg); break;
+        case 'k': pack = true; break;
+        case 'z': loop = true; break;
+        case 'v': servePort = (optarg != NULL) ? std::stoi(optarg) : 55132; break;
+        case 'V': serveHost = (optarg != NULL) ? optarg : ""; break;
+        case 'j': benchFile = (optarg != NULL) ? optarg : "benchmark.json"; break;
+        case 'q': if (optarg != NULL) iterations = std::stoi(optarg); break;
+        case 'T': if (optarg != NULL) traceReport = optarg; break;
+        case 'R': if (optarg != NULL) traceReplay = optarg; break;
         }
     }
 
     if (testTiming) return deviceTestTiming(argStr);
-    if (calSweep) return deviceCalSweep(argStr, start, stop, step, bw, dir, chans);
+    if (not benchFile.empty()) return deviceBenchmark(argStr, std::max(iterations, 1), benchFile);
+    if (not traceReport.empty()) return deviceTraceReport(traceReport);
+    if (not traceReplay.empty()) return deviceTraceReplay(argStr, traceReplay);
+    if (calSweep) return deviceCalSweep(argStr, start, stop, step, bw, dir, chans, tolerance, hostCal);
+    if (not recordFile.empty()) return deviceRecord(argStr, recordFile, chans, duration, pack);
+    if (not playFile.empty()) return devicePlay(argStr, playFile, chans, duration, loop);
+    if (not shareName.empty()) return deviceShare(argStr, shareName, chans, duration);
+#ifdef ENABLE_REMOTE
+    if (servePort > 0) return deviceServe(argStr, servePort, serveHost);
+#endif
 
     //unknown or unspecified options, do help...
     return printHelp();
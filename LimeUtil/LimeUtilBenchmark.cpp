@@ -0,0 +1,299 @@
+/**
+    @file LimeUtilBenchmark.cpp
+    @author Lime Microsystems
+    @brief Control-plane latency benchmark with JSON report
+*/
+
+#include <ConnectionRegistry.h>
+#include <IConnection.h>
+#include <lms7_device.h>
+#include <lime/LimeSuite.h>
+#include <ErrorReporting.h>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+
+using namespace lime;
+
+namespace
+{
+
+/** @brief Counts control packets sent to device through connection data log hook
+*/
+class TransactionCounter
+{
+public:
+    TransactionCounter() : packets(0), bytes(0), mConn(nullptr) {}
+    ~TransactionCounter() { Detach(); }
+
+    void Attach(IConnection* conn)
+    {
+        Detach();
+        mConn = conn;
+        if (mConn == nullptr)
+            return;
+        mConn->SetDataLogCallback([this](bool toDevice, const unsigned char*, const unsigned int length)
+        {
+            if (toDevice)
+            {
+                ++packets;
+                bytes += length;
+            }
+        });
+    }
+
+    void Detach()
+    {
+        if (mConn)
+            mConn->SetDataLogCallback(nullptr);
+        mConn = nullptr;
+    }
+
+    bool IsAttached() const { return mConn != nullptr; }
+
+    uint64_t packets;
+    uint64_t bytes;
+private:
+    IConnection* mConn;
+};
+
+struct OperationResult
+{
+    std::string name;
+    size_t iterations;
+    size_t failures;
+    std::vector<double> latencies; //!< seconds, successful calls only
+    bool counted; //!< transactions were counted for this operation
+    uint64_t packets;
+    uint64_t bytes;
+};
+
+/** @brief Runs operation given number of times, timing every call and
+    counting control packets it issues. Optional setup and teardown run
+    around each call outside of measurement.
+*/
+OperationResult measure(const std::string& name, const size_t iterations, TransactionCounter* counter, const std::function<int(size_t)>& op,
+    const std::function<void()>& setup = nullptr, const std::function<void()>& teardown = nullptr)
+{
+    OperationResult result;
+    result.name = name;
+    result.iterations = iterations;
+    result.failures = 0;
+    result.counted = counter != nullptr && counter->IsAttached();
+    result.packets = 0;
+    result.bytes = 0;
+    result.latencies.reserve(iterations);
+    std::cout << "  " << std::left << std::setw(20) << name << std::flush;
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        if (setup)
+            setup();
+        const uint64_t packets0 = counter ? counter->packets : 0;
+        const uint64_t bytes0 = counter ? counter->bytes : 0;
+        const auto t0 = std::chrono::high_resolution_clock::now();
+        const int status = op(i);
+        const auto t1 = std::chrono::high_resolution_clock::now();
+        if (counter)
+        {
+            result.packets += counter->packets - packets0;
+            result.bytes += counter->bytes - bytes0;
+        }
+        if (teardown)
+            teardown();
+        if (status == 0)
+            result.latencies.push_back(std::chrono::duration<double>(t1-t0).count());
+        else
+            ++result.failures;
+    }
+    std::sort(result.latencies.begin(), result.latencies.end());
+    if (result.latencies.empty())
+        std::cout << "failed: " << GetLastErrorMessage() << std::endl;
+    else
+    {
+        const double p50 = result.latencies[(result.latencies.size()-1)*50/100];
+        const double p99 = result.latencies[(result.latencies.size()-1)*99/100];
+        std::cout << "p50 " << std::setw(10) << p50*1e3 << " ms  p99 " << std::setw(10) << p99*1e3 << " ms";
+        if (result.counted)
+            std::cout << "  " << double(result.packets)/iterations << " packets/op";
+        if (result.failures)
+            std::cout << "  (" << result.failures << " failed)";
+        std::cout << std::endl;
+    }
+    return result;
+}
+
+std::string jsonEscape(const std::string& str)
+{
+    std::string out;
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        if ((unsigned char)c < 0x20)
+            continue;
+        out += c;
+    }
+    return out;
+}
+
+void writeJson(std::ostream& out, const std::string& device, const size_t iterations, const std::vector<OperationResult>& results)
+{
+    char timestamp[32];
+    const std::time_t now = std::time(nullptr);
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    out << std::setprecision(9);
+    out << "{" << std::endl;
+    out << "  \"device\": \"" << jsonEscape(device) << "\"," << std::endl;
+    out << "  \"timestamp\": \"" << timestamp << "\"," << std::endl;
+    out << "  \"iterations\": " << iterations << "," << std::endl;
+    out << "  \"operations\": [" << std::endl;
+    for (size_t r = 0; r < results.size(); ++r)
+    {
+        const OperationResult& res = results[r];
+        const auto& lat = res.latencies;
+        out << "    {\"name\": \"" << res.name << "\", \"iterations\": " << res.iterations
+            << ", \"failures\": " << res.failures;
+        if (lat.empty())
+            out << ", \"p50_ms\": null, \"p99_ms\": null, \"mean_ms\": null, \"max_ms\": null";
+        else
+        {
+            double sum = 0;
+            for (double v : lat)
+                sum += v;
+            out << ", \"p50_ms\": " << lat[(lat.size()-1)*50/100]*1e3
+                << ", \"p99_ms\": " << lat[(lat.size()-1)*99/100]*1e3
+                << ", \"mean_ms\": " << sum/lat.size()*1e3
+                << ", \"max_ms\": " << lat.back()*1e3;
+        }
+        if (res.counted && res.iterations > 0)
+            out << ", \"packets_per_op\": " << double(res.packets)/res.iterations
+                << ", \"bytes_per_op\": " << double(res.bytes)/res.iterations;
+        else
+            out << ", \"packets_per_op\": null, \"bytes_per_op\": null";
+        out << "}" << (r+1 < results.size() ? "," : "") << std::endl;
+    }
+    out << "  ]" << std::endl;
+    out << "}" << std::endl;
+}
+
+}
+
+int deviceBenchmark(const std::string &argStr, const size_t iterations, const std::string &outputFile)
+{
+    auto handles = ConnectionRegistry::findConnections(argStr);
+    if(handles.size() == 0)
+    {
+        std::cout << "No devices found" << std::endl;
+        return EXIT_FAILURE;
+    }
+    lms_info_str_t info;
+    strncpy(info, handles[0].serialize().c_str(), sizeof(info)-1);
+    info[sizeof(info)-1] = 0;
+    std::cout << "Benchmarking [" << info << "], " << iterations << " iterations" << std::endl;
+
+    std::vector<OperationResult> results;
+    //slow operations are repeated less, but at least few times for percentiles
+    const size_t slowIterations = std::max<size_t>(iterations/10, 3);
+
+    lms_device_t* device = nullptr;
+    results.push_back(measure("device_open", slowIterations, nullptr, [&](size_t)
+    {
+        return LMS_Open(&device, info, nullptr);
+    }, nullptr, [&]()
+    {
+        if (device)
+            LMS_Close(device);
+        device = nullptr;
+    }));
+
+    if (LMS_Open(&device, info, nullptr) != 0)
+    {
+        std::cout << "Failed to open device: " << GetLastErrorMessage() << std::endl;
+        return EXIT_FAILURE;
+    }
+    TransactionCounter counter;
+    counter.Attach(static_cast<LMS7_Device*>(device)->GetConnection());
+
+    results.push_back(measure("init", 1, &counter, [&](size_t)
+    {
+        return LMS_Init(device);
+    }));
+    LMS_EnableChannel(device, LMS_CH_RX, 0, true);
+    LMS_EnableChannel(device, LMS_CH_TX, 0, true);
+
+    //frequencies are distinct, so each cold tune runs full VCO search
+    auto loFrequency = [](size_t i) { return 1e9 + i*1.1e6; };
+    LMS_EnableCalibCache(device, false);
+    results.push_back(measure("sx_tune_cold", iterations, &counter, [&](size_t i)
+    {
+        return LMS_SetLOFrequency(device, LMS_CH_RX, 0, loFrequency(i));
+    }));
+    LMS_EnableCalibCache(device, true);
+    for (size_t i = 0; i < iterations; ++i) //populate cache
+        LMS_SetLOFrequency(device, LMS_CH_RX, 0, loFrequency(i));
+    results.push_back(measure("sx_tune_cached", iterations, &counter, [&](size_t i)
+    {
+        return LMS_SetLOFrequency(device, LMS_CH_RX, 0, loFrequency(i));
+    }));
+    LMS_EnableCalibCache(device, false);
+
+    results.push_back(measure("set_gain", iterations, &counter, [&](size_t i)
+    {
+        return LMS_SetGaindB(device, LMS_CH_RX, 0, i%70);
+    }));
+
+    //alternating rates, the usual switch between two configurations
+    results.push_back(measure("set_sample_rate", slowIterations, &counter, [&](size_t i)
+    {
+        return LMS_SetSampleRate(device, (i%2) ? 5e6 : 10e6, 0);
+    }));
+
+    results.push_back(measure("set_lpf_bw", slowIterations, &counter, [&](size_t i)
+    {
+        return LMS_SetLPFBW(device, LMS_CH_RX, 0, 5e6 + (i%10)*1e6);
+    }));
+
+    results.push_back(measure("calibrate", slowIterations, &counter, [&](size_t)
+    {
+        return LMS_Calibrate(device, LMS_CH_RX, 0, 20e6, 0);
+    }));
+
+    lms_stream_t stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.isTx = false;
+    stream.channel = 0;
+    stream.fifoSize = 1024*1024;
+    stream.throughputVsLatency = 0.5;
+    stream.dataFmt = lms_stream_t::LMS_FMT_I16;
+    const bool streamReady = LMS_SetupStream(device, &stream) == 0;
+    auto startStream = [&]() { if (streamReady) LMS_StartStream(&stream); };
+    auto stopStream = [&]() { if (streamReady) LMS_StopStream(&stream); };
+    results.push_back(measure("stream_start", slowIterations, &counter, [&](size_t)
+    {
+        return streamReady ? LMS_StartStream(&stream) : -1;
+    }, nullptr, stopStream));
+    results.push_back(measure("stream_stop", slowIterations, &counter, [&](size_t)
+    {
+        return streamReady ? LMS_StopStream(&stream) : -1;
+    }, startStream, nullptr));
+    if (streamReady)
+        LMS_DestroyStream(device, &stream);
+
+    counter.Detach();
+    LMS_Close(device);
+
+    std::ofstream file(outputFile);
+    if (not file.good())
+    {
+        std::cout << "Failed to create " << outputFile << std::endl;
+        return EXIT_FAILURE;
+    }
+    writeJson(file, info, iterations, results);
+    std::cout << "Results written to " << outputFile << std::endl;
+    return EXIT_SUCCESS;
+}
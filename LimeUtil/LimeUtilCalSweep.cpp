@@ -5,11 +5,199 @@
 */
 
 #include "lime/LimeSuite.h"
+#include "lms7_device.h"
+#include <LMS7002M.h>
 #include <iostream>
 #include <cstdlib>
 #include <cstddef>
 #include <string>
 #include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+typedef lime::LMS7002M::CalibrationValues CalibrationValues;
+
+//interior points are interpolated when the coarse grid neighbors agree
+static const size_t coarseStride = 8;
+
+//cache inserts are committed after this many points
+static const size_t cacheBatchSize = 32;
+
+struct CalSweepContext
+{
+    lms_device_t *device;
+    lime::LMS7002M *lms;
+    bool dirTx;
+    size_t chan;
+    double bw;
+    unsigned flags;
+    int tolerance;
+    std::vector<double> freqs;
+    std::vector<CalibrationValues> results;
+    size_t calibrated;
+    size_t interpolated;
+    size_t rechecked;
+    size_t pendingInserts;
+};
+
+static bool withinTolerance(const CalibrationValues &a, const CalibrationValues &b, const int tol)
+{
+    return std::abs(a.dcI - b.dcI) <= tol &&
+           std::abs(a.dcQ - b.dcQ) <= tol &&
+           std::abs(a.gainI - b.gainI) <= tol &&
+           std::abs(a.gainQ - b.gainQ) <= tol &&
+           std::abs(a.phase - b.phase) <= tol;
+}
+
+//value lies outside of its neighbors range by more than tolerance
+static bool isOutlier(const int v, const int lo, const int hi, const int tol)
+{
+    return v < std::min(lo, hi) - tol || v > std::max(lo, hi) + tol;
+}
+
+static bool isOutlier(const CalibrationValues &v, const CalibrationValues &lo, const CalibrationValues &hi, const int tol)
+{
+    return isOutlier(v.dcI, lo.dcI, hi.dcI, tol) ||
+           isOutlier(v.dcQ, lo.dcQ, hi.dcQ, tol) ||
+           isOutlier(v.gainI, lo.gainI, hi.gainI, tol) ||
+           isOutlier(v.gainQ, lo.gainQ, hi.gainQ, tol) ||
+           isOutlier(v.phase, lo.phase, hi.phase, tol);
+}
+
+static int interp(const int y0, const int y1, const double a)
+{
+    return int(std::lrint(y0 + (y1 - y0)*a));
+}
+
+static void commitCacheBatch(CalSweepContext &ctx, const bool force)
+{
+    if (not force and ++ctx.pendingInserts < cacheBatchSize) return;
+    ctx.lms->EndValuesCacheBatch();
+    ctx.lms->BeginValuesCacheBatch();
+    ctx.pendingInserts = 0;
+}
+
+static int tunePoint(CalSweepContext &ctx, const size_t idx)
+{
+    if (LMS_SetLOFrequency(ctx.device, ctx.dirTx, ctx.chan, ctx.freqs[idx]) != 0)
+    {
+        std::cerr << "Error tuning " << ctx.freqs[idx]/1e6 << " MHz (skipping): " << LMS_GetLastErrorMessage() << std::endl;
+        return -1;
+    }
+    return 0;
+}
+
+/*!
+ * Calibrate a single point, searches start from the seed when it is valid.
+ * A cold calibration bypasses the cache and overwrites the cached entry.
+ */
+static int calibratePoint(CalSweepContext &ctx, const size_t idx, const CalibrationValues &seed, const bool cold = false)
+{
+    ctx.results[idx] = CalibrationValues();
+    if (tunePoint(ctx, idx) != 0) return -1;
+
+    if (cold) ctx.lms->EnableValuesCache(false);
+    ctx.lms->SetCalibrationSeed(ctx.dirTx, seed);
+    const int status = LMS_Calibrate(ctx.device, ctx.dirTx, ctx.chan, ctx.bw, ctx.flags);
+    if (cold) ctx.lms->EnableValuesCache(true);
+    ctx.calibrated++;
+    if (status != 0)
+    {
+        std::cerr << "Error calibrating " << ctx.freqs[idx]/1e6 << " MHz (skipping): " << LMS_GetLastErrorMessage() << std::endl;
+        return -1;
+    }
+
+    ctx.results[idx] = ctx.lms->GetCalibrationResult(ctx.dirTx);
+    if (cold and ctx.results[idx].valid)
+        ctx.lms->StoreCalibrationValues(ctx.dirTx, ctx.results[idx], ctx.freqs[idx]);
+    commitCacheBatch(ctx, false);
+    return 0;
+}
+
+/*!
+ * Fill the points between two calibrated points.
+ * Points are interpolated when both ends agree within tolerance,
+ * otherwise the interval is bisected and the midpoint is calibrated
+ * with a warm start from the lower neighbor.
+ */
+static void refineInterval(CalSweepContext &ctx, const size_t lo, const size_t hi)
+{
+    if (hi - lo < 2) return;
+    const CalibrationValues &a = ctx.results[lo];
+    const CalibrationValues &b = ctx.results[hi];
+
+    if (a.valid and b.valid and withinTolerance(a, b, ctx.tolerance))
+    {
+        //interpolated values are cached for their frequency without retuning the LO
+        ctx.lms->SetActiveChannel((ctx.chan%2) ? lime::LMS7002M::ChB : lime::LMS7002M::ChA);
+        for (size_t i = lo+1; i < hi; i++)
+        {
+            const double k = double(i - lo)/(hi - lo);
+            CalibrationValues &v = ctx.results[i];
+            v.dcI = interp(a.dcI, b.dcI, k);
+            v.dcQ = interp(a.dcQ, b.dcQ, k);
+            v.gainI = interp(a.gainI, b.gainI, k);
+            v.gainQ = interp(a.gainQ, b.gainQ, k);
+            v.phase = interp(a.phase, b.phase, k);
+            v.valid = true;
+            if (ctx.lms->StoreCalibrationValues(ctx.dirTx, v, ctx.freqs[i]) != 0)
+                std::cerr << "Error caching " << ctx.freqs[i]/1e6 << " MHz: " << LMS_GetLastErrorMessage() << std::endl;
+            ctx.interpolated++;
+            commitCacheBatch(ctx, false);
+        }
+        return;
+    }
+
+    const size_t mid = (lo + hi)/2;
+    calibratePoint(ctx, mid, a.valid ? a : b);
+
+    //check the warm started result against its neighbors, confirm outliers with a cold run
+    const CalibrationValues &m = ctx.results[mid];
+    if (m.valid and a.valid and b.valid and isOutlier(m, a, b, ctx.tolerance))
+    {
+        calibratePoint(ctx, mid, CalibrationValues(), true);
+        ctx.rechecked++;
+    }
+
+    refineInterval(ctx, lo, mid);
+    refineInterval(ctx, mid, hi);
+}
+
+static void calSweepChannel(CalSweepContext &ctx)
+{
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    ctx.results.assign(ctx.freqs.size(), CalibrationValues());
+    ctx.calibrated = ctx.interpolated = ctx.rechecked = ctx.pendingInserts = 0;
+    ctx.lms->BeginValuesCacheBatch();
+
+    //coarse pass, each point seeded by the previous one
+    std::vector<size_t> coarse;
+    for (size_t i = 0; i < ctx.freqs.size(); i += coarseStride) coarse.push_back(i);
+    if (coarse.back() != ctx.freqs.size()-1) coarse.push_back(ctx.freqs.size()-1);
+    CalibrationValues seed;
+    for (const auto idx : coarse)
+    {
+        calibratePoint(ctx, idx, seed);
+        if (ctx.results[idx].valid) seed = ctx.results[idx];
+    }
+
+    //fill in between the coarse points
+    for (size_t i = 1; i < coarse.size(); i++)
+        refineInterval(ctx, coarse[i-1], coarse[i]);
+
+    commitCacheBatch(ctx, true);
+    ctx.lms->EndValuesCacheBatch();
+
+    const auto t1 = std::chrono::high_resolution_clock::now();
+    const double secs = std::chrono::duration<double>(t1-t0).count();
+    std::cout << "@@  " << (ctx.dirTx?"TX":"RX") << " ch" << ctx.chan
+        << ": " << ctx.freqs.size() << " points, "
+        << ctx.calibrated << " calibrated, "
+        << ctx.interpolated << " interpolated, "
+        << ctx.rechecked << " rechecked, "
+        << secs << " s, " << (ctx.freqs.size()*60.0/secs) << " points/min" << std::endl;
+}
 
 int deviceCalSweep(
     const std::string &argStr,
@@ -18,7 +206,9 @@ int deviceCalSweep(
     const double step,
     const double bw,
     const std::string &dirStr,
-    const std::string &chansStr)
+    const std::string &chansStr,
+    const int tolerance,
+    const bool hostCal)
 {
     //check the frequency range
     if (start == 0.0 || stop == 0.0 || step == 0.0)
@@ -79,43 +269,55 @@ int deviceCalSweep(
         LMS_EnableChannel(device, chanConfig.first, chanConfig.second, true);
     }
 
+    CalSweepContext ctx;
+    ctx.device = device;
+    ctx.bw = bw;
+    ctx.flags = hostCal ? 1 : 0;
+    ctx.tolerance = tolerance;
+    for (double freq = start; freq <= stop; freq += step) ctx.freqs.push_back(freq);
+    if (ctx.freqs.empty())
+    {
+        std::cerr << "Empty range --start, stop, step!" << std::endl;
+        LMS_Close(device);
+        return EXIT_FAILURE;
+    }
+
     //summary
-    std::cout << "Cal sweep over [" << start/1e6 << ", " << stop/1e6 << ", " << step/1e6 << "] MHz, channels=" << chansStr << ", dir=" << dirStr << std::endl;
+    std::cout << "Cal sweep over [" << start/1e6 << ", " << stop/1e6 << ", " << step/1e6 << "] MHz, channels=" << chansStr << ", dir=" << dirStr
+        << ", tolerance=" << tolerance << ", searches by " << (hostCal?"host":"MCU") << std::endl;
 
-    for (double freq = start; freq <= stop; freq += step)
+    const auto t0 = std::chrono::high_resolution_clock::now();
+    size_t totalPoints(0), totalCalibrated(0);
+    for (int path = 1; path < 3; path++)
     {
-        std::cout << "@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@" << std::endl;
-        std::cout << "@@  Calibrating for freq = " << freq/1e6 << " MHz" << std::endl;
-        std::cout << "@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@" << std::endl;
-        std::cout << std::endl;
+        //apply identical paths across channels
+        //(BAND1/BAND2 for Tx) (LNAL, LNAW for Rx)
+        for (int i = 0; i < LMS_GetNumChannels(device, LMS_CH_RX); i++)
+            LMS_SetAntenna(device, LMS_CH_RX, i, path+1);
+        for (int i = 0; i < LMS_GetNumChannels(device, LMS_CH_TX); i++)
+            LMS_SetAntenna(device, LMS_CH_TX, i, path);
 
-        for (int path = 1; path < 3; path++)
+        //iterate through the matrix of channel options
+        for (const auto chanConfig : channelMatrix)
         {
-            //apply identical paths across channels
-            //(BAND1/BAND2 for Tx) (LNAL, LNAW for Rx)
-            for (int i = 0; i < LMS_GetNumChannels(device, LMS_CH_RX); i++)
-                LMS_SetAntenna(device, LMS_CH_RX, i, path+1);
-            for (int i = 0; i < LMS_GetNumChannels(device, LMS_CH_TX); i++)
-                LMS_SetAntenna(device, LMS_CH_TX, i, path);
-
-            //iterate through the matrix of channel options
-            for (const auto chanConfig : channelMatrix)
-            {
-                if (LMS_SetLOFrequency(device, chanConfig.first, chanConfig.second, freq) != 0)
-                {
-                    std::cerr << "Error tuning (skipping): " << LMS_GetLastErrorMessage() << std::endl;
-                    continue;
-                }
-                if (LMS_Calibrate(device, chanConfig.first, chanConfig.second, bw, 0) != 0)
-                {
-                    std::cerr << "Error calibrating (skipping): " << LMS_GetLastErrorMessage() << std::endl;
-                    continue;
-                }
-            }
+            std::cout << "@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@" << std::endl;
+            std::cout << "@@  Calibrating " << (chanConfig.first?"TX":"RX") << " ch" << chanConfig.second << ", path " << path << std::endl;
+            std::cout << "@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@" << std::endl;
+            ctx.dirTx = chanConfig.first;
+            ctx.chan = chanConfig.second;
+            ctx.lms = ((LMS7_Device*)device)->GetLMS(ctx.chan/2);
+            calSweepChannel(ctx);
+            totalPoints += ctx.freqs.size();
+            totalCalibrated += ctx.calibrated;
+            std::cout << std::endl;
         }
-        std::cout << std::endl;
     }
 
+    const auto t1 = std::chrono::high_resolution_clock::now();
+    const double secs = std::chrono::duration<double>(t1-t0).count();
+    std::cout << "Cal sweep done: " << totalPoints << " points, " << totalCalibrated << " calibrated in "
+        << secs << " s, " << (totalPoints*60.0/secs) << " points/min" << std::endl;
+
     std::cout << "Cleanup..." << std::endl;
     LMS_Close(device);
     return EXIT_SUCCESS;
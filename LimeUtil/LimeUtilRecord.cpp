@@ -0,0 +1,199 @@
+/**
+    @file LimeUtilRecord.cpp
+    @author Lime Microsystems
+    @brief Record Rx stream to disk, play back files on Tx and share Rx with local processes
+*/
+
+#include <ConnectionRegistry.h>
+#include <IConnection.h>
+#include <LMS7002M.h>
+#include <StreamRecorder.h>
+#include <WaveformFile.h>
+#include <SharedStream.h>
+#include <ErrorReporting.h>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <csignal>
+
+using namespace lime;
+
+static std::atomic<bool> stopRequested(false);
+
+static void sigIntHandler(const int)
+{
+    stopRequested.store(true);
+}
+
+static std::vector<size_t> parseChannels(const std::string &chansStr)
+{
+    std::vector<size_t> channels;
+    if (chansStr == "ALL")
+        return {0, 1};
+    size_t pos = 0;
+    while (pos < chansStr.size())
+    {
+        size_t end = chansStr.find(',', pos);
+        if (end == std::string::npos)
+            end = chansStr.size();
+        channels.push_back(std::stoi(chansStr.substr(pos, end-pos)));
+        pos = end+1;
+    }
+    return channels;
+}
+
+static IConnection* connect(const std::string &argStr)
+{
+    auto handles = ConnectionRegistry::findConnections(argStr);
+    if(handles.size() == 0)
+    {
+        std::cout << "No devices found" << std::endl;
+        return nullptr;
+    }
+    std::cout << "Connected to [" << handles[0].serialize() << "]" << std::endl;
+    return ConnectionRegistry::makeConnection(handles[0]);
+}
+
+int deviceRecord(
+    const std::string &argStr,
+    const std::string &filename,
+    const std::string &chansStr,
+    const double duration,
+    const bool pack)
+{
+    auto conn = connect(argStr);
+    if (conn == nullptr)
+        return EXIT_FAILURE;
+
+    StreamRecorder::Config config;
+    config.channels = parseChannels(chansStr);
+    config.pack12 = pack;
+    {
+        //sampling parameters for the metadata, device is expected to be configured already
+        LMS7002M lms7;
+        lms7.SetConnection(conn);
+        config.sampleRate = lms7.GetSampleRate(false, LMS7002M::ChA);
+        config.frequency = lms7.GetFrequencySX(false);
+    }
+    if (duration > 0)
+        config.preallocateSamples = uint64_t(duration*config.sampleRate);
+
+    StreamRecorder recorder(conn);
+    if (recorder.Start(filename, config) != 0)
+    {
+        std::cout << "Recording failed! : " << GetLastErrorMessage() << std::endl;
+        ConnectionRegistry::freeConnection(conn);
+        return EXIT_FAILURE;
+    }
+    std::cout << "Recording " << config.sampleRate/1e6 << " MSps to " << filename << ", press Ctrl+C to stop" << std::endl;
+
+    stopRequested.store(false);
+    std::signal(SIGINT, sigIntHandler);
+    const auto t0 = std::chrono::steady_clock::now();
+    while (!stopRequested.load() && recorder.IsRunning())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+        if (duration > 0 && elapsed >= duration)
+            break;
+        auto stats = recorder.GetStats();
+        printf("%.1f s: %llu samples, %llu dropped\r", elapsed,
+            (unsigned long long)stats.samplesRecorded, (unsigned long long)stats.samplesDropped);
+    }
+    std::signal(SIGINT, SIG_DFL);
+
+    const int status = recorder.Stop();
+    const auto stats = recorder.GetStats();
+    std::cout << std::endl << "Recorded " << stats.samplesRecorded << " samples, "
+        << stats.samplesDropped << " dropped, " << stats.annotations << " annotations" << std::endl;
+    if (status != 0)
+        std::cout << "Recording failed! : " << GetLastErrorMessage() << std::endl;
+    ConnectionRegistry::freeConnection(conn);
+    return (status==0)?EXIT_SUCCESS:EXIT_FAILURE;
+}
+
+int devicePlay(
+    const std::string &argStr,
+    const std::string &filename,
+    const std::string &chansStr,
+    const double duration,
+    const bool loop)
+{
+    auto conn = connect(argStr);
+    if (conn == nullptr)
+        return EXIT_FAILURE;
+
+    WaveformPlayer player(conn);
+    if (player.Start(filename, parseChannels(chansStr), loop) != 0)
+    {
+        std::cout << "Playback failed! : " << GetLastErrorMessage() << std::endl;
+        ConnectionRegistry::freeConnection(conn);
+        return EXIT_FAILURE;
+    }
+    std::cout << "Playing " << filename << ", press Ctrl+C to stop" << std::endl;
+
+    stopRequested.store(false);
+    std::signal(SIGINT, sigIntHandler);
+    const auto t0 = std::chrono::steady_clock::now();
+    while (!stopRequested.load() && player.IsRunning())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (duration > 0 && std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count() >= duration)
+            break;
+    }
+    std::signal(SIGINT, SIG_DFL);
+    player.Stop();
+    ConnectionRegistry::freeConnection(conn);
+    return EXIT_SUCCESS;
+}
+
+int deviceShare(
+    const std::string &argStr,
+    const std::string &name,
+    const std::string &chansStr,
+    const double duration)
+{
+    auto conn = connect(argStr);
+    if (conn == nullptr)
+        return EXIT_FAILURE;
+
+    SharedStreamPublisher::Config config;
+    config.channels = parseChannels(chansStr);
+    {
+        LMS7002M lms7;
+        lms7.SetConnection(conn);
+        config.sampleRate = lms7.GetSampleRate(false, LMS7002M::ChA);
+    }
+
+    SharedStreamPublisher publisher(conn);
+    if (publisher.Start(name, config) != 0)
+    {
+        std::cout << "Sharing failed! : " << GetLastErrorMessage() << std::endl;
+        ConnectionRegistry::freeConnection(conn);
+        return EXIT_FAILURE;
+    }
+    std::cout << "Publishing " << config.sampleRate/1e6 << " MSps to shared memory " << name << ", press Ctrl+C to stop" << std::endl;
+
+    stopRequested.store(false);
+    std::signal(SIGINT, sigIntHandler);
+    const auto t0 = std::chrono::steady_clock::now();
+    while (!stopRequested.load() && publisher.IsRunning())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+        if (duration > 0 && elapsed >= duration)
+            break;
+        auto stats = publisher.GetStats();
+        printf("%.1f s: %llu samples, %llu dropped\r", elapsed,
+            (unsigned long long)stats.samplesPublished, (unsigned long long)stats.samplesDropped);
+    }
+    std::signal(SIGINT, SIG_DFL);
+
+    publisher.Stop();
+    const auto stats = publisher.GetStats();
+    std::cout << std::endl << "Published " << stats.samplesPublished << " samples, "
+        << stats.samplesDropped << " dropped" << std::endl;
+    ConnectionRegistry::freeConnection(conn);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,64 @@
+/**
+    @file LimeUtilServe.cpp
+    @author Lime Microsystems
+    @brief Share local device over network
+*/
+
+#include <ConnectionRegistry.h>
+#include <IConnection.h>
+#include <LimeSuiteServer.h>
+#include <ErrorReporting.h>
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+
+using namespace lime;
+
+static std::atomic<bool> stopRequested(false);
+
+static void sigIntHandler(const int)
+{
+    stopRequested.store(true);
+}
+
+int deviceServe(const std::string &argStr, const int port, const std::string &host)
+{
+    auto handles = ConnectionRegistry::findConnections(argStr);
+    if(handles.size() == 0)
+    {
+        std::cout << "No devices found" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Connected to [" << handles[0].serialize() << "]" << std::endl;
+    auto conn = ConnectionRegistry::makeConnection(handles[0]);
+
+    LimeSuiteServer server(conn);
+    if (server.Start(port, host) != 0)
+    {
+        std::cout << "Server failed! : " << GetLastErrorMessage() << std::endl;
+        ConnectionRegistry::freeConnection(conn);
+        return EXIT_FAILURE;
+    }
+    std::cout << "Serving on " << (host.empty() ? "all interfaces" : host) << " port " << port
+        << ", connect with --args=\"addr=udp://<host>:" << port << "\", press Ctrl+C to stop" << std::endl;
+
+    stopRequested.store(false);
+    std::signal(SIGINT, sigIntHandler);
+    while (!stopRequested.load())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        auto stats = server.GetStats();
+        printf("clients: %u, streaming: %s, rx packets: %llu, tx packets: %llu, tx lost: %llu    \r",
+            stats.clients, stats.streaming ? "yes" : "no", (unsigned long long)stats.rxPackets,
+            (unsigned long long)stats.txPackets, (unsigned long long)stats.txLost);
+        fflush(stdout);
+    }
+    std::signal(SIGINT, SIG_DFL);
+    std::cout << std::endl;
+    server.Stop();
+    ConnectionRegistry::freeConnection(conn);
+    return EXIT_SUCCESS;
+}
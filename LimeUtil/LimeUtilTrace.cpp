@@ -0,0 +1,364 @@
+/**
+    @file LimeUtilTrace.cpp
+    @author Lime Microsystems
+    @brief Control trace analysis and replay
+*/
+
+#include <ConnectionRegistry.h>
+#include <IConnection.h>
+#include <LMS64CProtocol.h>
+#include <ControlTrace.h>
+#include <ErrorReporting.h>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <map>
+#include <set>
+#include <algorithm>
+
+using namespace lime;
+
+namespace
+{
+
+const char* commandName(const uint8_t cmd)
+{
+    switch (cmd)
+    {
+    case CMD_GET_INFO: return "GET_INFO";
+    case CMD_SI5356_WR: return "SI5356_WR";
+    case CMD_SI5356_RD: return "SI5356_RD";
+    case CMD_SI5351_WR: return "SI5351_WR";
+    case CMD_SI5351_RD: return "SI5351_RD";
+    case CMD_LMS7002_RST: return "LMS7002_RST";
+    case CMD_LMS7002_WR: return "LMS7002_WR";
+    case CMD_LMS7002_RD: return "LMS7002_RD";
+    case CMD_PROG_MCU: return "PROG_MCU";
+    case CMD_ADF4002_WR: return "ADF4002_WR";
+    case CMD_USB_FIFO_RST: return "USB_FIFO_RST";
+    case CMD_GPIO_DIR_WR: return "GPIO_DIR_WR";
+    case CMD_GPIO_DIR_RD: return "GPIO_DIR_RD";
+    case CMD_GPIO_WR: return "GPIO_WR";
+    case CMD_GPIO_RD: return "GPIO_RD";
+    case CMD_ALTERA_FPGA_GW_WR: return "ALTERA_FPGA_GW_WR";
+    case CMD_ALTERA_FPGA_GW_RD: return "ALTERA_FPGA_GW_RD";
+    case CMD_BRDSPI_WR: return "BRDSPI_WR";
+    case CMD_BRDSPI_RD: return "BRDSPI_RD";
+    case CMD_BRDSPI8_WR: return "BRDSPI8_WR";
+    case CMD_BRDSPI8_RD: return "BRDSPI8_RD";
+    case CMD_BRDCONF_WR: return "BRDCONF_WR";
+    case CMD_BRDCONF_RD: return "BRDCONF_RD";
+    case CMD_ANALOG_VAL_WR: return "ANALOG_VAL_WR";
+    case CMD_ANALOG_VAL_RD: return "ANALOG_VAL_RD";
+    case CMD_MEMORY_WR: return "MEMORY_WR";
+    case CMD_MEMORY_RD: return "MEMORY_RD";
+    default: return "UNKNOWN";
+    }
+}
+
+struct LatencyStats
+{
+    LatencyStats() : count(0), total(0) {}
+    void Add(const uint32_t ns) { ++count; total += ns; samples.push_back(ns); }
+    double Percentile(const int p)
+    {
+        if (samples.empty())
+            return 0;
+        std::sort(samples.begin(), samples.end());
+        return samples[(samples.size()-1)*p/100];
+    }
+    uint64_t count;
+    uint64_t total; //!< nanoseconds
+    std::vector<uint32_t> samples;
+};
+
+struct CallStats
+{
+    CallStats() : transfers(0), redundantReads(0), busy(0), span(0) {}
+    std::set<uint32_t> calls;
+    uint64_t transfers;
+    uint64_t redundantReads;
+    uint64_t busy; //!< nanoseconds spent in transfers
+    uint64_t span; //!< nanoseconds from first transfer start to last transfer end of each call
+};
+
+/** @brief Finds registers read again with no write to them in between.
+    Registers above 0x00FF of LMS7002M are tracked per MAC channel selection.
+*/
+class RedundantReadTracker
+{
+public:
+    //returns number of redundant register reads in record
+    int Process(const ControlTrace::Record& rec)
+    {
+        int redundant = 0;
+        const bool lms = rec.cmd == CMD_LMS7002_WR || rec.cmd == CMD_LMS7002_RD;
+        if (rec.cmd == CMD_LMS7002_WR || rec.cmd == CMD_BRDSPI_WR)
+        {
+            for (size_t i = 0; i+3 < rec.out.size(); i += 4)
+            {
+                const uint16_t addr = ((rec.out[i] << 8) | rec.out[i+1]) & 0x7FFF;
+                mReadMask[Key(lms, rec.periphID, addr)] = 0;
+                if (lms && addr == 0x0020)
+                    mMAC[rec.periphID] = rec.out[i+3] & 0x3;
+            }
+        }
+        else if (rec.cmd == CMD_LMS7002_RD || rec.cmd == CMD_BRDSPI_RD)
+        {
+            for (size_t i = 0; i+1 < rec.out.size(); i += 2)
+            {
+                const uint16_t addr = ((rec.out[i] << 8) | rec.out[i+1]) & 0x7FFF;
+                const int mac = (lms && addr >= 0x0100) ? mMAC[rec.periphID] : 0;
+                uint8_t& mask = mReadMask[Key(lms, rec.periphID, addr)];
+                if (mask & (1 << mac))
+                {
+                    ++redundant;
+                    ++registers[Key(lms, rec.periphID, addr)];
+                }
+                mask |= (1 << mac);
+                if (lms && addr == 0x0020 && 2*i+3 < rec.in.size())
+                    mMAC[rec.periphID] = rec.in[2*i+3] & 0x3;
+            }
+        }
+        return redundant;
+    }
+
+    static uint32_t Key(const bool lms, const uint8_t periphID, const uint16_t addr)
+    {
+        return (lms ? 0 : 1u << 31) | (uint32_t(periphID) << 16) | addr;
+    }
+
+    std::map<uint32_t, uint64_t> registers; //!< redundant reads count by key
+private:
+    std::map<uint32_t, uint8_t> mReadMask; //!< MAC selections read since last write
+    std::map<uint8_t, int> mMAC;
+};
+
+bool isReadCommand(const uint8_t cmd)
+{
+    return cmd == CMD_LMS7002_RD || cmd == CMD_BRDSPI_RD;
+}
+
+//commands changing device flash or gateware are never replayed
+bool isReplaySafe(const uint8_t cmd)
+{
+    return cmd != CMD_MEMORY_WR && cmd != CMD_ALTERA_FPGA_GW_WR && cmd != CMD_BRDCONF_WR && cmd != CMD_PROG_MCU;
+}
+
+}
+
+int deviceTraceReport(const std::string &filename)
+{
+    std::vector<ControlTrace::Record> records;
+    if (ControlTrace::Load(filename, records) != 0)
+    {
+        std::cout << "Failed to load trace: " << GetLastErrorMessage() << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (records.empty())
+    {
+        std::cout << "Trace is empty" << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    std::map<std::string, CallStats> calls;
+    std::map<uint8_t, LatencyStats> commands;
+    std::set<uint32_t> threads;
+    RedundantReadTracker tracker;
+    std::map<uint32_t, std::pair<uint64_t, uint64_t>> callSpans; //first start, last end
+    uint64_t busy = 0, redundantTotal = 0, failed = 0;
+    for (const auto& rec : records)
+    {
+        const std::string label = rec.label.empty() ? "(outside API calls)" : rec.label;
+        CallStats& call = calls[label];
+        call.calls.insert(rec.callId);
+        ++call.transfers;
+        call.busy += rec.duration;
+        const int redundant = tracker.Process(rec);
+        call.redundantReads += redundant;
+        redundantTotal += redundant;
+        commands[rec.cmd].Add(rec.duration);
+        threads.insert(rec.threadId);
+        busy += rec.duration;
+        if (rec.status != STATUS_COMPLETED_CMD)
+            ++failed;
+        if (rec.callId != 0)
+        {
+            auto iter = callSpans.find(rec.callId);
+            if (iter == callSpans.end())
+                callSpans[rec.callId] = std::make_pair(rec.timestamp, rec.timestamp + rec.duration);
+            else
+                iter->second.second = rec.timestamp + rec.duration;
+        }
+    }
+    for (const auto& rec : records)
+    {
+        auto iter = callSpans.find(rec.callId);
+        if (rec.callId == 0 || iter == callSpans.end())
+            continue;
+        calls[rec.label].span += iter->second.second - iter->second.first;
+        callSpans.erase(iter);
+    }
+
+    const double traceLength = (records.back().timestamp + records.back().duration - records.front().timestamp)/1e9;
+    std::cout << "Trace " << filename << ": " << records.size() << " transfers, "
+        << threads.size() << " threads, " << traceLength << " s, "
+        << busy/1e6 << " ms in transfers, " << failed << " not completed" << std::endl;
+    std::cout << std::fixed << std::setprecision(3);
+
+    std::cout << std::endl << "Transfers by API call:" << std::endl;
+    std::cout << "  " << std::left << std::setw(28) << "call" << std::right << std::setw(8) << "calls"
+        << std::setw(11) << "transfers" << std::setw(10) << "per call" << std::setw(13) << "transfer ms"
+        << std::setw(11) << "span ms" << std::setw(11) << "redundant" << std::endl;
+    std::vector<std::pair<std::string, CallStats>> sortedCalls(calls.begin(), calls.end());
+    std::sort(sortedCalls.begin(), sortedCalls.end(), [](const std::pair<std::string, CallStats>& a, const std::pair<std::string, CallStats>& b)
+    {
+        return a.second.busy > b.second.busy;
+    });
+    for (const auto& c : sortedCalls)
+    {
+        const CallStats& s = c.second;
+        const bool outside = c.first[0] == '(';
+        std::cout << "  " << std::left << std::setw(28) << c.first << std::right;
+        if (outside)
+            std::cout << std::setw(8) << "-";
+        else
+            std::cout << std::setw(8) << s.calls.size();
+        std::cout << std::setw(11) << s.transfers;
+        if (outside)
+            std::cout << std::setw(10) << "-";
+        else
+            std::cout << std::setw(10) << double(s.transfers)/s.calls.size();
+        std::cout << std::setw(13) << s.busy/1e6;
+        if (outside)
+            std::cout << std::setw(11) << "-";
+        else
+            std::cout << std::setw(11) << s.span/1e6;
+        std::cout << std::setw(11) << s.redundantReads << std::endl;
+    }
+
+    std::cout << std::endl << "Latency by command:" << std::endl;
+    std::cout << "  " << std::left << std::setw(20) << "command" << std::right << std::setw(10) << "count"
+        << std::setw(12) << "total ms" << std::setw(12) << "p50 us" << std::setw(12) << "p99 us" << std::setw(12) << "max us" << std::endl;
+    for (auto& c : commands)
+    {
+        LatencyStats& s = c.second;
+        std::cout << "  " << std::left << std::setw(20) << commandName(c.first) << std::right
+            << std::setw(10) << s.count << std::setw(12) << s.total/1e6
+            << std::setw(12) << s.Percentile(50)/1e3 << std::setw(12) << s.Percentile(99)/1e3
+            << std::setw(12) << s.Percentile(100)/1e3 << std::endl;
+    }
+
+    std::cout << std::endl << "Redundant reads (register read again with no write in between): " << redundantTotal << std::endl;
+    if (redundantTotal > 0)
+    {
+        std::cout << "  status and read-only registers can change without writes, check before removing reads" << std::endl;
+        std::vector<std::pair<uint32_t, uint64_t>> regs(tracker.registers.begin(), tracker.registers.end());
+        std::sort(regs.begin(), regs.end(), [](const std::pair<uint32_t, uint64_t>& a, const std::pair<uint32_t, uint64_t>& b)
+        {
+            return a.second > b.second;
+        });
+        if (regs.size() > 20)
+            regs.resize(20);
+        for (const auto& r : regs)
+        {
+            const bool lms = (r.first & (1u << 31)) == 0;
+            std::cout << "  " << (lms ? "LMS7002M" : "FPGA    ") << " [" << ((r.first >> 16) & 0xFF) << "] 0x"
+                << std::hex << std::setw(4) << std::setfill('0') << (r.first & 0xFFFF)
+                << std::dec << std::setfill(' ') << ": " << r.second << std::endl;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+/** Replays safe transfers and compares timing and read values with the trace.
+    Read values are expected to match only when the board starts from the same
+    state as when the trace was recorded, e.g. after the same configuration load.
+*/
+int deviceTraceReplay(const std::string &argStr, const std::string &filename)
+{
+    std::vector<ControlTrace::Record> records;
+    if (ControlTrace::Load(filename, records) != 0)
+    {
+        std::cout << "Failed to load trace: " << GetLastErrorMessage() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    auto handles = ConnectionRegistry::findConnections(argStr);
+    if(handles.size() == 0)
+    {
+        std::cout << "No devices found" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Connected to [" << handles[0].serialize() << "]" << std::endl;
+    auto conn = ConnectionRegistry::makeConnection(handles[0]);
+    auto port = dynamic_cast<LMS64CProtocol*>(conn);
+    if (port == nullptr || not conn->IsOpen())
+    {
+        std::cout << "Connection does not accept control packets" << std::endl;
+        ConnectionRegistry::freeConnection(conn);
+        return EXIT_FAILURE;
+    }
+
+    LatencyStats original, replayed;
+    uint64_t skipped = 0, failed = 0, mismatched = 0;
+    std::map<uint32_t, uint64_t> mismatchedRegisters;
+    LMS64CProtocol::GenericPacket pkt;
+    for (const auto& rec : records)
+    {
+        if (not isReplaySafe(rec.cmd))
+        {
+            ++skipped;
+            continue;
+        }
+        pkt.cmd = eCMD_LMS(rec.cmd);
+        pkt.status = STATUS_UNDEFINED;
+        pkt.periphID = rec.periphID;
+        pkt.outBuffer.assign(rec.out.begin(), rec.out.end());
+        pkt.inBuffer.clear();
+        const uint64_t t0 = ControlTrace::Now();
+        const int status = port->TransferPacket(pkt);
+        const uint64_t t1 = ControlTrace::Now();
+        original.Add(rec.duration);
+        replayed.Add(t1-t0);
+        if (status != 0 || pkt.status != STATUS_COMPLETED_CMD)
+        {
+            //transfers failing in trace too are expected to fail again
+            if (rec.status == STATUS_COMPLETED_CMD)
+                ++failed;
+            continue;
+        }
+        if (not isReadCommand(rec.cmd))
+            continue;
+        //compare register values, address and value pairs
+        bool differs = false;
+        for (size_t i = 0; i+3 < rec.in.size() && i+3 < pkt.inBuffer.size(); i += 4)
+        {
+            if (rec.in[i+2] == pkt.inBuffer[i+2] && rec.in[i+3] == pkt.inBuffer[i+3])
+                continue;
+            differs = true;
+            const uint16_t addr = ((rec.out[i/2] << 8) | rec.out[i/2+1]) & 0x7FFF;
+            ++mismatchedRegisters[RedundantReadTracker::Key(rec.cmd == CMD_LMS7002_RD, rec.periphID, addr)];
+        }
+        if (differs)
+            ++mismatched;
+    }
+    ConnectionRegistry::freeConnection(conn);
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "Replayed " << replayed.count << " of " << records.size() << " transfers, "
+        << skipped << " programming transfers skipped, " << failed << " failed to complete" << std::endl;
+    std::cout << "  transfer time: trace " << original.total/1e6 << " ms, replay " << replayed.total/1e6 << " ms" << std::endl;
+    std::cout << "  p50 latency: trace " << original.Percentile(50)/1e3 << " us, replay " << replayed.Percentile(50)/1e3 << " us" << std::endl;
+    std::cout << "  p99 latency: trace " << original.Percentile(99)/1e3 << " us, replay " << replayed.Percentile(99)/1e3 << " us" << std::endl;
+    std::cout << "  reads returning different values: " << mismatched
+        << " (comparable only if the board started in the same state as traced)" << std::endl;
+    for (const auto& r : mismatchedRegisters)
+    {
+        const bool lms = (r.first & (1u << 31)) == 0;
+        std::cout << "    " << (lms ? "LMS7002M" : "FPGA    ") << " [" << ((r.first >> 16) & 0xFF) << "] 0x"
+            << std::hex << std::setw(4) << std::setfill('0') << (r.first & 0xFFFF)
+            << std::dec << std::setfill(' ') << ": " << r.second << std::endl;
+    }
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
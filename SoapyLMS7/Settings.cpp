@@ -1036,10 +1036,18 @@ std::string SoapyLMS7::readSensor(const std::string &name) const
     throw std::runtime_error("SoapyLMS7::readSensor("+name+") - unknown sensor name");
 }
 
-std::vector<std::string> SoapyLMS7::listSensors(const int /*direction*/, const size_t /*channel*/) const
+std::vector<std::string> SoapyLMS7::listSensors(const int direction, const size_t /*channel*/) const
 {
     std::vector<std::string> sensors;
     sensors.push_back("lo_locked");
+    if (direction == SOAPY_SDR_RX)
+    {
+        sensors.push_back("power");
+        sensors.push_back("peak");
+        sensors.push_back("dc_i");
+        sensors.push_back("dc_q");
+        sensors.push_back("clipped");
+    }
     return sensors;
 }
 
@@ -1054,6 +1062,31 @@ SoapySDR::ArgInfo SoapyLMS7::getSensorInfo(const int direction, const size_t cha
         info.value = "false";
         info.description = "LO synthesizer is locked, good VCO selection.";
     }
+    else if (name == "power" || name == "peak")
+    {
+        info.key = name;
+        info.name = name == "power" ? "Mean Power" : "Peak Power";
+        info.type = SoapySDR::ArgInfo::FLOAT;
+        info.value = "-200.0";
+        info.units = "dBFS";
+        info.description = "Received signal level over the meters window of active stream.";
+    }
+    else if (name == "dc_i" || name == "dc_q")
+    {
+        info.key = name;
+        info.name = name == "dc_i" ? "DC I" : "DC Q";
+        info.type = SoapySDR::ArgInfo::FLOAT;
+        info.value = "0.0";
+        info.description = "Mean value of received samples over the meters window, relative to full scale.";
+    }
+    else if (name == "clipped")
+    {
+        info.key = name;
+        info.name = "Clipped Samples";
+        info.type = SoapySDR::ArgInfo::INT;
+        info.value = "0";
+        info.description = "Number of full scale samples in the meters window.";
+    }
     return info;
 }
 
@@ -1067,6 +1100,18 @@ std::string SoapyLMS7::readSensor(const int direction, const size_t channel, con
     {
         return rfic->GetSXLocked(lmsDir)?"true":"false";
     }
+    if (direction == SOAPY_SDR_RX && (name == "power" || name == "peak" || name == "dc_i" || name == "dc_q" || name == "clipped"))
+    {
+        lime::StreamMeters meters;
+        auto it = _rxStreamIDs.find(channel);
+        if (it != _rxStreamIDs.end())
+            _conn->ReadStreamMeters(it->second, meters);
+        if (name == "power") return std::to_string(meters.power);
+        if (name == "peak") return std::to_string(meters.peak);
+        if (name == "dc_i") return std::to_string(meters.dcI);
+        if (name == "dc_q") return std::to_string(meters.dcQ);
+        return std::to_string(meters.clipped);
+    }
 
     throw std::runtime_error("SoapyLMS7::readSensor("+name+") - unknown sensor name");
 }
@@ -1209,6 +1254,11 @@ void SoapyLMS7::writeSetting(const std::string &key, const std::string &value)
         auto rfic = getRFIC(0);
         rfic->LoadConfig(value.c_str());
     }
+    else if (key == "STREAM_MEMORY_BUDGET")
+    {
+        if (_conn->SetStreamMemoryBudget(std::stoull(value)) != 0)
+            throw std::runtime_error(lime::GetLastErrorMessage());
+    }
 
     else throw std::runtime_error("unknown setting key: "+key);
 }
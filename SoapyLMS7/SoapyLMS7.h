@@ -285,5 +285,6 @@ private:
     lime::LMS7002M *getRFIC(const size_t channel) const;
     std::vector<lime::LMS7002M *> _rfics;
     std::set<std::pair<int, size_t>> _channelsToCal;
+    std::map<size_t, size_t> _rxStreamIDs; //channel to stream, for Rx meters sensors
     mutable std::recursive_mutex _accessMutex;
 };
@@ -24,6 +24,7 @@ struct IConnectionStream
     int direction;
     size_t elemSize;
     size_t elemMTU;
+    double tickRate; //!< timestamp rate of channelizer streams, 0 for device rate
 
     //rx cmd requests
     bool hasCmd;
@@ -41,6 +42,7 @@ std::vector<std::string> SoapyLMS7::getStreamFormats(const int direction, const
     formats.push_back(SOAPY_SDR_CF32);
     formats.push_back(SOAPY_SDR_CS12);
     formats.push_back(SOAPY_SDR_CS16);
+    formats.push_back(SOAPY_SDR_CS8);
     return formats;
 }
 
@@ -66,6 +68,84 @@ SoapySDR::ArgInfoList SoapyLMS7::getStreamArgsInfo(const int direction, const si
         argInfos.push_back(info);
     }
 
+    //buffer time
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "0";
+        info.key = "bufferTime";
+        info.name = "Buffer Time";
+        info.description = "Buffering time at current sample rate, used when buffer length is 0.";
+        info.units = "ms";
+        info.type = SoapySDR::ArgInfo::INT;
+        argInfos.push_back(info);
+    }
+
+    //packed storage
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "false";
+        info.key = "packedStorage";
+        info.name = "Packed Storage";
+        info.description = "Keep buffered samples packed to 12 bits, uses 25% less memory.";
+        info.type = SoapySDR::ArgInfo::BOOL;
+        argInfos.push_back(info);
+    }
+
+    //transfer buffers
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "0";
+        info.key = "transferBuffers";
+        info.name = "Transfer Buffers";
+        info.description = "Number of data transfers kept in flight (PCIe), 0 for default.";
+        info.type = SoapySDR::ArgInfo::INT;
+        argInfos.push_back(info);
+    }
+
+    //meters window
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "0";
+        info.key = "metersWindow";
+        info.name = "Meters Window";
+        info.description = "Samples per power/peak/DC/clipping measurement of Rx channel sensors, 0 for about 10 ms starting with the first sensor read.";
+        info.units = "samples";
+        info.type = SoapySDR::ArgInfo::INT;
+        argInfos.push_back(info);
+    }
+
+    //channelizer
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "0";
+        info.key = "channelizerRate";
+        info.name = "Channelizer Rate";
+        info.description = "Rx only: resample the band around channelizer offset to this rate on the host, CF32 format, 0 to disable.";
+        info.units = "Hz";
+        info.type = SoapySDR::ArgInfo::FLOAT;
+        argInfos.push_back(info);
+    }
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "0";
+        info.key = "channelizerOffset";
+        info.name = "Channelizer Offset";
+        info.description = "Channelizer band center relative to the channel center frequency.";
+        info.units = "Hz";
+        info.type = SoapySDR::ArgInfo::FLOAT;
+        argInfos.push_back(info);
+    }
+    {
+        SoapySDR::ArgInfo info;
+        info.value = "0";
+        info.key = "channelizerBandwidth";
+        info.name = "Channelizer Bandwidth";
+        info.description = "Channelizer passband width, 0 for 80% of channelizer rate.";
+        info.units = "Hz";
+        info.type = SoapySDR::ArgInfo::FLOAT;
+        argInfos.push_back(info);
+    }
+
     //link format
     {
         SoapySDR::ArgInfo info;
@@ -100,6 +180,7 @@ SoapySDR::Stream *SoapyLMS7::setupStream(
     stream->direction = direction;
     stream->elemSize = SoapySDR::formatToSize(format);
     stream->hasCmd = false;
+    stream->tickRate = 0;
 
     StreamConfig config;
     config.isTx = (direction == SOAPY_SDR_TX);
@@ -113,7 +194,8 @@ SoapySDR::Stream *SoapyLMS7::setupStream(
         config.channelID = channelIDs[i];
         if (format == SOAPY_SDR_CF32) config.format = StreamConfig::STREAM_COMPLEX_FLOAT32;
         else if (format == SOAPY_SDR_CS16) config.format = StreamConfig::STREAM_12_BIT_IN_16;
-        else if (format == SOAPY_SDR_CS12) config.format = StreamConfig::STREAM_12_BIT_COMPRESSED;
+        else if (format == SOAPY_SDR_CS12) config.format = StreamConfig::STREAM_12_BIT_PACKED;
+        else if (format == SOAPY_SDR_CS8) config.format = StreamConfig::STREAM_8_BIT;
         else throw std::runtime_error("SoapyLMS7::setupStream(format="+format+") unsupported format");
 
         //optional buffer length if specified
@@ -121,6 +203,40 @@ SoapySDR::Stream *SoapyLMS7::setupStream(
         {
             config.bufferLength = std::stoul(args.at("bufferLength"));
         }
+        //optional buffering time, used when buffer length is not specified
+        if (args.count("bufferTime") != 0)
+        {
+            config.bufferTime_ms = std::stoul(args.at("bufferTime"));
+        }
+        //optional packed storage of samples in buffers
+        if (args.count("packedStorage") != 0)
+        {
+            config.packedStorage = args.at("packedStorage") == "true";
+        }
+        //optional number of transfers in flight
+        if (args.count("transferBuffers") != 0)
+        {
+            config.transferBuffers = std::stoul(args.at("transferBuffers"));
+        }
+        //optional signal meters window
+        if (args.count("metersWindow") != 0)
+        {
+            config.metersWindow = std::stoul(args.at("metersWindow"));
+        }
+        //optional host side channelizer, several streams can split one channel
+        if (args.count("channelizerRate") != 0)
+        {
+            config.channelizerRate = std::stod(args.at("channelizerRate"));
+            stream->tickRate = config.channelizerRate;
+        }
+        if (args.count("channelizerOffset") != 0)
+        {
+            config.channelizerOffset = std::stod(args.at("channelizerOffset"));
+        }
+        if (args.count("channelizerBandwidth") != 0)
+        {
+            config.channelizerBandwidth = std::stod(args.at("channelizerBandwidth"));
+        }
         //optional packets latency, 0-maximum throughput, 1-lowest latency
         if (args.count("latency") != 0)
         {
@@ -138,6 +254,9 @@ SoapySDR::Stream *SoapyLMS7::setupStream(
             throw std::runtime_error("SoapyLMS7::setupStream() failed: " + std::string(GetLastErrorMessage()));
         stream->streamID.push_back(streamID);
         stream->elemMTU = _conn->GetStreamSize(streamID);
+        //channelizer outputs have no meters
+        if (direction == SOAPY_SDR_RX && config.channelizerRate == 0)
+            _rxStreamIDs[channelIDs[i]] = streamID;
     }
 
     //calibrate these channels when activated
@@ -156,7 +275,15 @@ void SoapyLMS7::closeStream(SoapySDR::Stream *stream)
     const auto &streamID = icstream->streamID;
 
     for(auto i : streamID)
+    {
+        for (auto it = _rxStreamIDs.begin(); it != _rxStreamIDs.end(); ++it)
+            if (it->second == i)
+            {
+                _rxStreamIDs.erase(it);
+                break;
+            }
         _conn->CloseStream(i);
+    }
 }
 
 size_t SoapyLMS7::getStreamMTU(SoapySDR::Stream *stream) const
@@ -261,46 +388,31 @@ int SoapyLMS7::readStream(
         numElems = std::min(numElems, icstream->elemMTU);
     }
 
-    ReadStreamAgain:
+    //the command had a time, FIFO skips samples until it arrives
     StreamMetadata metadata;
+    const double tickRate = icstream->tickRate > 0 ? icstream->tickRate : _conn->GetHardwareTimestampRate();
+    const bool timedRead = (icstream->flags & SOAPY_SDR_HAS_TIME) != 0;
+    const uint64_t cmdTicks = timedRead ? SoapySDR::timeNsToTicks(icstream->timeNs, tickRate) : 0;
+    metadata.hasTimestamp = timedRead;
+    metadata.timestamp = cmdTicks;
     int status = 0;
     int bufIndex = 0;
     for(auto i : streamID)
     {
+        //following channels are read from the timestamp of the first one
         status = _conn->ReadStream(i, buffs[bufIndex++], numElems, timeoutUs/1000, metadata);
         if(status == 0) return SOAPY_SDR_TIMEOUT;
         if(status < 0) return SOAPY_SDR_STREAM_ERROR;
     }
 
-    //the command had a time, so we need to compare it to received time
-    if ((icstream->flags & SOAPY_SDR_HAS_TIME) != 0 and metadata.hasTimestamp)
+    if (timedRead)
     {
-        const uint64_t cmdTicks = SoapySDR::timeNsToTicks(icstream->timeNs, _conn->GetHardwareTimestampRate());
-
         //our request time is now late, clear command and return error code
         if (cmdTicks < metadata.timestamp)
         {
             icstream->hasCmd = false;
             return SOAPY_SDR_TIME_ERROR;
         }
-
-        //our request time is not in this received buffer, try again
-        if (cmdTicks >= (metadata.timestamp + status))
-        {
-            if (std::chrono::high_resolution_clock::now() > exitTime) return SOAPY_SDR_TIMEOUT;
-            goto ReadStreamAgain;
-        }
-
-        //otherwise our request is in this buffer, advance memory
-        const size_t numOff = (cmdTicks - metadata.timestamp);
-        metadata.timestamp += numOff;
-        status -= numOff;
-        const size_t elemSize = icstream->elemSize;
-        for (size_t i = 0; i < streamID.size(); i++)
-        {
-            const size_t memStart = size_t(buffs[i])+(numOff*elemSize);
-            std::memmove(buffs[i], (const void *)memStart, status*elemSize);
-        }
         icstream->flags &= ~SOAPY_SDR_HAS_TIME; //clear for next read
     }
 
@@ -324,7 +436,7 @@ int SoapyLMS7::readStream(
     flags = 0;
     if (metadata.endOfBurst) flags |= SOAPY_SDR_END_BURST;
     if (metadata.hasTimestamp) flags |= SOAPY_SDR_HAS_TIME;
-    timeNs = SoapySDR::ticksToTimeNs(metadata.timestamp, _conn->GetHardwareTimestampRate());
+    timeNs = SoapySDR::ticksToTimeNs(metadata.timestamp, tickRate);
 
     //return num read or error code
     return (status >= 0) ? status : SOAPY_SDR_STREAM_ERROR;
@@ -352,12 +464,13 @@ int SoapyLMS7::writeStream(
     for(auto i : streamID)
     {
         ret = _conn->WriteStream(i, buffs[bufIndex++], numElems, timeoutUs/1000, metadata);
-        if(ret == 0) return SOAPY_SDR_TIMEOUT;
         if(ret < 0) return SOAPY_SDR_STREAM_ERROR;
+        //burst can be ended without samples, nothing written is not a timeout then
+        if(ret == 0 && numElems != 0) return SOAPY_SDR_TIMEOUT;
     }
 
     //return num written or error code
-    return (ret > 0)? ret : SOAPY_SDR_STREAM_ERROR;
+    return (ret > 0 || numElems == 0)? ret : SOAPY_SDR_STREAM_ERROR;
 }
 
 int SoapyLMS7::readStreamStatus(
@@ -375,18 +488,26 @@ int SoapyLMS7::readStreamStatus(
     auto start = std::chrono::high_resolution_clock::now();
     while (1)
     {
+        //the call blocks until an event arrives, backends without event
+        //queue return the current status immediately and are polled
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now()-start;
+        const long remaining_ms = std::max<long>(0, timeoutUs/1000 - long(elapsed.count()*1e3));
+        bool event = false;
         for(auto i : streamID)
         {
-            int ret = _conn->ReadStreamStatus(i, timeoutUs/1000, metadata);
+            int ret = _conn->ReadStreamStatus(i, remaining_ms, metadata);
             if (ret != 0)
             {
                 //handle the default not implemented case and return not supported
                 if (GetLastError() == EPERM) return SOAPY_SDR_NOT_SUPPORTED;
                 return SOAPY_SDR_TIMEOUT;
             }
+            event = metadata.endOfBurst || metadata.lateTimestamp || metadata.packetDropped || metadata.underflow;
+            if (event)
+                break;
         }
         //stop when event is detected
-        if (metadata.endOfBurst || metadata.lateTimestamp || metadata.packetDropped)
+        if (event)
             break;
         //check timeout
         std::chrono::duration<double> seconds = std::chrono::high_resolution_clock::now()-start;
@@ -405,6 +526,7 @@ int SoapyLMS7::readStreamStatus(
     if (metadata.hasTimestamp) flags |= SOAPY_SDR_HAS_TIME;
 
     if (metadata.lateTimestamp) return SOAPY_SDR_TIME_ERROR;
+    if (metadata.underflow) return SOAPY_SDR_UNDERFLOW;
     if (metadata.packetDropped) return SOAPY_SDR_OVERFLOW;
 
     return 0;
@@ -9,6 +9,7 @@
 #include "VersionInfo.h"
 #include <assert.h>
 #include "FPGA_common.h"
+#include "ControlTrace.h"
 
 using namespace std;
 
@@ -33,6 +34,7 @@ API_EXPORT int CALL_CONV LMS_GetDeviceList(lms_info_str_t * dev_list)
 
 API_EXPORT int CALL_CONV LMS_Open(lms_device_t** device, const lms_info_str_t info, void* args)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device pointer cannot be NULL");
@@ -79,6 +81,7 @@ API_EXPORT int CALL_CONV LMS_Open(lms_device_t** device, const lms_info_str_t in
 
 API_EXPORT int CALL_CONV LMS_Close(lms_device_t * device)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -91,6 +94,7 @@ API_EXPORT int CALL_CONV LMS_Close(lms_device_t * device)
 
 API_EXPORT int CALL_CONV LMS_Disconnect(lms_device_t *device)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -103,6 +107,7 @@ API_EXPORT int CALL_CONV LMS_Disconnect(lms_device_t *device)
 
 API_EXPORT bool CALL_CONV LMS_IsOpen(lms_device_t *device, int port)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
         return false;
 
@@ -118,6 +123,7 @@ API_EXPORT bool CALL_CONV LMS_IsOpen(lms_device_t *device, int port)
 
 API_EXPORT int CALL_CONV LMS_Reset(lms_device_t *device)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -130,6 +136,7 @@ API_EXPORT int CALL_CONV LMS_Reset(lms_device_t *device)
 
 API_EXPORT int CALL_CONV LMS_EnableChannel(lms_device_t * device, bool dir_tx, size_t chan, bool enabled)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -143,6 +150,7 @@ API_EXPORT int CALL_CONV LMS_EnableChannel(lms_device_t * device, bool dir_tx, s
 
 API_EXPORT int CALL_CONV LMS_SetSampleRate(lms_device_t * device, float_type rate, size_t oversample)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -156,6 +164,7 @@ API_EXPORT int CALL_CONV LMS_SetSampleRate(lms_device_t * device, float_type rat
 
 API_EXPORT int CALL_CONV LMS_SetSampleRateDir(lms_device_t *device, bool dir_tx, float_type rate, size_t oversample)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -169,6 +178,7 @@ API_EXPORT int CALL_CONV LMS_SetSampleRateDir(lms_device_t *device, bool dir_tx,
 
 API_EXPORT int CALL_CONV LMS_GetSampleRate(lms_device_t *device, bool dir_tx, size_t chan, float_type *host_Hz, float_type *rf_Hz)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -193,6 +203,7 @@ API_EXPORT int CALL_CONV LMS_GetSampleRate(lms_device_t *device, bool dir_tx, si
 
 API_EXPORT int CALL_CONV LMS_GetSampleRateRange(lms_device_t *device, bool dir_tx, lms_range_t *range)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -212,6 +223,7 @@ API_EXPORT int CALL_CONV LMS_GetSampleRateRange(lms_device_t *device, bool dir_t
 
 API_EXPORT int CALL_CONV LMS_Init(lms_device_t * device)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -226,6 +238,7 @@ API_EXPORT int CALL_CONV LMS_Init(lms_device_t * device)
 API_EXPORT int CALL_CONV LMS_ReadCustomBoardParam(lms_device_t *device,
                            uint8_t param_id, float_type *val, lms_name_t units)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -247,6 +260,7 @@ API_EXPORT int CALL_CONV LMS_ReadCustomBoardParam(lms_device_t *device,
 API_EXPORT int CALL_CONV LMS_WriteCustomBoardParam(lms_device_t *device,
                         uint8_t param_id, float_type val, const lms_name_t units)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -265,6 +279,7 @@ API_EXPORT int CALL_CONV LMS_WriteCustomBoardParam(lms_device_t *device,
 
 API_EXPORT int CALL_CONV LMS_VCTCXOWrite(lms_device_t * device, uint16_t val)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -276,6 +291,7 @@ API_EXPORT int CALL_CONV LMS_VCTCXOWrite(lms_device_t * device, uint16_t val)
 
 API_EXPORT int CALL_CONV LMS_VCTCXORead(lms_device_t * device, uint16_t *val)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -289,6 +305,7 @@ API_EXPORT int CALL_CONV LMS_VCTCXORead(lms_device_t * device, uint16_t *val)
 
 API_EXPORT int CALL_CONV LMS_GetClockFreq(lms_device_t *device, size_t clk_id, float_type *freq)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -301,6 +318,7 @@ API_EXPORT int CALL_CONV LMS_GetClockFreq(lms_device_t *device, size_t clk_id, f
 
 API_EXPORT int CALL_CONV LMS_SetClockFreq(lms_device_t *device, size_t clk_id, float_type freq)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -312,6 +330,7 @@ API_EXPORT int CALL_CONV LMS_SetClockFreq(lms_device_t *device, size_t clk_id, f
 
 API_EXPORT  int CALL_CONV LMS_Synchronize(lms_device_t *dev, bool toChip)
 {
+    LIME_TRACE_SCOPE();
     if (dev == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -324,6 +343,7 @@ API_EXPORT  int CALL_CONV LMS_Synchronize(lms_device_t *dev, bool toChip)
 
 API_EXPORT int CALL_CONV LMS_GPIORead(lms_device_t *dev,  uint8_t* buffer, size_t len)
 {
+    LIME_TRACE_SCOPE();
     if (dev == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -341,6 +361,7 @@ API_EXPORT int CALL_CONV LMS_GPIORead(lms_device_t *dev,  uint8_t* buffer, size_
 
 API_EXPORT int CALL_CONV LMS_GPIOWrite(lms_device_t *dev, const uint8_t* buffer, size_t len)
 {
+    LIME_TRACE_SCOPE();
     if (dev == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -358,6 +379,7 @@ API_EXPORT int CALL_CONV LMS_GPIOWrite(lms_device_t *dev, const uint8_t* buffer,
 
 API_EXPORT int CALL_CONV LMS_GPIODirRead(lms_device_t *dev,  uint8_t* buffer, size_t len)
 {
+    LIME_TRACE_SCOPE();
     if (dev == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -375,6 +397,7 @@ API_EXPORT int CALL_CONV LMS_GPIODirRead(lms_device_t *dev,  uint8_t* buffer, si
 
 API_EXPORT int CALL_CONV LMS_GPIODirWrite(lms_device_t *dev, const uint8_t* buffer, size_t len)
 {
+    LIME_TRACE_SCOPE();
     if (dev == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -392,6 +415,7 @@ API_EXPORT int CALL_CONV LMS_GPIODirWrite(lms_device_t *dev, const uint8_t* buff
 
 API_EXPORT int CALL_CONV LMS_EnableCalibCache(lms_device_t *dev, bool enable)
 {
+    LIME_TRACE_SCOPE();
     if (dev == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -404,6 +428,7 @@ API_EXPORT int CALL_CONV LMS_EnableCalibCache(lms_device_t *dev, bool enable)
 
 API_EXPORT int CALL_CONV LMS_GetChipTemperature(lms_device_t *dev, size_t ind, float_type *temp)
 {
+    LIME_TRACE_SCOPE();
     *temp = 0;
     if (dev == nullptr)
     {
@@ -426,6 +451,7 @@ API_EXPORT int CALL_CONV LMS_GetChipTemperature(lms_device_t *dev, size_t ind, f
 
 API_EXPORT int CALL_CONV LMS_GetNumChannels(lms_device_t * device, bool dir_tx)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -438,6 +464,7 @@ API_EXPORT int CALL_CONV LMS_GetNumChannels(lms_device_t * device, bool dir_tx)
 
 API_EXPORT int CALL_CONV LMS_SetLOFrequency(lms_device_t *device, bool dir_tx, size_t chan, float_type frequency)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -468,6 +495,7 @@ API_EXPORT int CALL_CONV LMS_SetLOFrequency(lms_device_t *device, bool dir_tx, s
 
 API_EXPORT int CALL_CONV LMS_GetLOFrequency(lms_device_t *device, bool dir_tx, size_t chan, float_type *frequency)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -488,6 +516,7 @@ API_EXPORT int CALL_CONV LMS_GetLOFrequency(lms_device_t *device, bool dir_tx, s
 
 API_EXPORT int CALL_CONV LMS_GetLOFrequencyRange(lms_device_t *device, bool dir_tx, lms_range_t *range)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -501,6 +530,7 @@ API_EXPORT int CALL_CONV LMS_GetLOFrequencyRange(lms_device_t *device, bool dir_
 
 API_EXPORT int CALL_CONV LMS_GetAntennaList(lms_device_t *device, bool dir_tx, size_t chan, lms_name_t *list)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -527,6 +557,7 @@ API_EXPORT int CALL_CONV LMS_GetAntennaList(lms_device_t *device, bool dir_tx, s
 
 API_EXPORT int CALL_CONV LMS_SetAntenna(lms_device_t *device, bool dir_tx, size_t chan, size_t path)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -549,6 +580,7 @@ API_EXPORT int CALL_CONV LMS_SetAntenna(lms_device_t *device, bool dir_tx, size_
 
 API_EXPORT int CALL_CONV LMS_GetAntenna(lms_device_t *device, bool dir_tx, size_t chan)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -562,6 +594,7 @@ API_EXPORT int CALL_CONV LMS_GetAntenna(lms_device_t *device, bool dir_tx, size_
 
 API_EXPORT int CALL_CONV LMS_GetAntennaBW(lms_device_t *device, bool dir_tx, size_t chan, size_t path, lms_range_t *range)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -579,6 +612,7 @@ API_EXPORT int CALL_CONV LMS_GetAntennaBW(lms_device_t *device, bool dir_tx, siz
 
 API_EXPORT int CALL_CONV LMS_SetLPFBW(lms_device_t *device, bool dir_tx, size_t chan, float_type bandwidth)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -598,6 +632,7 @@ API_EXPORT int CALL_CONV LMS_SetLPFBW(lms_device_t *device, bool dir_tx, size_t
 
 API_EXPORT int CALL_CONV LMS_GetLPFBW(lms_device_t *device, bool dir_tx, size_t chan, float_type *bandwidth)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -617,6 +652,7 @@ API_EXPORT int CALL_CONV LMS_GetLPFBW(lms_device_t *device, bool dir_tx, size_t
 
 API_EXPORT int CALL_CONV LMS_SetLPF(lms_device_t *device, bool dir_tx, size_t chan, bool enabled)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -635,6 +671,7 @@ API_EXPORT int CALL_CONV LMS_SetLPF(lms_device_t *device, bool dir_tx, size_t ch
 
 API_EXPORT int CALL_CONV LMS_SetGFIRLPF(lms_device_t *device, bool dir_tx, size_t chan, bool enabled, float_type bandwidth)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -660,6 +697,7 @@ API_EXPORT int CALL_CONV LMS_SetGFIRLPF(lms_device_t *device, bool dir_tx, size_
 
 API_EXPORT int CALL_CONV LMS_GetLPFBWRange(lms_device_t *device, bool dir_tx, lms_range_t *range)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -675,6 +713,7 @@ API_EXPORT int CALL_CONV LMS_GetLPFBWRange(lms_device_t *device, bool dir_tx, lm
 
 API_EXPORT int CALL_CONV LMS_SetNormalizedGain(lms_device_t *device, bool dir_tx, size_t chan, float_type gain)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -700,6 +739,7 @@ API_EXPORT int CALL_CONV LMS_SetNormalizedGain(lms_device_t *device, bool dir_tx
 API_EXPORT int CALL_CONV LMS_SetGaindB(lms_device_t *device, bool dir_tx,
                                                 size_t chan,unsigned gain)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -719,6 +759,7 @@ API_EXPORT int CALL_CONV LMS_SetGaindB(lms_device_t *device, bool dir_tx,
 
 API_EXPORT int CALL_CONV LMS_GetNormalizedGain(lms_device_t *device, bool dir_tx, size_t chan,float_type *gain)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -741,6 +782,7 @@ API_EXPORT int CALL_CONV LMS_GetNormalizedGain(lms_device_t *device, bool dir_tx
 
 API_EXPORT int CALL_CONV LMS_GetGaindB(lms_device_t *device, bool dir_tx, size_t chan, unsigned *gain)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -763,6 +805,7 @@ API_EXPORT int CALL_CONV LMS_GetGaindB(lms_device_t *device, bool dir_tx, size_t
 
 API_EXPORT int CALL_CONV LMS_Calibrate(lms_device_t *device, bool dir_tx, size_t chan, double bw, unsigned flags)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -792,6 +835,7 @@ API_EXPORT int CALL_CONV LMS_Calibrate(lms_device_t *device, bool dir_tx, size_t
 
 API_EXPORT int CALL_CONV LMS_LoadConfig(lms_device_t *device, const char *filename)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -805,6 +849,7 @@ API_EXPORT int CALL_CONV LMS_LoadConfig(lms_device_t *device, const char *filena
 
 API_EXPORT int CALL_CONV LMS_SaveConfig(lms_device_t *device, const char *filename)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -816,8 +861,37 @@ API_EXPORT int CALL_CONV LMS_SaveConfig(lms_device_t *device, const char *filena
     return lms->SaveConfig(filename);
 }
 
+API_EXPORT int CALL_CONV LMS_LoadProfile(lms_device_t *device, const char *filename)
+{
+    LIME_TRACE_SCOPE();
+    if (device == nullptr)
+    {
+        lime::ReportError(EINVAL, "Device cannot be NULL.");
+        return -1;
+    }
+
+    LMS7_Device* lms = (LMS7_Device*)device;
+
+    return lms->LoadProfile(filename);
+}
+
+API_EXPORT int CALL_CONV LMS_SaveProfile(lms_device_t *device, const char *filename)
+{
+    LIME_TRACE_SCOPE();
+    if (device == nullptr)
+    {
+        lime::ReportError(EINVAL, "Device cannot be NULL.");
+        return -1;
+    }
+
+    LMS7_Device* lms = (LMS7_Device*)device;
+
+    return lms->SaveProfile(filename);
+}
+
 API_EXPORT int CALL_CONV LMS_SetTestSignal(lms_device_t *device, bool dir_tx, size_t chan, lms_testsig_t sig, int16_t dc_i, int16_t dc_q)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -845,6 +919,7 @@ API_EXPORT int CALL_CONV LMS_SetTestSignal(lms_device_t *device, bool dir_tx, si
 
 API_EXPORT int CALL_CONV LMS_GetTestSignal(lms_device_t *device, bool dir_tx, size_t chan, lms_testsig_t *sig)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -869,6 +944,7 @@ API_EXPORT int CALL_CONV LMS_GetTestSignal(lms_device_t *device, bool dir_tx, si
 
 API_EXPORT int CALL_CONV LMS_SetNCOFrequency(lms_device_t *device, bool dir_tx, size_t ch, const float_type *freq, float_type pho)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -888,6 +964,7 @@ API_EXPORT int CALL_CONV LMS_SetNCOFrequency(lms_device_t *device, bool dir_tx,
 
 API_EXPORT int CALL_CONV LMS_GetNCOFrequency(lms_device_t *device, bool dir_tx, size_t chan, float_type *freq, float_type *pho)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -907,6 +984,7 @@ API_EXPORT int CALL_CONV LMS_GetNCOFrequency(lms_device_t *device, bool dir_tx,
 
 API_EXPORT int CALL_CONV LMS_SetNCOPhase(lms_device_t *device, bool dir_tx, size_t ch, const float_type *phase, float_type fcw)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -926,6 +1004,7 @@ API_EXPORT int CALL_CONV LMS_SetNCOPhase(lms_device_t *device, bool dir_tx, size
 
 API_EXPORT int CALL_CONV LMS_GetNCOPhase(lms_device_t *device, bool dir_tx, size_t ch, float_type *phase, float_type *fcw)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -945,6 +1024,7 @@ API_EXPORT int CALL_CONV LMS_GetNCOPhase(lms_device_t *device, bool dir_tx, size
 
 API_EXPORT int CALL_CONV LMS_SetNCOIndex(lms_device_t *device, bool dir_tx, size_t chan, int index,bool down)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -964,6 +1044,7 @@ API_EXPORT int CALL_CONV LMS_SetNCOIndex(lms_device_t *device, bool dir_tx, size
 
 API_EXPORT int CALL_CONV LMS_GetNCOIndex(lms_device_t *device, bool dir_tx, size_t chan)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -983,6 +1064,7 @@ API_EXPORT int CALL_CONV LMS_GetNCOIndex(lms_device_t *device, bool dir_tx, size
 
 API_EXPORT int CALL_CONV LMS_ReadLMSReg(lms_device_t *device, uint32_t address, uint16_t *val)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -995,6 +1077,7 @@ API_EXPORT int CALL_CONV LMS_ReadLMSReg(lms_device_t *device, uint32_t address,
 
 API_EXPORT int CALL_CONV LMS_WriteLMSReg(lms_device_t *device, uint32_t address, uint16_t val)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -1007,6 +1090,7 @@ API_EXPORT int CALL_CONV LMS_WriteLMSReg(lms_device_t *device, uint32_t address,
 
 API_EXPORT int CALL_CONV LMS_ReadFPGAReg(lms_device_t *device, uint32_t address, uint16_t *val)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -1031,6 +1115,7 @@ API_EXPORT int CALL_CONV LMS_ReadFPGAReg(lms_device_t *device, uint32_t address,
 
 API_EXPORT int CALL_CONV LMS_WriteFPGAReg(lms_device_t *device, uint32_t address, uint16_t val)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -1049,6 +1134,7 @@ API_EXPORT int CALL_CONV LMS_WriteFPGAReg(lms_device_t *device, uint32_t address
 
 API_EXPORT int CALL_CONV LMS_ReadParam(lms_device_t *device, struct LMS7Parameter param, uint16_t *val)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -1060,6 +1146,7 @@ API_EXPORT int CALL_CONV LMS_ReadParam(lms_device_t *device, struct LMS7Paramete
 
 API_EXPORT int CALL_CONV LMS_WriteParam(lms_device_t *device, struct LMS7Parameter param, uint16_t val)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -1072,6 +1159,7 @@ API_EXPORT int CALL_CONV LMS_WriteParam(lms_device_t *device, struct LMS7Paramet
 
 API_EXPORT int CALL_CONV LMS_SetGFIRCoeff(lms_device_t * device, bool dir_tx, size_t chan, lms_gfir_t filt, const float_type* coef,size_t count)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -1089,6 +1177,7 @@ API_EXPORT int CALL_CONV LMS_SetGFIRCoeff(lms_device_t * device, bool dir_tx, si
 
 API_EXPORT int CALL_CONV LMS_GetGFIRCoeff(lms_device_t * device, bool dir_tx, size_t chan, lms_gfir_t filt, float_type* coef)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -1106,6 +1195,7 @@ API_EXPORT int CALL_CONV LMS_GetGFIRCoeff(lms_device_t * device, bool dir_tx, si
 
 API_EXPORT int CALL_CONV LMS_SetGFIR(lms_device_t * device, bool dir_tx, size_t chan, lms_gfir_t filt, bool enabled)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -1122,15 +1212,8 @@ API_EXPORT int CALL_CONV LMS_SetGFIR(lms_device_t * device, bool dir_tx, size_t
     return lms->SetGFIR(dir_tx,chan,filt,enabled);
 }
 
-API_EXPORT int CALL_CONV LMS_SetupStream(lms_device_t *device, lms_stream_t *stream)
+static lime::StreamConfig StreamConfigFromStruct(const lms_stream_t *stream)
 {
-    if(device == nullptr)
-        return lime::ReportError(EINVAL, "Device is NULL.");
-    if(stream == nullptr)
-        return lime::ReportError(EINVAL, "stream is NULL.");
-
-    LMS7_Device* lms = (LMS7_Device*)device;
-
     lime::StreamConfig config;
     config.bufferLength = stream->fifoSize;
     config.channelID = stream->channel;
@@ -1150,11 +1233,45 @@ API_EXPORT int CALL_CONV LMS_SetupStream(lms_device_t *device, lms_stream_t *str
             config.format = lime::StreamConfig::STREAM_COMPLEX_FLOAT32;
     }
     config.isTx = stream->isTx;
+    return config;
+}
+
+API_EXPORT int CALL_CONV LMS_SetupStream(lms_device_t *device, lms_stream_t *stream)
+{
+    LIME_TRACE_SCOPE();
+    if(device == nullptr)
+        return lime::ReportError(EINVAL, "Device is NULL.");
+    if(stream == nullptr)
+        return lime::ReportError(EINVAL, "stream is NULL.");
+
+    LMS7_Device* lms = (LMS7_Device*)device;
+    lime::StreamConfig config = StreamConfigFromStruct(stream);
+    return lms->GetConnection(stream->channel)->SetupStream(stream->handle, config);
+}
+
+API_EXPORT int CALL_CONV LMS_SetupChannelizerStream(lms_device_t *device, lms_stream_t *stream, float_type offset, float_type rate, float_type bandwidth)
+{
+    LIME_TRACE_SCOPE();
+    if(device == nullptr)
+        return lime::ReportError(EINVAL, "Device is NULL.");
+    if(stream == nullptr)
+        return lime::ReportError(EINVAL, "stream is NULL.");
+    if(stream->isTx || stream->dataFmt != lms_stream_t::LMS_FMT_F32)
+        return lime::ReportError(EINVAL, "Channelizer streams are RX streams of LMS_FMT_F32 samples.");
+    if(rate <= 0)
+        return lime::ReportError(EINVAL, "Channelizer rate must be positive.");
+
+    LMS7_Device* lms = (LMS7_Device*)device;
+    lime::StreamConfig config = StreamConfigFromStruct(stream);
+    config.channelizerRate = rate;
+    config.channelizerOffset = offset;
+    config.channelizerBandwidth = bandwidth;
     return lms->GetConnection(stream->channel)->SetupStream(stream->handle, config);
 }
 
 API_EXPORT int CALL_CONV LMS_DestroyStream(lms_device_t *device, lms_stream_t *stream)
 {
+    LIME_TRACE_SCOPE();
     if(stream == nullptr)
         return lime::ReportError(EINVAL, "stream is NULL.");
 
@@ -1164,6 +1281,7 @@ API_EXPORT int CALL_CONV LMS_DestroyStream(lms_device_t *device, lms_stream_t *s
 
 API_EXPORT int CALL_CONV LMS_StartStream(lms_stream_t *stream)
 {
+    LIME_TRACE_SCOPE();
     if (stream==nullptr || stream->handle==0)
         return 0;
     return reinterpret_cast<lime::IStreamChannel*>(stream->handle)->Start();
@@ -1171,6 +1289,7 @@ API_EXPORT int CALL_CONV LMS_StartStream(lms_stream_t *stream)
 
 API_EXPORT int CALL_CONV LMS_StopStream(lms_stream_t *stream)
 {
+    LIME_TRACE_SCOPE();
     if (stream==nullptr || stream->handle==0)
         return 0;
     return reinterpret_cast<lime::IStreamChannel*>(stream->handle)->Stop();
@@ -1178,6 +1297,7 @@ API_EXPORT int CALL_CONV LMS_StopStream(lms_stream_t *stream)
 
 API_EXPORT int CALL_CONV LMS_RecvStream(lms_stream_t *stream, void *samples, size_t sample_count, lms_stream_meta_t *meta, unsigned timeout_ms)
 {
+    LIME_TRACE_SCOPE();
     if (stream==nullptr || stream->handle==0)
         return -1;
     lime::IStreamChannel* channel = (lime::IStreamChannel*)stream->handle;
@@ -1198,6 +1318,7 @@ API_EXPORT int CALL_CONV LMS_RecvStream(lms_stream_t *stream, void *samples, siz
 
 API_EXPORT int CALL_CONV LMS_SendStream(lms_stream_t *stream, const void *samples, size_t sample_count, const lms_stream_meta_t *meta, unsigned timeout_ms)
 {
+    LIME_TRACE_SCOPE();
     if (stream==nullptr || stream->handle==0)
         return -1;
     lime::IStreamChannel* channel = (lime::IStreamChannel*)stream->handle;
@@ -1206,6 +1327,7 @@ API_EXPORT int CALL_CONV LMS_SendStream(lms_stream_t *stream, const void *sample
     if (meta)
     {
         metadata.flags |= meta->waitForTimestamp * lime::IStreamChannel::Metadata::SYNC_TIMESTAMP;
+        metadata.flags |= meta->flushPartialPacket * lime::IStreamChannel::Metadata::END_BURST;
         metadata.timestamp = meta->timestamp;
     }
     else metadata.timestamp = 0;
@@ -1217,6 +1339,7 @@ API_EXPORT int CALL_CONV LMS_UploadWFM(lms_device_t *device,
                                          const void **samples, uint8_t chCount,
                                          size_t sample_count, int format)
 {
+    LIME_TRACE_SCOPE();
     LMS7_Device* lms = (LMS7_Device*)device;
     lime::StreamConfig::StreamDataFormat fmt;
     switch(format)
@@ -1237,8 +1360,21 @@ API_EXPORT int CALL_CONV LMS_UploadWFM(lms_device_t *device,
     return lms->UploadWFM(samples, chCount, sample_count, fmt);
 }
 
+API_EXPORT int CALL_CONV LMS_UploadWFMFile(lms_device_t *device, const char *filename, uint8_t chCount)
+{
+    LIME_TRACE_SCOPE();
+    if (device == nullptr || filename == nullptr)
+    {
+        lime::ReportError(EINVAL, "Device and filename cannot be NULL.");
+        return -1;
+    }
+    LMS7_Device* lms = (LMS7_Device*)device;
+    return lms->UploadWFMFile(filename, chCount) == 0 ? 0 : -1;
+}
+
 API_EXPORT int CALL_CONV LMS_EnableTxWFM(lms_device_t *device, unsigned ch, bool active)
 {
+    LIME_TRACE_SCOPE();
     uint16_t regAddr = 0x000D;
     uint16_t regValue = 0;
     int status = 0;
@@ -1254,26 +1390,49 @@ API_EXPORT int CALL_CONV LMS_EnableTxWFM(lms_device_t *device, unsigned ch, bool
 
 API_EXPORT int CALL_CONV LMS_GetStreamStatus(lms_stream_t *stream, lms_stream_status_t* status)
 {
+    LIME_TRACE_SCOPE();
     assert(stream != nullptr);
     lime::IStreamChannel* channel = (lime::IStreamChannel*)stream->handle;
     if(channel == nullptr)
         return -1;
     lime::IStreamChannel::Info info = channel->GetInfo();
 
-    status->active = false;
-    status->droppedPackets = 0;
+    status->active = info.active;
+    status->droppedPackets = info.droppedPackets;
     status->fifoFilledCount = info.fifoItemsCount;
     status->fifoSize = info.fifoSize;
     status->linkRate = info.linkRate;
-    status->overrun = 0;
-    status->underrun = 0;
+    status->overrun = info.overrun;
+    status->underrun = info.underrun;
     status->sampleRate = 0;
-    status->timestamp = 0;
+    status->timestamp = info.timestamp;
+    return 0;
+}
+
+API_EXPORT int CALL_CONV LMS_GetStreamMeters(lms_stream_t *stream, lms_stream_meters_t* meters)
+{
+    LIME_TRACE_SCOPE();
+    assert(stream != nullptr);
+    lime::IStreamChannel* channel = (lime::IStreamChannel*)stream->handle;
+    if(channel == nullptr || meters == nullptr)
+        return -1;
+    lime::StreamMeters values;
+    if(channel->GetMeters(values) != 0)
+        return -1;
+
+    meters->power = values.power;
+    meters->peak = values.peak;
+    meters->dcI = values.dcI;
+    meters->dcQ = values.dcQ;
+    meters->clipped = values.clipped;
+    meters->samplesCount = values.samplesCount;
+    meters->timestamp = values.timestamp;
     return 0;
 }
 
 API_EXPORT const lms_dev_info_t* CALL_CONV LMS_GetDeviceInfo(lms_device_t *device)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -1299,6 +1458,7 @@ API_EXPORT const lms_dev_info_t* CALL_CONV LMS_GetDeviceInfo(lms_device_t *devic
 API_EXPORT int CALL_CONV LMS_Program(lms_device_t *device, const char *data, size_t size,
            lms_prog_trg_t component, lms_prog_md_t mode, lms_prog_callback_t callback)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -1313,6 +1473,7 @@ API_EXPORT int CALL_CONV LMS_Program(lms_device_t *device, const char *data, siz
 
 API_EXPORT int CALL_CONV LMS_ProgramUpdate(lms_device_t *device, const bool download, lms_prog_callback_t callback)
 {
+    LIME_TRACE_SCOPE();
     if (device == nullptr)
     {
         lime::ReportError(EINVAL, "Device cannot be NULL.");
@@ -20,6 +20,9 @@
 #include "LMS64CProtocol.h"
 #include <assert.h>
 #include "ConnectionRegistry.h"
+#include <tuple>
+#include <algorithm>
+#include <map>
 
 static const size_t LMS_PATH_NONE = 0;
 static const size_t LMS_PATH_HIGH = 1;
@@ -97,6 +100,7 @@ void LMS7_Device::_Initialize(lime::IConnection* conn)
 
 int LMS7_Device::SetConnection(lime::IConnection* conn)
 {
+    fpgaRates.clear();
     if (this->connection != nullptr)
 	lime::ConnectionRegistry::freeConnection(this->connection);
 
@@ -145,6 +149,59 @@ int LMS7_Device::ConfigureRXLPF(bool enabled,int ch,float_type bandwidth)
     return 0;
 }
 
+/** @brief Returns GFIR coefficients for given ratio and normalized bandwidth
+    Designed filters are memoized, as the same bandwidths tend to be requested
+    repeatedly (adaptive receivers, channel switching).
+    @param L GFIR L parameter, filters have L*15 and L*5 taps
+    @param w normalized passband edge
+    @param w2 normalized stopband edge
+*/
+LMS7_Device::GFIRCoefficients LMS7_Device::DesignGFIR(int L, double w, double w2)
+{
+    static std::mutex cacheLock;
+    static std::map<std::tuple<int, double, double>, GFIRCoefficients> cache;
+    const size_t cacheLimit = 64;
+
+    std::lock_guard<std::mutex> lock(cacheLock);
+    auto key = std::make_tuple(L, w, w2);
+    auto iter = cache.find(key);
+    if (iter != cache.end())
+        return iter->second;
+    if (cache.size() >= cacheLimit)
+        cache.clear();
+
+    GFIRCoefficients &gfir = cache[key];
+    double coef[120];
+    double coef2[40];
+    GenerateFilter(L*15, w, w2, 1.0, 0, coef);
+    GenerateFilter(L*5, w, w2, 1.0, 0, coef2);
+
+    int sample = 0;
+    for(int i=0; i<15; i++)
+    {
+        for(int j=0; j<8; j++)
+        {
+            if( (j < L) && (sample < L*15) )
+                gfir.gfir1[i*8+j] = (coef[sample++]*32767.0);
+            else
+                gfir.gfir1[i*8+j] = 0;
+        }
+    }
+
+    sample = 0;
+    for(int i=0; i<5; i++)
+    {
+        for(int j=0; j<8; j++)
+        {
+            if( (j < L) && (sample < L*5) )
+                gfir.gfir2[i*8+j] = (coef2[sample++]*32767.0);
+            else
+                gfir.gfir2[i*8+j] = 0;
+        }
+    }
+    return gfir;
+}
+
 int LMS7_Device::ConfigureGFIR(bool enabled,bool tx, double bandwidth, size_t ch)
 {
     double w,w2;
@@ -220,76 +277,8 @@ int LMS7_Device::ConfigureGFIR(bool enabled,bool tx, double bandwidth, size_t ch
     }
     else return 0;
 
-  double coef[120];
-  double coef2[40];
-  short gfir1[120];
-  short gfir2[40];
-
-  GenerateFilter(L*15, w, w2, 1.0, 0, coef);
-  GenerateFilter(L*5, w, w2, 1.0, 0, coef2);
-
-    int sample = 0;
-    for(int i=0; i<15; i++)
-    {
-	for(int j=0; j<8; j++)
-        {
-            if( (j < L) && (sample < L*15) )
-            {
-                gfir1[i*8+j] = (coef[sample]*32767.0);
-		sample++;
-            }
-            else
-            {
-		gfir1[i*8+j] = 0;
-            }
-	}
-    }
-
-    sample = 0;
-    for(int i=0; i<5; i++)
-    {
-	for(int j=0; j<8; j++)
-        {
-            if( (j < L) && (sample < L*5) )
-            {
-                gfir2[i*8+j] = (coef2[sample]*32767.0);
-		sample++;
-            }
-            else
-            {
-		gfir2[i*8+j] = 0;
-            }
-	}
-    }
-
-    L-=1;
-
-    if (tx)
-    {
-        if (lms->Modify_SPI_Reg_bits(LMS7param(GFIR1_L_TXTSP), L, true) != 0)
-           return -1;
-        lms->Modify_SPI_Reg_bits(LMS7param(GFIR1_N_TXTSP), div, true);
-        lms->Modify_SPI_Reg_bits(LMS7param(GFIR2_L_TXTSP), L, true);
-        lms->Modify_SPI_Reg_bits(LMS7param(GFIR2_N_TXTSP), div, true);
-        lms->Modify_SPI_Reg_bits(LMS7param(GFIR3_L_TXTSP), L, true);
-        lms->Modify_SPI_Reg_bits(LMS7param(GFIR3_N_TXTSP), div, true);
-
-    }
-    else
-    {
-        if (lms->Modify_SPI_Reg_bits(LMS7param(GFIR1_L_RXTSP), L, true) != 0)
-          return -1;
-        lms->Modify_SPI_Reg_bits(LMS7param(GFIR1_N_RXTSP), div, true);
-        lms->Modify_SPI_Reg_bits(LMS7param(GFIR2_L_RXTSP), L, true);
-        lms->Modify_SPI_Reg_bits(LMS7param(GFIR2_N_RXTSP), div, true);
-        lms->Modify_SPI_Reg_bits(LMS7param(GFIR3_L_RXTSP), L, true);
-        lms->Modify_SPI_Reg_bits(LMS7param(GFIR3_N_RXTSP), div, true);
-
-    }
-
-    if ((lms->SetGFIRCoefficients(tx, 0, gfir2, 40) != 0)
-        || (lms->SetGFIRCoefficients(tx, 1, gfir2, 40) != 0)
-        || (lms->SetGFIRCoefficients(tx, 2, gfir1, 120) != 0))
+    const GFIRCoefficients gfir = DesignGFIR(L, w, w2);
+    if (lms->SetGFIRFilters(tx, L-1, div, gfir.gfir2, gfir.gfir1) != 0)
         return -1;
 
   return 0;
@@ -339,6 +328,50 @@ size_t LMS7_Device::GetNumChannels(const bool tx) const
     return 2;
 }
 
+//FPGA interface rates derived from cached LMS7002M registers
+static void GetInterfaceRates(lime::LMS7002M* lms, float_type* txRate, float_type* rxRate)
+{
+    int interp = lms->Get_SPI_Reg_bits(LMS7param(HBI_OVR_TXTSP));
+    int decim = lms->Get_SPI_Reg_bits(LMS7param(HBD_OVR_RXTSP));
+    *txRate = lms->GetReferenceClk_TSP(lime::LMS7002M::Tx);
+    if (interp != 7)
+        *txRate /= pow(2.0, interp);
+    *rxRate = lms->GetReferenceClk_TSP(lime::LMS7002M::Rx);
+    if (decim != 7)
+        *rxRate /= pow(2.0, decim);
+}
+
+/** Applies interface clocking to every chip, FPGA PLL is reprogrammed only
+    when interface rates differ from the ones it was last configured for here.
+*/
+int LMS7_Device::ApplyClockPlan(const lime::LMS7002M::ClockPlan& plan, bool retain_nco)
+{
+    fpgaRates.resize(lms_list.size(), std::make_pair(-1.0, -1.0));
+    for (unsigned i = 0; i < lms_list.size(); i++)
+    {
+        lime::LMS7002M* lms = lms_list[i];
+        lime::LMS7002M::CGEN_details cgen;
+        if (lms->ApplyClockPlan(plan, retain_nco, &cgen) != 0)
+            return -1;
+
+        //same as GetInterfaceRates(), without reading CGEN back
+        const float_type clkl = cgen.frequency / pow(2.0, plan.clkDiv);
+        float_type fpgaTxPLL = plan.clkMux == 0 ? clkl : cgen.frequency;
+        float_type fpgaRxPLL = plan.clkMux == 0 ? cgen.frequency / 4.0 : clkl / 4.0;
+        if (plan.interpolation != 7)
+            fpgaTxPLL /= pow(2.0, plan.interpolation);
+        if (plan.decimation != 7)
+            fpgaRxPLL /= pow(2.0, plan.decimation);
+        if (fpgaRates[i].first == fpgaTxPLL && fpgaRates[i].second == fpgaRxPLL)
+            continue;
+        fpgaRates[i] = std::make_pair(-1.0, -1.0);
+        if (this->connection->UpdateExternalDataRate(i, fpgaTxPLL / 2, fpgaRxPLL / 2) != 0)
+            return -1;
+        fpgaRates[i] = std::make_pair(fpgaTxPLL, fpgaRxPLL);
+    }
+    return 0;
+}
+
 int LMS7_Device::SetRate(float_type f_Hz, int oversample)
 {
    int decim = 0;
@@ -383,29 +416,14 @@ int LMS7_Device::SetRate(float_type f_Hz, int oversample)
        lime::ReportError(ERANGE, "Cannot set desired sample rate. CGEN clock out of range");
        return -1;
    }
-   for (unsigned i = 0; i < lms_list.size(); i++)
-   {
-        lime::LMS7002M* lms = lms_list[i];
-       if ((lms->SetFrequencyCGEN(cgen) != 0)
-           || (lms->Modify_SPI_Reg_bits(LMS7param(EN_ADCCLKH_CLKGN), 0) != 0)
-           || (lms->Modify_SPI_Reg_bits(LMS7param(CLKH_OV_CLKL_CGEN), 2) != 0)
-           || (lms->Modify_SPI_Reg_bits(LMS7param(MAC), 2, true) != 0)
-           || (lms->Modify_SPI_Reg_bits(LMS7param(HBD_OVR_RXTSP), decim) != 0)
-           || (lms->Modify_SPI_Reg_bits(LMS7param(HBI_OVR_TXTSP), decim) != 0)
-           || (lms->Modify_SPI_Reg_bits(LMS7param(MAC), 1, true) != 0)
-           || (lms->SetInterfaceFrequency(lms->GetFrequencyCGEN(), decim, decim) != 0))
-           return -1;
-
-        float_type fpgaTxPLL = lms->GetReferenceClk_TSP(lime::LMS7002M::Tx);
-        float_type fpgaRxPLL = lms->GetReferenceClk_TSP(lime::LMS7002M::Rx);
-        if (decim != 7)
-        {
-            fpgaTxPLL /= pow(2.0, decim);
-            fpgaRxPLL /= pow(2.0, decim);
-        }
-        if (this->connection->UpdateExternalDataRate(i, fpgaTxPLL / 2, fpgaRxPLL / 2) != 0)
-           return -1;
-   }
+   lime::LMS7002M::ClockPlan plan;
+   plan.cgenFrequency = cgen;
+   plan.clkMux = 0;
+   plan.clkDiv = 2;
+   plan.interpolation = decim;
+   plan.decimation = decim;
+   if (ApplyClockPlan(plan, false) != 0)
+       return -1;
 
     for (size_t i = 0; i < GetNumChannels(false);i++)
     {
@@ -660,28 +678,14 @@ int LMS7_Device::SetRate(bool tx, float_type f_Hz, size_t oversample)
         return -1;
     }
 
-    for (unsigned i = 0; i < lms_list.size(); i++)
-    {
-        lms = lms_list[i];
-        if ((lms->SetFrequencyCGEN(cgen, retain_nco) != 0)
-        || (lms->Modify_SPI_Reg_bits(LMS7param(EN_ADCCLKH_CLKGN), clk_mux) != 0)
-        || (lms->Modify_SPI_Reg_bits(LMS7param(CLKH_OV_CLKL_CGEN), clk_div) != 0)
-        || (lms->Modify_SPI_Reg_bits(LMS7param(MAC), 2, true) != 0)
-        || (lms->Modify_SPI_Reg_bits(LMS7param(HBD_OVR_RXTSP), decimation) != 0)
-        || (lms->Modify_SPI_Reg_bits(LMS7param(HBI_OVR_TXTSP), interpolation) != 0)
-        || (lms->Modify_SPI_Reg_bits(LMS7param(MAC), 1, true) != 0)
-        || (lms->SetInterfaceFrequency(lms->GetFrequencyCGEN(), interpolation, decimation) != 0))
-           return -1;
-
-    float_type fpgaTxPLL = lms->GetReferenceClk_TSP(lime::LMS7002M::Tx);
-    float_type fpgaRxPLL = lms->GetReferenceClk_TSP(lime::LMS7002M::Rx);
-    if (interpolation != 7)
-        fpgaTxPLL /= pow(2.0, interpolation);
-    if (decimation != 7)
-        fpgaRxPLL /= pow(2.0, decimation);
-        if (this->connection->UpdateExternalDataRate(i, fpgaTxPLL / 2, fpgaRxPLL / 2) != 0)
-            return -1;
-    }
+    lime::LMS7002M::ClockPlan plan;
+    plan.cgenFrequency = cgen;
+    plan.clkMux = clk_mux;
+    plan.clkDiv = clk_div;
+    plan.interpolation = interpolation;
+    plan.decimation = decimation;
+    if (ApplyClockPlan(plan, retain_nco) != 0)
+        return -1;
 
     for (size_t i = 0; i < GetNumChannels(false);i++)
     {
@@ -1520,6 +1524,8 @@ int LMS7_Device::Calibrate(bool dir_tx, size_t chan, double bw, unsigned flags)
     }
     lms->EnableCalibrationByMCU((flags&1) == 0);
     lms->Modify_SPI_Reg_bits(LMS7param(MAC), (chan%2) + 1, true);
+    //calibration may reconfigure FPGA interface
+    fpgaRates.clear();
     if (dir_tx)
         return lms->CalibrateTx(bw, false);
     else
@@ -1614,6 +1620,7 @@ int LMS7_Device::Init()
 
 int LMS7_Device::Reset()
 {
+    fpgaRates.clear();
     for (unsigned i = 0; i < lms_list.size(); i++)
     {
         lime::LMS7002M* lms = lms_list[i];
@@ -1643,6 +1650,7 @@ int LMS7_Device::EnableChannel(bool dir_tx, size_t chan, bool enabled)
 
 int LMS7_Device::Program(const char* data, size_t len, lms_prog_trg_t target, lms_prog_md_t mode, lime::IConnection::ProgrammingCallback callback)
 {
+    fpgaRates.clear();
     switch (target)
     {
         case LMS_PROG_TRG_FX3:
@@ -1740,6 +1748,7 @@ int LMS7_Device::GetClockFreq(size_t clk_id, float_type *freq)
 
 int LMS7_Device::SetClockFreq(size_t clk_id, float_type freq)
 {
+    fpgaRates.clear();
     lime::LMS7002M* lms = lms_list[lms_chip_id];
     switch (clk_id)
     {
@@ -1821,6 +1830,7 @@ lms_dev_info_t* LMS7_Device::GetInfo()
 
 int LMS7_Device::Synchronize(bool toChip)
 {
+    fpgaRates.clear();
     for (unsigned i = 0; i < lms_list.size(); i++)
     {
         lime::LMS7002M* lms = lms_list[i];
@@ -1872,18 +1882,15 @@ int LMS7_Device::GetChipTemperature(size_t ind, float_type *temp)
 
 int LMS7_Device::LoadConfig(const char *filename)
 {
+    fpgaRates.clear();
     lime::LMS7002M* lms = lms_list[lms_chip_id];
     if (lms->LoadConfig(filename)==0)
     {
         lms->Modify_SPI_Reg_bits(LMS7param(MAC),1,true);
         int interp = lms->Get_SPI_Reg_bits(LMS7param(HBI_OVR_TXTSP));
         int decim = lms->Get_SPI_Reg_bits(LMS7param(HBD_OVR_RXTSP));
-        float_type fpgaTxPLL = lms->GetReferenceClk_TSP(lime::LMS7002M::Tx);
-        if (interp != 7)
-            fpgaTxPLL /= pow(2.0, interp);
-        float_type fpgaRxPLL = lms->GetReferenceClk_TSP(lime::LMS7002M::Rx);
-        if (decim != 7)
-            fpgaRxPLL /= pow(2.0, decim);
+        float_type fpgaTxPLL, fpgaRxPLL;
+        GetInterfaceRates(lms, &fpgaTxPLL, &fpgaRxPLL);
         lms->SetInterfaceFrequency(lms->GetFrequencyCGEN(), interp, decim);
         return connection->UpdateExternalDataRate(lms_chip_id,fpgaTxPLL/2,fpgaRxPLL/2);
     }
@@ -1895,6 +1902,30 @@ int LMS7_Device::SaveConfig(const char *filename)
     return lms_list[this->lms_chip_id]->SaveConfig(filename);
 }
 
+int LMS7_Device::LoadProfile(const char *filename)
+{
+    fpgaRates.clear();
+    lime::LMS7002M* lms = lms_list[lms_chip_id];
+    float_type txRate, rxRate;
+    GetInterfaceRates(lms, &txRate, &rxRate);
+    if (lms->LoadProfile(filename) != 0)
+        return -1;
+    //FPGA PLL is reconfigured only when interface rates change
+    float_type newTxRate, newRxRate;
+    GetInterfaceRates(lms, &newTxRate, &newRxRate);
+    if (newTxRate == txRate && newRxRate == rxRate)
+        return 0;
+    int interp = lms->Get_SPI_Reg_bits(LMS7param(HBI_OVR_TXTSP));
+    int decim = lms->Get_SPI_Reg_bits(LMS7param(HBD_OVR_RXTSP));
+    lms->SetInterfaceFrequency(lms->GetFrequencyCGEN(), interp, decim);
+    return connection->UpdateExternalDataRate(lms_chip_id,newTxRate/2,newRxRate/2);
+}
+
+int LMS7_Device::SaveProfile(const char *filename)
+{
+    return lms_list[this->lms_chip_id]->SaveProfile(filename);
+}
+
 int LMS7_Device::ReadLMSReg(uint16_t address, uint16_t *val)
 {
     int status;
@@ -1907,19 +1938,71 @@ int LMS7_Device::WriteLMSReg(uint16_t address, uint16_t val)
     return lms_list.at(lms_chip_id)->SPI_write(address & 0xFFFF, val);
 }
 
-int LMS7_Device::ReadParam(struct LMS7Parameter param, uint16_t *val, bool forceReadFromChip)
+//registers containing read only registers, which values can change
+static const uint16_t readOnlyRegs[] = { 0, 1, 2, 3, 4, 5, 6, 0x002F, 0x008C, 0x00A8, 0x00A9, 0x00AA, 0x00AB, 0x00AC, 0x0123, 0x0209, 0x020A, 0x020B, 0x040E, 0x040F, 0x05C3, 0x05C4, 0x05C5, 0x05C6, 0x05C7, 0x05C8, 0x05C9, 0x05CA};
+
+static bool isReadOnlyReg(uint16_t address)
 {
-    //registers containing read only registers, which values can change
-    const uint16_t readOnlyRegs[] = { 0, 1, 2, 3, 4, 5, 6, 0x002F, 0x008C, 0x00A8, 0x00A9, 0x00AA, 0x00AB, 0x00AC, 0x0123, 0x0209, 0x020A, 0x020B, 0x040E, 0x040F, 0x05C3, 0x05C4, 0x05C5, 0x05C6, 0x05C7, 0x05C8, 0x05C9, 0x05CA};
     for (unsigned i = 0; i < sizeof(readOnlyRegs) / sizeof(uint16_t); ++i)
+        if (address == readOnlyRegs[i])
+            return true;
+    return false;
+}
+
+int LMS7_Device::ReadParam(struct LMS7Parameter param, uint16_t *val, bool forceReadFromChip)
+{
+    if (isReadOnlyReg(param.address))
+        forceReadFromChip = true;
+    *val = lms_list.at(lms_chip_id)->Get_SPI_Reg_bits(param, forceReadFromChip);
+    return LMS_SUCCESS;
+}
+
+/** @brief Reads multiple parameters, registers behind them are read from chip
+    in single batch and each parameter is decoded from that snapshot
+    @param params parameters to read
+    @param values returned parameter values, same order as params
+    @param forceReadFromChip read all registers from chip, otherwise only read-only ones
+*/
+int LMS7_Device::ReadParams(const std::vector<LMS7Parameter> &params, std::vector<uint16_t> &values, bool forceReadFromChip)
+{
+    lime::LMS7002M* lms = lms_list.at(lms_chip_id);
+    std::vector<uint16_t> addrs;
+    std::map<uint16_t, uint16_t> mcuRegs; //read through MCU, not kept in register cache
+    for (const auto &param : params)
     {
-        if (param.address == readOnlyRegs[i])
-        {
-            forceReadFromChip = true;
-            break;
-        }
+        if (!forceReadFromChip && !isReadOnlyReg(param.address))
+            continue;
+        if (param.address == 0x0640 || param.address == 0x0641)
+            mcuRegs[param.address] = 0;
+        else
+            addrs.push_back(param.address);
+    }
+    std::sort(addrs.begin(), addrs.end());
+    addrs.erase(std::unique(addrs.begin(), addrs.end()), addrs.end());
+
+    if (!addrs.empty())
+    {
+        std::vector<uint16_t> data(addrs.size());
+        if (lms->SPI_read_batch(addrs.data(), data.data(), addrs.size()) != 0)
+            return -1;
+    }
+    for (auto &reg : mcuRegs)
+    {
+        int status = 0;
+        reg.second = lms->SPI_read(reg.first, true, &status);
+        if (status != 0)
+            return -1;
+    }
+    //register cache now holds the snapshot
+    values.resize(params.size());
+    for (size_t i = 0; i < params.size(); ++i)
+    {
+        const auto reg = mcuRegs.find(params[i].address);
+        if (reg == mcuRegs.end())
+            values[i] = lms->Get_SPI_Reg_bits(params[i], false);
+        else
+            values[i] = (reg->second & (~(~0<<(params[i].msb+1)))) >> params[i].lsb;
     }
-    *val = lms_list.at(lms_chip_id)->Get_SPI_Reg_bits(param, forceReadFromChip);
     return LMS_SUCCESS;
 }
 
@@ -1949,3 +2032,8 @@ int LMS7_Device::UploadWFM(const void **samples, uint8_t chCount, int sample_cou
     return connection->UploadWFM(samples, chCount%2 ? 1 : 2, sample_count, fmt, chCount>2 ? 1 : 0);
 }
 
+int LMS7_Device::UploadWFMFile(const std::string& filename, uint8_t chCount)
+{
+    return connection->UploadWFMFile(filename, chCount%2 ? 1 : 2, chCount>2 ? 1 : 0);
+}
+
@@ -85,13 +85,17 @@ public:
     int GetChipTemperature(size_t ind, float_type *temp);
     int LoadConfig(const char *filename);
     int SaveConfig(const char *filename);
+    int LoadProfile(const char *filename);
+    int SaveProfile(const char *filename);
     int ReadLMSReg(uint16_t address, uint16_t *val);
     int WriteLMSReg(uint16_t address, uint16_t val);
     int ReadParam(struct LMS7Parameter param, uint16_t *val, bool forceReadFromChip = false);
+    int ReadParams(const std::vector<LMS7Parameter> &params, std::vector<uint16_t> &values, bool forceReadFromChip = false);
     int WriteParam(struct LMS7Parameter param, uint16_t val);
     int SetActiveChip(unsigned ind);
     lime::LMS7002M* GetLMS(int index = -1);
     int UploadWFM(const void **samples, uint8_t chCount, int sample_count, lime::StreamConfig::StreamDataFormat fmt);
+    int UploadWFMFile(const std::string& filename, uint8_t chCount);
     static LMS7_Device* CreateDevice(lime::IConnection* conn, LMS7_Device *obj = nullptr);
     std::map<std::string, double> extra_parameters;
 protected:
@@ -104,7 +108,15 @@ protected:
     int ConfigureRXLPF(bool enabled,int ch,float_type bandwidth);
     int ConfigureTXLPF(bool enabled,int ch,float_type bandwidth);
     int ConfigureGFIR(bool enabled,bool tx, float_type bandwidth,size_t ch);
+    struct GFIRCoefficients
+    {
+        int16_t gfir1[120];
+        int16_t gfir2[40];
+    };
+    static GFIRCoefficients DesignGFIR(int L, double w, double w2);
     void _Initialize(lime::IConnection* conn);
+    int ApplyClockPlan(const lime::LMS7002M::ClockPlan& plan, bool retain_nco);
+    std::vector<std::pair<float_type, float_type> > fpgaRates; //!< last FPGA interface rates set by SetRate
     unsigned lms_chip_id;
 };
 
@@ -6,10 +6,14 @@
 
 #include "ConnectionRegistry.h"
 #include "IConnection.h"
+#include "Logger.h"
 #include <mutex>
 #include <map>
 #include <memory>
 #include <iostream>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
 #include <iso646.h> // alternative operators for visual c++: not, and, or...
 using namespace lime;
 
@@ -40,26 +44,169 @@ struct SharedConnection
 
 static std::map<std::string, std::shared_ptr<SharedConnection>> connectionCache;
 
+/*******************************************************************
+ * Parallel discovery
+ ******************************************************************/
+//! Time limit for a single backend's enumerate() call
+static const auto enumerateTimeout = std::chrono::seconds(5);
+
+//! Serializes calls into the same entry, different entries run concurrently
+static std::mutex &entryMutex(const std::string &name)
+{
+    static std::mutex mapMutex;
+    static std::map<std::string, std::unique_ptr<std::mutex>> mutexes;
+    std::lock_guard<std::mutex> lock(mapMutex);
+    auto &m = mutexes[name];
+    if (not m) m.reset(new std::mutex());
+    return *m;
+}
+
+struct EnumerateTask
+{
+    EnumerateTask(void):
+        done(false),
+        finished(false),
+        timedOut(false)
+    {
+        return;
+    }
+    std::mutex lock;
+    std::condition_variable cv;
+    bool done;
+    std::vector<ConnectionHandle> handles;
+    bool finished; //!< thread no longer uses the entry, guarded by registryMutex()
+    bool timedOut; //!< caller stopped waiting, guarded by registryMutex()
+    std::thread thread;
+};
+
+/*!
+ * Enumerate threads that may still run, including ones which timed out.
+ * Each holds a reference on its entry, so the entry is not unregistered
+ * until the thread is done with it. All state is guarded by registryMutex().
+ */
+struct ProbeThreads
+{
+    ~ProbeThreads(void)
+    {
+        //entries have waited for their probes, remaining threads are exiting
+        for (auto &task : tasks) task->thread.join();
+    }
+
+    //join threads which have finished, caller holds registryMutex()
+    void reap(void)
+    {
+        for (auto it = tasks.begin(); it != tasks.end();)
+        {
+            if (not (*it)->finished) ++it;
+            else
+            {
+                (*it)->thread.join();
+                it = tasks.erase(it);
+            }
+        }
+    }
+
+    //drop a reference taken on the entry, caller holds registryMutex()
+    void release(const ConnectionRegistryEntry *entry)
+    {
+        if (--references[entry] == 0) references.erase(entry);
+        released.notify_all();
+    }
+
+    std::vector<std::shared_ptr<EnumerateTask>> tasks;
+    std::map<const ConnectionRegistryEntry *, size_t> references;
+    //entries with an enumerate call which exceeded the timeout and still runs
+    std::map<const ConnectionRegistryEntry *, size_t> stalled;
+    std::condition_variable released;
+};
+
+static ProbeThreads &probeThreads(void)
+{
+    static ProbeThreads probes;
+    return probes;
+}
+
+static void enumerateEntry(const std::string name, ConnectionRegistryEntry *entry,
+    const ConnectionHandle hint, std::shared_ptr<EnumerateTask> task)
+{
+    std::vector<ConnectionHandle> handles;
+    try
+    {
+        std::lock_guard<std::mutex> entryLock(entryMutex(name));
+        handles = entry->enumerate(hint);
+    }
+    catch (const std::exception &ex)
+    {
+        lime::error("%s enumerate failed: %s", name.c_str(), ex.what());
+    }
+    for (auto &handle : handles)
+    {
+        //insert the module name, which can be filtered on in makeConnection()
+        handle.module = name;
+    }
+    {
+        std::lock_guard<std::mutex> lock(task->lock);
+        task->handles = handles;
+        task->done = true;
+        task->cv.notify_one();
+    }
+
+    //release the entry, it can be unregistered from now on
+    std::lock_guard<std::mutex> lock(registryMutex());
+    auto &probes = probeThreads();
+    if (task->timedOut and --probes.stalled[entry] == 0) probes.stalled.erase(entry);
+    task->finished = true;
+    probes.release(entry);
+}
+
 /*******************************************************************
  * Registry implementation
  ******************************************************************/
 std::vector<ConnectionHandle> ConnectionRegistry::findConnections(const ConnectionHandle &hint)
 {
     __loadAllConnections();
-    std::lock_guard<std::mutex> lock(registryMutex());
 
-    std::vector<ConnectionHandle> results;
-    for (const auto &entry : registryEntries)
+    //enumerate all backends concurrently, each one in its own thread,
+    //so slow discovery does not hold the registry lock
+    std::vector<std::pair<std::string, ConnectionRegistryEntry *>> entries;
+    std::vector<std::shared_ptr<EnumerateTask>> tasks;
     {
-        //filter by module name when specified
-        if (not hint.module.empty() and hint.module != entry.first) continue;
+        std::lock_guard<std::mutex> lock(registryMutex());
+        auto &probes = probeThreads();
+        probes.reap();
+        for (const auto &entry : registryEntries)
+        {
+            //filter by module name when specified
+            if (not hint.module.empty() and hint.module != entry.first) continue;
+            entries.push_back(entry);
+            std::shared_ptr<EnumerateTask> task(new EnumerateTask());
+            probes.references[entry.second]++;
+            task->thread = std::thread(enumerateEntry, entry.first, entry.second, hint, task);
+            probes.tasks.push_back(task);
+            tasks.push_back(task);
+        }
+    }
 
-        for (auto handle : entry.second->enumerate(hint))
+    //collect results in registry order, backends that exceed the timeout
+    //are skipped and left to finish in the background, they are joined later
+    std::vector<ConnectionHandle> results;
+    const auto deadline = std::chrono::steady_clock::now() + enumerateTimeout;
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        std::unique_lock<std::mutex> lock(tasks[i]->lock);
+        if (not tasks[i]->cv.wait_until(lock, deadline, [&]{return tasks[i]->done;}))
         {
-            //insert the module name, which can be filtered on in makeConnection()
-            handle.module = entry.first;
-            results.push_back(handle);
+            lock.unlock();
+            lime::warning("%s enumerate timed out", entries[i].first.c_str());
+            std::lock_guard<std::mutex> registryLock(registryMutex());
+            if (not tasks[i]->finished)
+            {
+                tasks[i]->timedOut = true;
+                probeThreads().stalled[entries[i].second]++;
+            }
+            continue;
         }
+        results.insert(results.end(), tasks[i]->handles.begin(), tasks[i]->handles.end());
     }
     return results;
 }
@@ -67,22 +214,55 @@ std::vector<ConnectionHandle> ConnectionRegistry::findConnections(const Connecti
 IConnection *ConnectionRegistry::makeConnection(const ConnectionHandle &handle)
 {
     __loadAllConnections();
-    std::lock_guard<std::mutex> lock(registryMutex());
+
+    //take a reference on candidate entries, so enumerate can run without the registry lock
+    std::vector<std::pair<std::string, ConnectionRegistryEntry *>> entries;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        auto &probes = probeThreads();
+        probes.reap();
+        for (const auto &entry : registryEntries)
+        {
+            //filter by module name when specified
+            if (not handle.module.empty() and handle.module != entry.first) continue;
+            //a hung backend would block this call as well
+            if (probes.stalled.count(entry.second) != 0)
+            {
+                lime::warning("%s enumerate still running, skipped", entry.first.c_str());
+                continue;
+            }
+            probes.references[entry.second]++;
+            entries.push_back(entry);
+        }
+    }
+
+    //references are dropped on every return path, also when make() throws
+    struct EntriesRelease
+    {
+        ~EntriesRelease(void)
+        {
+            std::lock_guard<std::mutex> lock(registryMutex());
+            for (const auto &entry : entries) probeThreads().release(entry.second);
+        }
+        const std::vector<std::pair<std::string, ConnectionRegistryEntry *>> &entries;
+    } entriesRelease = {entries};
 
     //use the identifier as a hint to perform a discovery
     //only identifiers from the discovery function itself is used in the factory
-    for (const auto &entry : registryEntries)
+    for (const auto &entry : entries)
     {
-        //filter by module name when specified
-        if (not handle.module.empty() and handle.module != entry.first) continue;
-
-        const auto r = entry.second->enumerate(handle);
+        std::vector<ConnectionHandle> r;
+        {
+            std::lock_guard<std::mutex> entryLock(entryMutex(entry.first));
+            r = entry.second->enumerate(handle);
+        }
         if (r.empty()) continue;
 
         auto realHandle = r.front(); //just pick the first
         realHandle.module = entry.first;
 
         //check the cache
+        std::lock_guard<std::mutex> lock(registryMutex());
         auto &sharedConnection = connectionCache[realHandle.serialize()];
         if (not sharedConnection)
         {
@@ -151,12 +331,26 @@ std::vector<std::string> ConnectionRegistry::moduleNames(void)
 ConnectionRegistryEntry::ConnectionRegistryEntry(const std::string &name):
     _name(name)
 {
+    //statics used by enumerate threads are created first, so they outlive static entries
+    probeThreads();
+    entryMutex(_name);
     std::lock_guard<std::mutex> lock(registryMutex());
     registryEntries[_name] = this;
 }
 
 ConnectionRegistryEntry::~ConnectionRegistryEntry(void)
 {
-    std::lock_guard<std::mutex> lock(registryMutex());
-    registryEntries.erase(_name);
+    unregisterEntry();
+}
+
+void ConnectionRegistryEntry::unregisterEntry(void)
+{
+    std::unique_lock<std::mutex> lock(registryMutex());
+    auto it = registryEntries.find(_name);
+    if (it != registryEntries.end() and it->second == this) registryEntries.erase(it);
+
+    //wait for enumerate calls still running in background threads
+    auto &probes = probeThreads();
+    probes.released.wait(lock, [&]{return probes.references.count(this) == 0;});
+    probes.reap();
 }
@@ -93,6 +93,15 @@ public:
      */
     virtual IConnection *make(const ConnectionHandle &handle) = 0;
 
+protected:
+    /*!
+     * Remove the entry from the registry and wait for enumerate()
+     * calls still running in discovery threads to return.
+     * Destructors of entries owning resources used by enumerate()
+     * call this before releasing them, the base destructor calls it too.
+     */
+    void unregisterEntry(void);
+
 private:
     std::string _name;
 };
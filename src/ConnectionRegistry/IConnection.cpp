@@ -25,7 +25,20 @@ StreamMetadata::StreamMetadata(void):
     hasTimestamp(false),
     endOfBurst(false),
     lateTimestamp(false),
-    packetDropped(false)
+    packetDropped(false),
+    underflow(false)
+{
+    return;
+}
+
+StreamMeters::StreamMeters(void):
+    power(-200),
+    peak(-200),
+    dcI(0),
+    dcQ(0),
+    clipped(0),
+    samplesCount(0),
+    timestamp(0)
 {
     return;
 }
@@ -33,6 +46,13 @@ StreamMetadata::StreamMetadata(void):
 StreamConfig::StreamConfig(void):
     isTx(false),
     bufferLength(0),
+    bufferTime_ms(0),
+    packedStorage(false),
+    transferBuffers(0),
+    metersWindow(0),
+    channelizerRate(0),
+    channelizerOffset(0),
+    channelizerBandwidth(0),
     format(STREAM_12_BIT_IN_16),
     linkFormat(STREAM_12_BIT_IN_16)
 {
@@ -195,6 +215,11 @@ size_t IConnection::GetStreamSize(const size_t streamID)
     return 16*1024;
 }
 
+int IConnection::SetStreamMemoryBudget(const size_t bytes)
+{
+    return ReportError(EPERM, "SetStreamMemoryBudget not implemented");
+}
+
 int IConnection::ControlStream(const size_t streamID, const bool enable)
 {
     return ReportError(EPERM, "ControlStream not implemented");
@@ -215,11 +240,21 @@ int IConnection::ReadStreamStatus(const size_t streamID, const long timeout_ms,
     return ReportError(EPERM, "ReadStreamStatus not implemented");
 }
 
+int IConnection::ReadStreamMeters(const size_t streamID, StreamMeters &meters)
+{
+    return ReportError(EPERM, "ReadStreamMeters not implemented");
+}
+
 int IConnection::UploadWFM(const void * const* samples, uint8_t chCount, size_t sample_count, StreamConfig::StreamDataFormat format, int epIndex)
 {
     return ReportError(EPERM, "UploadTxWFM not implemented");
 }
 
+int IConnection::UploadWFMFile(const std::string& filename, uint8_t chCount, int epIndex)
+{
+    return ReportError(EPERM, "UploadWFMFile not implemented");
+}
+
 /** @brief Sets callback function which gets called each time data is sent or received
 */
 void IConnection::SetDataLogCallback(std::function<void(bool, const unsigned char*, const unsigned int)> callback)
@@ -110,6 +110,41 @@ struct LIME_API StreamMetadata
      * perhaps in a receiver overflow event.
      */
     bool packetDropped;
+
+    /*!
+     * True to indicate that transmitter ran out of samples
+     * in the middle of a burst.
+     * Used in stream status reporting.
+     */
+    bool underflow;
+};
+
+/*!
+ * Signal level statistics of a receive stream, measured over
+ * one window of samples while unpacking them from the link.
+ */
+struct LIME_API StreamMeters
+{
+    StreamMeters(void);
+
+    //! Mean power relative to full scale, dBFS
+    float power;
+
+    //! Peak magnitude relative to full scale, dBFS
+    float peak;
+
+    //! Mean I and Q values, normalized to full scale [-1, 1)
+    float dcI;
+    float dcQ;
+
+    //! Number of samples with I or Q at full scale
+    uint32_t clipped;
+
+    //! Number of samples in the window, 0 when nothing was measured yet
+    uint32_t samplesCount;
+
+    //! The timestamp of the first sample in the window
+    uint64_t timestamp;
 };
 
 /*!
@@ -138,6 +173,8 @@ struct LIME_API StreamConfig
         STREAM_12_BIT_IN_16,
         STREAM_12_BIT_COMPRESSED,
         STREAM_COMPLEX_FLOAT32,
+        STREAM_12_BIT_PACKED, //!< host only, 3 bytes per IQ sample as on the wire (CS12)
+        STREAM_8_BIT, //!< host only, 8 bit I and Q, upper bits of 12 bit samples (CS8)
     };
 
     /*!
@@ -147,6 +184,52 @@ struct LIME_API StreamConfig
      */
     size_t bufferLength;
 
+    /*!
+     * Buffering time in milliseconds at the current sample rate,
+     * used when bufferLength is 0.
+     * Default: 0, meaning automatic selection
+     */
+    uint32_t bufferTime_ms;
+
+    /*!
+     * Store samples in internal buffers in 12 bit packed form,
+     * they are expanded only when read. Uses 25% less memory.
+     * Default: false
+     */
+    bool packedStorage;
+
+    /*!
+     * Number of data transfer buffers kept in flight by connections
+     * which transfer stream data on a separate I/O thread (PCIe).
+     * Default: 0, meaning connection's default
+     */
+    uint8_t transferBuffers;
+
+    /*!
+     * Number of samples over which receive stream meters are measured,
+     * rounded up to whole packets. See ReadStreamMeters().
+     * Nonzero value measures from the stream start, otherwise
+     * measuring starts with the first ReadStreamMeters() call.
+     * Default: 0, meaning about 10 ms at the current sample rate
+     */
+    uint32_t metersWindow;
+
+    /*!
+     * Output rate of host side channelizer, receive streams only.
+     * When set, the stream delivers the band around channelizerOffset
+     * shifted to DC and resampled to this rate, in complex float format.
+     * Timestamps count output samples. Streams of the same channel
+     * share one device stream.
+     * Default: 0, meaning samples at the device sample rate
+     */
+    double channelizerRate;
+
+    //! Channelizer band center relative to the channel center, Hz
+    double channelizerOffset;
+
+    //! Channelizer passband width, Hz. Default: 0, meaning 80% of channelizerRate
+    double channelizerBandwidth;
+
     //! The format of the samples in Read/WriteStream().
     StreamDataFormat format;
 
@@ -381,6 +464,14 @@ public:
      */
     virtual size_t GetStreamSize(const size_t streamID);
 
+    /*!
+     * Set the memory limit shared by internal buffers of all streams.
+     * Buffers of streams set up later are shrunk to fit into the limit.
+     * @param bytes memory limit in bytes
+     * @return 0-success, other failure
+     */
+    virtual int SetStreamMemoryBudget(const size_t bytes);
+
     /*!
      * Control streaming activation, bursts, and timing.
      * While SetupStream() sets up and allocates resources,
@@ -397,11 +488,16 @@ public:
     /*!
      * Read blocking data from the stream into the specified buffer.
      *
+     * - When the metadata has a timestamp on input, reading starts at that
+     *   timestamp. Older samples are discarded without being copied.
+     *   A returned timestamp greater than requested means the sample was already lost.
+     * - Returns 0 if the requested timestamp did not arrive within the timeout.
+     *
      * @param streamID the RX stream index number
      * @param buffs an array of buffers pointers
      * @param length the number of samples per buffer
      * @param timeout_ms the timeout in milliseconds
-     * @param [out] metadata optional stream metadata
+     * @param [in,out] metadata optional stream metadata
      * @return the number of samples read or error code
      */
     virtual int ReadStream(const size_t streamID, void* buffer, const size_t length, const long timeout_ms, StreamMetadata &metadata);
@@ -432,6 +528,18 @@ public:
      */
     virtual int ReadStreamStatus(const size_t streamID, const long timeout_ms, StreamMetadata &metadata);
 
+    /*!
+     * Get signal level statistics of the last completed meters window.
+     * Meters are computed by the receive thread and published lock-free,
+     * reading them does not access the device. The first call starts
+     * measuring, unless StreamConfig::metersWindow was set.
+     *
+     * @param streamID the RX stream index number
+     * @param [out] meters signal statistics, left untouched on failure
+     * @return 0 on success, -1 when not available
+     */
+    virtual int ReadStreamMeters(const size_t streamID, StreamMeters &meters);
+
     /**	@brief Uploads waveform to on board memory for later use
     @param samples multiple channel samples data
     @param chCount number of waveform channels
@@ -440,6 +548,13 @@ public:
     */
     virtual int UploadWFM(const void* const* samples, uint8_t chCount, size_t sample_count, StreamConfig::StreamDataFormat format, int epIndex);
 
+    /**	@brief Uploads waveform file to on board memory for later use
+    @param filename waveform file (.wfm, .cs16, .cf32 or SigMF recording)
+    @param chCount number of waveform channels, all get the same samples
+    @param epIndex streaming port index
+    */
+    virtual int UploadWFMFile(const std::string& filename, uint8_t chCount, int epIndex);
+
     /**	@brief Read raw stream data from device streaming port
     @param buffer       read buffer pointer
     @param length       number of bytes to read
@@ -650,6 +765,7 @@ public:
         enum
         {
             SYNC_TIMESTAMP = 1,
+            END_BURST = 2, //!< last samples of burst, flushes partially filled packet
         };
         uint64_t timestamp;
         uint32_t flags;
@@ -671,6 +787,12 @@ public:
     virtual int Write(const void* samples, const uint32_t count, const Metadata* metadata, const int32_t timeout_ms = 100) = 0;
 
     virtual Info GetInfo() = 0;
+
+    /** @brief Returns signal statistics of receive channel
+        @param meters statistics of the last completed window
+        @return 0 on success, -1 when not available
+    */
+    virtual int GetMeters(StreamMeters& meters) {return -1;};
 };
 
 }
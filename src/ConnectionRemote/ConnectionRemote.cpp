@@ -0,0 +1,221 @@
+/**
+    @file ConnectionRemote.cpp
+    @author Lime Microsystems
+    @brief Connection to device shared over network by LimeSuiteServer
+*/
+
+#include "ConnectionRemote.h"
+#include "ErrorReporting.h"
+#include "Logger.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <cstring>
+
+using namespace std;
+using namespace lime;
+using namespace lime::remote;
+
+static const int helloTimeout_ms = 2000;
+
+/** @brief Connects to server control port and opens sample transport
+*/
+ConnectionRemote::ConnectionRemote(const std::string &host, const uint16_t port, const Transport transport) :
+    mControlFd(-1),
+    mHost(host),
+    mConnectionType(USB_PORT)
+{
+    RxLoopFunction = bind(&ConnectionRemote::ReceivePacketsLoop, this, std::placeholders::_1);
+    TxLoopFunction = bind(&ConnectionRemote::TransmitPacketsLoop, this, std::placeholders::_1);
+
+    mControlFd = ConnectTCP(host, port, helloTimeout_ms);
+    if (mControlFd < 0)
+    {
+        ReportError(ECONNREFUSED, "Failed to connect to %s:%i", host.c_str(), port);
+        return;
+    }
+    Message hello(MSG_HELLO);
+    hello.PutU16(PROTOCOL_VERSION);
+    Message reply;
+    if (Request(hello, reply, helloTimeout_ms) != 0)
+        return;
+    const uint16_t version = reply.GetU16();
+    mConnectionType = eConnectionType(reply.GetU8());
+    if (version != PROTOCOL_VERSION)
+    {
+        ReportError(EPROTO, "Remote server protocol version %i, expected %i", version, PROTOCOL_VERSION);
+        Close();
+        return;
+    }
+    if (OpenDataLink(transport) != 0)
+    {
+        Close();
+        return;
+    }
+    GetChipVersion();
+}
+
+ConnectionRemote::~ConnectionRemote(void)
+{
+    //streaming threads use data link, stop them before it is closed
+    for (auto streamer : mStreamers)
+        streamer->UpdateThreads(true);
+    Close();
+}
+
+void ConnectionRemote::Close()
+{
+    mLink.reset();
+    std::lock_guard<std::mutex> lock(mControlLock);
+    if (mControlFd >= 0)
+        close(mControlFd);
+    mControlFd = -1;
+}
+
+bool ConnectionRemote::IsOpen()
+{
+    return mControlFd >= 0 and mLink and mLink->IsAlive();
+}
+
+/** @brief Sends request and waits for its reply
+    @return 0 on success, -1 if server reported failure or connection was lost
+*/
+int ConnectionRemote::Request(Message &request, Message &reply, const int timeout_ms)
+{
+    std::lock_guard<std::mutex> lock(mControlLock);
+    if (mControlFd < 0)
+        return ReportError(ENOTCONN, "Remote connection is closed");
+    if (SendMessage(mControlFd, request) != 0 or ReceiveMessage(mControlFd, reply, timeout_ms) != 0
+        or reply.type != request.type)
+    {
+        //replies can not be matched to requests anymore
+        close(mControlFd);
+        mControlFd = -1;
+        return ReportError(ECONNRESET, "Remote connection to %s lost", mHost.c_str());
+    }
+    if (reply.status != 0)
+        return ReportError("Remote: %s", reply.GetString().c_str());
+    return 0;
+}
+
+int ConnectionRemote::Probe(const std::string &host, const uint16_t port, std::string &name, uint64_t &serial)
+{
+    const int fd = ConnectTCP(host, port, helloTimeout_ms);
+    if (fd < 0)
+        return -1;
+    Message hello(MSG_HELLO);
+    hello.PutU16(PROTOCOL_VERSION);
+    Message reply;
+    int status = -1;
+    if (SendMessage(fd, hello) == 0 and ReceiveMessage(fd, reply, helloTimeout_ms) == 0
+        and reply.type == MSG_HELLO and reply.status == 0)
+    {
+        reply.GetU16(); //version
+        reply.GetU8(); //connection type
+        name = reply.GetString();
+        serial = reply.GetU64();
+        status = reply.valid ? 0 : -1;
+    }
+    close(fd);
+    return status;
+}
+
+/** @brief Creates sample transport, UDP socket is bound locally before
+    server is asked to send to it, TCP connection is made to port given by server
+*/
+int ConnectionRemote::OpenDataLink(const Transport transport)
+{
+    sockaddr_storage peer;
+    socklen_t peerLength = sizeof(peer);
+    if (getpeername(mControlFd, (sockaddr*)&peer, &peerLength) != 0)
+        return ReportError(errno);
+
+    int fd = -1;
+    Message request(MSG_OPEN_DATA);
+    request.PutU8(transport);
+    if (transport == TRANSPORT_UDP)
+    {
+        fd = socket(peer.ss_family, SOCK_DGRAM, 0);
+        sockaddr_storage local;
+        memset(&local, 0, sizeof(local));
+        local.ss_family = peer.ss_family;
+        socklen_t localLength = peer.ss_family == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+        if (fd < 0 or ::bind(fd, (sockaddr*)&local, localLength) != 0
+            or getsockname(fd, (sockaddr*)&local, &localLength) != 0)
+        {
+            if (fd >= 0)
+                close(fd);
+            return ReportError(errno);
+        }
+        request.PutU16(ntohs(peer.ss_family == AF_INET6 ? ((sockaddr_in6*)&local)->sin6_port : ((sockaddr_in*)&local)->sin_port));
+    }
+    else
+        request.PutU16(0);
+
+    Message reply;
+    if (Request(request, reply) != 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    const uint16_t dataPort = reply.GetU16();
+    if (transport == TRANSPORT_UDP)
+    {
+        if (peer.ss_family == AF_INET6)
+            ((sockaddr_in6*)&peer)->sin6_port = htons(dataPort);
+        else
+            ((sockaddr_in*)&peer)->sin_port = htons(dataPort);
+        if (connect(fd, (sockaddr*)&peer, peerLength) != 0)
+        {
+            close(fd);
+            return ReportError(errno);
+        }
+    }
+    else
+    {
+        fd = ConnectTCP(mHost, dataPort, helloTimeout_ms);
+        if (fd < 0)
+            return ReportError(ECONNREFUSED, "Failed to open remote data connection");
+    }
+    mLink.reset(new DataLink(fd, transport));
+    return 0;
+}
+
+int ConnectionRemote::ControlDataFlow(const int epIndex, const bool tx, const bool enable)
+{
+    Message request(MSG_STREAM_CONTROL);
+    request.PutU8(epIndex);
+    request.PutU8(tx);
+    request.PutU8(enable);
+    Message reply;
+    return Request(request, reply);
+}
+
+int ConnectionRemote::TransferPacket(GenericPacket &pkt)
+{
+    Message request(MSG_TRANSFER_PACKET);
+    request.PutU8(pkt.cmd);
+    request.PutU8(pkt.status);
+    request.PutU32(pkt.periphID);
+    request.PutBytes(pkt.outBuffer.data(), pkt.outBuffer.size());
+    Message reply;
+    if (Request(request, reply) != 0)
+        return -1;
+    pkt.status = eCMD_STATUS(reply.GetU8());
+    pkt.inBuffer = reply.GetBytes();
+    return reply.valid ? 0 : ReportError(EPROTO, "Malformed remote reply");
+}
+
+/** @brief Control packets are forwarded whole by TransferPacket
+*/
+int ConnectionRemote::Write(const unsigned char *buffer, const int length, int timeout_ms)
+{
+    return ReportError(ENOTSUP, "Remote connection does not support raw control writes");
+}
+
+int ConnectionRemote::Read(unsigned char *buffer, const int length, int timeout_ms)
+{
+    return ReportError(ENOTSUP, "Remote connection does not support raw control reads");
+}
@@ -0,0 +1,80 @@
+/**
+    @file ConnectionRemote.h
+    @author Lime Microsystems
+    @brief Connection to device shared over network by LimeSuiteServer
+*/
+
+#pragma once
+#include <ConnectionRegistry.h>
+#include <ILimeSDRStreaming.h>
+#include <string>
+#include <memory>
+#include <mutex>
+#include "RemoteProtocol.h"
+
+namespace lime{
+
+/** @brief Client of LimeSuiteServer.
+
+    LMS64C control packets are forwarded over TCP, FPGA packets are exchanged
+    through remote::DataLink and parsed locally by the same streaming loops
+    as local devices use, so samples travel in packed 12 bit form.
+*/
+class ConnectionRemote : public ILimeSDRStreaming
+{
+public:
+    ConnectionRemote(const std::string &host, const uint16_t port, const remote::Transport transport);
+    ~ConnectionRemote(void);
+
+    bool IsOpen() override;
+    void Close();
+
+    int Write(const unsigned char *buffer, int length, int timeout_ms = 100) override;
+    int Read(unsigned char *buffer, int length, int timeout_ms = 100) override;
+    int TransferPacket(GenericPacket &pkt) override;
+
+    int UpdateExternalDataRate(const size_t channel, const double txRate, const double rxRate) override;
+    int UpdateExternalDataRate(const size_t channel, const double txRate, const double rxRate, const double txPhase, const double rxPhase) override;
+
+    /** @brief Connects and queries device identity, used for enumeration
+        @return 0 on success
+    */
+    static int Probe(const std::string &host, const uint16_t port, std::string &name, uint64_t &serial);
+
+protected:
+    void ReceivePacketsLoop(Streamer* args) override;
+    void TransmitPacketsLoop(Streamer* args) override;
+
+    int ReceiveData(char* buffer, int length, int epIndex, int timeout = 100) override;
+    int SendData(const char* buffer, int length, int epIndex, int timeout = 100) override;
+    int ResetStreamBuffers() override;
+
+private:
+    eConnectionType GetType(void) override
+    {
+        return mConnectionType;
+    }
+    int Request(remote::Message &request, remote::Message &reply, const int timeout_ms = 10000);
+    int OpenDataLink(const remote::Transport transport);
+    int ControlDataFlow(const int epIndex, const bool tx, const bool enable);
+
+    int mControlFd;
+    std::string mHost;
+    std::mutex mControlLock;
+    std::unique_ptr<remote::DataLink> mLink;
+    eConnectionType mConnectionType;
+};
+
+class ConnectionRemoteEntry : public ConnectionRegistryEntry
+{
+public:
+    ConnectionRemoteEntry(void);
+
+    ~ConnectionRemoteEntry(void);
+
+    std::vector<ConnectionHandle> enumerate(const ConnectionHandle &hint);
+
+    IConnection *make(const ConnectionHandle &handle);
+};
+
+}
@@ -0,0 +1,71 @@
+/**
+    @file ConnectionRemoteEntry.cpp
+    @author Lime Microsystems
+    @brief Registry entry of network connection to LimeSuiteServer
+*/
+
+#include "ConnectionRemote.h"
+#include <sstream>
+#include <iomanip>
+using namespace lime;
+
+//! make a static-initialized entry in the registry
+void __loadConnectionRemoteEntry(void) //TODO fixme replace with LoadLibrary/dlopen
+{
+    static ConnectionRemoteEntry remoteEntry;
+}
+
+ConnectionRemoteEntry::ConnectionRemoteEntry(void):
+    ConnectionRegistryEntry("Remote")
+{
+}
+
+ConnectionRemoteEntry::~ConnectionRemoteEntry(void)
+{
+}
+
+std::vector<ConnectionHandle> ConnectionRemoteEntry::enumerate(const ConnectionHandle &hint)
+{
+    std::vector<ConnectionHandle> handles;
+    //servers are not discovered, only the one given by address is probed,
+    //plain addresses are claimed only when module is explicitly Remote
+    if (hint.addr.empty())
+        return handles;
+    if (hint.addr.find("://") == std::string::npos and hint.module != "Remote")
+        return handles;
+
+    std::string host;
+    uint16_t port;
+    remote::Transport transport;
+    if (remote::ParseAddress(hint.addr, host, port, transport) != 0)
+        return handles;
+
+    std::string name;
+    uint64_t serial = 0;
+    if (ConnectionRemote::Probe(host, port, name, serial) != 0)
+        return handles;
+
+    ConnectionHandle handle;
+    handle.media = transport == remote::TRANSPORT_TCP ? "TCP" : "UDP";
+    handle.name = name;
+    handle.addr = remote::FormatAddress(host, port, transport);
+    if (serial != 0)
+    {
+        std::stringstream ss;
+        ss << std::hex << serial;
+        handle.serial = ss.str();
+    }
+    if (hint.serial.empty() or handle.serial.find(hint.serial) != std::string::npos)
+        handles.push_back(handle);
+    return handles;
+}
+
+IConnection *ConnectionRemoteEntry::make(const ConnectionHandle &handle)
+{
+    std::string host;
+    uint16_t port;
+    remote::Transport transport;
+    if (remote::ParseAddress(handle.addr, host, port, transport) != 0)
+        return nullptr;
+    return new ConnectionRemote(host, port, transport);
+}
@@ -0,0 +1,411 @@
+/**
+    @file ConnectionRemoteing.cpp
+    @author Lime Microsystems
+    @brief Streaming over network connection to LimeSuiteServer
+*/
+
+#include "ConnectionRemote.h"
+#include "fifo.h"
+#include <iostream>
+#include <thread>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <complex>
+#include <ciso646>
+#include <FPGA_common.h>
+#include <ErrorReporting.h>
+#include <Logger.h>
+#include "BufferedTransfer.h"
+
+using namespace std;
+using namespace lime;
+using namespace lime::remote;
+
+static const uint8_t defaultBuffersCount = 4; //transfers kept in flight
+static const uint32_t txWindowPackets = 512; //Tx packets in flight, limited by server queue
+
+int ConnectionRemote::UpdateExternalDataRate(const size_t channel, const double txRate_Hz, const double rxRate_Hz, const double txPhase, const double rxPhase)
+{
+    Message request(MSG_UPDATE_RATE);
+    request.PutU32(channel);
+    request.PutDouble(txRate_Hz);
+    request.PutDouble(rxRate_Hz);
+    request.PutU8(1);
+    request.PutDouble(txPhase);
+    request.PutDouble(rxPhase);
+    Message reply;
+    if (Request(request, reply) != 0)
+        return -1;
+    if (channel != 2)
+        mExpectedSampleRate = rxRate_Hz;
+    return 0;
+}
+
+/** @brief Configures server device FPGA plls to LimeLight interface frequency
+*/
+int ConnectionRemote::UpdateExternalDataRate(const size_t channel, const double txRate_Hz, const double rxRate_Hz)
+{
+    Message request(MSG_UPDATE_RATE);
+    request.PutU32(channel);
+    request.PutDouble(txRate_Hz);
+    request.PutDouble(rxRate_Hz);
+    request.PutU8(0);
+    Message reply;
+    if (Request(request, reply) != 0)
+        return -1;
+    mExpectedSampleRate = rxRate_Hz;
+    return 0;
+}
+
+int ConnectionRemote::ResetStreamBuffers()
+{
+    Message request(MSG_RESET_BUFFERS);
+    Message reply;
+    const int status = Request(request, reply);
+    if (mLink)
+        for (int ep = 0; ep < MAX_EP_COUNT; ++ep)
+            mLink->Clear(ep);
+    return status;
+}
+
+int ConnectionRemote::ReceiveData(char* buffer, int length, int epIndex, int timeout_ms)
+{
+    if (not mLink)
+        return -1;
+    return mLink->Receive(buffer, length, epIndex, timeout_ms);
+}
+
+/** @brief Sends FPGA packets to server, blocks while too many packets are
+    still waiting to be passed to device
+*/
+int ConnectionRemote::SendData(const char* buffer, int length, int epIndex, int timeout_ms)
+{
+    if (not mLink)
+        return -1;
+    if (not mLink->WaitCredit(epIndex, length/PACKET_SIZE, txWindowPackets, timeout_ms))
+        return 0;
+    return mLink->Send(buffer, length, epIndex);
+}
+
+/** @brief Function dedicated for receiving data samples from board
+    @param rxFIFO FIFO to store received data
+    @param terminate periodically pooled flag to terminate thread
+    @param dataRate_Bps (optional) if not NULL periodically returns data rate in bytes per second
+*/
+void ConnectionRemote::ReceivePacketsLoop(Streamer* stream)
+{
+    //at this point FPGA has to be already configured to output samples
+    const uint8_t chCount = stream->mRxStreams.size();
+    const auto link = stream->mRxStreams[0]->config.linkFormat;
+    const uint32_t samplesInPacket = (link == StreamConfig::STREAM_12_BIT_COMPRESSED ? 1360 : 1020)/chCount;
+    const int epIndex = stream->mChipID;
+
+    double latency=0;
+    for (int i = 0; i < chCount; i++)
+    {
+        latency += stream->mRxStreams[i]->config.performanceLatency/chCount;
+    }
+    const unsigned tmp_cnt = (latency * 6)+0.5;
+
+    const uint8_t packetsToBatch = (1<<tmp_cnt);
+    const uint32_t bufferSize = packetsToBatch*sizeof(FPGA_DataPacket);
+    const uint8_t buffersCount = stream->mRxStreams[0]->config.transferBuffers > 0 ? stream->mRxStreams[0]->config.transferBuffers : defaultBuffersCount;
+    vector<StreamChannel::Frame> chFrames;
+    std::unique_ptr<BufferedTransfer> transfers;
+    try
+    {
+        chFrames.resize(chCount);
+        //reading continues on I/O thread while received packets are parsed
+        transfers.reset(new BufferedTransfer([this, epIndex](char* buffer, int length, int timeout_ms){
+            return this->ReceiveData(buffer, length, epIndex, timeout_ms);
+        }, false, bufferSize, buffersCount));
+    }
+    catch (const std::bad_alloc &ex)
+    {
+        ReportError("Error allocating Rx buffers, not enough memory");
+        return;
+    }
+
+    if (ControlDataFlow(epIndex, false, true) != 0)
+        return;
+
+    unsigned long totalBytesReceived = 0; //for data rate calculation
+    int m_bufferFailures = 0;
+    int32_t droppedSamples = 0;
+    int32_t packetLoss = 0;
+
+    vector<uint32_t> samplesReceived(chCount, 0);
+
+    auto t1 = chrono::high_resolution_clock::now();
+    auto t2 = chrono::high_resolution_clock::now();
+
+    //late Tx packet flags are cleared directly from this thread
+    uint32_t reg9 = 0;
+    this->ReadRegister(0x0009, reg9);
+    const uint32_t resetTxFlagsAddr[] = {0x0009, 0x0009};
+    const uint32_t resetTxFlagsData[] = {reg9 | (1 << 1), reg9 & ~(1 << 1)};
+
+    int resetFlagsDelay = 128;
+    uint64_t prevTs = 0;
+    bool streamingPaused = false;
+    while (stream->terminateRx.load() == false)
+    {
+        if(stream->generateData.load())
+        {
+            fpga::StopStreaming(this, epIndex);
+            streamingPaused = true;
+            stream->safeToConfigInterface.notify_all(); //notify that it's safe to change chip config
+            const int batchSize = (this->mExpectedSampleRate/chFrames[0].samplesCount)/10;
+            IStreamChannel::Metadata meta;
+            for(int i=0; i<batchSize; ++i)
+            {
+                for(int ch=0; ch<chCount; ++ch)
+                {
+                    meta.timestamp = chFrames[ch].timestamp;
+                    for(int j=0; j<chFrames[ch].samplesCount; ++j)
+                    {
+                        chFrames[ch].samples[j].i = 0;
+                        chFrames[ch].samples[j].q = 0;
+                    }
+                    uint32_t samplesPushed = stream->mRxStreams[ch]->Write((const void*)chFrames[ch].samples, chFrames[ch].samplesCount, &meta);
+                    samplesReceived[ch] += chFrames[ch].samplesCount;
+                    if(samplesPushed != chFrames[ch].samplesCount)
+                        LIME_LOG_ASYNC(lime::LOG_LEVEL_WARNING, "Rx samples pushed %i/%i", samplesPushed, chFrames[ch].samplesCount);
+                }
+            }
+            this_thread::sleep_for(chrono::milliseconds(100));
+        }
+        else if(streamingPaused)
+        {
+            fpga::StartStreaming(this, epIndex);
+            streamingPaused = false;
+        }
+        int bytesReceived = 0;
+        const char* buffer = transfers->Acquire(&bytesReceived, 200);
+        if (buffer == nullptr)
+            bytesReceived = 0;
+        totalBytesReceived += bytesReceived;
+        if (bytesReceived != int32_t(bufferSize)) //data should come in full sized packets
+            ++m_bufferFailures;
+
+        bool txLate=false;
+        for (uint8_t pktIndex = 0; pktIndex < bytesReceived / sizeof(FPGA_DataPacket); ++pktIndex)
+        {
+            const FPGA_DataPacket* pkt = (const FPGA_DataPacket*)buffer;
+            const uint8_t byte0 = pkt[pktIndex].reserved[0];
+            if ((byte0 & (1 << 3)) != 0 && !txLate) //report only once per batch
+            {
+                txLate = true;
+                if(resetFlagsDelay > 0)
+                    --resetFlagsDelay;
+                else
+                {
+                    LIME_LOG_ASYNC(lime::LOG_LEVEL_INFO, "L %llu", (unsigned long long)pkt[pktIndex].counter);
+                    this->WriteRegisters(resetTxFlagsAddr, resetTxFlagsData, 2);
+                    stream->txEvents.push({StreamEvent::LATE, pkt[pktIndex].counter});
+                    resetFlagsDelay = packetsToBatch*2;
+                }
+            }
+            uint8_t* pktStart = (uint8_t*)pkt[pktIndex].data;
+            if(pkt[pktIndex].counter - prevTs != samplesInPacket && pkt[pktIndex].counter != prevTs)
+            {
+#ifndef NDEBUG
+                LIME_LOG_ASYNC(lime::LOG_LEVEL_DEBUG, "Rx pktLoss@%i - ts diff: %li  pktLoss: %.1f", pktIndex, long(pkt[pktIndex].counter - prevTs), float(pkt[pktIndex].counter - prevTs)/samplesInPacket);
+#endif
+                packetLoss += (pkt[pktIndex].counter - prevTs)/samplesInPacket;
+                stream->rxEvents.push({StreamEvent::PACKET_LOSS, pkt[pktIndex].counter});
+            }
+            prevTs = pkt[pktIndex].counter;
+            stream->rxLastTimestamp.store(pkt[pktIndex].counter);
+            bool rxOverflow = false;
+            for(int ch=0; ch<chCount; ++ch)
+            {
+                IStreamChannel::Metadata meta;
+                meta.timestamp = pkt[pktIndex].counter;
+                meta.flags = RingFIFO::OVERWRITE_OLD;
+                //each channel parses its samples into own format
+                uint32_t samplesPushed = stream->mRxStreams[ch]->WritePayload(pktStart, 4080, ch, chCount, &meta, 100);
+                if(samplesPushed != samplesInPacket)
+                {
+                    droppedSamples += samplesInPacket-samplesPushed;
+                    rxOverflow = true;
+                }
+            }
+            if (rxOverflow)
+                stream->rxEvents.push({StreamEvent::RX_OVERFLOW, pkt[pktIndex].counter});
+        }
+        //correlate host clock with timestamp at the end of received data
+        if (bytesReceived >= int32_t(sizeof(FPGA_DataPacket)))
+            stream->clock.Update(ClockModel::clock::now(), prevTs + samplesInPacket);
+        if (buffer != nullptr)
+            transfers->Release();
+        t2 = chrono::high_resolution_clock::now();
+        auto timePeriod = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+        if (timePeriod >= 1000)
+        {
+            t1 = t2;
+            //total number of bytes sent per second
+            double dataRate = 1000.0*totalBytesReceived / timePeriod;
+#ifndef NDEBUG
+            //each channel sample rate
+            float samplingRate = 1000.0*samplesReceived[0] / timePeriod;
+            printf("Rx: %.3f MB/s, Fs: %.3f MHz, overrun: %i, loss: %i, network loss: %llu\n", dataRate / 1000000.0, samplingRate / 1000000.0, droppedSamples, packetLoss, (unsigned long long)mLink->GetLostCount(epIndex));
+#endif
+            samplesReceived[0] = 0;
+            totalBytesReceived = 0;
+            m_bufferFailures = 0;
+            droppedSamples = 0;
+            packetLoss = 0;
+
+            stream->rxDataRate_Bps.store((uint32_t)dataRate);
+        }
+    }
+    transfers.reset();
+    ControlDataFlow(epIndex, false, false);
+    stream->rxDataRate_Bps.store(0);
+}
+
+/** @brief Functions dedicated for transmitting packets to board
+    @param txFIFO data source FIFO
+    @param terminate periodically pooled flag to terminate thread
+    @param dataRate_Bps (optional) if not NULL periodically returns data rate in bytes per second
+*/
+void ConnectionRemote::TransmitPacketsLoop(Streamer* stream)
+{
+    //at this point FPGA has to be already configured to output samples
+    const uint8_t maxChannelCount = 2;
+    const uint8_t chCount = stream->mTxStreams.size();
+    const auto link = stream->mTxStreams[0]->config.linkFormat;
+    const int epIndex = stream->mChipID;
+
+    double latency=0;
+    for (int i = 0; i < chCount; i++)
+    {
+        latency += stream->mTxStreams[i]->config.performanceLatency/chCount;
+    }
+    const unsigned tmp_cnt = (latency * 6)+0.5;
+    const uint8_t packetsToBatch = (1<<tmp_cnt); //packets in single USB transfer
+    const uint32_t bufferSize = packetsToBatch*4096;
+    const uint32_t popTimeout_ms = 100;
+    const uint8_t buffersCount = stream->mTxStreams[0]->config.transferBuffers > 0 ? stream->mTxStreams[0]->config.transferBuffers : defaultBuffersCount;
+    const uint64_t noBurstEnd = ~0ULL;
+
+    const int maxSamplesBatch = (link==StreamConfig::STREAM_12_BIT_COMPRESSED?1360:1020)/chCount;
+    vector<complex16_t> samples[maxChannelCount];
+    std::atomic<long> totalBytesSent(0);
+    std::unique_ptr<BufferedTransfer> transfers;
+    try
+    {
+        for(int i=0; i<chCount; ++i)
+            samples[i].resize(maxSamplesBatch);
+        //packets for next buffer are formed while previous buffers are being written
+        transfers.reset(new BufferedTransfer([this, epIndex](char* buffer, int length, int timeout_ms){
+            return this->SendData(buffer, length, epIndex, timeout_ms);
+        }, true, bufferSize, buffersCount, [stream, &totalBytesSent, noBurstEnd](int requested, int transferred, uint64_t burstEnd){
+            totalBytesSent += transferred;
+            if (transferred == requested && burstEnd != noBurstEnd)
+                stream->txEvents.push({StreamEvent::END_BURST, burstEnd});
+        }));
+    }
+    catch (const std::bad_alloc& ex) //not enough memory for buffers
+    {
+        lime::error("Error allocating Tx buffers, not enough memory");
+        return;
+    }
+
+    if (ControlDataFlow(epIndex, true, true) != 0)
+        return;
+
+    uint32_t samplesSent = 0;
+
+    auto t1 = chrono::high_resolution_clock::now();
+    auto t2 = chrono::high_resolution_clock::now();
+
+    while (stream->terminateTx.load() != true)
+    {
+        int i=0;
+        bool endOfBurst = false;
+        uint64_t burstEndTimestamp = noBurstEnd;
+        char* buffer = transfers->Acquire(nullptr, popTimeout_ms);
+        if (buffer == nullptr)
+            continue; //all buffers are still being sent
+
+        while(i<packetsToBatch && !endOfBurst)
+        {
+            IStreamChannel::Metadata meta;
+            FPGA_DataPacket* pkt = reinterpret_cast<FPGA_DataPacket*>(buffer);
+            bool samplesPending = false;
+            for(int ch=0; ch<chCount; ++ch)
+            {
+                int samplesPopped = stream->mTxStreams[ch]->Read(samples[ch].data(), maxSamplesBatch, &meta, popTimeout_ms);
+                samplesPending |= samplesPopped > 0;
+                if (meta.flags & IStreamChannel::Metadata::END_BURST)
+                {
+                    endOfBurst = true;
+                    burstEndTimestamp = meta.timestamp + samplesPopped;
+                }
+                else if (samplesPopped > 0 && samplesPopped < maxSamplesBatch)
+                    stream->txEvents.push({StreamEvent::TX_UNDERFLOW, meta.timestamp + samplesPopped});
+                if (samplesPopped != maxSamplesBatch)
+                {
+                    //burst ended or underflow, pad packet with zeros
+                    memset(&samples[ch][samplesPopped], 0, (maxSamplesBatch-samplesPopped)*sizeof(complex16_t));
+                #ifndef NDEBUG
+                    LIME_LOG_ASYNC(lime::LOG_LEVEL_DEBUG, "popping from TX, samples popped %i/%i", samplesPopped, maxSamplesBatch);
+                #endif
+                }
+            }
+            if(stream->terminateTx.load() == true) //early termination
+                break;
+            //burst ended by write without samples, do not send padding packet
+            if (endOfBurst && !samplesPending)
+                break;
+            pkt[i].counter = meta.timestamp;
+            pkt[i].reserved[0] = 0;
+            //by default ignore timestamps
+            const int ignoreTimestamp = !(meta.flags & IStreamChannel::Metadata::SYNC_TIMESTAMP);
+            pkt[i].reserved[0] |= ((int)ignoreTimestamp << 4); //ignore timestamp
+
+            complex16_t* src[maxChannelCount];
+            for(uint8_t c=0; c<chCount; ++c)
+                src[c] = (samples[c].data());
+            uint8_t* const dataStart = (uint8_t*)pkt[i].data;
+            fpga::Samples2FPGAPacketPayload(src, maxSamplesBatch, chCount, link, dataStart, nullptr);
+            samplesSent += maxSamplesBatch;
+            ++i;
+        }
+
+        //end of burst is sent immediately with the packets gathered so far
+        const uint32_t bytesToSend = i*sizeof(FPGA_DataPacket);
+        if (bytesToSend == 0)
+        {
+            //burst data has already been queued for sending
+            if (endOfBurst && stream->terminateTx.load() != true)
+                stream->txEvents.push({StreamEvent::END_BURST, burstEndTimestamp});
+            continue;
+        }
+        transfers->Release(bytesToSend, burstEndTimestamp);
+
+        t2 = chrono::high_resolution_clock::now();
+        auto timePeriod = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+        if (timePeriod >= 1000)
+        {
+            //total number of bytes sent per second
+            float dataRate = 1000.0*totalBytesSent.exchange(0) / timePeriod;
+            stream->txDataRate_Bps.store(dataRate);
+            t1 = t2;
+#ifndef NDEBUG
+            //total number of samples from all channels per second
+            float sampleRate = 1000.0*samplesSent / timePeriod;
+            printf("Tx: %.3f MB/s, Fs: %.3f MHz, failures: %u\n", dataRate / 1000000.0, sampleRate / 1000000.0, transfers->GetFailuresCount());
+#endif
+            samplesSent = 0;
+        }
+    }
+
+    // Wait for all the queued requests to be cancelled
+    transfers.reset();
+    ControlDataFlow(epIndex, true, false);
+    stream->txDataRate_Bps.store(0);
+}
@@ -0,0 +1,489 @@
+/**
+@file LimeSuiteServer.cpp
+@author Lime Microsystems
+@brief Shares opened device over network
+*/
+
+#include "LimeSuiteServer.h"
+#include "RemoteProtocol.h"
+#include "ILimeSDRStreaming.h"
+#include "BufferedTransfer.h"
+#include "ErrorReporting.h"
+#include "Logger.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cstring>
+
+using namespace lime;
+using namespace lime::remote;
+
+static const int rxPumpPackets = 16; //packets per device read
+static const int rxPumpBuffers = 4;
+static const int txPumpPackets = 8; //packets per device write
+static const int txPumpBuffers = 4;
+static const int dataAcceptTimeout_ms = 5000;
+
+LimeSuiteServer::LimeSuiteServer(IConnection* port) :
+    mPort(port),
+    mProtocol(dynamic_cast<LMS64CProtocol*>(port)),
+    mStreaming(dynamic_cast<ILimeSDRStreaming*>(port)),
+    mListenFd(-1),
+    mTerminate(false),
+    mLinkOwner(nullptr),
+    mRxPackets(0),
+    mTxPackets(0)
+{
+    for (int i = 0; i < MAX_EP_COUNT; ++i)
+    {
+        mRxEnabled[i].store(false);
+        mTxEnabled[i].store(false);
+    }
+}
+
+LimeSuiteServer::~LimeSuiteServer()
+{
+    Stop();
+}
+
+int LimeSuiteServer::Start(const uint16_t port, const std::string& host)
+{
+    if (IsRunning())
+        return ReportError(EBUSY, "Server is already running");
+    if (mProtocol == nullptr)
+        return ReportError(ENOTSUP, "Connection can not be shared, control packets are not supported");
+
+    //there is no authentication, listen on loopback unless asked otherwise
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+    addrinfo* addresses = nullptr;
+    const std::string portStr = std::to_string(port);
+    const int gaiStatus = getaddrinfo(host.empty() ? nullptr : host.c_str(), portStr.c_str(), &hints, &addresses);
+    if (gaiStatus != 0)
+        return ReportError(EINVAL, "Failed to resolve server address %s: %s", host.c_str(), gai_strerror(gaiStatus));
+
+    const int one = 1;
+    const int zero = 0;
+    int err = EADDRNOTAVAIL;
+    for (addrinfo* ai = addresses; ai != nullptr and mListenFd < 0; ai = ai->ai_next)
+    {
+        mListenFd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (mListenFd < 0)
+        {
+            err = errno;
+            continue;
+        }
+        setsockopt(mListenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        //IPv6 wildcard accepts IPv4 clients as well
+        if (ai->ai_family == AF_INET6)
+            setsockopt(mListenFd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+        if (bind(mListenFd, ai->ai_addr, ai->ai_addrlen) != 0)
+        {
+            err = errno;
+            close(mListenFd);
+            mListenFd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    if (mListenFd < 0)
+        return ReportError(err, "Failed to bind server %s:%i: %s", host.c_str(), port, strerror(err));
+    if (listen(mListenFd, 8) != 0)
+    {
+        err = errno;
+        close(mListenFd);
+        mListenFd = -1;
+        return ReportError(err);
+    }
+    mTerminate.store(false);
+    mAcceptThread = std::thread(&LimeSuiteServer::AcceptLoop, this);
+    lime::info("LimeSuiteServer listening on %s:%i", host.empty() ? "*" : host.c_str(), port);
+    return 0;
+}
+
+void LimeSuiteServer::Stop()
+{
+    if (not mAcceptThread.joinable())
+        return;
+    mTerminate.store(true);
+    mAcceptThread.join();
+    //sessions poll termination flag between requests
+    for (auto& session : mSessions)
+        session->thread.join();
+    mSessions.clear();
+    CloseDataLink();
+    close(mListenFd);
+    mListenFd = -1;
+}
+
+bool LimeSuiteServer::IsRunning() const
+{
+    return mListenFd >= 0;
+}
+
+LimeSuiteServer::Stats LimeSuiteServer::GetStats() const
+{
+    Stats stats;
+    {
+        std::lock_guard<std::mutex> lock(mSessionsLock);
+        stats.clients = 0;
+        for (auto& session : mSessions)
+            if (not session->done.load())
+                ++stats.clients;
+    }
+    std::lock_guard<std::mutex> lock(mDataLock);
+    stats.streaming = mLink != nullptr;
+    stats.rxPackets = mRxPackets.load();
+    stats.txPackets = mTxPackets.load();
+    stats.txLost = 0;
+    for (int ep = 0; mLink and ep < MAX_EP_COUNT; ++ep)
+        stats.txLost += mLink->GetLostCount(ep);
+    return stats;
+}
+
+void LimeSuiteServer::AcceptLoop()
+{
+    while (not mTerminate.load())
+    {
+        {
+            //reap finished sessions
+            std::lock_guard<std::mutex> lock(mSessionsLock);
+            for (auto it = mSessions.begin(); it != mSessions.end();)
+            {
+                if ((*it)->done.load())
+                {
+                    (*it)->thread.join();
+                    it = mSessions.erase(it);
+                }
+                else
+                    ++it;
+            }
+        }
+        pollfd pfd = {mListenFd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0)
+            continue;
+        sockaddr_storage peer;
+        socklen_t peerLength = sizeof(peer);
+        const int fd = accept(mListenFd, (sockaddr*)&peer, &peerLength);
+        if (fd < 0)
+            continue;
+        const int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        std::unique_ptr<Session> session(new Session);
+        session->fd = fd;
+        session->done.store(false);
+        std::lock_guard<std::mutex> lock(mSessionsLock);
+        session->thread = std::thread(&LimeSuiteServer::Serve, this, session.get());
+        mSessions.push_back(std::move(session));
+    }
+}
+
+void LimeSuiteServer::Serve(Session* session)
+{
+    char peerName[INET6_ADDRSTRLEN] = "?";
+    sockaddr_storage peer;
+    socklen_t peerLength = sizeof(peer);
+    if (getpeername(session->fd, (sockaddr*)&peer, &peerLength) == 0)
+    {
+        if (peer.ss_family == AF_INET6)
+            inet_ntop(AF_INET6, &((sockaddr_in6*)&peer)->sin6_addr, peerName, sizeof(peerName));
+        else
+            inet_ntop(AF_INET, &((sockaddr_in*)&peer)->sin_addr, peerName, sizeof(peerName));
+    }
+    lime::info("Remote client %s connected", peerName);
+
+    while (not mTerminate.load())
+    {
+        pollfd pfd = {session->fd, POLLIN, 0};
+        const int ready = poll(&pfd, 1, 100);
+        if (ready == 0)
+            continue;
+        Message request;
+        if (ready < 0 or ReceiveMessage(session->fd, request, 5000) != 0)
+            break;
+        Message reply(request.type);
+        const int status = Dispatch(session, request, reply);
+        if (status > 0)
+            continue; //reply has already been sent
+        if (status != 0)
+        {
+            reply = Message(request.type, -1);
+            reply.PutString(GetLastErrorMessage());
+        }
+        if (SendMessage(session->fd, reply) != 0)
+            break;
+    }
+
+    bool ownsLink;
+    {
+        std::lock_guard<std::mutex> lock(mDataLock);
+        ownsLink = mLinkOwner == session;
+    }
+    if (ownsLink)
+        CloseDataLink();
+    lime::info("Remote client %s disconnected", peerName);
+    close(session->fd);
+    session->done.store(true);
+}
+
+/** @brief Executes client request
+    @return 0 on success, 1 if reply was sent by handler, -1 on failure
+*/
+int LimeSuiteServer::Dispatch(Session* session, Message& request, Message& reply)
+{
+    switch (request.type)
+    {
+    case MSG_HELLO:
+    {
+        const DeviceInfo info = mPort->GetDeviceInfo();
+        reply.PutU16(PROTOCOL_VERSION);
+        reply.PutU8(mProtocol->GetType());
+        reply.PutString(info.deviceName);
+        reply.PutU64(info.boardSerialNumber);
+        return 0;
+    }
+    case MSG_TRANSFER_PACKET:
+    {
+        LMS64CProtocol::GenericPacket pkt;
+        pkt.cmd = eCMD_LMS(request.GetU8());
+        pkt.status = eCMD_STATUS(request.GetU8());
+        pkt.periphID = request.GetU32();
+        pkt.outBuffer = request.GetBytes();
+        if (not request.valid)
+            return ReportError(EPROTO, "Malformed request");
+        if (mProtocol->TransferPacket(pkt) != 0)
+            return -1;
+        reply.PutU8(pkt.status);
+        reply.PutBytes(pkt.inBuffer.data(), pkt.inBuffer.size());
+        return 0;
+    }
+    case MSG_UPDATE_RATE:
+    {
+        const size_t channel = request.GetU32();
+        const double txRate = request.GetDouble();
+        const double rxRate = request.GetDouble();
+        const bool hasPhase = request.GetU8();
+        if (hasPhase)
+        {
+            const double txPhase = request.GetDouble();
+            const double rxPhase = request.GetDouble();
+            if (not request.valid)
+                return ReportError(EPROTO, "Malformed request");
+            return mPort->UpdateExternalDataRate(channel, txRate, rxRate, txPhase, rxPhase);
+        }
+        if (not request.valid)
+            return ReportError(EPROTO, "Malformed request");
+        return mPort->UpdateExternalDataRate(channel, txRate, rxRate);
+    }
+    case MSG_RESET_BUFFERS:
+    {
+        if (mStreaming == nullptr)
+            return 0;
+        std::lock_guard<std::mutex> lock(mDataLock);
+        if (mLink)
+            for (int ep = 0; ep < MAX_EP_COUNT; ++ep)
+                mLink->Clear(ep);
+        return mStreaming->ResetStreamBuffers();
+    }
+    case MSG_OPEN_DATA:
+        return OpenDataLink(session, request, reply);
+    case MSG_STREAM_CONTROL:
+    {
+        const int ep = request.GetU8();
+        const bool tx = request.GetU8();
+        const bool enable = request.GetU8();
+        if (not request.valid or ep >= MAX_EP_COUNT)
+            return ReportError(EINVAL, "Invalid stream endpoint");
+        {
+            std::lock_guard<std::mutex> lock(mDataLock);
+            if (mLinkOwner != session)
+                return ReportError(EPERM, "Data link is not open");
+        }
+        return ControlDataFlow(ep, tx, enable);
+    }
+    default:
+        return ReportError(ENOTSUP, "Unknown request %i", request.type);
+    }
+}
+
+/** @brief Creates data link to client.
+    UDP socket is connected to port the client has bound, so only its
+    datagrams are accepted. For TCP, listening port is sent to client
+    before waiting for its connection.
+*/
+int LimeSuiteServer::OpenDataLink(Session* session, Message& request, Message& reply)
+{
+    const Transport transport = Transport(request.GetU8());
+    const uint16_t clientPort = request.GetU16();
+    if (not request.valid)
+        return ReportError(EPROTO, "Malformed request");
+    if (mStreaming == nullptr)
+        return ReportError(ENOTSUP, "Device does not support streaming");
+    {
+        std::lock_guard<std::mutex> lock(mDataLock);
+        if (mLinkOwner != nullptr and mLinkOwner != session)
+            return ReportError(EBUSY, "Device is streaming to another client");
+    }
+    CloseDataLink();
+
+    sockaddr_storage peer;
+    socklen_t peerLength = sizeof(peer);
+    if (getpeername(session->fd, (sockaddr*)&peer, &peerLength) != 0)
+        return ReportError(errno);
+    //data socket listens on the same local address as the control connection
+    sockaddr_storage local;
+    socklen_t localLength = sizeof(local);
+    if (getsockname(session->fd, (sockaddr*)&local, &localLength) != 0)
+        return ReportError(errno);
+    auto setPort = [](sockaddr_storage& addr, const uint16_t port) {
+        if (addr.ss_family == AF_INET6)
+            ((sockaddr_in6*)&addr)->sin6_port = htons(port);
+        else
+            ((sockaddr_in*)&addr)->sin_port = htons(port);
+    };
+    auto getPort = [](const sockaddr_storage& addr) -> uint16_t {
+        return ntohs(addr.ss_family == AF_INET6 ? ((const sockaddr_in6*)&addr)->sin6_port : ((const sockaddr_in*)&addr)->sin_port);
+    };
+
+    setPort(local, 0);
+    int fd = socket(local.ss_family, transport == TRANSPORT_TCP ? SOCK_STREAM : SOCK_DGRAM, 0);
+    if (fd < 0)
+        return ReportError(errno);
+    if (bind(fd, (sockaddr*)&local, localLength) != 0 or getsockname(fd, (sockaddr*)&local, &localLength) != 0)
+    {
+        const int err = errno;
+        close(fd);
+        return ReportError(err);
+    }
+    reply.PutU16(getPort(local));
+
+    if (transport == TRANSPORT_UDP)
+    {
+        setPort(peer, clientPort);
+        if (connect(fd, (sockaddr*)&peer, peerLength) != 0)
+        {
+            const int err = errno;
+            close(fd);
+            return ReportError(err);
+        }
+    }
+    else
+    {
+        if (listen(fd, 1) != 0 or SendMessage(session->fd, reply) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        pollfd pfd = {fd, POLLIN, 0};
+        const int dataFd = poll(&pfd, 1, dataAcceptTimeout_ms) == 1 ? accept(fd, nullptr, nullptr) : -1;
+        close(fd);
+        if (dataFd < 0)
+        {
+            lime::error("Remote client did not open data connection");
+            return 1;
+        }
+        fd = dataFd;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mDataLock);
+        mLink.reset(new DataLink(fd, transport));
+        mLinkOwner = session;
+    }
+    lime::info("Remote data link opened (%s)", transport == TRANSPORT_TCP ? "TCP" : "UDP");
+    return transport == TRANSPORT_TCP ? 1 : 0;
+}
+
+void LimeSuiteServer::CloseDataLink()
+{
+    for (int ep = 0; ep < MAX_EP_COUNT; ++ep)
+    {
+        ControlDataFlow(ep, false, false);
+        ControlDataFlow(ep, true, false);
+    }
+    std::lock_guard<std::mutex> lock(mDataLock);
+    mLink.reset();
+    mLinkOwner = nullptr;
+}
+
+int LimeSuiteServer::ControlDataFlow(const int ep, const bool tx, const bool enable)
+{
+    std::thread& pump = tx ? mTxPumps[ep] : mRxPumps[ep];
+    std::atomic<bool>& enabled = tx ? mTxEnabled[ep] : mRxEnabled[ep];
+    if (enable)
+    {
+        std::lock_guard<std::mutex> lock(mDataLock);
+        if (not mLink)
+            return ReportError(ENOTCONN, "Data link is not open");
+        if (pump.joinable())
+            return 0;
+        enabled.store(true);
+        if (tx)
+            pump = std::thread(&LimeSuiteServer::TxPump, this, ep);
+        else
+            pump = std::thread(&LimeSuiteServer::RxPump, this, ep);
+        return 0;
+    }
+    enabled.store(false);
+    if (pump.joinable())
+        pump.join();
+    return 0;
+}
+
+/** @brief Forwards packets received from device to client
+*/
+void LimeSuiteServer::RxPump(const int ep)
+{
+    ILimeSDRStreaming* device = mStreaming;
+    BufferedTransfer transfers([device, ep](char* buffer, int length, int timeout_ms){
+        return device->ReceiveData(buffer, length, ep, timeout_ms);
+    }, false, rxPumpPackets*PACKET_SIZE, rxPumpBuffers);
+
+    while (mRxEnabled[ep].load() and mLink->IsAlive())
+    {
+        int bytesReceived = 0;
+        const char* buffer = transfers.Acquire(&bytesReceived, 100);
+        if (buffer == nullptr)
+            continue;
+        const int packets = bytesReceived > 0 ? bytesReceived/PACKET_SIZE : 0;
+        if (packets > 0 and mLink->Send(buffer, packets*PACKET_SIZE, ep) > 0)
+            mRxPackets += packets;
+        transfers.Release();
+    }
+}
+
+/** @brief Passes packets received from client to device and returns credits,
+    which let the client send more
+*/
+void LimeSuiteServer::TxPump(const int ep)
+{
+    ILimeSDRStreaming* device = mStreaming;
+    BufferedTransfer transfers([device, ep](char* buffer, int length, int timeout_ms){
+        return device->SendData(buffer, length, ep, timeout_ms);
+    }, true, txPumpPackets*PACKET_SIZE, txPumpBuffers);
+
+    char* buffer = nullptr;
+    while (mTxEnabled[ep].load() and mLink->IsAlive())
+    {
+        if (buffer == nullptr)
+            buffer = transfers.Acquire(nullptr, 100);
+        if (buffer == nullptr)
+            continue; //device is not taking packets
+        const int bytesReceived = mLink->Receive(buffer, txPumpPackets*PACKET_SIZE, ep, 10);
+        mLink->SendCredit(ep);
+        if (bytesReceived <= 0)
+            continue;
+        transfers.Release(bytesReceived);
+        mTxPackets += bytesReceived/PACKET_SIZE;
+        buffer = nullptr;
+    }
+    transfers.WaitIdle(1000);
+}
@@ -0,0 +1,105 @@
+/**
+@file LimeSuiteServer.h
+@author Lime Microsystems
+@brief Shares opened device over network
+*/
+
+#ifndef LIMESUITE_SERVER_H
+#define LIMESUITE_SERVER_H
+
+#include <LimeSuiteConfig.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+
+namespace lime
+{
+
+class IConnection;
+class ILimeSDRStreaming;
+class LMS64CProtocol;
+namespace remote
+{
+class Message;
+class DataLink;
+}
+
+/** @brief Exposes control plane and sample streams of opened device to
+    ConnectionRemote clients.
+
+    Control requests are served over TCP from any number of clients, samples
+    are exchanged as raw FPGA packets with a single client at a time, over UDP
+    or TCP as requested by the client. Server does not configure the device,
+    FPGA and transceiver are set up by client through forwarded control packets.
+*/
+class LIME_API LimeSuiteServer
+{
+public:
+    struct Stats
+    {
+        uint32_t clients; //!< connected control sessions
+        bool streaming; //!< client has data link open
+        uint64_t rxPackets; //!< packets sent to client
+        uint64_t txPackets; //!< packets passed to device
+        uint64_t txLost; //!< packets lost on the way from client
+    };
+
+    /// @param port device to share, must stay opened while server is running
+    LimeSuiteServer(IConnection* port);
+    ~LimeSuiteServer();
+
+    /** @brief Starts listening for clients
+        @param port TCP port of control connections
+        @param host local address to listen on, empty for all interfaces.
+        Clients are not authenticated, anyone reaching the address controls the device.
+        @return 0 on success, -1 on failure
+    */
+    int Start(const uint16_t port, const std::string& host = "127.0.0.1");
+    void Stop();
+    bool IsRunning() const;
+    Stats GetStats() const;
+
+private:
+    struct Session
+    {
+        int fd;
+        std::thread thread;
+        std::atomic<bool> done;
+    };
+
+    void AcceptLoop();
+    void Serve(Session* session);
+    int Dispatch(Session* session, remote::Message& request, remote::Message& reply);
+    int OpenDataLink(Session* session, remote::Message& request, remote::Message& reply);
+    void CloseDataLink();
+    int ControlDataFlow(const int ep, const bool tx, const bool enable);
+    void RxPump(const int ep);
+    void TxPump(const int ep);
+
+    IConnection* mPort;
+    LMS64CProtocol* mProtocol;
+    ILimeSDRStreaming* mStreaming;
+    int mListenFd;
+    std::thread mAcceptThread;
+    std::atomic<bool> mTerminate;
+    std::vector<std::unique_ptr<Session>> mSessions;
+    mutable std::mutex mSessionsLock;
+
+    mutable std::mutex mDataLock; //!< guards data link ownership and pumps
+    std::unique_ptr<remote::DataLink> mLink;
+    Session* mLinkOwner;
+    std::thread mRxPumps[2];
+    std::thread mTxPumps[2];
+    std::atomic<bool> mRxEnabled[2];
+    std::atomic<bool> mTxEnabled[2];
+    std::atomic<uint64_t> mRxPackets;
+    std::atomic<uint64_t> mTxPackets;
+};
+
+}
+
+#endif
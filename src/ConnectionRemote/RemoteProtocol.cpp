@@ -0,0 +1,774 @@
+/**
+    @file RemoteProtocol.cpp
+    @author Lime Microsystems
+    @brief Messages and sample transport shared by remote server and client
+*/
+
+#include "RemoteProtocol.h"
+#include "Logger.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+
+using namespace lime;
+using namespace lime::remote;
+
+static const size_t maxMessageLength = 1 << 20;
+
+Message::Message(const uint16_t type, const int16_t status) :
+    type(type), status(status), readPos(0), valid(true)
+{
+}
+
+void Message::PutU8(const uint8_t value)
+{
+    payload.push_back(value);
+}
+
+void Message::PutU16(const uint16_t value)
+{
+    for (int i = 0; i < 2; ++i)
+        payload.push_back(value >> (8*i));
+}
+
+void Message::PutU32(const uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+        payload.push_back(value >> (8*i));
+}
+
+void Message::PutU64(const uint64_t value)
+{
+    for (int i = 0; i < 8; ++i)
+        payload.push_back(value >> (8*i));
+}
+
+void Message::PutDouble(const double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    PutU64(bits);
+}
+
+void Message::PutBytes(const void* data, const uint32_t length)
+{
+    PutU32(length);
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    payload.insert(payload.end(), bytes, bytes+length);
+}
+
+void Message::PutString(const std::string& value)
+{
+    PutBytes(value.data(), value.size());
+}
+
+const uint8_t* Message::Take(const size_t length)
+{
+    if (not valid or payload.size() - readPos < length)
+    {
+        valid = false;
+        return nullptr;
+    }
+    const uint8_t* data = payload.data() + readPos;
+    readPos += length;
+    return data;
+}
+
+uint8_t Message::GetU8()
+{
+    const uint8_t* data = Take(1);
+    return data ? data[0] : 0;
+}
+
+uint16_t Message::GetU16()
+{
+    const uint8_t* data = Take(2);
+    return data ? data[0] | (data[1] << 8) : 0;
+}
+
+uint32_t Message::GetU32()
+{
+    const uint8_t* data = Take(4);
+    uint32_t value = 0;
+    for (int i = 0; data and i < 4; ++i)
+        value |= uint32_t(data[i]) << (8*i);
+    return value;
+}
+
+uint64_t Message::GetU64()
+{
+    const uint8_t* data = Take(8);
+    uint64_t value = 0;
+    for (int i = 0; data and i < 8; ++i)
+        value |= uint64_t(data[i]) << (8*i);
+    return value;
+}
+
+double Message::GetDouble()
+{
+    const uint64_t bits = GetU64();
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+std::vector<uint8_t> Message::GetBytes()
+{
+    const uint32_t length = GetU32();
+    const uint8_t* data = Take(length);
+    if (data == nullptr)
+        return std::vector<uint8_t>();
+    return std::vector<uint8_t>(data, data+length);
+}
+
+std::string Message::GetString()
+{
+    const std::vector<uint8_t> bytes = GetBytes();
+    return std::string(bytes.begin(), bytes.end());
+}
+
+/***********************************************************************
+ * Socket helpers
+ **********************************************************************/
+static int WriteAll(const int fd, const uint8_t* data, size_t length)
+{
+    while (length > 0)
+    {
+        const ssize_t ret = send(fd, data, length, MSG_NOSIGNAL);
+        if (ret < 0 and errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return -1;
+        data += ret;
+        length -= ret;
+    }
+    return 0;
+}
+
+static int ReadAll(const int fd, uint8_t* data, size_t length, const std::chrono::steady_clock::time_point& deadline)
+{
+    while (length > 0)
+    {
+        const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0)
+            return -1;
+        pollfd pfd = {fd, POLLIN, 0};
+        const int ready = poll(&pfd, 1, remaining);
+        if (ready < 0 and errno == EINTR)
+            continue;
+        if (ready <= 0)
+            return -1;
+        const ssize_t ret = recv(fd, data, length, 0);
+        if (ret < 0 and errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return -1;
+        data += ret;
+        length -= ret;
+    }
+    return 0;
+}
+
+int lime::remote::SendMessage(const int fd, const Message& msg)
+{
+    std::vector<uint8_t> frame(12);
+    const uint32_t length = msg.payload.size();
+    for (int i = 0; i < 4; ++i)
+    {
+        frame[i] = PROTOCOL_MAGIC >> (8*i);
+        frame[8+i] = length >> (8*i);
+    }
+    frame[4] = msg.type;
+    frame[5] = msg.type >> 8;
+    frame[6] = uint16_t(msg.status);
+    frame[7] = uint16_t(msg.status) >> 8;
+    frame.insert(frame.end(), msg.payload.begin(), msg.payload.end());
+    return WriteAll(fd, frame.data(), frame.size());
+}
+
+int lime::remote::ReceiveMessage(const int fd, Message& msg, const int timeout_ms)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    uint8_t header[12];
+    if (ReadAll(fd, header, sizeof(header), deadline) != 0)
+        return -1;
+    uint32_t magic = 0;
+    uint32_t length = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        magic |= uint32_t(header[i]) << (8*i);
+        length |= uint32_t(header[8+i]) << (8*i);
+    }
+    if (magic != PROTOCOL_MAGIC or length > maxMessageLength)
+        return -1;
+    msg.type = header[4] | (header[5] << 8);
+    msg.status = int16_t(header[6] | (header[7] << 8));
+    msg.payload.resize(length);
+    msg.readPos = 0;
+    msg.valid = true;
+    return ReadAll(fd, msg.payload.data(), length, deadline);
+}
+
+int lime::remote::ParseAddress(const std::string& addr, std::string& host, uint16_t& port, Transport& transport)
+{
+    std::string rest = addr;
+    transport = TRANSPORT_UDP;
+    const size_t scheme = addr.find("://");
+    if (scheme != std::string::npos)
+    {
+        const std::string name = addr.substr(0, scheme);
+        if (name == "tcp")
+            transport = TRANSPORT_TCP;
+        else if (name != "udp")
+            return -1;
+        rest = addr.substr(scheme+3);
+    }
+    port = DEFAULT_PORT;
+    if (not rest.empty() and rest[0] == '[') //[ipv6]:port
+    {
+        const size_t end = rest.find(']');
+        if (end == std::string::npos)
+            return -1;
+        host = rest.substr(1, end-1);
+        rest = rest.substr(end+1);
+    }
+    else
+    {
+        const size_t colon = rest.find(':');
+        host = rest.substr(0, colon);
+        rest = colon == std::string::npos ? "" : rest.substr(colon);
+    }
+    if (not rest.empty())
+    {
+        if (rest[0] != ':')
+            return -1;
+        char* end = nullptr;
+        const unsigned long value = strtoul(rest.c_str()+1, &end, 10);
+        if (*end != 0 or value == 0 or value > 0xFFFF)
+            return -1;
+        port = value;
+    }
+    return host.empty() ? -1 : 0;
+}
+
+std::string lime::remote::FormatAddress(const std::string& host, const uint16_t port, const Transport transport)
+{
+    const bool ipv6 = host.find(':') != std::string::npos;
+    return std::string(transport == TRANSPORT_TCP ? "tcp://" : "udp://")
+        + (ipv6 ? "[" + host + "]" : host) + ":" + std::to_string(port);
+}
+
+int lime::remote::ConnectTCP(const std::string& host, const uint16_t port, const int timeout_ms)
+{
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0)
+        return -1;
+
+    int fd = -1;
+    for (addrinfo* ai = result; ai != nullptr and fd < 0; ai = ai->ai_next)
+    {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0)
+            continue;
+        //non-blocking connect, so unreachable hosts do not stall enumeration
+        const int flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        int ret = connect(fd, ai->ai_addr, ai->ai_addrlen);
+        if (ret != 0 and errno == EINPROGRESS)
+        {
+            pollfd pfd = {fd, POLLOUT, 0};
+            int err = ETIMEDOUT;
+            socklen_t len = sizeof(err);
+            if (poll(&pfd, 1, timeout_ms) == 1)
+                getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len);
+            ret = err == 0 ? 0 : -1;
+        }
+        fcntl(fd, F_SETFL, flags);
+        if (ret != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(result);
+    if (fd >= 0)
+    {
+        const int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+/***********************************************************************
+ * DataLink
+ **********************************************************************/
+DataLink::DataLink(const int fd, const Transport transport, const size_t queuePackets) :
+    mFd(fd), mTransport(transport), mQueuePackets(queuePackets), mTerminate(false), mAlive(true)
+{
+    for (auto& flow : mFlows)
+    {
+        flow.queue.resize(queuePackets*PACKET_SIZE);
+        flow.head = 0;
+        flow.count = 0;
+        flow.expected = 0;
+        flow.synced = false;
+        flow.reorder.resize(REORDER_WINDOW*PACKET_SIZE);
+        memset(flow.held, 0, sizeof(flow.held));
+        flow.lost = 0;
+        flow.overflow = 0;
+        flow.sendSeq = 0;
+        flow.credit = 0;
+    }
+    //large socket buffers absorb scheduling hiccups at high sample rates
+    const int bufferSize = 8 << 20;
+    setsockopt(mFd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+    setsockopt(mFd, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+    if (mTransport == TRANSPORT_TCP)
+    {
+        const int one = 1;
+        setsockopt(mFd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    mReceiveThread = std::thread(&DataLink::ReceiveLoop, this);
+}
+
+DataLink::~DataLink()
+{
+    mTerminate.store(true);
+    shutdown(mFd, SHUT_RDWR);
+    if (mReceiveThread.joinable())
+        mReceiveThread.join();
+    close(mFd);
+}
+
+bool DataLink::IsAlive() const
+{
+    return mAlive.load();
+}
+
+int DataLink::WriteFrames(const uint8_t* headers, const char* const* payloads, const int* lengths, const int count)
+{
+    std::lock_guard<std::mutex> lock(mSendLock);
+    iovec iov[2*REORDER_WINDOW];
+    for (int i = 0; i < count; ++i)
+    {
+        iov[2*i].iov_base = const_cast<uint8_t*>(headers + i*HEADER_SIZE);
+        iov[2*i].iov_len = HEADER_SIZE;
+        iov[2*i+1].iov_base = const_cast<char*>(payloads[i]);
+        iov[2*i+1].iov_len = lengths[i];
+    }
+    if (mTransport == TRANSPORT_TCP)
+    {
+        //byte stream, gather all frames and handle partial writes
+        int iovIndex = 0;
+        const int iovCount = 2*count;
+        while (iovIndex < iovCount)
+        {
+            msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &iov[iovIndex];
+            msg.msg_iovlen = iovCount - iovIndex;
+            ssize_t ret = sendmsg(mFd, &msg, MSG_NOSIGNAL);
+            if (ret < 0 and errno == EINTR)
+                continue;
+            if (ret <= 0)
+                return -1;
+            while (iovIndex < iovCount and size_t(ret) >= iov[iovIndex].iov_len)
+                ret -= iov[iovIndex++].iov_len;
+            if (iovIndex < iovCount)
+            {
+                iov[iovIndex].iov_base = static_cast<char*>(iov[iovIndex].iov_base) + ret;
+                iov[iovIndex].iov_len -= ret;
+            }
+        }
+        return count;
+    }
+#ifdef __linux__
+    mmsghdr msgs[REORDER_WINDOW];
+    memset(msgs, 0, sizeof(mmsghdr)*count);
+    for (int i = 0; i < count; ++i)
+    {
+        msgs[i].msg_hdr.msg_iov = &iov[2*i];
+        msgs[i].msg_hdr.msg_iovlen = 2;
+    }
+    int sent = 0;
+    while (sent < count)
+    {
+        const int ret = sendmmsg(mFd, &msgs[sent], count-sent, MSG_NOSIGNAL);
+        if (ret < 0 and errno == EINTR)
+            continue;
+        if (ret < 0)
+            return -1;
+        sent += ret;
+    }
+#else
+    for (int i = 0; i < count; ++i)
+    {
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov[2*i];
+        msg.msg_iovlen = 2;
+        if (sendmsg(mFd, &msg, MSG_NOSIGNAL) < 0 and errno != EINTR)
+            return -1;
+    }
+#endif
+    return count;
+}
+
+int DataLink::Send(const char* buffer, const int length, const int ep)
+{
+    if (ep < 0 or ep >= MAX_EP_COUNT)
+        return -1;
+    Flow& flow = mFlows[ep];
+    const int packetsCount = length/PACKET_SIZE;
+    uint8_t headers[REORDER_WINDOW*HEADER_SIZE];
+    const char* payloads[REORDER_WINDOW];
+    int lengths[REORDER_WINDOW];
+    int packetsSent = 0;
+    while (packetsSent < packetsCount)
+    {
+        const int batch = std::min<int>(REORDER_WINDOW, packetsCount-packetsSent);
+        uint32_t seq;
+        {
+            std::lock_guard<std::mutex> lock(flow.lock);
+            seq = flow.sendSeq;
+            flow.sendSeq += batch;
+        }
+        for (int i = 0; i < batch; ++i)
+        {
+            uint8_t* header = &headers[i*HEADER_SIZE];
+            for (int b = 0; b < 4; ++b)
+                header[b] = (seq+i) >> (8*b);
+            header[4] = ep;
+            header[5] = FRAME_DATA;
+            header[6] = PACKET_SIZE & 0xFF;
+            header[7] = PACKET_SIZE >> 8;
+            payloads[i] = buffer + (packetsSent+i)*PACKET_SIZE;
+            lengths[i] = PACKET_SIZE;
+        }
+        if (WriteFrames(headers, payloads, lengths, batch) < 0)
+        {
+            mAlive.store(false);
+            return packetsSent > 0 ? packetsSent*PACKET_SIZE : -1;
+        }
+        packetsSent += batch;
+    }
+    return packetsSent*PACKET_SIZE;
+}
+
+int DataLink::SendCredit(const int ep)
+{
+    if (ep < 0 or ep >= MAX_EP_COUNT)
+        return -1;
+    Flow& flow = mFlows[ep];
+    uint32_t taken;
+    {
+        std::lock_guard<std::mutex> lock(flow.lock);
+        taken = flow.expected - flow.count;
+    }
+    uint8_t header[HEADER_SIZE] = {0, 0, 0, 0, uint8_t(ep), FRAME_CREDIT, 4, 0};
+    char value[4];
+    for (int b = 0; b < 4; ++b)
+        value[b] = taken >> (8*b);
+    const char* payload = value;
+    const int length = sizeof(value);
+    return WriteFrames(header, &payload, &length, 1) < 0 ? -1 : 0;
+}
+
+bool DataLink::WaitCredit(const int ep, const uint32_t packets, const uint32_t window, const int timeout_ms)
+{
+    if (ep < 0 or ep >= MAX_EP_COUNT)
+        return false;
+    Flow& flow = mFlows[ep];
+    std::unique_lock<std::mutex> lock(flow.lock);
+    return flow.credited.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&]{
+        return uint32_t(flow.sendSeq + packets - flow.credit) <= window or not mAlive.load();
+    }) and mAlive.load();
+}
+
+int DataLink::Receive(char* buffer, const int length, const int ep, const int timeout_ms)
+{
+    if (ep < 0 or ep >= MAX_EP_COUNT)
+        return -1;
+    Flow& flow = mFlows[ep];
+    const size_t packetsCount = length/PACKET_SIZE;
+    size_t packetsReceived = 0;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    std::unique_lock<std::mutex> lock(flow.lock);
+    while (packetsReceived < packetsCount)
+    {
+        if (flow.count == 0)
+        {
+            if (not mAlive.load() or flow.queued.wait_until(lock, deadline) == std::cv_status::timeout)
+                break;
+            continue;
+        }
+        const size_t batch = std::min(std::min(flow.count, packetsCount-packetsReceived), mQueuePackets-flow.head);
+        memcpy(buffer + packetsReceived*PACKET_SIZE, &flow.queue[flow.head*PACKET_SIZE], batch*PACKET_SIZE);
+        flow.head = (flow.head + batch) % mQueuePackets;
+        flow.count -= batch;
+        packetsReceived += batch;
+    }
+    return packetsReceived*PACKET_SIZE;
+}
+
+void DataLink::Clear(const int ep)
+{
+    if (ep < 0 or ep >= MAX_EP_COUNT)
+        return;
+    Flow& flow = mFlows[ep];
+    std::lock_guard<std::mutex> lock(flow.lock);
+    //held packets are discarded, not lost, expected moves past them so credits cover them
+    uint32_t last = flow.expected;
+    for (uint32_t i = 0; i < REORDER_WINDOW; ++i)
+        if (flow.held[(flow.expected + i) % REORDER_WINDOW])
+            last = flow.expected + i + 1;
+    flow.expected = last;
+    memset(flow.held, 0, sizeof(flow.held));
+    flow.synced = false;
+    flow.head = 0;
+    flow.count = 0;
+}
+
+uint64_t DataLink::GetLostCount(const int ep) const
+{
+    std::lock_guard<std::mutex> lock(mFlows[ep].lock);
+    return mFlows[ep].lost;
+}
+
+uint64_t DataLink::GetOverflowCount(const int ep) const
+{
+    std::lock_guard<std::mutex> lock(mFlows[ep].lock);
+    return mFlows[ep].overflow;
+}
+
+/** @brief Appends packet to queue, overwriting the oldest one if full
+*/
+void DataLink::Push(Flow& flow, const char* data)
+{
+    if (flow.count == mQueuePackets)
+    {
+        flow.head = (flow.head + 1) % mQueuePackets;
+        --flow.count;
+        ++flow.overflow;
+    }
+    const size_t tail = (flow.head + flow.count) % mQueuePackets;
+    memcpy(&flow.queue[tail*PACKET_SIZE], data, PACKET_SIZE);
+    ++flow.count;
+}
+
+/** @brief Queues held out of order packets, missing ones are counted as lost
+*/
+void DataLink::FlushHeld(Flow& flow)
+{
+    uint32_t last = flow.expected;
+    for (uint32_t i = 0; i < REORDER_WINDOW; ++i)
+        if (flow.held[(flow.expected + i) % REORDER_WINDOW])
+            last = flow.expected + i + 1;
+    while (flow.expected != last)
+    {
+        const uint32_t slot = flow.expected % REORDER_WINDOW;
+        if (flow.held[slot])
+        {
+            Push(flow, &flow.reorder[slot*PACKET_SIZE]);
+            flow.held[slot] = false;
+        }
+        else
+            ++flow.lost;
+        ++flow.expected;
+    }
+}
+
+void DataLink::Deliver(Flow& flow, const uint32_t seq, const char* data)
+{
+    if (not flow.synced)
+    {
+        flow.expected = seq;
+        flow.synced = true;
+    }
+    if (int32_t(seq - flow.expected) < 0)
+        return; //duplicate, or arrived after being counted as lost
+
+    //window overrun, give up on the oldest missing packets
+    while (seq - flow.expected >= REORDER_WINDOW)
+    {
+        const uint32_t slot = flow.expected % REORDER_WINDOW;
+        if (flow.held[slot])
+        {
+            Push(flow, &flow.reorder[slot*PACKET_SIZE]);
+            flow.held[slot] = false;
+        }
+        else
+            ++flow.lost;
+        ++flow.expected;
+    }
+
+    if (seq != flow.expected)
+    {
+        const uint32_t slot = seq % REORDER_WINDOW;
+        memcpy(&flow.reorder[slot*PACKET_SIZE], data, PACKET_SIZE);
+        flow.held[slot] = true;
+        return;
+    }
+    Push(flow, data);
+    ++flow.expected;
+    while (flow.held[flow.expected % REORDER_WINDOW])
+    {
+        const uint32_t slot = flow.expected % REORDER_WINDOW;
+        Push(flow, &flow.reorder[slot*PACKET_SIZE]);
+        flow.held[slot] = false;
+        ++flow.expected;
+    }
+}
+
+void DataLink::HandleFrame(const uint8_t* frame, const int length)
+{
+    if (length < HEADER_SIZE)
+        return;
+    const uint32_t seq = frame[0] | (frame[1] << 8) | (frame[2] << 16) | (uint32_t(frame[3]) << 24);
+    const uint8_t ep = frame[4];
+    const uint8_t type = frame[5];
+    const int payloadLength = frame[6] | (frame[7] << 8);
+    if (ep >= MAX_EP_COUNT or payloadLength != length - HEADER_SIZE)
+        return;
+    Flow& flow = mFlows[ep];
+    const uint8_t* payload = frame + HEADER_SIZE;
+    if (type == FRAME_CREDIT and payloadLength == 4)
+    {
+        const uint32_t taken = payload[0] | (payload[1] << 8) | (payload[2] << 16) | (uint32_t(payload[3]) << 24);
+        {
+            std::lock_guard<std::mutex> lock(flow.lock);
+            //credits may arrive reordered, keep the newest
+            if (int32_t(taken - flow.credit) > 0)
+                flow.credit = taken;
+        }
+        flow.credited.notify_all();
+    }
+    else if (type == FRAME_DATA and payloadLength == PACKET_SIZE)
+    {
+        {
+            std::lock_guard<std::mutex> lock(flow.lock);
+            Deliver(flow, seq, reinterpret_cast<const char*>(payload));
+        }
+        flow.queued.notify_all();
+    }
+}
+
+void DataLink::ReceiveLoop()
+{
+    const int frameSize = HEADER_SIZE + PACKET_SIZE;
+    std::vector<uint8_t> buffer(REORDER_WINDOW*frameSize);
+#ifdef __linux__
+    mmsghdr msgs[REORDER_WINDOW];
+    iovec iov[REORDER_WINDOW];
+#endif
+    size_t pending = 0; //TCP stream bytes not parsed yet
+    bool idle = false;
+    while (not mTerminate.load())
+    {
+        pollfd pfd = {mFd, POLLIN, 0};
+        const int ready = poll(&pfd, 1, 50);
+        if (ready < 0 and errno == EINTR)
+            continue;
+        if (ready == 0)
+        {
+            //no traffic, deliver packets held behind missing ones
+            if (not idle)
+            {
+                for (auto& flow : mFlows)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(flow.lock);
+                        FlushHeld(flow);
+                    }
+                    flow.queued.notify_all();
+                }
+                idle = true;
+            }
+            continue;
+        }
+        idle = false;
+        if (ready < 0 or (pfd.revents & (POLLERR | POLLNVAL)))
+            break;
+
+        if (mTransport == TRANSPORT_TCP)
+        {
+            const ssize_t ret = recv(mFd, buffer.data() + pending, buffer.size() - pending, 0);
+            if (ret < 0 and errno == EINTR)
+                continue;
+            if (ret <= 0)
+                break;
+            pending += ret;
+            size_t offset = 0;
+            while (pending - offset >= size_t(HEADER_SIZE))
+            {
+                const uint8_t* frame = buffer.data() + offset;
+                const size_t length = HEADER_SIZE + (frame[6] | (frame[7] << 8));
+                if (length > size_t(frameSize))
+                {
+                    lime::error("Remote data stream corrupted");
+                    mAlive.store(false);
+                    break;
+                }
+                if (pending - offset < length)
+                    break;
+                HandleFrame(frame, length);
+                offset += length;
+            }
+            if (not mAlive.load())
+                break;
+            memmove(buffer.data(), buffer.data() + offset, pending - offset);
+            pending -= offset;
+            continue;
+        }
+#ifdef __linux__
+        for (uint32_t i = 0; i < REORDER_WINDOW; ++i)
+        {
+            iov[i].iov_base = buffer.data() + i*frameSize;
+            iov[i].iov_len = frameSize;
+            memset(&msgs[i], 0, sizeof(mmsghdr));
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        const int count = recvmmsg(mFd, msgs, REORDER_WINDOW, MSG_DONTWAIT, nullptr);
+        if (count < 0)
+        {
+            if (errno == EINTR or errno == EAGAIN or errno == EWOULDBLOCK or errno == ECONNREFUSED)
+                continue; //peer socket not ready yet
+            break;
+        }
+        for (int i = 0; i < count; ++i)
+            HandleFrame(buffer.data() + i*frameSize, msgs[i].msg_len);
+#else
+        const ssize_t ret = recv(mFd, buffer.data(), frameSize, 0);
+        if (ret < 0)
+        {
+            if (errno == EINTR or errno == ECONNREFUSED)
+                continue;
+            break;
+        }
+        HandleFrame(buffer.data(), ret);
+#endif
+    }
+    if (not mTerminate.load())
+        lime::info("Remote data link closed");
+    mAlive.store(false);
+    for (auto& flow : mFlows)
+    {
+        flow.queued.notify_all();
+        flow.credited.notify_all();
+    }
+}
@@ -0,0 +1,182 @@
+/**
+    @file RemoteProtocol.h
+    @author Lime Microsystems
+    @brief Messages and sample transport shared by remote server and client
+*/
+
+#ifndef LIMESUITE_REMOTE_PROTOCOL_H
+#define LIMESUITE_REMOTE_PROTOCOL_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+namespace lime
+{
+namespace remote
+{
+
+static const uint32_t PROTOCOL_MAGIC = 0x52534D4C; //"LMSR"
+static const uint16_t PROTOCOL_VERSION = 1;
+static const uint16_t DEFAULT_PORT = 55132;
+static const int PACKET_SIZE = 4096; //FPGA_DataPacket
+static const int MAX_EP_COUNT = 2;
+
+enum MessageType
+{
+    MSG_HELLO = 1,          //version -> version, connection type, device name, serial
+    MSG_TRANSFER_PACKET,    //LMS64C packet -> status, input buffer
+    MSG_UPDATE_RATE,        //channel, tx rate, rx rate, [tx phase, rx phase]
+    MSG_RESET_BUFFERS,
+    MSG_OPEN_DATA,          //transport, client UDP port -> server data port
+    MSG_STREAM_CONTROL,     //endpoint, direction, enable
+};
+
+enum Transport
+{
+    TRANSPORT_UDP = 0,
+    TRANSPORT_TCP = 1,
+};
+
+/** @brief Control message, values are serialized little endian.
+    Get functions mark message invalid instead of reading past the payload.
+*/
+class Message
+{
+public:
+    Message(const uint16_t type = 0, const int16_t status = 0);
+
+    void PutU8(const uint8_t value);
+    void PutU16(const uint16_t value);
+    void PutU32(const uint32_t value);
+    void PutU64(const uint64_t value);
+    void PutDouble(const double value);
+    void PutBytes(const void* data, const uint32_t length);
+    void PutString(const std::string& value);
+
+    uint8_t GetU8();
+    uint16_t GetU16();
+    uint32_t GetU32();
+    uint64_t GetU64();
+    double GetDouble();
+    std::vector<uint8_t> GetBytes();
+    std::string GetString();
+
+    uint16_t type;
+    int16_t status; //!< request handler return value, message text on failure
+    std::vector<uint8_t> payload;
+    size_t readPos;
+    bool valid;
+private:
+    const uint8_t* Take(const size_t length);
+};
+
+/// @return 0 on success, -1 if socket failed
+int SendMessage(const int fd, const Message& msg);
+/// @return 0 on success, -1 if socket failed or timed out
+int ReceiveMessage(const int fd, Message& msg, const int timeout_ms);
+
+/** @brief Parses remote address "[udp://|tcp://]host[:port]"
+    @return 0 on success, -1 if address is not remote
+*/
+int ParseAddress(const std::string& addr, std::string& host, uint16_t& port, Transport& transport);
+std::string FormatAddress(const std::string& host, const uint16_t port, const Transport transport);
+
+/// @return connected TCP socket, -1 on failure
+int ConnectTCP(const std::string& host, const uint16_t port, const int timeout_ms);
+
+/** @brief Moves FPGA packets of up to MAX_EP_COUNT endpoints over UDP or TCP socket.
+
+    Each packet is prefixed with endpoint and sequence number. Receiving thread
+    restores packet order within small window, counts missing packets as lost,
+    and keeps packets in fixed size per endpoint queues, dropping the oldest
+    ones when reader falls behind. Packet timestamps are left intact, so
+    stream loops detect the gaps the same way as with local devices.
+
+    Receiver periodically returns credits (packets taken out of link),
+    which lets sender limit number of packets in flight.
+    On Linux datagrams are sent and received in batches with sendmmsg/recvmmsg.
+*/
+class DataLink
+{
+public:
+    /** @param fd connected UDP or TCP socket, closed by DataLink
+        @param transport socket type
+        @param queuePackets receive queue length of each endpoint
+    */
+    DataLink(const int fd, const Transport transport, const size_t queuePackets = 1024);
+    ~DataLink();
+
+    /** @brief Sends whole packets from buffer
+        @return number of bytes sent, -1 on socket failure
+    */
+    int Send(const char* buffer, const int length, const int ep);
+
+    /** @brief Waits until buffer is filled with received packets or timeout
+        @return number of bytes received
+    */
+    int Receive(char* buffer, const int length, const int ep, const int timeout_ms);
+
+    /** @brief Waits until peer has taken enough packets to keep in-flight count within window
+        @return true if packets can be sent
+    */
+    bool WaitCredit(const int ep, const uint32_t packets, const uint32_t window, const int timeout_ms);
+
+    /// @brief Reports peer how many packets have been taken from endpoint
+    int SendCredit(const int ep);
+
+    /// @brief Discards queued and held packets, next received packet restarts sequence tracking
+    void Clear(const int ep);
+
+    uint64_t GetLostCount(const int ep) const;
+    uint64_t GetOverflowCount(const int ep) const;
+    bool IsAlive() const;
+
+private:
+    static const uint32_t REORDER_WINDOW = 32;
+    static const int HEADER_SIZE = 8;
+    enum FrameType {FRAME_DATA = 0, FRAME_CREDIT = 1};
+
+    struct Flow
+    {
+        std::vector<char> queue;
+        size_t head;
+        size_t count;
+        uint32_t expected; //!< next sequence number to be queued
+        bool synced;
+        std::vector<char> reorder;
+        bool held[REORDER_WINDOW];
+        uint64_t lost;
+        uint64_t overflow;
+        uint32_t sendSeq; //!< outgoing packets
+        uint32_t credit; //!< outgoing packets taken out by peer
+        mutable std::mutex lock;
+        std::condition_variable queued;
+        std::condition_variable credited;
+    };
+
+    void ReceiveLoop();
+    void HandleFrame(const uint8_t* frame, const int length);
+    void Deliver(Flow& flow, const uint32_t seq, const char* data);
+    void Push(Flow& flow, const char* data);
+    void FlushHeld(Flow& flow);
+    int WriteFrames(const uint8_t* headers, const char* const* payloads, const int* lengths, const int count);
+
+    int mFd;
+    Transport mTransport;
+    size_t mQueuePackets;
+    Flow mFlows[MAX_EP_COUNT];
+    std::mutex mSendLock;
+    std::thread mReceiveThread;
+    std::atomic<bool> mTerminate;
+    std::atomic<bool> mAlive;
+};
+
+}
+}
+
+#endif
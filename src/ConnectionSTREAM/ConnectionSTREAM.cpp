@@ -400,8 +400,8 @@ int ConnectionSTREAM::Write(const unsigned char *buffer, const int length, int t
     if(IsOpen() == false)
         return 0;
 
-    unsigned char* wbuffer = new unsigned char[length];
-    memcpy(wbuffer, buffer, length);
+    //transfer functions only read from output buffer
+    unsigned char* wbuffer = const_cast<unsigned char*>(buffer);
     bulkCtrlInProgress = false;
     #ifndef __unix__
     if(bulkCtrlAvailable
@@ -426,7 +426,6 @@ int ConnectionSTREAM::Write(const unsigned char *buffer, const int length, int t
     else
         len = libusb_control_transfer(dev_handle, LIBUSB_REQUEST_TYPE_VENDOR,CTR_W_REQCODE ,CTR_W_VALUE, CTR_W_INDEX, wbuffer, length, timeout_ms);
     #endif
-    delete[] wbuffer;
     return len;
 }
 
@@ -784,6 +783,27 @@ int ConnectionSTREAM::SendData(const char* buffer, int length, int epIndex, int
     return FinishDataSending((char*)buffer, length , context);
 }
 
+int ConnectionSTREAM::SendDataAsync(const char* buffer, int length, int epIndex)
+{
+    return BeginDataSending(buffer, length, 0x01);
+}
+
+int ConnectionSTREAM::WaitDataSent(const char* buffer, int length, int handle, int timeout_ms)
+{
+    if (WaitForSending(handle, timeout_ms)==false)
+    {
+        //cancel only this transfer, streaming may use the same endpoint
+#ifndef __unix__
+        CancelIoEx(contextsToSend[handle].EndPt->hDevice, contextsToSend[handle].inOvLap);
+#else
+        libusb_cancel_transfer(contextsToSend[handle].transfer);
+#endif
+        //buffer can be released only after cancellation completes
+        WaitForSending(handle, 1000);
+    }
+    return FinishDataSending(buffer, length, handle);
+}
+
 int ConnectionSTREAM::ReceiveData(char* buffer, int length, int epIndex, int timeout)
 {
     const unsigned char ep = 0x81;
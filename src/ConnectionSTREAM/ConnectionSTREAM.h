@@ -10,6 +10,7 @@
 #include <ILimeSDRStreaming.h>
 #include <vector>
 #include <set>
+#include <map>
 #include <string>
 #include <atomic>
 #include <memory>
@@ -116,6 +117,8 @@ protected:
     virtual void TransmitPacketsLoop(Streamer* args) override;
     int SendData(const char* buffer, int length, int epIndex = 0, int timeout = 100)override;
     int ReceiveData(char* buffer, int length, int epIndex = 0, int timeout = 100)override;
+    int SendDataAsync(const char* buffer, int length, int epIndex) override;
+    int WaitDataSent(const char* buffer, int length, int handle, int timeout_ms) override;
 
     virtual int BeginDataReading(char* buffer, uint32_t length, const uint8_t streamBulkInAddr = 0x81);
     virtual int WaitForReading(int contextHandle, unsigned int timeout_ms);
@@ -184,6 +187,12 @@ protected:
     std::thread mUSBProcessingThread;
     void handle_libusb_events();
     std::atomic<bool> mProcessUSBEvents;
+    //! handles of already seen devices, so enumeration does not reopen them
+    std::map<uint64_t, ConnectionHandle> mHandleCache;
+    std::mutex mHandleCacheLock;
+    libusb_hotplug_callback_handle mHotplugHandle;
+    bool mHotplugRegistered;
+    static int LIBUSB_CALL hotplug_callback(libusb_context *ctx, libusb_device *dev, libusb_hotplug_event event, void *user_data);
 #endif
 };
 
@@ -21,6 +21,17 @@ void ConnectionSTREAMEntry::handle_libusb_events()
         if(r != 0) lime::error("error libusb_handle_events %s", libusb_strerror(libusb_error(r)));
     }
 }
+
+/** @brief Drops cached device handles when devices are attached or removed,
+    so bus addresses reused by a different device are not served from cache
+*/
+int LIBUSB_CALL ConnectionSTREAMEntry::hotplug_callback(libusb_context *ctx, libusb_device *dev, libusb_hotplug_event event, void *user_data)
+{
+    ConnectionSTREAMEntry* entry = static_cast<ConnectionSTREAMEntry*>(user_data);
+    std::lock_guard<std::mutex> lock(entry->mHandleCacheLock);
+    entry->mHandleCache.clear();
+    return 0;
+}
 #endif // __UNIX__
 
 //! make a static-initialized entry in the registry
@@ -39,6 +50,15 @@ ConnectionSTREAMEntry::ConnectionSTREAMEntry(void):
     if(r < 0)
         lime::error("Init Error %i", r); //there was an error
     libusb_set_debug(ctx, 3); //set verbosity level to 3, as suggested in the documentation
+    mHotplugRegistered = false;
+    if(libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG))
+    {
+        r = libusb_hotplug_register_callback(ctx,
+            libusb_hotplug_event(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT),
+            libusb_hotplug_flag(0), LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+            &ConnectionSTREAMEntry::hotplug_callback, this, &mHotplugHandle);
+        mHotplugRegistered = (r == LIBUSB_SUCCESS);
+    }
     mProcessUSBEvents.store(true);
     mUSBProcessingThread = std::thread(&ConnectionSTREAMEntry::handle_libusb_events, this);
 #endif
@@ -52,6 +72,15 @@ ConnectionSTREAMEntry::ConnectionSTREAMEntry(const std::string entryName):
     if(r < 0)
         lime::error("Init Error %i", r); //there was an error
     libusb_set_debug(ctx, 3); //set verbosity level to 3, as suggested in the documentation
+    mHotplugRegistered = false;
+    if(libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG))
+    {
+        r = libusb_hotplug_register_callback(ctx,
+            libusb_hotplug_event(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT),
+            libusb_hotplug_flag(0), LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY,
+            &ConnectionSTREAMEntry::hotplug_callback, this, &mHotplugHandle);
+        mHotplugRegistered = (r == LIBUSB_SUCCESS);
+    }
     mProcessUSBEvents.store(true);
     mUSBProcessingThread = std::thread(&ConnectionSTREAMEntry::handle_libusb_events, this);
 #endif
@@ -59,7 +88,10 @@ ConnectionSTREAMEntry::ConnectionSTREAMEntry(const std::string entryName):
 
 ConnectionSTREAMEntry::~ConnectionSTREAMEntry(void)
 {
+    unregisterEntry(); //enumerate() uses the libusb context
 #ifdef __unix__
+    if(mHotplugRegistered)
+        libusb_hotplug_deregister_callback(ctx, mHotplugHandle);
     mProcessUSBEvents.store(false);
     mUSBProcessingThread.join();
     libusb_exit(ctx);
@@ -124,6 +156,7 @@ std::vector<ConnectionHandle> ConnectionSTREAMEntry::enumerate(const ConnectionH
 #else
     libusb_device **devs; //pointer to pointer of device, used to retrieve a list of devices
     int usbDeviceCount = libusb_get_device_list(ctx, &devs);
+    std::set<uint64_t> seenDevices;
 
     if (usbDeviceCount < 0) {
         lime::error("failed to get libusb device list: %s", libusb_strerror(libusb_error(usbDeviceCount)));
@@ -149,38 +182,67 @@ std::vector<ConnectionHandle> ConnectionSTREAMEntry::enumerate(const ConnectionH
         }
         else if((vid == 1204 && pid == 241) || (vid == 1204 && pid == 243) || (vid == 7504 && pid == 24840))
         {
-            libusb_device_handle *tempDev_handle(nullptr);
-            if(libusb_open(devs[i], &tempDev_handle) != 0 || tempDev_handle == nullptr)
-                continue;
+            //device is identified by its bus location, it changes on every reattach
+            const uint64_t key = (uint64_t(libusb_get_bus_number(devs[i])) << 40)
+                | (uint64_t(libusb_get_device_address(devs[i])) << 32)
+                | (uint64_t(vid) << 16) | uint64_t(pid);
+            seenDevices.insert(key);
 
             ConnectionHandle handle;
+            bool cached = false;
+            {
+                std::lock_guard<std::mutex> lock(mHandleCacheLock);
+                auto iter = mHandleCache.find(key);
+                if(iter != mHandleCache.end())
+                {
+                    handle = iter->second;
+                    cached = true;
+                }
+            }
 
-            //check operating speed
-            int speed = libusb_get_device_speed(devs[i]);
-            if(speed == LIBUSB_SPEED_HIGH)
-                handle.media = "USB 2.0";
-            else if(speed == LIBUSB_SPEED_SUPER)
-                handle.media = "USB 3.0";
-            else
-                handle.media = "USB";
+            if(not cached)
+            {
+                libusb_device_handle *tempDev_handle(nullptr);
+                if(libusb_open(devs[i], &tempDev_handle) != 0 || tempDev_handle == nullptr)
+                    continue;
 
-            //read device name
-            char data[255];
-            r = libusb_get_string_descriptor_ascii(tempDev_handle,  LIBUSB_CLASS_COMM, (unsigned char*)data, sizeof(data));
-            if(r > 0) handle.name = std::string(data, size_t(r));
+                //check operating speed
+                int speed = libusb_get_device_speed(devs[i]);
+                if(speed == LIBUSB_SPEED_HIGH)
+                    handle.media = "USB 2.0";
+                else if(speed == LIBUSB_SPEED_SUPER)
+                    handle.media = "USB 3.0";
+                else
+                    handle.media = "USB";
 
-            r = std::sprintf(data, "%.4x:%.4x", int(vid), int(pid));
-            if (r > 0) handle.addr = std::string(data, size_t(r));
+                //read device name
+                char data[255];
+                r = libusb_get_string_descriptor_ascii(tempDev_handle,  LIBUSB_CLASS_COMM, (unsigned char*)data, sizeof(data));
+                if(r > 0) handle.name = std::string(data, size_t(r));
 
-            if (desc.iSerialNumber > 0)
-            {
-                r = libusb_get_string_descriptor_ascii(tempDev_handle,desc.iSerialNumber,(unsigned char*)data, sizeof(data));
-                if(r<0)
-                    lime::error("failed to get serial number");
-                else
-                    handle.serial = std::string(data, size_t(r));
+                r = std::sprintf(data, "%.4x:%.4x", int(vid), int(pid));
+                if (r > 0) handle.addr = std::string(data, size_t(r));
+
+                bool serialOk = true;
+                if (desc.iSerialNumber > 0)
+                {
+                    r = libusb_get_string_descriptor_ascii(tempDev_handle,desc.iSerialNumber,(unsigned char*)data, sizeof(data));
+                    if(r<0)
+                    {
+                        lime::error("failed to get serial number");
+                        serialOk = false;
+                    }
+                    else
+                        handle.serial = std::string(data, size_t(r));
+                }
+                libusb_close(tempDev_handle);
+
+                if(serialOk)
+                {
+                    std::lock_guard<std::mutex> lock(mHandleCacheLock);
+                    mHandleCache[key] = handle;
+                }
             }
-            libusb_close(tempDev_handle);
 
             //add handle conditionally, filter by serial number
             if (hint.serial.empty() or hint.serial == handle.serial)
@@ -190,6 +252,18 @@ std::vector<ConnectionHandle> ConnectionSTREAMEntry::enumerate(const ConnectionH
         }
     }
 
+    //forget devices that are no longer present
+    {
+        std::lock_guard<std::mutex> lock(mHandleCacheLock);
+        for(auto iter = mHandleCache.begin(); iter != mHandleCache.end();)
+        {
+            if(seenDevices.count(iter->first) == 0)
+                iter = mHandleCache.erase(iter);
+            else
+                ++iter;
+        }
+    }
+
     libusb_free_device_list(devs, 1);
 #endif
     return handles;
@@ -13,6 +13,7 @@
 #include <algorithm>
 #include <complex>
 #include <ciso646>
+#include <cstring>
 #include <FPGA_common.h>
 #include "ErrorReporting.h"
 #include "Logger.h"
@@ -253,25 +254,11 @@ void ConnectionSTREAM::ReceivePacketsLoop(Streamer* stream)
     auto t1 = chrono::high_resolution_clock::now();
     auto t2 = t1;
 
-    std::mutex txFlagsLock;
-    condition_variable resetTxFlags;
-    //worker thread for reseting late Tx packet flags
-    std::thread txReset([](ILimeSDRStreaming* port,
-                        atomic<bool> *terminate,
-                        mutex *spiLock,
-                        condition_variable *doWork)
-    {
-        uint32_t reg9;
-        port->ReadRegister(0x0009, reg9);
-        const uint32_t addr[] = {0x0009, 0x0009};
-        const uint32_t data[] = {reg9 | (5 << 1), reg9 & ~(5 << 1)};
-        while (not terminate->load())
-        {
-            std::unique_lock<std::mutex> lck(*spiLock);
-            doWork->wait(lck);
-            port->WriteRegisters(addr, data, 2);
-        }
-    }, this, &stream->terminateRx, &txFlagsLock, &resetTxFlags);
+    //late Tx packet flags are cleared directly from this thread
+    uint32_t reg9 = 0;
+    this->ReadRegister(0x0009, reg9);
+    const uint32_t resetTxFlagsAddr[] = {0x0009, 0x0009};
+    const uint32_t resetTxFlagsData[] = {reg9 | (5 << 1), reg9 & ~(5 << 1)};
 
     int resetFlagsDelay = 128;
     uint64_t prevTs = 0;
@@ -296,7 +283,7 @@ void ConnectionSTREAM::ReceivePacketsLoop(Streamer* stream)
                     }
                     uint32_t samplesPushed = stream->mRxStreams[ch]->Write((const void*)chFrames[ch].samples, chFrames[ch].samplesCount, &meta);
                     if(samplesPushed != chFrames[ch].samplesCount)
-                        lime::warning("Rx samples pushed %i/%i", samplesPushed, chFrames[ch].samplesCount);
+                        LIME_LOG_ASYNC(lime::LOG_LEVEL_WARNING, "Rx samples pushed %i/%i", samplesPushed, chFrames[ch].samplesCount);
                 }
             }
             this_thread::sleep_for(chrono::milliseconds(100));
@@ -324,10 +311,10 @@ void ConnectionSTREAM::ReceivePacketsLoop(Streamer* stream)
                     --resetFlagsDelay;
                 else
                 {
-                    lime::info("L %llu", (unsigned long long)pkt[pktIndex].counter);
-                    resetTxFlags.notify_one();
+                    LIME_LOG_ASYNC(lime::LOG_LEVEL_INFO, "L %llu", (unsigned long long)pkt[pktIndex].counter);
+                    this->WriteRegisters(resetTxFlagsAddr, resetTxFlagsData, 2);
+                    stream->txEvents.push({StreamEvent::LATE, pkt[pktIndex].counter});
                     resetFlagsDelay = packetsToBatch*buffersCount;
-                    stream->txLastLateTime.store(pkt[pktIndex].counter);
                     for(auto value: stream->mTxStreams)
                         value->pktLost++;
                 }
@@ -337,30 +324,34 @@ void ConnectionSTREAM::ReceivePacketsLoop(Streamer* stream)
             {
                 int packetLoss = ((pkt[pktIndex].counter - prevTs)/samplesInPacket)-1;
 #ifndef NDEBUG
-                printf("\tRx pktLoss: ts diff: %li  pktLoss: %i\n", pkt[pktIndex].counter - prevTs, packetLoss);
+                LIME_LOG_ASYNC(lime::LOG_LEVEL_DEBUG, "Rx pktLoss: ts diff: %li  pktLoss: %i", long(pkt[pktIndex].counter - prevTs), packetLoss);
 #endif
                 for(auto value: stream->mRxStreams)
                     value->pktLost += packetLoss;
+                stream->rxEvents.push({StreamEvent::PACKET_LOSS, pkt[pktIndex].counter});
             }
             prevTs = pkt[pktIndex].counter;
             stream->rxLastTimestamp.store(prevTs);
-            //parse samples
-            vector<complex16_t*> dest(chCount);
-            for(uint8_t c=0; c<chCount; ++c)
-                dest[c] = (chFrames[c].samples);
-            size_t samplesCount = 0;
-            fpga::FPGAPacketPayload2Samples(pktStart, 4080, chCount, link, dest.data(), &samplesCount);
-
+            bool rxOverflow = false;
             for(int ch=0; ch<chCount; ++ch)
             {
                 IStreamChannel::Metadata meta;
                 meta.timestamp = pkt[pktIndex].counter;
                 meta.flags = RingFIFO::OVERWRITE_OLD;
-                uint32_t samplesPushed = stream->mRxStreams[ch]->Write((const void*)chFrames[ch].samples, samplesCount, &meta, 100);
-                if(samplesPushed != samplesCount)
+                //each channel parses its samples into own format
+                uint32_t samplesPushed = stream->mRxStreams[ch]->WritePayload(pktStart, 4080, ch, chCount, &meta, 100);
+                if(samplesPushed != samplesInPacket)
+                {
                     stream->mRxStreams[ch]->overflow++;
+                    rxOverflow = true;
+                }
             }
+            if (rxOverflow)
+                stream->rxEvents.push({StreamEvent::RX_OVERFLOW, pkt[pktIndex].counter});
         }
+        //correlate host clock with timestamp at the end of received data
+        if (bytesReceived >= int32_t(sizeof(FPGA_DataPacket)))
+            stream->clock.Update(ClockModel::clock::now(), prevTs + samplesInPacket);
         // Re-submit this request to keep the queue full
         if(not stream->generateData.load())
         {
@@ -402,8 +393,6 @@ void ConnectionSTREAM::ReceivePacketsLoop(Streamer* stream)
         }
         bi = (bi + 1) & (buffersCount-1);
     }
-    resetTxFlags.notify_one();
-    txReset.join();
     stream->rxDataRate_Bps.store(0);
 }
 
@@ -434,8 +423,19 @@ void ConnectionSTREAM::TransmitPacketsLoop(Streamer* stream)
     const int maxSamplesBatch = (link==StreamConfig::STREAM_12_BIT_COMPRESSED?1360:1020)/chCount;
     vector<int> handles(buffersCount, 0);
     vector<bool> bufferUsed(buffersCount, 0);
+    vector<uint32_t> bytesToSend(buffersCount, 0);
+    //burst end acknowledgement is reported when its transfer completes
+    vector<bool> burstEndInBuffer(buffersCount, false);
+    vector<uint64_t> burstEndTimestamp(buffersCount, 0);
     vector<complex16_t> samples[maxChannelCount];
-    vector<char> buffers;
+    //samples gathered for the packet being assembled, kept between pops
+    vector<int> filled(chCount, 0);
+    vector<bool> burstEnded(chCount, false);
+    IStreamChannel::Metadata pktMeta;
+    pktMeta.timestamp = 0;
+    pktMeta.flags = 0;
+    bool inBurst = false;
+    uint64_t nextTimestamp = 0; //timestamp following the last sent packet
     try
     {
         for(int i=0; i<chCount; ++i)
@@ -456,58 +456,139 @@ void ConnectionSTREAM::TransmitPacketsLoop(Streamer* stream)
     {
         if (bufferUsed[bi])
         {
-            unsigned bytesSent;
+            unsigned bytesSent = 0;
             if (this->WaitForSending(handles[bi], 1000) == true)
-                bytesSent = this->FinishDataSending(&buffers[bi*bufferSize], bufferSize, handles[bi]);
-            if (bytesSent != bufferSize)
+                bytesSent = this->FinishDataSending(&buffers[bi*bufferSize], bytesToSend[bi], handles[bi]);
+            if (bytesSent != bytesToSend[bi])
             {
                 for (auto value : stream->mTxStreams)
                     value->overflow++;
             }
             else
+            {
                 totalBytesSent += bytesSent;
+                if (burstEndInBuffer[bi])
+                    stream->txEvents.push({StreamEvent::END_BURST, burstEndTimestamp[bi]});
+            }
             bufferUsed[bi] = false;
         }
         int i=0;
+        burstEndInBuffer[bi] = false;
+        bool flush = false; //send batched packets without waiting for full transfer
 
-        while(i<packetsToBatch && stream->terminateTx.load() != true)
+        while(i<packetsToBatch && !flush && stream->terminateTx.load() != true)
         {
-            IStreamChannel::Metadata meta;
             FPGA_DataPacket* pkt = reinterpret_cast<FPGA_DataPacket*>(&buffers[bi*bufferSize]);
-            bool badSamples = false;
+            bool timedOut = false;
             for(int ch=0; ch<chCount; ++ch)
             {
-                int samplesPopped = stream->mTxStreams[ch]->Read(samples[ch].data(), maxSamplesBatch, &meta, popTimeout_ms);
-                if (samplesPopped != maxSamplesBatch)
+                if (filled[ch] == maxSamplesBatch || burstEnded[ch])
+                    continue;
+                IStreamChannel::Metadata meta;
+                meta.flags = 0;
+                int samplesPopped = stream->mTxStreams[ch]->Read(samples[ch].data()+filled[ch], maxSamplesBatch-filled[ch], &meta, popTimeout_ms);
+                if (samplesPopped > 0)
                 {
-                    badSamples = true;
-                    stream->mTxStreams[ch]->underflow++;
+                    //packet timestamp and flags are taken from it's first sample
+                    if (ch == 0 && filled[ch] == 0)
+                        pktMeta = meta;
+                    filled[ch] += samplesPopped;
+                }
+                if (meta.flags & IStreamChannel::Metadata::END_BURST)
+                    burstEnded[ch] = true;
+                else if (filled[ch] < maxSamplesBatch)
+                    timedOut = true;
+            }
+            if(stream->terminateTx.load() == true) //early termination
+                break;
+
+            bool endOfBurst = false;
+            bool packetReady = true;
+            for(int ch=0; ch<chCount; ++ch)
+            {
+                endOfBurst |= burstEnded[ch];
+                if (filled[ch] < maxSamplesBatch && !burstEnded[ch])
+                    packetReady = false;
+            }
+            if (!packetReady)
+            {
+                if (timedOut && inBurst)
+                {
+                    for(int ch=0; ch<chCount; ++ch)
+                        if (filled[ch] < maxSamplesBatch)
+                            stream->mTxStreams[ch]->underflow++;
+                    stream->txEvents.push({StreamEvent::TX_UNDERFLOW, nextTimestamp});
                     stream->txDataRate_Bps.store(0);
 #ifndef NDEBUG
-                    printf("popping from TX, samples popped %i/%i\n", samplesPopped, maxSamplesBatch);
+                    LIME_LOG_ASYNC(lime::LOG_LEVEL_DEBUG, "popping from TX, samples popped %i/%i", filled[0], maxSamplesBatch);
 #endif
-                    break;
                 }
+                //do not hold already prepared packets while waiting for samples
+                if (i > 0)
+                    flush = true;
+                continue;
             }
-            if (badSamples)
+
+            bool samplesPending = false;
+            for(int ch=0; ch<chCount; ++ch)
+                samplesPending |= filled[ch] > 0;
+            if (endOfBurst && !samplesPending)
+            {
+                //burst ended by write without samples, its data has already been batched
+                for(int ch=0; ch<chCount; ++ch)
+                    burstEnded[ch] = false;
+                inBurst = false;
+                const uint8_t prev = (bi + buffersCount - 1) & (buffersCount-1);
+                if (i > 0)
+                {
+                    burstEndInBuffer[bi] = true;
+                    burstEndTimestamp[bi] = nextTimestamp;
+                    flush = true;
+                }
+                else if (bufferUsed[prev]) //acknowledge when last transfer completes
+                {
+                    burstEndInBuffer[prev] = true;
+                    burstEndTimestamp[prev] = nextTimestamp;
+                }
+                else
+                    stream->txEvents.push({StreamEvent::END_BURST, nextTimestamp});
                 continue;
-            if(stream->terminateTx.load() == true) //early termination
-                break;
-            pkt[i].counter = meta.timestamp;
+            }
+
+            pkt[i].counter = pktMeta.timestamp;
             pkt[i].reserved[0] = 0;
             //by default ignore timestamps
-            const int ignoreTimestamp = !(meta.flags & IStreamChannel::Metadata::SYNC_TIMESTAMP);
+            const int ignoreTimestamp = !(pktMeta.flags & IStreamChannel::Metadata::SYNC_TIMESTAMP);
             pkt[i].reserved[0] |= ((int)ignoreTimestamp << 4); //ignore timestamp
 
-            vector<complex16_t*> src(chCount);
+            nextTimestamp = pktMeta.timestamp + maxSamplesBatch;
+            if (endOfBurst)
+            {
+                burstEndInBuffer[bi] = true;
+                burstEndTimestamp[bi] = pktMeta.timestamp + filled[0];
+            }
+            //last packet of burst is padded with zeros
+            complex16_t* src[maxChannelCount];
             for(uint8_t c=0; c<chCount; ++c)
+            {
+                if (filled[c] < maxSamplesBatch)
+                    memset(&samples[c][filled[c]], 0, (maxSamplesBatch-filled[c])*sizeof(complex16_t));
                 src[c] = (samples[c].data());
+                filled[c] = 0;
+                burstEnded[c] = false;
+            }
             uint8_t* const dataStart = (uint8_t*)pkt[i].data;
-            fpga::Samples2FPGAPacketPayload(src.data(), maxSamplesBatch, chCount, link, dataStart, nullptr);
+            fpga::Samples2FPGAPacketPayload(src, maxSamplesBatch, chCount, link, dataStart, nullptr);
             ++i;
+            inBurst = !endOfBurst;
+            if (endOfBurst)
+                flush = true;
         }
+        if (i == 0)
+            continue;
 
-        handles[bi] = this->BeginDataSending(&buffers[bi*bufferSize], bufferSize, ep);
+        bytesToSend[bi] = i*sizeof(FPGA_DataPacket);
+        handles[bi] = this->BeginDataSending(&buffers[bi*bufferSize], bytesToSend[bi], ep);
         bufferUsed[bi] = true;
 
         t2 = chrono::high_resolution_clock::now();
@@ -533,7 +614,7 @@ void ConnectionSTREAM::TransmitPacketsLoop(Streamer* stream)
         if (bufferUsed[bi])
         {
             this->WaitForSending(handles[bi], 1000);
-            this->FinishDataSending(&buffers[bi*bufferSize], bufferSize, handles[bi]);
+            this->FinishDataSending(&buffers[bi*bufferSize], bytesToSend[bi], handles[bi]);
         }
         bi = (bi + 1) & (buffersCount-1);
     }
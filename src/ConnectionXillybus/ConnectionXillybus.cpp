@@ -10,6 +10,7 @@
 #include "Windows.h"
 #else
 #include <unistd.h>
+#include <poll.h>
 #endif
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -61,7 +62,8 @@ const ConnectionXillybus::EPConfig ConnectionXillybus::deviceConfigs[] = {
 
 /** @brief Initializes port type and object necessary to communicate to usb device.
 */
-ConnectionXillybus::ConnectionXillybus(const unsigned index)
+ConnectionXillybus::ConnectionXillybus(const unsigned index, const std::string &deviceDir) :
+    mDeviceDir(deviceDir)
 {
     RxLoopFunction = bind(&ConnectionXillybus::ReceivePacketsLoop, this, std::placeholders::_1);
     TxLoopFunction = bind(&ConnectionXillybus::TransmitPacketsLoop, this, std::placeholders::_1);
@@ -118,14 +120,25 @@ int ConnectionXillybus::Open(const unsigned index)
     isConnected = true;
     for (int i = 0; i < MAX_EP_CNT; i++)
     {
-        readStreamPort[i] = deviceConfigs[index].streamRead[i];
-        writeStreamPort[i] = deviceConfigs[index].streamWrite[i];
+        readStreamPort[i] = DevicePath(deviceConfigs[index].streamRead[i]);
+        writeStreamPort[i] = DevicePath(deviceConfigs[index].streamWrite[i]);
     }
-    writeCtrlPort = deviceConfigs[index].ctrlWrite;
-    readCtrlPort = deviceConfigs[index].ctrlRead;
+    writeCtrlPort = DevicePath(deviceConfigs[index].ctrlWrite);
+    readCtrlPort = DevicePath(deviceConfigs[index].ctrlRead);
     return 0;
 }
 
+/** @brief Maps default device file path into device directory
+*/
+std::string ConnectionXillybus::DevicePath(const std::string &path) const
+{
+#ifdef __unix__
+    if (!mDeviceDir.empty() && path.compare(0, 5, "/dev/") == 0)
+        return mDeviceDir + path.substr(4);
+#endif
+    return path;
+}
+
 /** @brief Closes communication to device.
 */
 void ConnectionXillybus::Close()
@@ -374,6 +387,22 @@ int ConnectionXillybus::Read(unsigned char *buffer, const int length, int timeou
     return totalBytesReaded;
 }
 
+#ifdef __unix__
+/** @brief Waits until stream file is ready for transfer or timeout since start expires
+    @param fd stream file descriptor
+    @param events POLLIN or POLLOUT
+*/
+static void WaitStream(int fd, short events, const chrono::high_resolution_clock::time_point &start, int timeout_ms)
+{
+    const int elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(chrono::high_resolution_clock::now() - start).count();
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = events;
+    pfd.revents = 0;
+    poll(&pfd, 1, elapsed < timeout_ms ? timeout_ms - elapsed : 0);
+}
+#endif
+
 /**
     @brief Reads data from board
     @param buffer array where to store received data
@@ -439,7 +468,12 @@ int ConnectionXillybus::ReceiveData(char *buffer, int length, int epIndex, int t
         int bytesReceived;
         if ((bytesReceived = read(hReadStream[epIndex], buffer+ totalBytesReaded, bytesToRead))<0)
         {
-            if(errno == EINTR || errno == EAGAIN)
+            if(errno == EAGAIN) //wait for data instead of spinning
+            {
+                WaitStream(hReadStream[epIndex], POLLIN, t1, timeout_ms);
+                continue;
+            }
+            if(errno == EINTR)
                 continue;
             ReportError(errno);
             return totalBytesReaded;
@@ -540,7 +574,12 @@ int ConnectionXillybus::SendData(const char *buffer, int length, int epIndex, in
         int bytesSent;
         if ((bytesSent  = write(hWriteStream[epIndex], buffer+ totalBytesWritten, bytesToWrite))<0)
         {
-            if(errno == EINTR || errno == EAGAIN)
+            if(errno == EAGAIN) //wait for space instead of spinning
+            {
+                WaitStream(hWriteStream[epIndex], POLLOUT, t1, timeout_ms);
+                continue;
+            }
+            if(errno == EINTR)
                 continue;
             ReportError(errno);
             return totalBytesWritten;
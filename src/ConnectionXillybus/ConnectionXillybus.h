@@ -27,7 +27,10 @@ namespace lime{
 class ConnectionXillybus : public ILimeSDRStreaming
 {
 public:
-    ConnectionXillybus(const unsigned index);
+    /** @param index device configuration index
+        @param deviceDir directory of device files, empty for default
+    */
+    ConnectionXillybus(const unsigned index, const std::string &deviceDir = "");
     ~ConnectionXillybus(void);
 
     int Open(const unsigned index);
@@ -63,11 +66,13 @@ private:
     };
 
     static const EPConfig deviceConfigs[];
+    std::string DevicePath(const std::string &path) const;
     eConnectionType GetType(void)
     {
         return PCIE_PORT;
     }
 
+    std::string mDeviceDir;
     std::string m_hardwareName;
     int m_hardwareVer;
 
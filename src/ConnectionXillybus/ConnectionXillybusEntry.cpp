@@ -52,14 +52,17 @@ std::vector<ConnectionHandle> ConnectionXillybusEntry::enumerate(const Connectio
         CloseHandle(fh);
     }
 #else
-    if( access("/dev/xillybus_control0_write_32", F_OK ) != -1 )
+    //device files can be substituted with files or pipes in a directory given by addr
+    const std::string dir = hint.addr.empty() ? "/dev" : hint.addr;
+    handle.addr = hint.addr;
+    if( access((dir + "/xillybus_control0_write_32").c_str(), F_OK ) != -1 )
     {
         handle.name = "LimeSDR-QPCIe";
         handle.index = 1;
         handles.push_back(handle);
     }
 
-    if( access("/dev/xillybus_write_8", F_OK ) != -1 )
+    if( access((dir + "/xillybus_write_8").c_str(), F_OK ) != -1 )
     {
         handle.name = "LimeSDR-PCIe";
         handle.index = 0;
@@ -71,5 +74,5 @@ std::vector<ConnectionHandle> ConnectionXillybusEntry::enumerate(const Connectio
 
 IConnection *ConnectionXillybusEntry::make(const ConnectionHandle &handle)
 {
-    return new ConnectionXillybus(handle.index);
+    return new ConnectionXillybus(handle.index, handle.addr);
 }
@@ -9,16 +9,21 @@
 #include <LMS7002M.h>
 #include <iostream>
 #include <thread>
+#include <cstring>
 #include <chrono>
 #include <algorithm>
 #include <complex>
 #include <ciso646>
 #include <FPGA_common.h>
 #include <ErrorReporting.h>
+#include <Logger.h>
+#include "BufferedTransfer.h"
 
 using namespace std;
 using namespace lime;
 
+static const uint8_t defaultBuffersCount = 4; //transfers kept in flight
+
 int ConnectionXillybus::UpdateExternalDataRate(const size_t channel, const double txRate_Hz, const double rxRate_Hz, const double txPhase, const double rxPhase)
 {
     lime::fpga::FPGA_PLL_clock clocks[2];
@@ -212,11 +217,16 @@ void ConnectionXillybus::ReceivePacketsLoop(Streamer* stream)
 
     const uint8_t packetsToBatch = (1<<tmp_cnt);
     const uint32_t bufferSize = packetsToBatch*sizeof(FPGA_DataPacket);
-    vector<char>buffers(bufferSize, 0);
+    const uint8_t buffersCount = stream->mRxStreams[0]->config.transferBuffers > 0 ? stream->mRxStreams[0]->config.transferBuffers : defaultBuffersCount;
     vector<StreamChannel::Frame> chFrames;
+    std::unique_ptr<BufferedTransfer> transfers;
     try
     {
         chFrames.resize(chCount);
+        //reading continues on I/O thread while received packets are parsed
+        transfers.reset(new BufferedTransfer([this, epIndex](char* buffer, int length, int timeout_ms){
+            return this->ReceiveData(buffer, length, epIndex, timeout_ms);
+        }, false, bufferSize, buffersCount));
     }
     catch (const std::bad_alloc &ex)
     {
@@ -234,33 +244,21 @@ void ConnectionXillybus::ReceivePacketsLoop(Streamer* stream)
     auto t1 = chrono::high_resolution_clock::now();
     auto t2 = chrono::high_resolution_clock::now();
 
-    std::mutex txFlagsLock;
-    condition_variable resetTxFlags;
-    //worker thread for reseting late Tx packet flags
-    std::thread txReset([](ILimeSDRStreaming* port,
-                        atomic<bool> *terminate,
-                        mutex *spiLock,
-                        condition_variable *doWork)
-    {
-        uint32_t reg9;
-        port->ReadRegister(0x0009, reg9);
-        const uint32_t addr[] = {0x0009, 0x0009};
-        const uint32_t data[] = {reg9 | (1 << 1), reg9 & ~(1 << 1)};
-        while (not terminate->load())
-        {
-            std::unique_lock<std::mutex> lck(*spiLock);
-            doWork->wait(lck);
-            port->WriteRegisters(addr, data, 2);
-        }
-    }, this, &stream->terminateRx, &txFlagsLock, &resetTxFlags);
+    //late Tx packet flags are cleared directly from this thread
+    uint32_t reg9 = 0;
+    this->ReadRegister(0x0009, reg9);
+    const uint32_t resetTxFlagsAddr[] = {0x0009, 0x0009};
+    const uint32_t resetTxFlagsData[] = {reg9 | (1 << 1), reg9 & ~(1 << 1)};
 
     int resetFlagsDelay = 128;
     uint64_t prevTs = 0;
+    bool streamingPaused = false;
     while (stream->terminateRx.load() == false)
     {
         if(stream->generateData.load())
         {
             fpga::StopStreaming(this, epIndex);
+            streamingPaused = true;
             stream->safeToConfigInterface.notify_all(); //notify that it's safe to change chip config
             const int batchSize = (this->mExpectedSampleRate/chFrames[0].samplesCount)/10;
             IStreamChannel::Metadata meta;
@@ -277,14 +275,20 @@ void ConnectionXillybus::ReceivePacketsLoop(Streamer* stream)
                     uint32_t samplesPushed = stream->mRxStreams[ch]->Write((const void*)chFrames[ch].samples, chFrames[ch].samplesCount, &meta);
                     samplesReceived[ch] += chFrames[ch].samplesCount;
                     if(samplesPushed != chFrames[ch].samplesCount)
-                        printf("Rx samples pushed %i/%i\n", samplesPushed, chFrames[ch].samplesCount);
+                        LIME_LOG_ASYNC(lime::LOG_LEVEL_WARNING, "Rx samples pushed %i/%i", samplesPushed, chFrames[ch].samplesCount);
                 }
             }
             this_thread::sleep_for(chrono::milliseconds(100));
         }
-        int32_t bytesReceived = 0;
-
-        bytesReceived = this->ReceiveData(&buffers[0], bufferSize, epIndex, 200);
+        else if(streamingPaused)
+        {
+            fpga::StartStreaming(this, epIndex);
+            streamingPaused = false;
+        }
+        int bytesReceived = 0;
+        const char* buffer = transfers->Acquire(&bytesReceived, 200);
+        if (buffer == nullptr)
+            bytesReceived = 0;
         totalBytesReceived += bytesReceived;
         if (bytesReceived != int32_t(bufferSize)) //data should come in full sized packets
             ++m_bufferFailures;
@@ -292,7 +296,7 @@ void ConnectionXillybus::ReceivePacketsLoop(Streamer* stream)
         bool txLate=false;
         for (uint8_t pktIndex = 0; pktIndex < bytesReceived / sizeof(FPGA_DataPacket); ++pktIndex)
         {
-            const FPGA_DataPacket* pkt = (FPGA_DataPacket*)&buffers[0];
+            const FPGA_DataPacket* pkt = (const FPGA_DataPacket*)buffer;
             const uint8_t byte0 = pkt[pktIndex].reserved[0];
             if ((byte0 & (1 << 3)) != 0 && !txLate) //report only once per batch
             {
@@ -301,8 +305,9 @@ void ConnectionXillybus::ReceivePacketsLoop(Streamer* stream)
                     --resetFlagsDelay;
                 else
                 {
-                    printf("L");
-                    resetTxFlags.notify_one();
+                    LIME_LOG_ASYNC(lime::LOG_LEVEL_INFO, "L %llu", (unsigned long long)pkt[pktIndex].counter);
+                    this->WriteRegisters(resetTxFlagsAddr, resetTxFlagsData, 2);
+                    stream->txEvents.push({StreamEvent::LATE, pkt[pktIndex].counter});
                     resetFlagsDelay = packetsToBatch*2;
                 }
             }
@@ -310,34 +315,35 @@ void ConnectionXillybus::ReceivePacketsLoop(Streamer* stream)
             if(pkt[pktIndex].counter - prevTs != samplesInPacket && pkt[pktIndex].counter != prevTs)
             {
 #ifndef NDEBUG
-                printf("\tRx pktLoss@%i - ts diff: %li  pktLoss: %.1f\n", pktIndex, pkt[pktIndex].counter - prevTs, float(pkt[pktIndex].counter - prevTs)/samplesInPacket);
+                LIME_LOG_ASYNC(lime::LOG_LEVEL_DEBUG, "Rx pktLoss@%i - ts diff: %li  pktLoss: %.1f", pktIndex, long(pkt[pktIndex].counter - prevTs), float(pkt[pktIndex].counter - prevTs)/samplesInPacket);
 #endif
                 packetLoss += (pkt[pktIndex].counter - prevTs)/samplesInPacket;
+                stream->rxEvents.push({StreamEvent::PACKET_LOSS, pkt[pktIndex].counter});
             }
             prevTs = pkt[pktIndex].counter;
             stream->rxLastTimestamp.store(pkt[pktIndex].counter);
-            //parse samples
-            vector<complex16_t*> dest(chCount);
-            for(uint8_t c=0; c<chCount; ++c)
-                dest[c] = (chFrames[c].samples);
-            size_t samplesCount = 0;
-            fpga::FPGAPacketPayload2Samples(pktStart, 4080, chCount, link, dest.data(), &samplesCount);
-
+            bool rxOverflow = false;
             for(int ch=0; ch<chCount; ++ch)
             {
                 IStreamChannel::Metadata meta;
                 meta.timestamp = pkt[pktIndex].counter;
                 meta.flags = RingFIFO::OVERWRITE_OLD;
-                uint32_t samplesPushed = stream->mRxStreams[ch]->Write((const void*)chFrames[ch].samples, samplesCount, &meta, 100);
-                if(samplesPushed != samplesCount)
-                    droppedSamples += samplesCount-samplesPushed;
+                //each channel parses its samples into own format
+                uint32_t samplesPushed = stream->mRxStreams[ch]->WritePayload(pktStart, 4080, ch, chCount, &meta, 100);
+                if(samplesPushed != samplesInPacket)
+                {
+                    droppedSamples += samplesInPacket-samplesPushed;
+                    rxOverflow = true;
+                }
             }
+            if (rxOverflow)
+                stream->rxEvents.push({StreamEvent::RX_OVERFLOW, pkt[pktIndex].counter});
         }
-        // Re-submit this request to keep the queue full
-        if(!stream->generateData.load())
-        {
-            fpga::StartStreaming(this, epIndex);
-        }
+        //correlate host clock with timestamp at the end of received data
+        if (bytesReceived >= int32_t(sizeof(FPGA_DataPacket)))
+            stream->clock.Update(ClockModel::clock::now(), prevTs + samplesInPacket);
+        if (buffer != nullptr)
+            transfers->Release();
         t2 = chrono::high_resolution_clock::now();
         auto timePeriod = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
         if (timePeriod >= 1000)
@@ -359,9 +365,8 @@ void ConnectionXillybus::ReceivePacketsLoop(Streamer* stream)
             stream->rxDataRate_Bps.store((uint32_t)dataRate);
         }
     }
+    transfers.reset();
     AbortReading(epIndex);
-    resetTxFlags.notify_one();
-    txReset.join();
     stream->rxDataRate_Bps.store(0);
 }
 
@@ -387,25 +392,32 @@ void ConnectionXillybus::TransmitPacketsLoop(Streamer* stream)
     const uint8_t packetsToBatch = (1<<tmp_cnt); //packets in single USB transfer
     const uint32_t bufferSize = packetsToBatch*4096;
     const uint32_t popTimeout_ms = 100;
+    const uint8_t buffersCount = stream->mTxStreams[0]->config.transferBuffers > 0 ? stream->mTxStreams[0]->config.transferBuffers : defaultBuffersCount;
+    const uint64_t noBurstEnd = ~0ULL;
 
     const int maxSamplesBatch = (link==StreamConfig::STREAM_12_BIT_COMPRESSED?1360:1020)/chCount;
     vector<complex16_t> samples[maxChannelCount];
-    vector<char> buffers;
+    std::atomic<long> totalBytesSent(0);
+    std::unique_ptr<BufferedTransfer> transfers;
     try
     {
         for(int i=0; i<chCount; ++i)
             samples[i].resize(maxSamplesBatch);
-        buffers.resize(bufferSize, 0);
+        //packets for next buffer are formed while previous buffers are being written
+        transfers.reset(new BufferedTransfer([this, epIndex](char* buffer, int length, int timeout_ms){
+            return this->SendData(buffer, length, epIndex, timeout_ms);
+        }, true, bufferSize, buffersCount, [stream, &totalBytesSent, noBurstEnd](int requested, int transferred, uint64_t burstEnd){
+            totalBytesSent += transferred;
+            if (transferred == requested && burstEnd != noBurstEnd)
+                stream->txEvents.push({StreamEvent::END_BURST, burstEnd});
+        }));
     }
     catch (const std::bad_alloc& ex) //not enough memory for buffers
     {
-        printf("Error allocating Tx buffers, not enough memory\n");
+        lime::error("Error allocating Tx buffers, not enough memory");
         return;
     }
 
-    int m_bufferFailures = 0;
-    long totalBytesSent = 0;
-
     uint32_t samplesSent = 0;
 
     auto t1 = chrono::high_resolution_clock::now();
@@ -414,63 +426,87 @@ void ConnectionXillybus::TransmitPacketsLoop(Streamer* stream)
     while (stream->terminateTx.load() != true)
     {
         int i=0;
+        bool endOfBurst = false;
+        uint64_t burstEndTimestamp = noBurstEnd;
+        char* buffer = transfers->Acquire(nullptr, popTimeout_ms);
+        if (buffer == nullptr)
+            continue; //all buffers are still being sent
 
-        while(i<packetsToBatch)
+        while(i<packetsToBatch && !endOfBurst)
         {
             IStreamChannel::Metadata meta;
-            FPGA_DataPacket* pkt = reinterpret_cast<FPGA_DataPacket*>(&buffers[0]);
+            FPGA_DataPacket* pkt = reinterpret_cast<FPGA_DataPacket*>(buffer);
+            bool samplesPending = false;
             for(int ch=0; ch<chCount; ++ch)
             {
                 int samplesPopped = stream->mTxStreams[ch]->Read(samples[ch].data(), maxSamplesBatch, &meta, popTimeout_ms);
+                samplesPending |= samplesPopped > 0;
+                if (meta.flags & IStreamChannel::Metadata::END_BURST)
+                {
+                    endOfBurst = true;
+                    burstEndTimestamp = meta.timestamp + samplesPopped;
+                }
+                else if (samplesPopped > 0 && samplesPopped < maxSamplesBatch)
+                    stream->txEvents.push({StreamEvent::TX_UNDERFLOW, meta.timestamp + samplesPopped});
                 if (samplesPopped != maxSamplesBatch)
                 {
+                    //burst ended or underflow, pad packet with zeros
+                    memset(&samples[ch][samplesPopped], 0, (maxSamplesBatch-samplesPopped)*sizeof(complex16_t));
                 #ifndef NDEBUG
-                    printf("Warning popping from TX, samples popped %i/%i\n", samplesPopped, maxSamplesBatch);
+                    LIME_LOG_ASYNC(lime::LOG_LEVEL_DEBUG, "popping from TX, samples popped %i/%i", samplesPopped, maxSamplesBatch);
                 #endif
                 }
             }
             if(stream->terminateTx.load() == true) //early termination
                 break;
+            //burst ended by write without samples, do not send padding packet
+            if (endOfBurst && !samplesPending)
+                break;
             pkt[i].counter = meta.timestamp;
             pkt[i].reserved[0] = 0;
             //by default ignore timestamps
             const int ignoreTimestamp = !(meta.flags & IStreamChannel::Metadata::SYNC_TIMESTAMP);
             pkt[i].reserved[0] |= ((int)ignoreTimestamp << 4); //ignore timestamp
 
-            vector<complex16_t*> src(chCount);
+            complex16_t* src[maxChannelCount];
             for(uint8_t c=0; c<chCount; ++c)
                 src[c] = (samples[c].data());
             uint8_t* const dataStart = (uint8_t*)pkt[i].data;
-            fpga::Samples2FPGAPacketPayload(src.data(), maxSamplesBatch, chCount, link, dataStart, nullptr);
+            fpga::Samples2FPGAPacketPayload(src, maxSamplesBatch, chCount, link, dataStart, nullptr);
             samplesSent += maxSamplesBatch;
             ++i;
         }
 
-        uint32_t bytesSent = this->SendData(&buffers[0], bufferSize, epIndex, 200);
-                totalBytesSent += bytesSent;
-        if (bytesSent != bufferSize)
-            ++m_bufferFailures;
+        //end of burst is sent immediately with the packets gathered so far
+        const uint32_t bytesToSend = i*sizeof(FPGA_DataPacket);
+        if (bytesToSend == 0)
+        {
+            //burst data has already been queued for sending
+            if (endOfBurst && stream->terminateTx.load() != true)
+                stream->txEvents.push({StreamEvent::END_BURST, burstEndTimestamp});
+            continue;
+        }
+        transfers->Release(bytesToSend, burstEndTimestamp);
 
         t2 = chrono::high_resolution_clock::now();
         auto timePeriod = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
         if (timePeriod >= 1000)
         {
             //total number of bytes sent per second
-            float dataRate = 1000.0*totalBytesSent / timePeriod;
+            float dataRate = 1000.0*totalBytesSent.exchange(0) / timePeriod;
             stream->txDataRate_Bps.store(dataRate);
-            m_bufferFailures = 0;
-            samplesSent = 0;
-            totalBytesSent = 0;
             t1 = t2;
 #ifndef NDEBUG
             //total number of samples from all channels per second
             float sampleRate = 1000.0*samplesSent / timePeriod;
-            printf("Tx: %.3f MB/s, Fs: %.3f MHz, failures: %i\n", dataRate / 1000000.0, sampleRate / 1000000.0, m_bufferFailures);
+            printf("Tx: %.3f MB/s, Fs: %.3f MHz, failures: %u\n", dataRate / 1000000.0, sampleRate / 1000000.0, transfers->GetFailuresCount());
 #endif
+            samplesSent = 0;
         }
     }
 
     // Wait for all the queued requests to be cancelled
+    transfers.reset();
     AbortSending(epIndex);
     stream->txDataRate_Bps.store(0);
 }
@@ -276,12 +276,10 @@ int Connection_uLimeSDR::Write(const unsigned char *buffer, const int length, in
     FT_ReleaseOverlapped(mFTHandle, &vOverlapped);
     return ulBytesWrite;
 #else
-    unsigned char* wbuffer = new unsigned char[length];
-    memcpy(wbuffer, buffer, length);
     int actual = 0;
-    libusb_bulk_transfer(dev_handle, 0x02, wbuffer, length, &actual, timeout_ms);
+    //OUT transfer only reads from the buffer, libusb takes non-const pointer for both directions
+    libusb_bulk_transfer(dev_handle, 0x02, const_cast<unsigned char*>(buffer), length, &actual, timeout_ms);
     len = actual;
-    delete[] wbuffer;
     return len;
 #endif
 }
@@ -695,3 +693,25 @@ void Connection_uLimeSDR::AbortSending()
     txSize = 0;
 #endif
 }
+
+int Connection_uLimeSDR::SendDataAsync(const char* buffer, int length, int epIndex)
+{
+    return BeginDataSending(buffer, length);
+}
+
+int Connection_uLimeSDR::WaitDataSent(const char* buffer, int length, int handle, int timeout_ms)
+{
+    if (WaitForSending(handle, timeout_ms)==false)
+    {
+#ifndef __unix__
+        //D3XX can only abort the whole pipe
+        AbortSending();
+#else
+        //cancel only this transfer, streaming may use the same endpoint
+        libusb_cancel_transfer(contextsToSend[handle].transfer);
+        //buffer can be released only after cancellation completes
+        WaitForSending(handle, 1000);
+#endif
+    }
+    return FinishDataSending(buffer, length, handle);
+}
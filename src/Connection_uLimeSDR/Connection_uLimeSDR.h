@@ -109,6 +109,8 @@ protected:
     virtual void AbortSending();
 
     int ResetStreamBuffers() override;
+    int SendDataAsync(const char* buffer, int length, int epIndex) override;
+    int WaitDataSent(const char* buffer, int length, int handle, int timeout_ms) override;
 
     eConnectionType GetType(void) {return USB_PORT;}
 
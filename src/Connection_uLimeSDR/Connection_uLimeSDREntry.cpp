@@ -46,6 +46,7 @@ Connection_uLimeSDREntry::Connection_uLimeSDREntry(void):
 
 Connection_uLimeSDREntry::~Connection_uLimeSDREntry(void)
 {
+    unregisterEntry(); //enumerate() uses the libusb context
 #ifndef __unix__
     //delete m_pDriver;
 #else
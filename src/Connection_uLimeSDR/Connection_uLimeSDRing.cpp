@@ -9,6 +9,7 @@
 #include <LMS7002M.h>
 #include <iostream>
 #include <thread>
+#include <cstring>
 #include <chrono>
 #include <algorithm>
 #include <complex>
@@ -16,6 +17,7 @@
 #include <vector>
 #include <FPGA_common.h>
 #include "ErrorReporting.h"
+#include "Logger.h"
 
 using namespace lime;
 using namespace std;
@@ -281,25 +283,11 @@ void Connection_uLimeSDR::ReceivePacketsLoop(Connection_uLimeSDR::Streamer* stre
     auto t1 = chrono::high_resolution_clock::now();
     auto t2 = chrono::high_resolution_clock::now();
 
-    std::mutex txFlagsLock;
-    condition_variable resetTxFlags;
-    //worker thread for reseting late Tx packet flags
-    std::thread txReset([](ILimeSDRStreaming* port,
-                        atomic<bool> *terminate,
-                        mutex *spiLock,
-                        condition_variable *doWork)
-    {
-        uint32_t reg9;
-        port->ReadRegister(0x0009, reg9);
-        const uint32_t addr[] = {0x0009, 0x0009};
-        const uint32_t data[] = {reg9 | (1 << 1), reg9 & ~(1 << 1)};
-        while (not terminate->load())
-        {
-            std::unique_lock<std::mutex> lck(*spiLock);
-            doWork->wait(lck);
-            port->WriteRegisters(addr, data, 2);
-        }
-    }, this, &stream->terminateRx, &txFlagsLock, &resetTxFlags);
+    //late Tx packet flags are cleared directly from this thread
+    uint32_t reg9 = 0;
+    this->ReadRegister(0x0009, reg9);
+    const uint32_t resetTxFlagsAddr[] = {0x0009, 0x0009};
+    const uint32_t resetTxFlagsData[] = {reg9 | (1 << 1), reg9 & ~(1 << 1)};
 
     int resetFlagsDelay = 128;
     uint64_t prevTs = 0;
@@ -325,7 +313,7 @@ void Connection_uLimeSDR::ReceivePacketsLoop(Connection_uLimeSDR::Streamer* stre
                     uint32_t samplesPushed = stream->mRxStreams[ch]->Write((const void*)chFrames[ch].samples, chFrames[ch].samplesCount, &meta);
                     samplesReceived[ch] += chFrames[ch].samplesCount;
                     if(samplesPushed != chFrames[ch].samplesCount)
-                        printf("Rx samples pushed %i/%i\n", samplesPushed, chFrames[ch].samplesCount);
+                        LIME_LOG_ASYNC(lime::LOG_LEVEL_WARNING, "Rx samples pushed %i/%i", samplesPushed, chFrames[ch].samplesCount);
                 }
             }
             this_thread::sleep_for(chrono::milliseconds(100));
@@ -353,39 +341,43 @@ void Connection_uLimeSDR::ReceivePacketsLoop(Connection_uLimeSDR::Streamer* stre
                     --resetFlagsDelay;
                 else
                 {
-                    printf("L");
-                    resetTxFlags.notify_one();
+                    LIME_LOG_ASYNC(lime::LOG_LEVEL_INFO, "L %llu", (unsigned long long)pkt[pktIndex].counter);
+                    this->WriteRegisters(resetTxFlagsAddr, resetTxFlagsData, 2);
+                    stream->txEvents.push({StreamEvent::LATE, pkt[pktIndex].counter});
                     resetFlagsDelay = packetsToBatch*buffersCount;
-                    stream->txLastLateTime.store(pkt[pktIndex].counter);
                 }
             }
             uint8_t* pktStart = (uint8_t*)pkt[pktIndex].data;
             if(pkt[pktIndex].counter - prevTs != samplesInPacket && pkt[pktIndex].counter != prevTs)
             {
 #ifndef NDEBUG
-                printf("\tRx pktLoss ts diff %lli\n", (long long)pkt[pktIndex].counter - prevTs);
+                LIME_LOG_ASYNC(lime::LOG_LEVEL_DEBUG, "Rx pktLoss ts diff %lli", (long long)pkt[pktIndex].counter - prevTs);
 #endif
                 packetLoss += (pkt[pktIndex].counter - prevTs)/samplesInPacket;
+                stream->rxEvents.push({StreamEvent::PACKET_LOSS, pkt[pktIndex].counter});
             }
             prevTs = pkt[pktIndex].counter;
             stream->rxLastTimestamp.store(pkt[pktIndex].counter);
-            //parse samples
-            vector<complex16_t*> dest(chCount);
-            for(uint8_t c=0; c<chCount; ++c)
-                dest[c] = (chFrames[c].samples);
-            size_t samplesCount = 0;
-            fpga::FPGAPacketPayload2Samples(pktStart, 4080, chCount, link, dest.data(), &samplesCount);
-
+            bool rxOverflow = false;
             for(int ch=0; ch<chCount; ++ch)
             {
                 IStreamChannel::Metadata meta;
                 meta.timestamp = pkt[pktIndex].counter;
                 meta.flags = RingFIFO::OVERWRITE_OLD;
-                uint32_t samplesPushed = stream->mRxStreams[ch]->Write((const void*)chFrames[ch].samples, samplesCount, &meta, 100);
-                if(samplesPushed != samplesCount)
-                    droppedSamples += samplesCount-samplesPushed;
+                //each channel parses its samples into own format
+                uint32_t samplesPushed = stream->mRxStreams[ch]->WritePayload(pktStart, 4080, ch, chCount, &meta, 100);
+                if(samplesPushed != samplesInPacket)
+                {
+                    droppedSamples += samplesInPacket-samplesPushed;
+                    rxOverflow = true;
+                }
             }
+            if (rxOverflow)
+                stream->rxEvents.push({StreamEvent::RX_OVERFLOW, pkt[pktIndex].counter});
         }
+        //correlate host clock with timestamp at the end of received data
+        if (bytesReceived >= int32_t(sizeof(FPGA_DataPacket)))
+            stream->clock.Update(ClockModel::clock::now(), prevTs + samplesInPacket);
         // Re-submit this request to keep the queue full
         if(not stream->generateData.load())
         {
@@ -433,8 +425,6 @@ void Connection_uLimeSDR::ReceivePacketsLoop(Connection_uLimeSDR::Streamer* stre
         }
         bi = (bi + 1) & (buffersCount-1);
     }
-    resetTxFlags.notify_one();
-    txReset.join();
     stream->rxDataRate_Bps.store(0);
 }
 
@@ -503,42 +493,68 @@ void Connection_uLimeSDR::TransmitPacketsLoop(Streamer* stream)
             bufferUsed[bi] = false;
         }
         int i=0;
+        bool endOfBurst = false;
+        uint64_t burstEndTimestamp = 0;
 
-        while(i<packetsToBatch && stream->terminateTx.load() != true)
+        while(i<packetsToBatch && !endOfBurst && stream->terminateTx.load() != true)
         {
             IStreamChannel::Metadata meta;
             FPGA_DataPacket* pkt = reinterpret_cast<FPGA_DataPacket*>(&buffers[bi*bufferSize]);
+            bool samplesPending = false;
             for(int ch=0; ch<chCount; ++ch)
             {
                 int samplesPopped = stream->mTxStreams[ch]->Read(samples[ch].data(), maxSamplesBatch, &meta, popTimeout_ms);
+                samplesPending |= samplesPopped > 0;
+                if (meta.flags & IStreamChannel::Metadata::END_BURST)
+                {
+                    endOfBurst = true;
+                    burstEndTimestamp = meta.timestamp + samplesPopped;
+                }
+                else if (samplesPopped > 0 && samplesPopped < maxSamplesBatch)
+                    stream->txEvents.push({StreamEvent::TX_UNDERFLOW, meta.timestamp + samplesPopped});
                 if (samplesPopped != maxSamplesBatch)
                 {
+                    //burst ended or underflow, pad packet with zeros
+                    memset(&samples[ch][samplesPopped], 0, (maxSamplesBatch-samplesPopped)*sizeof(complex16_t));
                 #ifndef NDEBUG
-                    printf("Warning popping from TX, samples popped %i/%i\n", samplesPopped, maxSamplesBatch);
+                    LIME_LOG_ASYNC(lime::LOG_LEVEL_DEBUG, "popping from TX, samples popped %i/%i", samplesPopped, maxSamplesBatch);
                 #endif
                 }
 
             }
             if(stream->terminateTx.load() == true) //early termination
                 break;
+            //burst ended by write without samples, do not send padding packet
+            if (endOfBurst && !samplesPending)
+                break;
             pkt[i].counter = meta.timestamp;
             pkt[i].reserved[0] = 0;
             //by default ignore timestamps
             const int ignoreTimestamp = !(meta.flags & IStreamChannel::Metadata::SYNC_TIMESTAMP);
             pkt[i].reserved[0] |= ((int)ignoreTimestamp << 4); //ignore timestamp
 
-            vector<complex16_t*> src(chCount);
+            complex16_t* src[maxChannelCount];
             for(uint8_t c=0; c<chCount; ++c)
                 src[c] = (samples[c].data());
             uint8_t* const dataStart = (uint8_t*)pkt[i].data;
-            fpga::Samples2FPGAPacketPayload(src.data(), maxSamplesBatch, chCount, link, dataStart, nullptr);
+            fpga::Samples2FPGAPacketPayload(src, maxSamplesBatch, chCount, link, dataStart, nullptr);
             samplesSent += maxSamplesBatch;
             ++i;
         }
 
-        bytesToSend[bi] = bufferSize;
+        //end of burst is sent immediately with the packets gathered so far
+        bytesToSend[bi] = i*sizeof(FPGA_DataPacket);
+        if (bytesToSend[bi] == 0)
+        {
+            //burst data has already been queued for sending
+            if (endOfBurst && stream->terminateTx.load() != true)
+                stream->txEvents.push({StreamEvent::END_BURST, burstEndTimestamp});
+            continue;
+        }
         handles[bi] = this->BeginDataSending(&buffers[bi*bufferSize], bytesToSend[bi]);
         bufferUsed[bi] = true;
+        if (endOfBurst)
+            stream->txEvents.push({StreamEvent::END_BURST, burstEndTimestamp});
 
         t2 = chrono::high_resolution_clock::now();
         auto timePeriod = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
@@ -567,7 +583,7 @@ void Connection_uLimeSDR::TransmitPacketsLoop(Streamer* stream)
         if (bufferUsed[bi])
         {
             this->WaitForSending(handles[bi], 1000);
-            this->FinishDataSending(&buffers[bi*bufferSize], bufferSize, handles[bi]);
+            this->FinishDataSending(&buffers[bi*bufferSize], bytesToSend[bi], handles[bi]);
         }
         bi = (bi + 1) & (buffersCount-1);
     }
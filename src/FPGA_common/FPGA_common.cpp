@@ -3,6 +3,7 @@
 #include "ErrorReporting.h"
 #include "LMS64CProtocol.h"
 #include <ciso646>
+#include <cstring>
 #include <vector>
 #include <map>
 #include <math.h>
@@ -454,6 +455,7 @@ int SetDirectClocking(IConnection* serPort, uint8_t clockIndex, const double inp
 }
 
 /** @brief Parses FPGA packet payload into samples
+    Channels with null destination pointer are skipped
 */
 int FPGAPacketPayload2Samples(const uint8_t* buffer, const size_t bufLen, const size_t chCount, const int format, complex16_t** samples, size_t* samplesCount)
 {
@@ -467,6 +469,9 @@ int FPGAPacketPayload2Samples(const uint8_t* buffer, const size_t bufLen, const
         const uint8_t stepSize = frameSize * chCount;
         for(uint8_t ch=0; ch<chCount; ++ch)
         {
+            //skipped channels keep count of the parsed one
+            if(samples[ch] == nullptr)
+                continue;
             collected = 0;
             for(uint16_t b=0; b<bufLen; b+=stepSize)
             {
@@ -493,6 +498,9 @@ int FPGAPacketPayload2Samples(const uint8_t* buffer, const size_t bufLen, const
         const uint8_t stepSize = frameSize * chCount;
         for(uint8_t ch=0; ch<chCount; ++ch)
         {
+            //skipped channels keep count of the parsed one
+            if(samples[ch] == nullptr)
+                continue;
             collected = 0;
             for(uint16_t b=0; b<bufLen; b+=stepSize)
             {
@@ -516,6 +524,77 @@ int FPGAPacketPayload2Samples(const uint8_t* buffer, const size_t bufLen, const
     return 0;
 }
 
+/** @brief Extracts single channel from FPGA packet payload into packed host format
+    @param format STREAM_12_BIT_PACKED or STREAM_8_BIT
+*/
+int FPGAPacketPayload2Packed(const uint8_t* buffer, const size_t bufLen, const size_t chCount, const size_t ch, const int linkFormat, const int format, uint8_t* dest, size_t* samplesCount)
+{
+    assert(dest != nullptr);
+    assert(buffer != nullptr);
+    size_t collected = 0;
+    //plain loops over bytes, so that compiler can vectorize them
+    if(linkFormat == StreamConfig::STREAM_12_BIT_COMPRESSED)
+    {
+        const size_t stepSize = 3 * chCount;
+        const uint8_t* src = buffer + 3 * ch;
+        collected = bufLen / stepSize;
+        if(format == StreamConfig::STREAM_12_BIT_PACKED)
+        {
+            //already in host format, only channels deinterleaving is needed
+            if(chCount == 1)
+                memcpy(dest, buffer, collected * 3);
+            else
+                for(size_t i=0; i<collected; ++i)
+                    memcpy(dest + 3*i, src + stepSize*i, 3);
+        }
+        else if(format == StreamConfig::STREAM_8_BIT)
+        {
+            //upper 8 bits of I are split between first two bytes, Q is the third byte
+            for(size_t i=0; i<collected; ++i)
+            {
+                const uint8_t* frame = src + stepSize*i;
+                dest[2*i] = (frame[0] >> 4) | (frame[1] << 4);
+                dest[2*i+1] = frame[2];
+            }
+        }
+        else
+            return ReportError(EINVAL, "Unsupported samples format");
+    }
+    else if(linkFormat == StreamConfig::STREAM_12_BIT_IN_16)
+    {
+        const size_t step = 2 * chCount;
+        const int16_t* src = reinterpret_cast<const int16_t*>(buffer) + 2 * ch;
+        collected = bufLen / (4 * chCount);
+        if(format == StreamConfig::STREAM_12_BIT_PACKED)
+        {
+            for(size_t i=0; i<collected; ++i)
+            {
+                const int16_t iSample = src[step*i];
+                const int16_t qSample = src[step*i+1];
+                dest[3*i] = iSample & 0xFF;
+                dest[3*i+1] = ((iSample >> 8) & 0x0F) | ((qSample << 4) & 0xF0);
+                dest[3*i+2] = (qSample >> 4) & 0xFF;
+            }
+        }
+        else if(format == StreamConfig::STREAM_8_BIT)
+        {
+            int8_t* dst = reinterpret_cast<int8_t*>(dest);
+            for(size_t i=0; i<collected; ++i)
+            {
+                dst[2*i] = src[step*i] >> 4;
+                dst[2*i+1] = src[step*i+1] >> 4;
+            }
+        }
+        else
+            return ReportError(EINVAL, "Unsupported samples format");
+    }
+    else
+        return ReportError(EINVAL, "Unsupported link format");
+    if(samplesCount)
+        *samplesCount = collected;
+    return 0;
+}
+
 int Samples2FPGAPacketPayload(const complex16_t* const* samples, const size_t samplesCount, const size_t chCount, const int format, uint8_t* buffer, size_t* bufLen)
 {
     assert(samples != nullptr);
@@ -39,6 +39,7 @@ int SetPllFrequency(IConnection* serPort, const uint8_t pllIndex, const double i
 int SetDirectClocking(IConnection* serPort, uint8_t clockIndex, const double inputFreq, const double phaseShift_deg);
 
 int FPGAPacketPayload2Samples(const uint8_t* buffer, const size_t bufLen, const size_t chCount, const int format, complex16_t** samples, size_t* samplesCount);
+int FPGAPacketPayload2Packed(const uint8_t* buffer, const size_t bufLen, const size_t chCount, const size_t ch, const int linkFormat, const int format, uint8_t* dest, size_t* samplesCount);
 int Samples2FPGAPacketPayload(const complex16_t* const* samples, const size_t samplesCount, const size_t chCount, const int format, uint8_t* buffer, size_t* bufLen);
 
 }
@@ -134,67 +134,9 @@ FPGAcontrols_wxgui::~FPGAcontrols_wxgui()
     wxCommandEvent evt;
 }
 
-/** @brief Reads WFM file and outputs iq sample pairs
-    @param filename source file
-    @param iSamples I samples destination vector
-    @param qSamples Q samples destination vector
-    @return number of samples returned, -1 file not found
-*/
-int ReadWFM(const wxString filename, std::vector<int16_t> &iSamples, std::vector<int16_t> &qSamples)
-{
-	if (filename.length() <= 1)
-		return 0;
-    wxFFile fpin(filename, "rb");
-    unsigned char inputBuffer[4];
-    unsigned char c1, c2, c3, c4; // To read Agilent Signal Studio file
-    double iin, qin; // IQ inputs
-    int iint, qint;	// IQ integer versions
-    int cnt = 0;
-
-    if( fpin.IsOpened() == false)
-    {
-#ifndef NDEBUG
-        cout << _("WFM reading: Input file can not be opened (") << filename << _(")\n");
-#endif
-        return -1;
-    }
-
-    while( fpin.Read(inputBuffer, 4) == 4 )
-    {
-        c1 = inputBuffer[0];
-        c2 = inputBuffer[1];
-        c3 = inputBuffer[2];
-        c4 = inputBuffer[3];
-
-        cnt++;
-
-        c1 &= 0xFF;
-        c2 &= 0xFF;
-        c3 &= 0xFF;
-        c4 &= 0xFF;
-
-        if( c1&0x80 ) iin = (double)(-1*(1<<15) + ((c1&0x7F)<<8) + c2);
-        else iin = (double)(((c1&0x7F)<<8) + c2);
-
-        if( c3&0x80 ) qin = (double)(-1*(1<<15) + ((c3&0x7F)<<8) + c4);
-        else qin = (double)(((c3&0x7F)<<8) + c4);
-
-        iint = (int)(iin);
-        qint = (int)(qin);
-
-        //convert from 16 bit to 12 bit values
-        iint = iint >> 4;
-        qint = qint >> 4;
-
-        iSamples.push_back(iint);
-        qSamples.push_back(qint);
-    };
-    return iSamples.size();
-}
-
 void FPGAcontrols_wxgui::OnbtnOpenFileClick(wxCommandEvent& event)
 {
-    wxFileDialog dlg(this, _("Open file"), _(""), _(""), _("wfm (*.wfm)|*.wfm"), wxFD_OPEN | wxFD_FILE_MUST_EXIST);
+    wxFileDialog dlg(this, _("Open file"), _(""), _(""), _("Waveform files (*.wfm;*.cs16;*.cf32;*.sigmf-meta)|*.wfm;*.cs16;*.cf32;*.sigmf-meta|wfm (*.wfm)|*.wfm"), wxFD_OPEN | wxFD_FILE_MUST_EXIST);
     if (dlg.ShowModal() == wxID_CANCEL)
         return;
     txtFilename->SetLabelText( dlg.GetPath());
@@ -224,19 +166,31 @@ int FPGAcontrols_wxgui::UploadFile(const wxString &filename)
         wxMessageBox(_("File not selected"), _("Error"));
         return -1;
     }
-    vector<int16_t> isamples;
-    vector<int16_t> qsamples;
-    isamples.clear();
-    qsamples.clear();
-    if( ReadWFM(filename, isamples, qsamples) < 0)
+
+    btnPlayWFM->Enable(false);
+    btnStopWFM->Enable(false);
+    progressBar->SetValue(0);
+
+    //file is memory mapped and streamed directly to the device
+    const bool MIMO = chkMIMO->IsChecked();
+    const uint8_t chCount = (MIMO ? 2 : 1) + (lmsIndex ? 2 : 0);
+    int status = LMS_UploadWFMFile(lmsControl, filename.mb_str(), chCount);
+
+    progressBar->SetValue(progressBar->GetRange());
+    lblProgressPercent->SetLabelText(_("100%"));
+    btnPlayWFM->Enable(true);
+    btnStopWFM->Enable(true);
+
+    if (status != 0)
     {
-        wxMessageBox(_("File not found ") + filename, _("Error"));
+        wxMessageBox(_("Failed to upload WFM file ") + filename, _("Error"));
         return -1;
     }
-    return UploadFile(isamples, qsamples);
+    LMS_EnableTxWFM(lmsControl, lmsIndex*2, true);
+    return 0;
 }
 
-int FPGAcontrols_wxgui::UploadFile(std::vector<int16_t> isamples, std::vector<int16_t> qsamples)
+int FPGAcontrols_wxgui::UploadFile(const std::vector<int16_t> &isamples, const std::vector<int16_t> &qsamples)
 {
     if (!lmsControl)
     {
@@ -250,31 +204,19 @@ int FPGAcontrols_wxgui::UploadFile(std::vector<int16_t> isamples, std::vector<in
     btnPlayWFM->Enable(false);
     btnStopWFM->Enable(false);
 
-    const uint8_t chCount = 2;
-    bool MIMO = chkMIMO->IsChecked();
-
-    lime::complex16_t* src[chCount];
-    for(int i=0; i<chCount; ++i)
-        src[i] = new lime::complex16_t[isamples.size()];
+    const bool MIMO = chkMIMO->IsChecked();
+    const uint8_t chCount = (MIMO ? 2 : 1) + (lmsIndex ? 2 : 0);
 
+    //both MIMO channels play the same samples
+    vector<lime::complex16_t> iq(isamples.size());
     for(size_t i=0; i<isamples.size(); ++i)
     {
-        for(int c=0; c<chCount; ++c)
-        {
-            if(c == 1 && !MIMO)
-            {
-                src[c][i].i = 0;
-                src[c][i].q = 0;
-            }
-            else
-            {
-                src[c][i].i = isamples[i];
-                src[c][i].q = qsamples[i];
-            }
-        }
+        iq[i].i = isamples[i];
+        iq[i].q = qsamples[i];
     }
+    const lime::complex16_t* src[2] = {iq.data(), iq.data()};
 
-    int status = LMS_UploadWFM(lmsControl, (const void**)src, lmsIndex ? 4 : 2, isamples.size(), 0);
+    int status = LMS_UploadWFM(lmsControl, (const void**)src, chCount, isamples.size(), 0);
 
     progressBar->SetValue(progressBar->GetRange());
     lblProgressPercent->SetLabelText(_("100%"));
@@ -33,7 +33,7 @@ double (*correction)();
 	int i, points;
 	double deltaw;
 
-	int **bincode, **csdcode, **csdcoder, **xpx, **xmx, **x;
+	int **bincode, **csdcode, **csdcoder;
 
 	/* Points on a frequency grid */
 	points = LMS_POINTS/2;
@@ -52,15 +52,6 @@ double (*correction)();
 	csdcoder = (int **) calloc(n, sizeof(int *));
 	for(i=0; i<n; i++) csdcoder[i] = (int *) calloc(cprec+1, sizeof(int));
 
-	xpx = (int **) calloc(n, sizeof(int *));
-	for(i=0; i<n; i++) xpx[i] = (int *) calloc(cprec+1, sizeof(int));
-
-	xmx = (int **) calloc(n, sizeof(int *));
-	for(i=0; i<n; i++) xmx[i] = (int *) calloc(cprec+1, sizeof(int));
-
-	x = (int **) calloc(n, sizeof(int *));
-	for(i=0; i<n; i++) x[i] = (int *) calloc(cprec+1, sizeof(int));
-
         /* Configure the filter with infinite precision coefficients */
         hr->m = n-1;
         hr->n = 0;
@@ -139,9 +130,6 @@ double (*correction)();
 	for(i=0; i<n; i++) free(bincode[i]); free(bincode);
 	for(i=0; i<n; i++) free(csdcode[i]); free(csdcode);
 	for(i=0; i<n; i++) free(csdcoder[i]); free(csdcoder);
-        for(i=0; i<n; i++) free(xpx[i]); free(xpx);
-        for(i=0; i<n; i++) free(xmx[i]); free(xmx);
-        for(i=0; i<n; i++) free(x[i]); free(x);
 
 }
 
@@ -154,5 +142,9 @@ void GenerateFilter(int n, double w1, double w2, double a1, double a2, double *c
 	gfir_lms (&hr, &hi, &hcsd, n, w1, w2, a1, a2, CPREC, CSDPREC, NONE); 
         for (i = 0; i < n; i++)
             coefs[i] = hi.a[i];
-       
+
+	/* Coefficient arrays are allocated by gfir_lms() */
+	free(hr.a); free(hr.b);
+	free(hi.a); free(hi.b);
+	free(hcsd.a); free(hcsd.b);
  }
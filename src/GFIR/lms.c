@@ -102,7 +102,8 @@ int **bincode, **csdcode, **csdcoder;
 	
 	int parity;		/* Parity of the filter (ODD or EVEN) */
 	int i, j, k;		/* Loop counters */
-	double fwki, fwkj;	/* Used for equation formulation */
+	double fwkj;		/* Used for equation formulation */
+	double *fk;		/* Trigonometric terms at one frequency point */
 
 	/* Check the correctness of inputs */
 	if( (hr == NULL) || (w == NULL) || 
@@ -132,12 +133,13 @@ int **bincode, **csdcode, **csdcoder;
 		return(-1);
 	}
 
-	/* Allocate memory for a[1:L], A[1:L][1:L] and index[1:L]. */
+	/* Allocate memory for a[1:L], A[1:L][1:L], index[1:L] and fk[1:L]. */
 	/* Functions from Numerical Recipes are used because I hate  */
 	/* FORTRAN like indexing (starting from 1, not 0). */
 	a = vector(1, L);
 	A = matrix(1, L, 1, L);
 	index = ivector(1, L);
+	fk = vector(1, L);
 
 	/* Set A, a and index all to zeroes */
 	for(j=1; j <= L; j++) {
@@ -146,19 +148,19 @@ int **bincode, **csdcode, **csdcoder;
 		for(i=1; i <= L; i++) A[i][j] = 0.0;
 	}
 
-	/* OK, ready to fill up the equations */
+	/* OK, ready to fill up the equations. Trigonometric terms of */
+	/* every frequency point are evaluated once into fk[], and as */
+	/* A is symmetric only its lower triangle is accumulated.     */
 	for(k=0; k<p; k++) {
+		for(j=1; j <= L; j++) fk[j] = (f)(w[k], j);
 		for(j=1; j <= L; j++) {
-			fwkj = (f)(w[k], j);
-			A[j][j] += weight[k]*fwkj*fwkj;
-			a[j] += weight[k]*des[k]*fwkj;
-			for(i=j+1; i <= L; i++) {
-				fwki = (f)(w[k], i);
-				A[i][j] += weight[k]*fwki*fwkj;
-				A[j][i] += weight[k]*fwkj*fwki;
-			}
+			fwkj = weight[k]*fk[j];
+			a[j] += fwkj*des[k];
+			for(i=j; i <= L; i++) A[i][j] += fwkj*fk[i];
 		}
 	}
+	for(j=1; j <= L; j++)
+		for(i=j+1; i <= L; i++) A[j][i] = A[i][j];
 
 	/* Solve the equations */
 	ludcmp(A, L, index, &d); lubksb(A, L, index, a);
@@ -183,6 +185,7 @@ int **bincode, **csdcode, **csdcoder;
 	free_vector(a, 1, L);
 	free_matrix(A, 1, L, 1, L);
 	free_ivector(index, 1, L);
+	free_vector(fk, 1, L);
 
 	/* That's all, let's go home */
 	return(0);
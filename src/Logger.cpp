@@ -6,6 +6,12 @@
 
 #include "Logger.h"
 #include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
 
 static void defaultLogHandler(const lime::LogLevel level, const char *message)
 {
@@ -38,3 +44,229 @@ const char *lime::logLevelToName(const LogLevel level)
     }
     return "";
 }
+
+/***********************************************************************
+ * Asynchronous logging
+ **********************************************************************/
+static const int asyncQueueSize = 1024; //power of 2
+static const uint32_t asyncRateLimit = 10; //messages per second per call site
+
+struct AsyncMessage
+{
+    std::atomic<size_t> sequence;
+    lime::LogLevel level;
+    const char *format;
+    lime::LogArgument args[lime::LOG_ASYNC_MAX_ARGS];
+    int argsCount;
+    uint32_t suppressed;
+};
+
+//bounded multi-producer queue, each slot sequence tells whether it is free or filled
+struct AsyncQueue
+{
+    AsyncQueue() : head(0), tail(0), dropped(0), droppedReported(0)
+    {
+        for (size_t i = 0; i < asyncQueueSize; ++i)
+            messages[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    AsyncMessage messages[asyncQueueSize];
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+    std::atomic<uint64_t> dropped;
+    uint64_t droppedReported;
+    std::mutex consumerLock;
+};
+
+//never destroyed, logging thread may still run while static objects are destroyed at exit
+static AsyncQueue *asyncQueue = new AsyncQueue();
+static std::once_flag asyncThreadStarted;
+
+static AsyncMessage *acquireSlot(size_t &pos)
+{
+    pos = asyncQueue->tail.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        AsyncMessage *msg = &asyncQueue->messages[pos & (asyncQueueSize-1)];
+        const size_t seq = msg->sequence.load(std::memory_order_acquire);
+        const intptr_t diff = intptr_t(seq) - intptr_t(pos);
+        if (diff == 0)
+        {
+            if (asyncQueue->tail.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+                return msg;
+        }
+        else if (diff < 0)
+            return nullptr; //full
+        else
+            pos = asyncQueue->tail.load(std::memory_order_relaxed);
+    }
+}
+
+static size_t formatArgument(char *dest, const size_t size, const char *spec, const size_t specLength, const lime::LogArgument &arg)
+{
+    //rebuild conversion specification without length modifiers, using the stored argument type
+    char fmt[32];
+    size_t len = 0;
+    for (size_t i = 0; i < specLength-1 && len < sizeof(fmt)-4; ++i)
+        if (strchr("hlLqjzt", spec[i]) == nullptr)
+            fmt[len++] = spec[i];
+    const char conversion = spec[specLength-1];
+    int ret = 0;
+    switch (conversion)
+    {
+    case 'd': case 'i':
+    {
+        long long value = arg.type == lime::LogArgument::SIGNED ? arg.value.i : (long long)arg.value.u;
+        strcpy(&fmt[len], "lld");
+        ret = snprintf(dest, size, fmt, value);
+        break;
+    }
+    case 'u': case 'x': case 'X': case 'o':
+    {
+        unsigned long long value = arg.value.u;
+        if (arg.type == lime::LogArgument::SIGNED && arg.size < sizeof(value))
+            value &= (1ULL << (8*arg.size)) - 1; //same width as original argument
+        fmt[len++] = 'l';
+        fmt[len++] = 'l';
+        fmt[len++] = conversion;
+        fmt[len] = '\0';
+        ret = snprintf(dest, size, fmt, value);
+        break;
+    }
+    case 'c':
+        fmt[len++] = 'c';
+        fmt[len] = '\0';
+        ret = snprintf(dest, size, fmt, int(arg.value.i));
+        break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        fmt[len++] = conversion;
+        fmt[len] = '\0';
+        ret = snprintf(dest, size, fmt, arg.type == lime::LogArgument::FLOATING ? arg.value.d : double(arg.value.i));
+        break;
+    case 's':
+        fmt[len++] = 's';
+        fmt[len] = '\0';
+        ret = snprintf(dest, size, fmt, arg.value.p ? (const char*)arg.value.p : "(null)");
+        break;
+    case 'p':
+        fmt[len++] = 'p';
+        fmt[len] = '\0';
+        ret = snprintf(dest, size, fmt, arg.value.p);
+        break;
+    default:
+        ret = snprintf(dest, size, "%.*s", int(specLength), spec);
+    }
+    if (ret < 0)
+        return 0;
+    return std::min<size_t>(ret, size-1);
+}
+
+static void formatMessage(char *dest, const size_t size, const AsyncMessage &msg)
+{
+    size_t pos = 0;
+    int argIndex = 0;
+    const char *p = msg.format;
+    while (*p && pos < size-1)
+    {
+        if (*p != '%')
+        {
+            dest[pos++] = *p++;
+            continue;
+        }
+        if (p[1] == '%')
+        {
+            dest[pos++] = '%';
+            p += 2;
+            continue;
+        }
+        const size_t specLength = strspn(p+1, "-+ #0123456789.hlLqjzt") + 2;
+        if (p[specLength-1] == '\0' || argIndex >= msg.argsCount)
+        {
+            dest[pos++] = *p++; //malformed or missing argument, copy as text
+            continue;
+        }
+        pos += formatArgument(&dest[pos], size-pos, p, specLength, msg.args[argIndex++]);
+        p += specLength;
+    }
+    dest[pos] = '\0';
+    if (msg.suppressed > 0 && pos < size-1)
+        snprintf(&dest[pos], size-pos, " (%u similar messages suppressed)", msg.suppressed);
+}
+
+void lime::flushLog(void)
+{
+    std::lock_guard<std::mutex> lock(asyncQueue->consumerLock);
+    char buff[4096];
+    for (;;)
+    {
+        const size_t pos = asyncQueue->head.load(std::memory_order_relaxed);
+        AsyncMessage &msg = asyncQueue->messages[pos & (asyncQueueSize-1)];
+        if (msg.sequence.load(std::memory_order_acquire) != pos+1)
+            break; //empty
+        formatMessage(buff, sizeof(buff), msg);
+        const LogLevel level = msg.level;
+        msg.sequence.store(pos+asyncQueueSize, std::memory_order_release);
+        asyncQueue->head.store(pos+1, std::memory_order_relaxed);
+        logHandler(level, buff);
+    }
+    const uint64_t dropped = asyncQueue->dropped.load(std::memory_order_relaxed);
+    if (dropped != asyncQueue->droppedReported)
+    {
+        snprintf(buff, sizeof(buff), "%llu log messages dropped, queue full",
+            (unsigned long long)(dropped - asyncQueue->droppedReported));
+        asyncQueue->droppedReported = dropped;
+        logHandler(LOG_LEVEL_WARNING, buff);
+    }
+}
+
+static void flushLogAtExit(void)
+{
+    lime::flushLog();
+}
+
+static void asyncLogLoop(void)
+{
+    for (;;)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        lime::flushLog();
+    }
+}
+
+void lime::logAsync(const LogLevel level, LogSite &site, const char *format, const LogArgument *args, const int argsCount)
+{
+    std::call_once(asyncThreadStarted, [](){
+        std::thread(asyncLogLoop).detach();
+        std::atexit(flushLogAtExit);
+    });
+
+    const int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t windowStart = site.windowStart.load(std::memory_order_relaxed);
+    if (now - windowStart >= 1000 && site.windowStart.compare_exchange_strong(windowStart, now))
+        site.windowCount.store(0, std::memory_order_relaxed);
+    if (site.windowCount.fetch_add(1, std::memory_order_relaxed) >= asyncRateLimit)
+    {
+        site.suppressed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    size_t pos;
+    AsyncMessage *msg = acquireSlot(pos);
+    if (msg == nullptr)
+    {
+        asyncQueue->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    msg->level = level;
+    msg->format = format;
+    msg->argsCount = std::min(argsCount, LOG_ASYNC_MAX_ARGS);
+    for (int i = 0; i < msg->argsCount; ++i)
+        msg->args[i] = args[i];
+    msg->suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+    msg->sequence.store(pos+1, std::memory_order_release); //publish to consumer
+}
+
+uint64_t lime::getLogDropCount(void)
+{
+    return asyncQueue->dropped.load(std::memory_order_relaxed);
+}
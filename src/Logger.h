@@ -10,6 +10,8 @@
 #include <LimeSuiteConfig.h>
 #include <string>
 #include <cstdarg>
+#include <cstdint>
+#include <atomic>
 
 namespace lime
 {
@@ -63,8 +65,75 @@ LIME_API void registerLogHandler(const LogHandler handler);
 //! Convert log level to a string name for printing
 LIME_API const char *logLevelToName(const LogLevel level);
 
+/*!
+ * Call site state for rate limiting of asynchronous messages.
+ * Declared as static variable at each call site by LIME_LOG_ASYNC.
+ */
+struct LogSite
+{
+    LogSite() : windowStart(0), windowCount(0), suppressed(0) {}
+    std::atomic<int64_t> windowStart;
+    std::atomic<uint32_t> windowCount;
+    std::atomic<uint32_t> suppressed;
+};
+
+//! Argument of asynchronous message, copied by value
+struct LogArgument
+{
+    enum Type : uint8_t { SIGNED, UNSIGNED, FLOATING, POINTER };
+    LogArgument() : type(SIGNED), size(0) { value.i = 0; }
+    LogArgument(int v) : type(SIGNED), size(sizeof(v)) { value.i = v; }
+    LogArgument(long v) : type(SIGNED), size(sizeof(v)) { value.i = v; }
+    LogArgument(long long v) : type(SIGNED), size(sizeof(v)) { value.i = v; }
+    LogArgument(unsigned v) : type(UNSIGNED), size(sizeof(v)) { value.u = v; }
+    LogArgument(unsigned long v) : type(UNSIGNED), size(sizeof(v)) { value.u = v; }
+    LogArgument(unsigned long long v) : type(UNSIGNED), size(sizeof(v)) { value.u = v; }
+    LogArgument(double v) : type(FLOATING), size(sizeof(v)) { value.d = v; }
+    LogArgument(const void* v) : type(POINTER), size(sizeof(v)) { value.p = v; }
+    union
+    {
+        long long i;
+        unsigned long long u;
+        double d;
+        const void* p;
+    } value;
+    Type type;
+    uint8_t size;
+};
+
+static const int LOG_ASYNC_MAX_ARGS = 8;
+
+/*!
+ * Queue a message to be formatted and sent to the log handler by the logging thread.
+ * Does not block, so it is safe to use from streaming threads. The message is
+ * dropped when the queue is full or the call site exceeds its rate limit,
+ * dropped messages are counted and reported later.
+ * String arguments are not copied, they must stay valid (string literals).
+ */
+LIME_API void logAsync(const LogLevel level, LogSite &site, const char *format, const LogArgument *args, const int argsCount);
+
+template<typename... Args>
+static inline void logAsync(const LogLevel level, LogSite &site, const char *format, Args... args)
+{
+    static_assert(sizeof...(Args) <= LOG_ASYNC_MAX_ARGS, "too many log arguments");
+    const LogArgument argList[] = {LogArgument(args)..., LogArgument()};
+    logAsync(level, site, format, static_cast<const LogArgument *>(argList), int(sizeof...(Args)));
 }
 
+//! Format and dispatch all queued asynchronous messages on the calling thread
+LIME_API void flushLog(void);
+
+//! Number of asynchronous messages lost because the queue was full
+LIME_API uint64_t getLogDropCount(void);
+
+}
+
+//! Log message asynchronously with rate limiting per call site
+#define LIME_LOG_ASYNC(level, ...) do { \
+    static lime::LogSite limeLogSite_; \
+    lime::logAsync(level, limeLogSite_, __VA_ARGS__); \
+} while(0)
+
 static inline void lime::log(const LogLevel level, const char *format, ...)
 {
     va_list args;
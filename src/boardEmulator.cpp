@@ -35,6 +35,11 @@ int main(int argc, char** argv)
 	sigIntHandler.sa_flags = 0;
 	sigaction(SIGINT, &sigIntHandler, NULL);
 
+	//optional argument: reply delay in microseconds, imitates control link latency
+	int latency_us = 0;
+	if(argc > 1)
+		latency_us = atoi(argv[1]);
+
 	int masterFd = posix_openpt(O_RDWR);
 	if(masterFd < 0)
 	{
@@ -51,7 +56,7 @@ int main(int argc, char** argv)
 	sprintf(linkCommand, "sudo ln -s %s /dev/ttyACM_LMS7emulator", ptsname(masterFd));
 	system(linkCommand);
 
-	cout << "LMS7 board emulator started" << endl;
+	cout << "LMS7 board emulator started, reply latency " << latency_us << " us" << endl;
 
 	const int bufSize = 64;
 	vector<uint8_t> inputBuf;
@@ -91,6 +96,8 @@ int main(int argc, char** argv)
 			if(inputBuf.size() == 64)
 			{
 				ProcessLMS64C(inputBuf.data(), outputBuf);
+				if(latency_us > 0)
+					std::this_thread::sleep_for(std::chrono::microseconds(latency_us));
 				bwrite = write(masterFd, outputBuf, bufSize);
 				if(bwrite < 0)
 				{
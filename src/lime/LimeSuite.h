@@ -466,6 +466,32 @@ API_EXPORT int CALL_CONV LMS_LoadConfig(lms_device_t *device, const char *filena
  */
 API_EXPORT int CALL_CONV LMS_SaveConfig(lms_device_t *device, const char *filename);
 
+/**
+ * Save LMS chip registers, reference clocks and calibration results
+ * as a binary profile for fast configuration switching
+ *
+ * @param   device      Device handle
+ * @param   filename    path to profile file
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SaveProfile(lms_device_t *device, const char *filename);
+
+/**
+ * Apply a profile created with LMS_SaveProfile()
+ *
+ * Only registers which differ from the current configuration are written,
+ * and FPGA interface clocks are reconfigured only when the sample rate
+ * changes, so switching between profiles is much faster than
+ * LMS_LoadConfig().
+ *
+ * @param   device      Device handle
+ * @param   filename    path to profile file
+ *
+ * @return  0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_LoadProfile(lms_device_t *device, const char *filename);
+
 /**
  * Apply the specified test signal
  *
@@ -996,7 +1022,8 @@ typedef struct
     /**In TX: wait for the specified HW timestamp before broadcasting data over
      * the air
      * In RX: wait for the specified HW timestamp before starting to receive
-     * samples
+     * samples, older samples are discarded. Returned timestamp greater than
+     * requested indicates that samples at requested timestamp were lost
      */
     bool waitForTimestamp;
 
@@ -1062,6 +1089,25 @@ typedef struct
 
 } lms_stream_status_t;
 
+/**Signal statistics of RX stream, measured over one window of samples*/
+typedef struct
+{
+    /**Mean power, dBFS*/
+    float_type power;
+    /**Peak magnitude, dBFS*/
+    float_type peak;
+    /**Mean I value, normalized to full scale*/
+    float_type dcI;
+    /**Mean Q value, normalized to full scale*/
+    float_type dcQ;
+    /**Number of samples with I or Q at full scale*/
+    uint32_t clipped;
+    /**Number of samples in measurement window*/
+    uint32_t samplesCount;
+    /**Timestamp of the first sample in window*/
+    uint64_t timestamp;
+} lms_stream_meters_t;
+
 /**
  * Create new stream based on parameters passed in configuration structure.
  * The structure is initialized with stream handle.
@@ -1073,6 +1119,25 @@ typedef struct
  */
 API_EXPORT int CALL_CONV LMS_SetupStream(lms_device_t *device, lms_stream_t *stream);
 
+/**
+ * Create RX stream of a narrow band processed on the host. The band centered
+ * at @p offset from the channel center frequency is shifted to DC and
+ * resampled to @p rate, which does not need to be a power of two fraction of
+ * the sampling rate. Streams of the same channel share one device stream.
+ * Samples are read with LMS_RecvStream() in ::LMS_FMT_F32 format and
+ * timestamps count output samples. Sampling rate has to be set before the
+ * stream is started. The stream is destroyed with LMS_DestroyStream().
+ *
+ * @param device    Device handle previously obtained by LMS_Open().
+ * @param stream    RX stream configuration. See the ::lms_stream_t description.
+ * @param offset    Band center relative to channel center frequency, Hz
+ * @param rate      Output sampling rate, Hz
+ * @param bandwidth Passband width, Hz, 0 for 80% of output rate
+ *
+ * @return      0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_SetupChannelizerStream(lms_device_t *device, lms_stream_t *stream, float_type offset, float_type rate, float_type bandwidth);
+
 /**
  * Deallocate memory used for stream.
  * @todo
@@ -1125,6 +1190,19 @@ API_EXPORT int CALL_CONV LMS_StopStream(lms_stream_t *conf);
  */
 API_EXPORT int CALL_CONV LMS_GetStreamStatus(lms_stream_t *stream, lms_stream_status_t* status);
 
+/**
+ * Get signal level statistics of RX stream. Statistics are computed while
+ * unpacking received samples, about every 10 ms, and reading them does not
+ * access the device. Measuring starts with the first call, which fails until
+ * the first window is completed.
+ *
+ * @param stream    RX stream previously initialized with LMS_SetupStream().
+ * @param meters    Signal statistics. See the ::lms_stream_meters_t for description
+ *
+ * @return  0 on success, (-1) on failure or when not measured yet
+ */
+API_EXPORT int CALL_CONV LMS_GetStreamMeters(lms_stream_t *stream, lms_stream_meters_t* meters);
+
 /**
  * Write samples to the FIFO of the specified stream.
  *
@@ -1134,6 +1212,9 @@ API_EXPORT int CALL_CONV LMS_GetStreamStatus(lms_stream_t *stream, lms_stream_st
  * @param meta          Metadata. See the ::lms_stream_meta_t description.
  * @param timeout_ms    how long to wait for data before timing out.
  *
+ * Burst can be ended without samples by setting meta->flushPartialPacket
+ * with sample_count 0, such write returns 0 on success.
+ *
  * @return number of samples send on success, (-1) on failure
  */
 API_EXPORT int CALL_CONV LMS_SendStream(lms_stream_t *stream,
@@ -1151,6 +1232,19 @@ API_EXPORT int CALL_CONV LMS_SendStream(lms_stream_t *stream,
 API_EXPORT int CALL_CONV LMS_UploadWFM(lms_device_t *device, const void **samples,
                                 uint8_t chCount, size_t sample_count, int format);
 
+/** @brief Uploads waveform file to on board memory for later use
+ *
+ * File is memory mapped and streamed to the device without intermediate copies.
+ * Supported files: .wfm, raw .cs16/.cf32 IQ samples and SigMF recordings.
+ *
+ * @param device        Device handle previously obtained by LMS_Open().
+ * @param filename      waveform file
+ * @param chCount       number of waveform channels, all get the same samples
+ * @return              0 on success, (-1) on failure
+ */
+API_EXPORT int CALL_CONV LMS_UploadWFMFile(lms_device_t *device, const char *filename,
+                                uint8_t chCount);
+
 /** @brief Enables/Disables transmitting of uploaded waveform
  * @param device    Device handle previously obtained by LMS_Open().
  * @param chan      Channel index
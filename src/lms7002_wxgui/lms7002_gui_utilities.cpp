@@ -36,15 +36,27 @@ void LMS7002_WXGUI::UpdateControlsByMap(wxPanel* panel, lms_device_t* lmsControl
     wxClassInfo *labelInfo = wxClassInfo::FindClass(_("wxStaticText"));
     wxClassInfo *radioBtnInfo = wxClassInfo::FindClass(_("wxRadioButton"));
 
+    //read all registers used by panel in one batch
+    std::vector<LMS7Parameter> params;
+    std::vector<uint16_t> values;
+    for (const auto &idParam : wndId2param)
+        params.push_back(idParam.second);
+    LMS7_Device* lms = (LMS7_Device*)lmsControl;
+    if (lms->ReadParams(params, values, true) != 0)
+    {
+        panel->Thaw();
+        return;
+    }
+
+    size_t paramIndex = 0;
     for (auto idParam : wndId2param)
     {
+        value = values[paramIndex++];
         wnd = idParam.first;
         if (wnd == nullptr)
             continue;
         wndClass = wnd->GetClassInfo();
 
-        LMS7_Device* lms = (LMS7_Device*)lmsControl;
-        lms->ReadParam(idParam.second, &value, true);
         //cast window to specific control, to set value, or set selection
         if (wndClass->IsKindOf(cmbInfo))
         {
@@ -56,11 +68,14 @@ void LMS7002_WXGUI::UpdateControlsByMap(wxPanel* panel, lms_device_t* lmsControl
                 //wxMessageBox(str, "WARNING!");
                 value = 0;
             }
-            box->SetSelection(value);
+            if (box->GetSelection() != value)
+                box->SetSelection(value);
         }
         else if (wndClass->IsKindOf(chkInfo))
         {
-            wxStaticCast(wnd, wxCheckBox)->SetValue(value);
+            wxCheckBox *box = wxStaticCast(wnd, wxCheckBox);
+            if (box->GetValue() != (value != 0))
+                box->SetValue(value);
         }
         else if (wndClass->IsKindOf(rgrInfo))
         {
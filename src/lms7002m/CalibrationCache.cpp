@@ -19,6 +19,7 @@ std::string CalibrationCache::cachePath = "";
 static const char* cacheFilename = "LMS7002M_cache_values.db";
 
 int CalibrationCache::instanceCount = 0;
+int CalibrationCache::batchDepth = 0;
 sqlite3* CalibrationCache::db = nullptr;
 
 static inline double linearInterp(double x, double x0, double y0, double x1, double y1)
@@ -439,3 +440,34 @@ int CalibrationCache::GetFilter_RC(uint32_t boardId, double bandwidth, uint8_t c
         *cfb = queryResults.cfb;
     return 0;
 }
+
+int CalibrationCache::BeginBatch()
+{
+    if(batchDepth++ > 0)
+        return 0;
+    char* zErrMsg = 0;
+    int rc = sqlite3_exec(db, "BEGIN TRANSACTION;", nullptr, 0, &zErrMsg);
+    if( rc != SQLITE_OK )
+    {
+        lime::error("SQL error: %s", zErrMsg);
+        sqlite3_free(zErrMsg);
+        batchDepth = 0;
+        return -1;
+    }
+    return 0;
+}
+
+int CalibrationCache::EndBatch()
+{
+    if(batchDepth == 0 || --batchDepth > 0)
+        return 0;
+    char* zErrMsg = 0;
+    int rc = sqlite3_exec(db, "COMMIT TRANSACTION;", nullptr, 0, &zErrMsg);
+    if( rc != SQLITE_OK )
+    {
+        lime::error("SQL error: %s", zErrMsg);
+        sqlite3_free(zErrMsg);
+        return -1;
+    }
+    return 0;
+}
@@ -24,11 +24,16 @@ public:
     int InsertFilter_RC(uint32_t boardId, double bandwidth, uint8_t channel, bool transmitter, int filter_id, int rcal, int ccal, int cfb = 0);
     int GetFilter_RC(uint32_t boardId, double bandwidth, uint8_t channel, bool transmitter, int filter_id, int *rcal, int *ccal, int *cfb = nullptr);
 
+    ///Inserts between BeginBatch() and EndBatch() are committed as one transaction
+    int BeginBatch();
+    int EndBatch();
+
 protected:
     int initializeDatabase();
 
     static std::string cachePath;
     static int instanceCount;
+    static int batchDepth;
     static sqlite3 *db;
 };
 
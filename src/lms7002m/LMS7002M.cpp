@@ -24,7 +24,14 @@
 #include <assert.h>
 #include <chrono>
 #include <thread>
+#include <cstring>
 #include "Logger.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include "MCU_BD.h"
 const static uint16_t MCU_PARAMETER_ADDRESS = 0x002D; //register used to pass parameter values to MCU
@@ -369,6 +376,7 @@ int LMS7002M::ResetChip()
     checkConnection();
 
     int status = controlPort->DeviceReset();
+    mcuControl->InvalidateProgramState(); //MCU SRAM is lost on reset
     if (status == 0) Modify_SPI_Reg_bits(LMS7param(MIMO_SISO), 0); //enable B channel after reset
     return status;
 }
@@ -380,6 +388,7 @@ int LMS7002M::SoftReset()
     this->SPI_write(0x0020, 0x0);
     this->SPI_write(0x0020, reg_0x0020);
     this->SPI_write(0x002E, reg_0x002E);//must write
+    mcuControl->InvalidateProgramState();
     return 0;
 }
 
@@ -392,6 +401,7 @@ int LMS7002M::LoadConfigLegacyFile(const char* filename)
         return ReportError(ENOENT, "LoadConfigLegacyFile(%s) - file not found", filename);
     }
     f.close();
+    mcuControl->InvalidateProgramState(); //configuration rewrites MCU control registers
     uint16_t addr = 0;
     uint16_t value = 0;
     Channel ch = this->GetActiveChannel(); //remember used channel
@@ -575,6 +585,7 @@ int LMS7002M::LoadConfig(const char* filename)
         return ReportError(ENOENT, "LoadConfig(%s) - file not found", filename);
     }
     f.close();
+    mcuControl->InvalidateProgramState(); //configuration rewrites MCU control registers
     uint16_t addr = 0;
     uint16_t value = 0;
     Channel ch = this->GetActiveChannel(); //remember used channel
@@ -724,6 +735,197 @@ int LMS7002M::SaveConfig(const char* filename)
     return 0;
 }
 
+//binary register image, register entries follow the header
+static const char profileMagic[8] = {'L','M','S','7','P','R','F','\0'};
+static const uint32_t profileVersion = 1;
+
+struct ProfileCalibration
+{
+    int32_t valid;
+    int32_t dcI;
+    int32_t dcQ;
+    int32_t gainI;
+    int32_t gainQ;
+    int32_t phase;
+};
+
+struct ProfileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t registersCount[2]; //channel A and channel B entries
+    uint32_t x0020_value; //channel selection register, applied last
+    double refClkSXR;
+    double refClkSXT;
+    ProfileCalibration calibration[2]; //Rx, Tx
+};
+
+struct ProfileRegister
+{
+    uint16_t address;
+    uint16_t value;
+};
+
+static bool IsProfileRegister(const uint16_t address)
+{
+    //channel selection is applied separately, RSSI DC registers are accessed through MCU
+    if (address == 0x0020 || address == 0x0640 || address == 0x0641)
+        return false;
+    static const uint16_t readOnly[] = { 0x002F, 0x008C, 0x00A8, 0x00A9, 0x00AA, 0x00AB, 0x00AC, 0x0123, 0x0209, 0x020A, 0x020B, 0x040E, 0x040F };
+    return std::find(std::begin(readOnly), std::end(readOnly), address) == std::end(readOnly);
+}
+
+/** @brief Reads all registers from chip and saves them as binary register image
+    The image also holds reference clocks and last calibration results,
+    it is applied with LoadProfile() or ApplyProfile().
+    @param filename destination filename
+    @return 0-success, other failure
+*/
+int LMS7002M::SaveProfile(const char* filename)
+{
+    if (controlPort != nullptr && DownloadAll() != 0)
+        return -1;
+
+    ProfileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, profileMagic, sizeof(profileMagic));
+    header.version = profileVersion;
+    header.x0020_value = mRegistersMap->GetValue(0, 0x0020);
+    header.refClkSXR = GetReferenceClk_SX(Rx);
+    header.refClkSXT = GetReferenceClk_SX(Tx);
+    for (int i = 0; i < 2; ++i)
+    {
+        const CalibrationValues& cal = mCalibrationResult[i];
+        header.calibration[i] = {cal.valid, cal.dcI, cal.dcQ, cal.gainI, cal.gainQ, cal.phase};
+    }
+
+    vector<ProfileRegister> registers;
+    for (uint8_t ch = 0; ch < 2; ++ch)
+    {
+        for (auto address : mRegistersMap->GetUsedAddresses(ch))
+        {
+            if (!IsProfileRegister(address) || (ch == 1 && address < 0x0100))
+                continue;
+            registers.push_back({address, mRegistersMap->GetValue(ch, address)});
+            ++header.registersCount[ch];
+        }
+    }
+
+    ofstream fout(filename, ios::binary);
+    if (!fout.good())
+        return ReportError(EIO, "SaveProfile(%s) - failed to create file", filename);
+    fout.write((const char*)&header, sizeof(header));
+    fout.write((const char*)registers.data(), registers.size()*sizeof(ProfileRegister));
+    if (!fout.good())
+        return ReportError(EIO, "SaveProfile(%s) - write failed", filename);
+    return 0;
+}
+
+/** @brief Maps binary register image from file and applies it
+    @param filename profile created by SaveProfile()
+    @return 0-success, other failure
+*/
+int LMS7002M::LoadProfile(const char* filename)
+{
+#ifdef _WIN32
+    ifstream fin(filename, ios::binary);
+    if (!fin.good())
+        return ReportError(ENOENT, "LoadProfile(%s) - file not found", filename);
+    vector<char> image((istreambuf_iterator<char>(fin)), istreambuf_iterator<char>());
+    return ApplyProfile(image.data(), image.size());
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return ReportError(ENOENT, "LoadProfile(%s) - file not found", filename);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return ReportError(EINVAL, "LoadProfile(%s) - invalid format", filename);
+    }
+    void* image = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED)
+        return ReportError(errno, "LoadProfile(%s) - %s", filename, strerror(errno));
+    int status = ApplyProfile(image, st.st_size);
+    munmap(image, st.st_size);
+    return status;
+#endif
+}
+
+/** @brief Applies binary register image, writing only registers which differ
+    from the cached register values in a single SPI batch.
+    @param image register image in SaveProfile() format
+    @param length image size in bytes
+    @return 0-success, other failure
+*/
+int LMS7002M::ApplyProfile(const void* image, const size_t length)
+{
+    const ProfileHeader* header = (const ProfileHeader*)image;
+    if (length < sizeof(ProfileHeader) || memcmp(header->magic, profileMagic, sizeof(profileMagic)) != 0)
+        return ReportError(EINVAL, "ApplyProfile() - invalid format");
+    if (header->version != profileVersion)
+        return ReportError(EINVAL, "ApplyProfile() - unsupported version %i", int(header->version));
+    const size_t count = size_t(header->registersCount[0]) + header->registersCount[1];
+    if (length < sizeof(ProfileHeader) + count*sizeof(ProfileRegister))
+        return ReportError(EINVAL, "ApplyProfile() - truncated image");
+    const ProfileRegister* registers = (const ProfileRegister*)(header+1);
+
+    vector<uint16_t> addrToWrite;
+    vector<uint16_t> dataToWrite;
+    const uint16_t x0020_value = mRegistersMap->GetValue(0, 0x0020);
+    bool mcuRegistersChanged = false;
+    for (uint8_t ch = 0; ch < 2; ++ch)
+    {
+        bool macSelected = false;
+        for (uint32_t i = 0; i < header->registersCount[ch]; ++i, ++registers)
+        {
+            if (!IsProfileRegister(registers->address) || registers->value == mRegistersMap->GetValue(ch, registers->address))
+                continue;
+            if (!macSelected) //select channel only when it has changes
+            {
+                addrToWrite.push_back(0x0020);
+                dataToWrite.push_back((x0020_value & ~0x0003) | (ch+1));
+                macSelected = true;
+            }
+            addrToWrite.push_back(registers->address);
+            dataToWrite.push_back(registers->value);
+            if (registers->address < 0x0007)
+                mcuRegistersChanged = true;
+        }
+    }
+    if (!addrToWrite.empty() || header->x0020_value != x0020_value)
+    {
+        addrToWrite.push_back(0x0020);
+        dataToWrite.push_back(header->x0020_value);
+    }
+
+    if (!addrToWrite.empty())
+    {
+        int status = SPI_write_batch(addrToWrite.data(), dataToWrite.data(), addrToWrite.size());
+        if (mcuRegistersChanged)
+            mcuControl->InvalidateProgramState(); //MCU control registers are rewritten
+        if (status != 0)
+            return status;
+    }
+
+    if (header->refClkSXR != GetReferenceClk_SX(Rx))
+        SetReferenceClk_SX(Rx, header->refClkSXR);
+    if (header->refClkSXT != GetReferenceClk_SX(Tx))
+        SetReferenceClk_SX(Tx, header->refClkSXT);
+    for (int i = 0; i < 2; ++i)
+    {
+        const ProfileCalibration& cal = header->calibration[i];
+        mCalibrationResult[i].valid = cal.valid != 0;
+        mCalibrationResult[i].dcI = cal.dcI;
+        mCalibrationResult[i].dcQ = cal.dcQ;
+        mCalibrationResult[i].gainI = cal.gainI;
+        mCalibrationResult[i].gainQ = cal.gainQ;
+        mCalibrationResult[i].phase = cal.phase;
+    }
+    return 0;
+}
+
 int LMS7002M::SetRBBPGA_dB(const float_type value)
 {
     int g_pga_rbb = (int)(value + 12.5);
@@ -1071,7 +1273,6 @@ int LMS7002M::SetFrequencyCGEN(const float_type freq_Hz, const bool retainNCOfre
     stringstream ss;
     LMS7002M_SelfCalState state(this);
     float_type dFvco;
-    float_type dFrac;
     int16_t iHdiv;
 
     //remember NCO frequencies
@@ -1093,24 +1294,13 @@ int LMS7002M::SetFrequencyCGEN(const float_type freq_Hz, const bool retainNCOfre
                 txNCO[ch].push_back(GetNCOFrequency(LMS7002M::Tx, i, false));
         }
     }
-    //VCO frequency selection according to F_CLKH
-    vector<float_type> vcoFreqs;
-    for (iHdiv = 0; iHdiv < 256; ++iHdiv)
-    {
-        dFvco = 2 * (iHdiv + 1) * freq_Hz;
-        if (dFvco >= gCGEN_VCO_frequencies[0] && dFvco <= gCGEN_VCO_frequencies[1])
-            vcoFreqs.push_back(dFvco);
-    }
-    if (vcoFreqs.size() == 0)
-        return ReportError(ERANGE, "SetFrequencyCGEN(%g MHz) - cannot deliver requested frequency", freq_Hz / 1e6);
-    dFvco = vcoFreqs[vcoFreqs.size() / 2];
-    iHdiv = dFvco / freq_Hz / 2 - 1;
-    //Integer division
-    uint16_t gINT = (uint16_t)(dFvco/GetReferenceClk_SX(Rx) - 1);
-
-    //Fractional division
-    dFrac = dFvco/GetReferenceClk_SX(Rx) - (uint32_t)(dFvco/GetReferenceClk_SX(Rx));
-    uint32_t gFRAC = (uint32_t)(dFrac * 1048576);
+    CGEN_details cgen;
+    if (CalculateCGEN(freq_Hz, cgen) != 0)
+        return -1;
+    dFvco = cgen.frequencyVCO;
+    iHdiv = cgen.div_outch_cgen;
+    uint16_t gINT = cgen.INT;
+    uint32_t gFRAC = cgen.FRAC;
 
     Modify_SPI_Reg_bits(LMS7param(INT_SDM_CGEN), gINT); //INT_SDM_CGEN
     Modify_SPI_Reg_bits(0x0087, 15, 0, gFRAC&0xFFFF); //INT_SDM_CGEN[15:0]
@@ -1156,7 +1346,7 @@ int LMS7002M::SetFrequencyCGEN(const float_type freq_Hz, const bool retainNCOfre
 #endif // NDEBUG
         }
     }
-    if(TuneVCO(VCO_CGEN) != 0)
+    if(TuneCGEN(dFvco) != 0)
     {
         if (output)
         {
@@ -1171,6 +1361,64 @@ int LMS7002M::SetFrequencyCGEN(const float_type freq_Hz, const bool retainNCOfre
     return 0;
 }
 
+/** @brief Selects CGEN VCO frequency and divider values for given output frequency
+    @param freq_Hz desired CGEN frequency in Hz
+    @param cgen calculated VCO frequency and INT, FRAC, DIV_OUTCH_CGEN values
+    @return 0-success, other-cannot deliver desired frequency
+*/
+int LMS7002M::CalculateCGEN(const float_type freq_Hz, CGEN_details& cgen)
+{
+    //VCO frequency selection according to F_CLKH
+    vector<float_type> vcoFreqs;
+    for (int iHdiv = 0; iHdiv < 256; ++iHdiv)
+    {
+        float_type dFvco = 2 * (iHdiv + 1) * freq_Hz;
+        if (dFvco >= gCGEN_VCO_frequencies[0] && dFvco <= gCGEN_VCO_frequencies[1])
+            vcoFreqs.push_back(dFvco);
+    }
+    if (vcoFreqs.size() == 0)
+        return ReportError(ERANGE, "SetFrequencyCGEN(%g MHz) - cannot deliver requested frequency", freq_Hz / 1e6);
+    const float_type refClk = GetReferenceClk_SX(Rx);
+    cgen.frequencyVCO = vcoFreqs[vcoFreqs.size() / 2];
+    cgen.referenceClock = refClk;
+    cgen.div_outch_cgen = cgen.frequencyVCO / freq_Hz / 2 - 1;
+    //Integer division
+    cgen.INT = (uint16_t)(cgen.frequencyVCO/refClk - 1);
+    //Fractional division
+    const float_type dFrac = cgen.frequencyVCO/refClk - (uint32_t)(cgen.frequencyVCO/refClk);
+    cgen.FRAC = (uint32_t)(dFrac * 1048576);
+    //frequency actually delivered, as GetFrequencyCGEN() reports it
+    cgen.frequency = (refClk/2.0)/(cgen.div_outch_cgen+1) * (cgen.INT + 1 + cgen.FRAC/1048576.0);
+    cgen.csw = 0;
+    cgen.success = true;
+    return 0;
+}
+
+/** @brief Tunes CGEN VCO, first trying CSW value remembered for the same VCO
+    frequency, full search is done only if VCO does not lock with it
+    @param frequencyVCO currently configured VCO frequency
+    @return 0-success, other-failure
+*/
+int LMS7002M::TuneCGEN(const float_type frequencyVCO)
+{
+    const uint64_t key = (uint64_t)(frequencyVCO + 0.5);
+    auto iter = mCGENTuneCache.find(key);
+    if (iter != mCGENTuneCache.end())
+    {
+        if (Get_SPI_Reg_bits(LMS7param(CSW_VCO_CGEN)) != iter->second)
+            Modify_SPI_Reg_bits(LMS7param(CSW_VCO_CGEN), iter->second);
+        this_thread::sleep_for(chrono::microseconds(50)); //VCO settling
+        if (GetCGENLocked())
+            return 0;
+    }
+    int status = TuneVCO(VCO_CGEN);
+    if (status == 0)
+        mCGENTuneCache[key] = Get_SPI_Reg_bits(LMS7param(CSW_VCO_CGEN));
+    else
+        mCGENTuneCache.erase(key);
+    return status;
+}
+
 bool LMS7002M::GetCGENLocked(void)
 {
     return (Get_SPI_Reg_bits(LMS7param(VCO_CMPHO_CGEN).address, 13, 12, true) & 0x3) == 2;
@@ -1410,59 +1658,37 @@ int LMS7002M::SetFrequencySX(bool tx, float_type freq_Hz, SX_details* output)
     stringstream ss; //VCO tuning report
     const char* vcoNames[] = {"VCOL", "VCOM", "VCOH"};
     checkConnection();
-    const uint8_t sxVCO_N = 2; //number of entries in VCO frequencies
-    const float_type m_dThrF = 5500e6; //threshold to enable additional divider
-    float_type VCOfreq;
-    int8_t div_loch;
     int8_t sel_vco;
     bool canDeliverFrequency = false;
-    uint16_t integerPart;
-    uint32_t fractionalPart;
     int16_t csw_value;
+    SX_details sx;
+    int status = CalculateSX(tx, freq_Hz, sx);
+    if (status != 0)
+        return status;
     uint32_t boardId = controlPort->GetDeviceInfo().boardSerialNumber;
 
-    //find required VCO frequency
-    for (div_loch = 6; div_loch >= 0; --div_loch)
-    {
-        VCOfreq = (1 << (div_loch + 1)) * freq_Hz;
-        if ((VCOfreq >= gVCO_frequency_table[0][0]) && (VCOfreq <= gVCO_frequency_table[2][sxVCO_N - 1]))
-        {
-            canDeliverFrequency = true;
-            break;
-        }
-    }
-    if (canDeliverFrequency == false)
-        return ReportError(ERANGE, "SetFrequencySX%s(%g MHz) - required VCO frequency is out of range [%g-%g] MHz",
-                            tx?"T":"R", freq_Hz / 1e6,
-                            gVCO_frequency_table[0][0]/1e6,
-                            gVCO_frequency_table[2][sxVCO_N - 1]/1e6);
-
-    const float_type refClk_Hz = GetReferenceClk_SX(tx);
-    integerPart = (uint16_t)(VCOfreq / (refClk_Hz * (1 + (VCOfreq > m_dThrF))) - 4);
-    fractionalPart = (uint32_t)((VCOfreq / (refClk_Hz * (1 + (VCOfreq > m_dThrF))) - (uint32_t)(VCOfreq / (refClk_Hz * (1 + (VCOfreq > m_dThrF))))) * 1048576);
-
     Channel ch = this->GetActiveChannel();
     this->SetActiveChannel(tx?ChSXT:ChSXR);
     Modify_SPI_Reg_bits(LMS7param(EN_INTONLY_SDM), 0);
-    Modify_SPI_Reg_bits(LMS7param(INT_SDM), integerPart); //INT_SDM
-    Modify_SPI_Reg_bits(0x011D, 15, 0, fractionalPart & 0xFFFF); //FRAC_SDM[15:0]
-    Modify_SPI_Reg_bits(0x011E, 3, 0, (fractionalPart >> 16)); //FRAC_SDM[19:16]
-    Modify_SPI_Reg_bits(LMS7param(DIV_LOCH), div_loch); //DIV_LOCH
-    Modify_SPI_Reg_bits(LMS7param(EN_DIV2_DIVPROG), (VCOfreq > m_dThrF)); //EN_DIV2_DIVPROG
+    Modify_SPI_Reg_bits(LMS7param(INT_SDM), sx.INT); //INT_SDM
+    Modify_SPI_Reg_bits(0x011D, 15, 0, sx.FRAC & 0xFFFF); //FRAC_SDM[15:0]
+    Modify_SPI_Reg_bits(0x011E, 3, 0, (sx.FRAC >> 16)); //FRAC_SDM[19:16]
+    Modify_SPI_Reg_bits(LMS7param(DIV_LOCH), sx.div_loch); //DIV_LOCH
+    Modify_SPI_Reg_bits(LMS7param(EN_DIV2_DIVPROG), sx.en_div2_divprog); //EN_DIV2_DIVPROG
 
-    ss << "INT: " << integerPart << "\tFRAC: " << fractionalPart << endl;
-    ss << "DIV_LOCH: " << (int16_t)div_loch << "\t EN_DIV2_DIVPROG: " << (VCOfreq > m_dThrF) << endl;
-    ss << "VCO: " << VCOfreq/1e6 << "MHz\tRefClk: " << refClk_Hz/1e6 << " MHz" << endl;
+    ss << "INT: " << sx.INT << "\tFRAC: " << sx.FRAC << endl;
+    ss << "DIV_LOCH: " << (int16_t)sx.div_loch << "\t EN_DIV2_DIVPROG: " << sx.en_div2_divprog << endl;
+    ss << "VCO: " << sx.frequencyVCO/1e6 << "MHz\tRefClk: " << sx.referenceClock/1e6 << " MHz" << endl;
 
     if (output)
     {
         output->frequency = freq_Hz;
-        output->frequencyVCO = VCOfreq;
-        output->referenceClock = GetReferenceClk_SX(tx);
-        output->INT = integerPart;
-        output->FRAC = fractionalPart;
-        output->en_div2_divprog = (VCOfreq > m_dThrF);
-        output->div_loch = div_loch;
+        output->frequencyVCO = sx.frequencyVCO;
+        output->referenceClock = sx.referenceClock;
+        output->INT = sx.INT;
+        output->FRAC = sx.FRAC;
+        output->en_div2_divprog = sx.en_div2_divprog;
+        output->div_loch = sx.div_loch;
     }
 
     //find which VCO supports required frequency
@@ -1489,7 +1715,7 @@ int LMS7002M::SetFrequencySX(bool tx, float_type freq_Hz, SX_details* output)
         for (sel_vco = 0; sel_vco < 3; ++sel_vco)
         {
             Modify_SPI_Reg_bits(LMS7param(SEL_VCO), sel_vco);
-            int status = TuneVCO(tx ? VCO_SXT : VCO_SXR);
+            status = TuneVCO(tx ? VCO_SXT : VCO_SXR);
             if(status == 0)
             {
                 tuneScore[sel_vco] = -128 + Get_SPI_Reg_bits(LMS7param(CSW_VCO), true);
@@ -1626,6 +1852,60 @@ float_type LMS7002M::GetFrequencySX(bool tx)
 	return dMul;
 }
 
+/** @brief Returns frequency SXR/SXT would synthesize for requested one, without tuning
+    @param tx Rx/Tx module selection
+    @param freq_Hz requested frequency
+    @return frequency Hz as returned by GetFrequencySX() after SetFrequencySX(), 0 if out of range
+*/
+float_type LMS7002M::GetSynthesizedFrequencySX(bool tx, float_type freq_Hz)
+{
+    SX_details sx;
+    if (CalculateSX(tx, freq_Hz, sx) != 0)
+        return 0;
+    return sx.frequency;
+}
+
+/** @brief Selects SX VCO frequency, divider and SDM values for given output frequency
+    @param tx Rx/Tx module selection
+    @param freq_Hz desired SX frequency in Hz
+    @param sx calculated VCO frequency and INT, FRAC, DIV_LOCH, EN_DIV2_DIVPROG values
+    @return 0-success, other-cannot deliver desired frequency
+*/
+int LMS7002M::CalculateSX(bool tx, const float_type freq_Hz, SX_details& sx)
+{
+    const uint8_t sxVCO_N = 2; //number of entries in VCO frequencies
+    const float_type m_dThrF = 5500e6; //threshold to enable additional divider
+    //find required VCO frequency
+    int8_t div_loch;
+    float_type VCOfreq = 0;
+    for (div_loch = 6; div_loch >= 0; --div_loch)
+    {
+        VCOfreq = (1 << (div_loch + 1)) * freq_Hz;
+        if ((VCOfreq >= gVCO_frequency_table[0][0]) && (VCOfreq <= gVCO_frequency_table[2][sxVCO_N - 1]))
+            break;
+    }
+    if (div_loch < 0)
+        return ReportError(ERANGE, "SetFrequencySX%s(%g MHz) - required VCO frequency is out of range [%g-%g] MHz",
+                            tx?"T":"R", freq_Hz / 1e6,
+                            gVCO_frequency_table[0][0]/1e6,
+                            gVCO_frequency_table[2][sxVCO_N - 1]/1e6);
+
+    const float_type refClk_Hz = GetReferenceClk_SX(tx);
+    sx.frequencyVCO = VCOfreq;
+    sx.referenceClock = refClk_Hz;
+    sx.div_loch = div_loch;
+    sx.en_div2_divprog = (VCOfreq > m_dThrF);
+    const float_type ratio = VCOfreq / (refClk_Hz * (1 + sx.en_div2_divprog));
+    sx.INT = (uint16_t)(ratio - 4);
+    sx.FRAC = (uint32_t)((ratio - (uint32_t)ratio) * 1048576);
+    //frequency actually delivered, as GetFrequencySX() reports it
+    sx.frequency = refClk_Hz / (1 << (div_loch + 1)) * (sx.INT + 4 + sx.FRAC / 1048576.0) * (sx.en_div2_divprog + 1);
+    sx.sel_vco = 0;
+    sx.csw = 0;
+    sx.success = true;
+    return 0;
+}
+
 /** @brief Sets chosen NCO's frequency
     @param tx transmitter or receiver selection
     @param index NCO index from 0 to 15
@@ -1744,6 +2024,48 @@ int LMS7002M::SetGFIRCoefficients(bool tx, uint8_t GFIR_index, const int16_t *co
     return 0;
 }
 
+/** @brief Configures all three GFIRs in single SPI batch
+    @param tx Transmitter or receiver selection
+    @param L GFIR*_L parameter used for all filters
+    @param N GFIR*_N parameter (clock division) used for all filters
+    @param gfir12Coef 40 coefficients loaded into GFIR1 and GFIR2
+    @param gfir3Coef 120 coefficients loaded into GFIR3
+    @return 0-success, other-failure
+*/
+int LMS7002M::SetGFIRFilters(bool tx, uint8_t L, uint8_t N, const int16_t *gfir12Coef, const int16_t *gfir3Coef)
+{
+    checkConnection();
+    const uint16_t cfgAddr = tx ? LMS7param(GFIR1_L_TXTSP).address : LMS7param(GFIR1_L_RXTSP).address;
+    const uint16_t offset = tx ? 0 : 0x0200;
+    uint16_t addrs[3+40+40+120];
+    uint16_t values[3+40+40+120];
+    for (int i = 0; i < 3; ++i)
+        addrs[i] = cfgAddr + i;
+    int status = SPI_read_batch(addrs, values, 3);
+    if (status != 0)
+        return status;
+    for (int i = 0; i < 3; ++i)
+        values[i] = (values[i] & ~0x07FF) | ((L & 0x7) << 8) | N;
+
+    int cnt = 3;
+    for (int i = 0; i < 40; ++i, ++cnt)
+    {
+        addrs[cnt] = 0x0280 + offset + i;
+        values[cnt] = gfir12Coef[i];
+    }
+    for (int i = 0; i < 40; ++i, ++cnt)
+    {
+        addrs[cnt] = 0x02C0 + offset + i;
+        values[cnt] = gfir12Coef[i];
+    }
+    for (int i = 0; i < 120; ++i, ++cnt)
+    {
+        addrs[cnt] = 0x0300 + offset + i + 24 * (i / 40);
+        values[cnt] = gfir3Coef[i];
+    }
+    return SPI_write_batch(addrs, values, cnt);
+}
+
 /** @brief Returns currently loaded FIR coefficients
     @param tx Transmitter or receiver selection
     @param GFIR_index GIR index from 0 to 2
@@ -1864,7 +2186,15 @@ uint16_t LMS7002M::SPI_read(uint16_t address, bool fromChip, int *status)
 int LMS7002M::SPI_write_batch(const uint16_t* spiAddr, const uint16_t* spiData, uint16_t cnt)
 {
     int mac = mRegistersMap->GetValue(0, LMS7param(MAC).address) & 0x0003;
-    std::vector<uint32_t> data(cnt);
+    //typical batches fit on stack, only large configuration uploads allocate
+    uint32_t stackData[spiBatchStackSize];
+    std::vector<uint32_t> heapData;
+    uint32_t* data = stackData;
+    if (cnt > spiBatchStackSize)
+    {
+        heapData.resize(cnt);
+        data = heapData.data();
+    }
     for (size_t i = 0; i < cnt; ++i)
     {
         data[i] = (1 << 31) | (uint32_t(spiAddr[i]) << 16) | spiData[i]; //msbit 1=SPI write
@@ -1883,7 +2213,7 @@ int LMS7002M::SPI_write_batch(const uint16_t* spiAddr, const uint16_t* spiData,
     }
 
     checkConnection();
-    return controlPort->WriteLMS7002MSPI(data.data(), cnt,mdevIndex);
+    return controlPort->WriteLMS7002MSPI(data, cnt,mdevIndex);
 }
 
 /** @brief Batches multiple register reads into least amount of transactions
@@ -1896,15 +2226,22 @@ int LMS7002M::SPI_read_batch(const uint16_t* spiAddr, uint16_t* spiData, uint16_
 {
     checkConnection();
 
-    std::vector<uint32_t> dataWr(cnt);
-    std::vector<uint32_t> dataRd(cnt);
+    uint32_t stackData[2*spiBatchStackSize];
+    std::vector<uint32_t> heapData;
+    uint32_t* dataWr = stackData;
+    if (cnt > spiBatchStackSize)
+    {
+        heapData.resize(2*cnt);
+        dataWr = heapData.data();
+    }
+    uint32_t* dataRd = dataWr + cnt;
     for (size_t i = 0; i < cnt; ++i)
     {
         dataWr[i] = (uint32_t(spiAddr[i]) << 16);
     }
 
 
-    int status = controlPort->ReadLMS7002MSPI(dataWr.data(), dataRd.data(), cnt,mdevIndex);
+    int status = controlPort->ReadLMS7002MSPI(dataWr, dataRd, cnt,mdevIndex);
     if (status != 0) return status;
 
     int mac = mRegistersMap->GetValue(0, LMS7param(MAC).address) & 0x0003;
@@ -2229,6 +2566,7 @@ isSyncedEnding:
 int LMS7002M::UploadAll()
 {
     checkConnection();
+    mcuControl->InvalidateProgramState(); //MCU control registers are rewritten
 
     Channel ch = this->GetActiveChannel(); //remember used channel
 
@@ -2376,6 +2714,158 @@ int LMS7002M::SetInterfaceFrequency(float_type cgen_freq_Hz, const uint8_t inter
     return status;
 }
 
+/** @brief Configures CGEN, TSP clock dividers and interpolation/decimation of
+    both channels. Target register values are derived from the register cache
+    and only the differing registers are written, in a single SPI batch.
+    CGEN VCO is tuned when the synthesizer settings change or CGEN is found
+    unlocked.
+    @param plan interface clocking to apply
+    @param retainNCOfrequencies recalculate NCO coefficients to keep currently set frequencies
+    @param output if not null outputs calculated CGEN parameters
+    @return 0-success, other-failure
+*/
+int LMS7002M::ApplyClockPlan(const ClockPlan& plan, const bool retainNCOfrequencies, CGEN_details* output)
+{
+    CGEN_details cgen;
+    if (CalculateCGEN(plan.cgenFrequency, cgen) != 0)
+        return -1;
+    if (output)
+        *output = cgen;
+
+    //target register values, keyed by channel and address
+    map<uint32_t, uint16_t> target;
+    auto setBits = [&](const uint8_t ch, const LMS7Parameter& param, const uint16_t value)
+    {
+        const uint32_t key = (uint32_t(ch) << 16) | param.address;
+        auto iter = target.find(key);
+        if (iter == target.end())
+            iter = target.insert(make_pair(key, mRegistersMap->GetValue(ch, param.address))).first;
+        const uint16_t mask = (~(~0u << (param.msb - param.lsb + 1))) << param.lsb;
+        iter->second = (iter->second & ~mask) | ((value << param.lsb) & mask);
+    };
+
+    static const LMS7Parameter fracLow = { 0x0087, 15, 0, 0, "FRAC_SDM_CGEN[15:0]", "" };
+    static const LMS7Parameter fracHigh = { 0x0088, 3, 0, 0, "FRAC_SDM_CGEN[19:16]", "" };
+    const bool synthChanged = Get_SPI_Reg_bits(LMS7param(INT_SDM_CGEN)) != cgen.INT
+        || Get_SPI_Reg_bits(fracLow) != (cgen.FRAC & 0xFFFF)
+        || Get_SPI_Reg_bits(fracHigh) != (cgen.FRAC >> 16)
+        || Get_SPI_Reg_bits(LMS7param(DIV_OUTCH_CGEN)) != cgen.div_outch_cgen;
+    //NCO frequencies depend on TSP clock, which is also divided by clkDiv and selected by clkMux
+    const bool tspClockChanged = synthChanged
+        || Get_SPI_Reg_bits(LMS7param(EN_ADCCLKH_CLKGN)) != plan.clkMux
+        || Get_SPI_Reg_bits(LMS7param(CLKH_OV_CLKL_CGEN)) != plan.clkDiv;
+    setBits(0, LMS7param(INT_SDM_CGEN), cgen.INT);
+    setBits(0, fracLow, cgen.FRAC & 0xFFFF);
+    setBits(0, fracHigh, cgen.FRAC >> 16);
+    setBits(0, LMS7param(DIV_OUTCH_CGEN), cgen.div_outch_cgen);
+    auto csw = mCGENTuneCache.find((uint64_t)(cgen.frequencyVCO + 0.5));
+    if (synthChanged && csw != mCGENTuneCache.end())
+        setBits(0, LMS7param(CSW_VCO_CGEN), csw->second);
+    //adjust VCO bias current to lock on 491.52 MHz
+    if (abs(plan.cgenFrequency - 491.52e6) < 2e6)
+        setBits(0, LMS7param(ICT_VCO_CGEN), 31);
+    setBits(0, LMS7param(EN_ADCCLKH_CLKGN), plan.clkMux);
+    setBits(0, LMS7param(CLKH_OV_CLKL_CGEN), plan.clkDiv);
+    for (uint8_t ch = 0; ch < 2; ++ch)
+    {
+        setBits(ch, LMS7param(HBD_OVR_RXTSP), plan.decimation);
+        setBits(ch, LMS7param(HBI_OVR_TXTSP), plan.interpolation);
+    }
+
+    //interface clock dividers, as in SetInterfaceFrequency()
+    const uint16_t mclk2src = Get_SPI_Reg_bits(LMS7param(MCLK2SRC)) & 1;
+    if (plan.decimation == 7 || plan.decimation == 0) //bypass
+    {
+        setBits(0, LMS7param(RXTSPCLKA_DIV), 0);
+        setBits(0, LMS7param(RXDIVEN), false);
+        setBits(0, LMS7param(MCLK2SRC), mclk2src | 0x2);
+    }
+    else
+    {
+        setBits(0, LMS7param(RXTSPCLKA_DIV), (1 << plan.decimation) / 2 - 1);
+        setBits(0, LMS7param(RXDIVEN), true);
+        setBits(0, LMS7param(MCLK2SRC), mclk2src);
+    }
+    const uint16_t mclk1src = Get_SPI_Reg_bits(LMS7param(MCLK1SRC)) & 1;
+    if (plan.interpolation == 7 || plan.interpolation == 0) //bypass
+    {
+        setBits(0, LMS7param(TXTSPCLKA_DIV), 0);
+        setBits(0, LMS7param(TXDIVEN), false);
+        setBits(0, LMS7param(MCLK1SRC), mclk1src | 0x2);
+    }
+    else
+    {
+        setBits(0, LMS7param(TXTSPCLKA_DIV), (1 << plan.interpolation) / 2 - 1);
+        setBits(0, LMS7param(TXDIVEN), true);
+        setBits(0, LMS7param(MCLK1SRC), mclk1src);
+    }
+
+    //remember NCO frequencies, they depend on TSP clock frequency
+    Channel chBck = this->GetActiveChannel(false);
+    vector<vector<float_type> > rxNCO(2);
+    vector<vector<float_type> > txNCO(2);
+    const bool rxModeNCO = Get_SPI_Reg_bits(LMS7param(MODE_RX));
+    const bool txModeNCO = Get_SPI_Reg_bits(LMS7param(MODE_TX));
+    for (int ch = 0; ch < 2 && retainNCOfrequencies && tspClockChanged; ++ch)
+    {
+        this->SetActiveChannel((ch == 0)?ChA:ChB);
+        for (int i = 0; i < 16 && rxModeNCO == 0; ++i)
+            rxNCO[ch].push_back(GetNCOFrequency(LMS7002M::Rx, i, false));
+        for (int i = 0; i < 16 && txModeNCO == 0; ++i)
+            txNCO[ch].push_back(GetNCOFrequency(LMS7002M::Tx, i, false));
+    }
+    this->SetActiveChannel(chBck);
+
+    vector<uint16_t> addrToWrite;
+    vector<uint16_t> dataToWrite;
+    const uint16_t x0020_value = mRegistersMap->GetValue(0, 0x0020);
+    int macSelected = -1;
+    for (const auto& reg : target)
+    {
+        const uint8_t ch = reg.first >> 16;
+        const uint16_t address = reg.first & 0xFFFF;
+        if (reg.second == mRegistersMap->GetValue(ch, address))
+            continue;
+        if (address >= 0x0100 && macSelected != ch)
+        {
+            addrToWrite.push_back(0x0020);
+            dataToWrite.push_back((x0020_value & ~0x0003) | (ch+1));
+            macSelected = ch;
+        }
+        addrToWrite.push_back(address);
+        dataToWrite.push_back(reg.second);
+    }
+    //matching registers do not guarantee that CGEN is still locked
+    const bool relock = addrToWrite.empty() && !GetCGENLocked();
+    if (addrToWrite.empty() && !relock)
+        return 0;
+    LMS7002M_SelfCalState state(this);
+    if (!addrToWrite.empty())
+    {
+        if (macSelected >= 0)
+        {
+            addrToWrite.push_back(0x0020);
+            dataToWrite.push_back(x0020_value);
+        }
+        int status = SPI_write_batch(addrToWrite.data(), dataToWrite.data(), addrToWrite.size());
+        if (status != 0)
+            return status;
+    }
+
+    if ((synthChanged || relock) && TuneCGEN(cgen.frequencyVCO) != 0)
+        return ReportError(-1, "ApplyClockPlan(%g MHz) - CGEN tuning failed", plan.cgenFrequency/1e6);
+    for (int ch = 0; ch < 2 && retainNCOfrequencies && tspClockChanged; ++ch)
+    {
+        this->SetActiveChannel((ch == 0)?ChA:ChB);
+        for (int i = 0; i < 16 && rxModeNCO == 0; ++i)
+            SetNCOFrequency(LMS7002M::Rx, i, rxNCO[ch][i]);
+        for (int i = 0; i < 16 && txModeNCO == 0; ++i)
+            SetNCOFrequency(LMS7002M::Tx, i, txNCO[ch][i]);
+    }
+    this->SetActiveChannel(chBck);
+    return 0;
+}
+
 float_type LMS7002M::GetSampleRate(bool tx, Channel ch)
 {
     float_type interface_Hz;
@@ -2545,6 +3035,59 @@ bool LMS7002M::IsValuesCacheEnabled()
     return useCache;
 }
 
+void LMS7002M::SetCalibrationSeed(const bool tx, const CalibrationValues &seed)
+{
+    mCalibrationSeed[tx ? 1 : 0] = seed;
+}
+
+LMS7002M::CalibrationValues LMS7002M::GetCalibrationResult(const bool tx) const
+{
+    return mCalibrationResult[tx ? 1 : 0];
+}
+
+void LMS7002M::StoreCalibrationResult(const bool tx, const int dcI, const int dcQ, const int gainI, const int gainQ, const int phase, const bool valid)
+{
+    CalibrationValues &result = mCalibrationResult[tx ? 1 : 0];
+    result.dcI = dcI;
+    result.dcQ = dcQ;
+    result.gainI = gainI;
+    result.gainQ = gainQ;
+    result.phase = phase;
+    result.valid = valid;
+}
+
+int LMS7002M::StoreCalibrationValues(const bool tx, const CalibrationValues &values, const float_type freq_Hz)
+{
+    if(controlPort == nullptr)
+        return ReportError(ENODEV, "Device not connected");
+    if(not useCache)
+        return ReportError(EPERM, "Calibration values cache is disabled");
+
+    //same keys as used by CalibrateTx() and CalibrateRx() lookups
+    const uint32_t boardId = controlPort->GetDeviceInfo().boardSerialNumber;
+    const uint8_t channel = Get_SPI_Reg_bits(LMS7param(MAC)) == 1 ? 0 : 1;
+    const double freq = GetSynthesizedFrequencySX(tx, freq_Hz);
+    if(freq <= 0)
+        return ReportError(ERANGE, "StoreCalibrationValues(%g MHz) - frequency is out of SX range", freq_Hz/1e6);
+    int band_lna;
+    if(tx)
+        band_lna = Get_SPI_Reg_bits(LMS7param(SEL_BAND1_TRF)) ? 0 : 1;
+    else
+        band_lna = Get_SPI_Reg_bits(LMS7param(SEL_PATH_RFE));
+    return mValueCache->InsertDC_IQ(boardId, freq, channel, tx, band_lna,
+        values.dcI, values.dcQ, values.gainI, values.gainQ, values.phase);
+}
+
+int LMS7002M::BeginValuesCacheBatch()
+{
+    return mValueCache->BeginBatch();
+}
+
+int LMS7002M::EndValuesCacheBatch()
+{
+    return mValueCache->EndBatch();
+}
+
 MCU_BD* LMS7002M::GetMCUControls() const
 {
     return mcuControl;
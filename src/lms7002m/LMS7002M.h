@@ -14,6 +14,7 @@
 #include <stdarg.h>
 #include <functional>
 #include <vector>
+#include <map>
 
 namespace lime{
 class IConnection;
@@ -145,6 +146,15 @@ public:
 
 	int LoadConfig(const char* filename);
 	int SaveConfig(const char* filename);
+
+    /*!
+     * Binary register images for fast switching between configurations.
+     * Applying a profile writes only registers that differ from the
+     * cached register values, so the cache has to match the chip.
+     */
+    int SaveProfile(const char* filename);
+    int LoadProfile(const char* filename);
+    int ApplyProfile(const void* image, const size_t length);
     ///@}
 
     ///@name Registers writing and reading
@@ -154,6 +164,8 @@ public:
     int Modify_SPI_Reg_bits(uint16_t address, uint8_t msb, uint8_t lsb, uint16_t value, bool fromChip = false);
     int SPI_write(uint16_t address, uint16_t data);
     uint16_t SPI_read(uint16_t address, bool fromChip = false, int *status = 0);
+    int SPI_write_batch(const uint16_t* spiAddr, const uint16_t* spiData, uint16_t cnt);
+    int SPI_read_batch(const uint16_t* spiAddr, uint16_t* spiData, uint16_t cnt);
     int RegistersTest(const char* fileName = "registersTest.txt");
     ///@}
 
@@ -169,6 +181,45 @@ public:
     ///@name Transmitter, Receiver calibrations
     int CalibrateRx(float_type bandwidth, const bool useExtLoopback = false);
     int CalibrateTx(float_type bandwidth, const bool useExtLoopback = false);
+
+    ///DC/IQ correction values found by a Tx or Rx calibration
+    struct CalibrationValues
+    {
+        CalibrationValues() : valid(false), dcI(0), dcQ(0), gainI(2047), gainQ(2047), phase(0){};
+        bool valid;
+        int dcI;
+        int dcQ;
+        int gainI;
+        int gainQ;
+        int phase;
+    };
+
+    /*!
+     * Seed the next PC based Tx or Rx calibration with a previous result.
+     * The DC and IQ searches are narrowed around the seed values and
+     * fall back to the full range when the result hits the window edge.
+     * The seed is consumed by the next calibration of that direction.
+     * @param tx true for Tx, false for Rx
+     * @param seed values to start from, invalid seed clears it
+     */
+    void SetCalibrationSeed(const bool tx, const CalibrationValues &seed);
+
+    /*!
+     * Get the values applied by the last Tx or Rx calibration,
+     * including the values loaded from the calibration cache.
+     */
+    CalibrationValues GetCalibrationResult(const bool tx) const;
+
+    /*!
+     * Store correction values into the calibration cache for the
+     * active channel and selected RF path. The LO is not retuned,
+     * the entry is keyed by the frequency SX would synthesize for freq_Hz.
+     */
+    int StoreCalibrationValues(const bool tx, const CalibrationValues &values, const float_type freq_Hz);
+
+    ///Group calibration cache writes into a single transaction
+    int BeginValuesCacheBatch();
+    int EndValuesCacheBatch();
     ///@}
 
     ///@name Filters tuning
@@ -294,6 +345,7 @@ public:
     int SetFrequencyCGEN(float_type freq_Hz, const bool retainNCOfrequencies = false, CGEN_details* output = nullptr);
 	bool GetCGENLocked(void);
 	float_type GetFrequencySX(bool tx);
+    float_type GetSynthesizedFrequencySX(bool tx, float_type freq_Hz);
     int SetFrequencySX(bool tx, float_type freq_Hz, SX_details* output = nullptr);
     int SetFrequencySXWithSpurCancelation(bool tx, float_type freq_Hz, float_type BW);
 	bool GetSXLocked(bool tx);
@@ -313,12 +365,28 @@ public:
 	int SetNCOPhaseOffset(bool tx, uint8_t index, float_type angle_Deg);
 	float_type GetNCOPhaseOffset_Deg(bool tx, uint8_t index);
 	int SetGFIRCoefficients(bool tx, uint8_t GFIR_index, const int16_t *coef, uint8_t coefCount);
+	int SetGFIRFilters(bool tx, uint8_t L, uint8_t N, const int16_t *gfir12Coef, const int16_t *gfir3Coef);
 	int GetGFIRCoefficients(bool tx, uint8_t GFIR_index, int16_t *coef, uint8_t coefCount);
     float_type GetReferenceClk_TSP(bool tx);
     ///@}
 
     int SetInterfaceFrequency(float_type cgen_freq_Hz, const uint8_t interpolation, const uint8_t decimation);
 
+    /*!
+     * LimeLight interface clocking, computed on host and applied at once
+     * with ApplyClockPlan(). Only registers which differ from the cached
+     * values are written.
+     */
+    struct ClockPlan
+    {
+        float_type cgenFrequency;
+        uint8_t clkMux; //!< EN_ADCCLKH_CLKGN
+        uint8_t clkDiv; //!< CLKH_OV_CLKL_CGEN
+        uint8_t interpolation; //!< HBI_OVR_TXTSP of both channels
+        uint8_t decimation; //!< HBD_OVR_RXTSP of both channels
+    };
+    int ApplyClockPlan(const ClockPlan& plan, const bool retainNCOfrequencies = false, CGEN_details* output = nullptr);
+
     //! Get the sample rate in Hz
     float_type GetSampleRate(bool tx, Channel ch);
 
@@ -432,13 +500,21 @@ protected:
     MCU_BD *mcuControl;
     bool useCache;
     CalibrationCache *mValueCache;
+    CalibrationValues mCalibrationSeed[2];
+    CalibrationValues mCalibrationResult[2];
     LMS7002M_RegistersMap *mRegistersMap;
+    std::map<uint64_t, uint16_t> mCGENTuneCache; //!< CSW_VCO_CGEN by VCO frequency
 
     static const uint16_t readOnlyRegisters[];
     static const uint16_t readOnlyRegistersMasks[];
+    static const uint16_t spiBatchStackSize = 64; //!< SPI batch length handled without heap buffers
 
 
     uint16_t MemorySectionAddresses[MEMORY_SECTIONS_COUNT][2];
+    int CalculateCGEN(float_type freq_Hz, CGEN_details& cgen);
+    int CalculateSX(bool tx, float_type freq_Hz, SX_details& sx);
+    int TuneCGEN(float_type frequencyVCO);
+
     ///@name Algorithms functions
     void BackupAllRegisters();
     void RestoreAllRegisters();
@@ -448,9 +524,11 @@ protected:
     void CalibrateRxDC();
     void AdjustAutoDC(const uint16_t address, bool tx);
     void CalibrateRxDCAuto();
-    void CalibrateTxDCAuto();
+    void CalibrateTxDCAuto(const CalibrationValues *seed = nullptr);
     void CalibrateTxDC(int16_t *dccorri, int16_t *dccorrq);
-    void CalibrateIQImbalance(const bool tx, uint16_t *gainI=nullptr, uint16_t *gainQ=nullptr, int16_t *phase=nullptr);
+    void CalibrateIQImbalance(const bool tx, uint16_t *gainI=nullptr, uint16_t *gainQ=nullptr, int16_t *phase=nullptr, const CalibrationValues *seed = nullptr);
+    //! Fills result reported by GetCalibrationResult()
+    void StoreCalibrationResult(const bool tx, const int dcI, const int dcQ, const int gainI, const int gainQ, const int phase, const bool valid);
 
     int CalibrateTxSetup(const float_type bandwidth_Hz, const bool useExtLoopback);
     int CalibrateRxSetup(const float_type bandwidth_Hz, const bool useExtLoopback);
@@ -472,8 +550,6 @@ protected:
     int TuneTxFilterSetup(const float_type tx_lpf_IF);
 
     int RegistersTestInterval(uint16_t startAddr, uint16_t endAddr, uint16_t pattern, std::stringstream &ss);
-    int SPI_write_batch(const uint16_t* spiAddr, const uint16_t* spiData, uint16_t cnt);
-    int SPI_read_batch(const uint16_t* spiAddr, uint16_t* spiData, uint16_t cnt);
     int Modify_SPI_Reg_mask(const uint16_t *addr, const uint16_t *masks, const uint16_t *values, uint8_t start, uint8_t stop);
     ///@}
 
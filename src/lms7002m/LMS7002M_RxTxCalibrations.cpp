@@ -15,6 +15,7 @@
 #include <fstream>
 #include "dataTypes.h"
 #include <thread>
+#include <algorithm>
 #define LMS_VERBOSE_OUTPUT
 
 #include "LMS7002M_RegistersMap.h"
@@ -105,6 +106,86 @@ static const char cDashLine[] =
 
 using namespace lime;
 
+/*!
+ * Apply Tx analog DC correction values to channel (0-A, 1-B)
+ */
+static void WriteTxDCCorrection(LMS7002M *lms, const uint8_t channel, const int dcI, const int dcQ)
+{
+    if (channel == 0)
+    {
+        lms->Modify_SPI_Reg_bits(LMS7param(PD_DCDAC_TXA), 0);
+        lms->Modify_SPI_Reg_bits(LMS7param(DCWR_TXAI), 0);
+        lms->Modify_SPI_Reg_bits(LMS7param(DCWR_TXAI), 1);
+        lms->Modify_SPI_Reg_bits(LMS7param(DC_TXAI), int2txdcreg(dcI));
+        lms->Modify_SPI_Reg_bits(LMS7param(DCWR_TXAQ), 0);
+        lms->Modify_SPI_Reg_bits(LMS7param(DCWR_TXAQ), 1);
+        lms->Modify_SPI_Reg_bits(LMS7param(DC_TXAQ), int2txdcreg(dcQ));
+    }
+    else
+    {
+        lms->Modify_SPI_Reg_bits(LMS7param(PD_DCDAC_TXB), 0);
+        lms->Modify_SPI_Reg_bits(LMS7param(DCWR_TXBI), 0);
+        lms->Modify_SPI_Reg_bits(LMS7param(DCWR_TXBI), 1);
+        lms->Modify_SPI_Reg_bits(LMS7param(DC_TXBI), int2txdcreg(dcI));
+        lms->Modify_SPI_Reg_bits(LMS7param(DCWR_TXBQ), 0);
+        lms->Modify_SPI_Reg_bits(LMS7param(DCWR_TXBQ), 1);
+        lms->Modify_SPI_Reg_bits(LMS7param(DC_TXBQ), int2txdcreg(dcQ));
+    }
+}
+
+/*!
+ * Read back Tx analog DC correction values of channel (0-A, 1-B)
+ */
+static void ReadTxDCCorrection(LMS7002M *lms, const uint8_t channel, int16_t &dcI, int16_t &dcQ)
+{
+    if (channel == 0)
+    {
+        lms->Modify_SPI_Reg_bits(LMS7param(DCRD_TXAI), 0);
+        lms->Modify_SPI_Reg_bits(LMS7param(DCRD_TXAI), 1);
+        dcI = txdcreg2int(lms->Get_SPI_Reg_bits(LMS7param(DC_TXAI), true));
+        lms->Modify_SPI_Reg_bits(LMS7param(DCRD_TXAQ), 0);
+        lms->Modify_SPI_Reg_bits(LMS7param(DCRD_TXAQ), 1);
+        dcQ = txdcreg2int(lms->Get_SPI_Reg_bits(LMS7param(DC_TXAQ), true));
+    }
+    else
+    {
+        lms->Modify_SPI_Reg_bits(LMS7param(DCRD_TXBI), 0);
+        lms->Modify_SPI_Reg_bits(LMS7param(DCRD_TXBI), 1);
+        dcI = txdcreg2int(lms->Get_SPI_Reg_bits(LMS7param(DC_TXBI), true));
+        lms->Modify_SPI_Reg_bits(LMS7param(DCRD_TXBQ), 0);
+        lms->Modify_SPI_Reg_bits(LMS7param(DCRD_TXBQ), 1);
+        dcQ = txdcreg2int(lms->Get_SPI_Reg_bits(LMS7param(DC_TXBQ), true));
+    }
+}
+
+/*!
+ * Convert sign magnitude Tx DC correction into the
+ * offset representation used by WriteAnalogDC()
+ */
+static inline int txdc2analog(const int value)
+{
+    return value < 0 ? -(1023 + value) : value;
+}
+
+/*!
+ * Narrow a search window around the seed, limited to the full search range
+ */
+static void seedWindow(BinSearchParam &args, const int seed, const int radius, const int minValue, const int maxValue)
+{
+    args.minValue = std::max(minValue, seed - radius);
+    args.maxValue = std::min(maxValue, seed + radius);
+}
+
+/*!
+ * Seeded search result is only trusted if it did not stop at the window edge,
+ * unless that edge is also the limit of the full search range
+ */
+static bool seedWindowHit(const BinSearchParam &args, const int minValue, const int maxValue)
+{
+    return (args.result <= args.minValue && args.minValue > minValue) ||
+           (args.result >= args.maxValue && args.maxValue < maxValue);
+}
+
 static const float_type calibUserBwDivider = 5;
 static const uint16_t MCU_PARAMETER_ADDRESS = 0x002D; //register used to pass parameter values to MCU
 
@@ -858,6 +939,10 @@ int LMS7002M::CalibrateTx(float_type bandwidth_Hz, bool useExtLoopback)
         return ReportError(ERANGE, "Frequency out of range, available range: %g-%g MHz", TrxCalib_RF_LimitLow / 1e6, TrxCalib_RF_LimitHigh / 1e6);
     if(controlPort == nullptr)
         return ReportError(EINVAL, "Device not connected");
+    //seed is used only by this calibration
+    const CalibrationValues seed = mCalibrationSeed[Tx];
+    mCalibrationSeed[Tx] = CalibrationValues();
+    mCalibrationResult[Tx] = CalibrationValues();
 #ifdef __cplusplus
     auto beginTime = std::chrono::high_resolution_clock::now();
 #endif
@@ -881,26 +966,7 @@ int LMS7002M::CalibrateTx(float_type bandwidth_Hz, bool useExtLoopback)
         bool foundInCache = (mValueCache->GetDC_IQ(boardId, txFreq, channel, true, band, &dcI, &dcQ, &gainI, &gainQ, &phOffset) == 0);
         if(foundInCache)
         {
-            if (channel == 0)
-            {
-                Modify_SPI_Reg_bits(LMS7param(PD_DCDAC_TXA), 0);
-                Modify_SPI_Reg_bits(LMS7param(DCWR_TXAI), 0);
-                Modify_SPI_Reg_bits(LMS7param(DCWR_TXAI), 1);
-                Modify_SPI_Reg_bits(LMS7param(DC_TXAI), int2txdcreg(dcI));
-                Modify_SPI_Reg_bits(LMS7param(DCWR_TXAQ), 0);
-                Modify_SPI_Reg_bits(LMS7param(DCWR_TXAQ), 1);
-                Modify_SPI_Reg_bits(LMS7param(DC_TXAQ), int2txdcreg(dcQ));
-            }
-            else
-            {
-                Modify_SPI_Reg_bits(LMS7param(PD_DCDAC_TXB), 0);
-                Modify_SPI_Reg_bits(LMS7param(DCWR_TXBI), 0);
-                Modify_SPI_Reg_bits(LMS7param(DCWR_TXBI), 1);
-                Modify_SPI_Reg_bits(LMS7param(DC_TXBI), int2txdcreg(dcI));
-                Modify_SPI_Reg_bits(LMS7param(DCWR_TXBQ), 0);
-                Modify_SPI_Reg_bits(LMS7param(DCWR_TXBQ), 1);
-                Modify_SPI_Reg_bits(LMS7param(DC_TXBQ), int2txdcreg(dcQ));
-            }
+            WriteTxDCCorrection(this, channel, dcI, dcQ);
             Modify_SPI_Reg_bits(LMS7param(GCORRI_TXTSP), gainI);
             Modify_SPI_Reg_bits(LMS7param(GCORRQ_TXTSP), gainQ);
             Modify_SPI_Reg_bits(LMS7param(IQCORR_TXTSP), phOffset);
@@ -912,6 +978,7 @@ int LMS7002M::CalibrateTx(float_type bandwidth_Hz, bool useExtLoopback)
             verbose_printf("I: | %3i | %4i | %i\n", dcI, gainI, phOffset);
             verbose_printf("Q: | %3i | %4i |\n", dcQ, gainQ);
             verbose_printf(cSquaresLine);
+            StoreCalibrationResult(Tx, dcI, dcQ, gainI, gainQ, phOffset, true);
             return 0;
         }
     }
@@ -948,16 +1015,9 @@ int LMS7002M::CalibrateTx(float_type bandwidth_Hz, bool useExtLoopback)
     auto registersBackup = BackupRegisterMap();
     if(mCalibrationByMCU && not useExtLoopback)
     {
-        uint8_t mcuID = mcuControl->ReadMCUProgramID();
-        verbose_printf("Current MCU firmware: %i, %s\n", mcuID,
-            mcuID == MCU_ID_CALIBRATIONS_SINGLE_IMAGE ? "DC/IQ calibration full":"unknown");
-        if(mcuID != MCU_ID_CALIBRATIONS_SINGLE_IMAGE)
-        {
-            verbose_printf("Uploading DC/IQ calibration firmware\n");
-            status = mcuControl->Program_MCU(mcu_program_lms7_dc_iq_calibration_bin, IConnection::MCU_PROG_MODE::SRAM);
-            if(status != 0)
-                return status;
-        }
+        status = mcuControl->EnsureProgram(mcu_program_lms7_dc_iq_calibration_bin, MCU_ID_CALIBRATIONS_SINGLE_IMAGE);
+        if(status != 0)
+            return status;
 
         //set reference clock parameter inside MCU
         long refClk = GetReferenceClk_SX(false);
@@ -976,24 +1036,7 @@ int LMS7002M::CalibrateTx(float_type bandwidth_Hz, bool useExtLoopback)
         for (int a = 0x05C0; a <= 0x05CC; a++) this->SPI_read(a, true);
 
         //need to read back calibration results
-        if (channel == 0)
-        {
-            Modify_SPI_Reg_bits(LMS7param(DCRD_TXAI), 0);
-            Modify_SPI_Reg_bits(LMS7param(DCRD_TXAI), 1);
-            dccorri = txdcreg2int(Get_SPI_Reg_bits(LMS7param(DC_TXAI)));
-            Modify_SPI_Reg_bits(LMS7param(DCRD_TXAQ), 0);
-            Modify_SPI_Reg_bits(LMS7param(DCRD_TXAQ), 1);
-            dccorrq = txdcreg2int(Get_SPI_Reg_bits(LMS7param(DC_TXAQ)));
-        }
-        else
-        {
-            Modify_SPI_Reg_bits(LMS7param(DCRD_TXBI), 0);
-            Modify_SPI_Reg_bits(LMS7param(DCRD_TXBI), 1);
-            dccorri = txdcreg2int(Get_SPI_Reg_bits(LMS7param(DC_TXBI)));
-            Modify_SPI_Reg_bits(LMS7param(DCRD_TXBQ), 0);
-            Modify_SPI_Reg_bits(LMS7param(DCRD_TXBQ), 1);
-            dccorrq = txdcreg2int(Get_SPI_Reg_bits(LMS7param(DC_TXBQ)));
-        }
+        ReadTxDCCorrection(this, channel, dccorri, dccorrq);
         gcorri = Get_SPI_Reg_bits(LMS7param(GCORRI_TXTSP));
         gcorrq = Get_SPI_Reg_bits(LMS7param(GCORRQ_TXTSP));
         phaseOffset = signextIqCorr(Get_SPI_Reg_bits(LMS7param(IQCORR_TXTSP)));
@@ -1001,6 +1044,7 @@ int LMS7002M::CalibrateTx(float_type bandwidth_Hz, bool useExtLoopback)
         if(useCache)
             mValueCache->InsertDC_IQ(boardId, txFreq, channel, true, band, dccorri, dccorrq, gcorri, gcorrq, phaseOffset);
 
+        StoreCalibrationResult(Tx, dccorri, dccorrq, gcorri, gcorrq, phaseOffset, status == 0);
         return status;
     }
 
@@ -1039,11 +1083,12 @@ int LMS7002M::CalibrateTx(float_type bandwidth_Hz, bool useExtLoopback)
     if(useExtLoopback == false)
         CalibrateRxDCAuto();
     SetNCOFrequency(LMS7002M::Rx, 0, calibrationSXOffset_Hz - offsetNCO + (bandwidth_Hz / calibUserBwDivider));
-    CalibrateTxDCAuto();
+    CalibrateTxDCAuto(seed.valid ? &seed : nullptr);
+    ReadTxDCCorrection(this, channel, dccorri, dccorrq);
     //CalibrateTxDC(&dccorri, &dccorrq);
     //TXIQ
     SetNCOFrequency(LMS7002M::Rx, 0, calibrationSXOffset_Hz - offsetNCO);
-    CalibrateIQImbalance(LMS7002M::Tx, &gcorri, &gcorrq, &phaseOffset);
+    CalibrateIQImbalance(LMS7002M::Tx, &gcorri, &gcorrq, &phaseOffset, seed.valid ? &seed : nullptr);
 TxCalibrationEnd:
 #ifdef ENABLE_CALIBRATION_USING_FFT
     dataPort->ControlStream(streamId, false);
@@ -1068,8 +1113,8 @@ TxCalibrationEnd:
         mValueCache->InsertDC_IQ(boardId, txFreq, channel, true, band, dccorri, dccorrq, gcorri, gcorrq, phaseOffset);
 
     Modify_SPI_Reg_bits(LMS7param(MAC), ch);
-    //Modify_SPI_Reg_bits(LMS7param(DCCORRI_TXTSP), dccorri);
-    //Modify_SPI_Reg_bits(LMS7param(DCCORRQ_TXTSP), dccorrq);
+    //register restore has overwritten the analog DC correction
+    WriteTxDCCorrection(this, channel, dccorri, dccorrq);
     Modify_SPI_Reg_bits(LMS7param(GCORRI_TXTSP), gcorri);
     Modify_SPI_Reg_bits(LMS7param(GCORRQ_TXTSP), gcorrq);
     Modify_SPI_Reg_bits(LMS7param(IQCORR_TXTSP), phaseOffset);
@@ -1082,6 +1127,7 @@ TxCalibrationEnd:
 
     Modify_SPI_Reg_bits(0x0208, 1, 0, 0); //GC_BYP PH_BYP
     LoadDC_REG_IQ(Tx, (int16_t)0x7FFF, (int16_t)0x8000);
+    StoreCalibrationResult(Tx, dccorri, dccorrq, gcorri, gcorrq, phaseOffset, true);
     Log("Tx calibration finished", LOG_INFO);
 #ifdef LMS_VERBOSE_OUTPUT
     verbose_printf("#####Tx calibration RESULTS:###########################\n");
@@ -1362,7 +1408,7 @@ void LMS7002M::TxDcBinarySearch(BinSearchParam* args)
     WriteAnalogDC(this, args->param, args->result);
 }
 
-void LMS7002M::CalibrateTxDCAuto()
+void LMS7002M::CalibrateTxDCAuto(const CalibrationValues *seed)
 {
     verbose_printf("Searching Tx DC...\n");
     Modify_SPI_Reg_bits(LMS7param(EN_G_TRF), 1);
@@ -1408,26 +1454,46 @@ void LMS7002M::CalibrateTxDCAuto()
     int16_t ivalue = 0;//ReadAnalogDC(this, iparams.param);
     int16_t qvalue = 0;//ReadAnalogDC(this, qparams.param);
     int offset = 1023;
-    iparams.minValue = ivalue-offset;
-    iparams.maxValue = ivalue+offset;
-    qparams.minValue = qvalue-offset;
-    qparams.maxValue = qvalue+offset;
-
-    TxDcBinarySearch(&iparams);
-    ivalue = iparams.result;
-    TxDcBinarySearch(&qparams);
-    qvalue = qparams.result;
-
-    offset = 128;
-    iparams.minValue = ivalue-offset;
-    iparams.maxValue = ivalue+offset;
-    qparams.minValue = qvalue-offset;
-    qparams.maxValue = qvalue+offset;
-
-    TxDcBinarySearch(&iparams);
-    ivalue = iparams.result;
-    TxDcBinarySearch(&qparams);
-    qvalue = qparams.result;
+    bool coldSearch = true;
+    if(seed)
+    {
+        //warm start, skip the full range stages if seed window holds the minimum
+        const int seedRadius = 64;
+        seedWindow(iparams, txdc2analog(seed->dcI), seedRadius, -offset, offset);
+        seedWindow(qparams, txdc2analog(seed->dcQ), seedRadius, -offset, offset);
+        TxDcBinarySearch(&iparams);
+        TxDcBinarySearch(&qparams);
+        coldSearch = seedWindowHit(iparams, -offset, offset) || seedWindowHit(qparams, -offset, offset);
+        ivalue = iparams.result;
+        qvalue = qparams.result;
+        if(coldSearch)
+            verbose_printf("Tx DC seed window missed, searching full range\n");
+    }
+
+    if(coldSearch)
+    {
+        ivalue = qvalue = 0;
+        iparams.minValue = ivalue-offset;
+        iparams.maxValue = ivalue+offset;
+        qparams.minValue = qvalue-offset;
+        qparams.maxValue = qvalue+offset;
+
+        TxDcBinarySearch(&iparams);
+        ivalue = iparams.result;
+        TxDcBinarySearch(&qparams);
+        qvalue = qparams.result;
+
+        offset = 128;
+        iparams.minValue = ivalue-offset;
+        iparams.maxValue = ivalue+offset;
+        qparams.minValue = qvalue-offset;
+        qparams.maxValue = qvalue+offset;
+
+        TxDcBinarySearch(&iparams);
+        ivalue = iparams.result;
+        TxDcBinarySearch(&qparams);
+        qvalue = qparams.result;
+    }
 
     offset = 8;
     iparams.minValue = ivalue-offset;
@@ -1728,6 +1794,10 @@ int LMS7002M::CalibrateRx(float_type bandwidth_Hz, bool useExtLoopback)
         return ReportError(ERANGE, "Frequency out of range, available range: from %g to %g MHz", TrxCalib_RF_LimitLow / 1e6, TrxCalib_RF_LimitHigh / 1e6);
     if(controlPort == nullptr)
         return ReportError(ENODEV, "Device not connected");
+    //seed is used only by this calibration
+    const CalibrationValues seed = mCalibrationSeed[Rx];
+    mCalibrationSeed[Rx] = CalibrationValues();
+    mCalibrationResult[Rx] = CalibrationValues();
 #ifdef __cplusplus
     auto beginTime = std::chrono::high_resolution_clock::now();
 #endif
@@ -1808,6 +1878,7 @@ int LMS7002M::CalibrateRx(float_type bandwidth_Hz, bool useExtLoopback)
             verbose_printf("I: | %3i | %4i | %i\n", dcIsigned, gainI, phaseSigned);
             verbose_printf("Q: | %3i | %4i |\n", dcQsigned, gainQ);
             verbose_printf(cSquaresLine);
+            StoreCalibrationResult(Rx, dcI, dcQ, gainI, gainQ, phOffset, true);
             return 0;
         }
     }
@@ -1818,16 +1889,9 @@ int LMS7002M::CalibrateRx(float_type bandwidth_Hz, bool useExtLoopback)
     auto registersBackup = BackupRegisterMap();
     if(mCalibrationByMCU && not useExtLoopback)
     {
-        uint8_t mcuID = mcuControl->ReadMCUProgramID();
-        verbose_printf("Current MCU firmware: %i, %s\n", mcuID,
-            mcuID == MCU_ID_CALIBRATIONS_SINGLE_IMAGE ? "DC/IQ calibration full" : "unknown");
-        if(mcuID != MCU_ID_CALIBRATIONS_SINGLE_IMAGE)
-        {
-            verbose_printf("Uploading DC/IQ calibration firmware\n");
-            status = mcuControl->Program_MCU(mcu_program_lms7_dc_iq_calibration_bin, IConnection::MCU_PROG_MODE::SRAM);
-            if(status != 0)
-                return status;
-        }
+        status = mcuControl->EnsureProgram(mcu_program_lms7_dc_iq_calibration_bin, MCU_ID_CALIBRATIONS_SINGLE_IMAGE);
+        if(status != 0)
+            return status;
 
         //set reference clock parameter inside MCU
         long refClk = GetReferenceClk_SX(false);
@@ -1854,6 +1918,8 @@ int LMS7002M::CalibrateRx(float_type bandwidth_Hz, bool useExtLoopback)
 
         if(useCache)
             mValueCache->InsertDC_IQ(boardId, rxFreq, channel, false, lna, /*dcoffi*/0, /*dcoffq*/0, gcorri, gcorrq, phaseOffset);
+        //Rx DC is corrected by the chip loop, no offsets are stored
+        StoreCalibrationResult(Rx, 0, 0, gcorri, gcorrq, phaseOffset, status == 0);
         //logic reset
         Modify_SPI_Reg_bits(LMS7param(LRST_TX_A), 0);
         Modify_SPI_Reg_bits(LMS7param(LRST_TX_B), 0);
@@ -1931,7 +1997,7 @@ int LMS7002M::CalibrateRx(float_type bandwidth_Hz, bool useExtLoopback)
     Modify_SPI_Reg_bits(LMS7param(CMIX_BYP_RXTSP), 0);
     SetNCOFrequency(LMS7002M::Rx, 0, bandwidth_Hz/calibUserBwDivider + offsetNCO);
 
-    CalibrateIQImbalance(LMS7002M::Rx, &gcorri, &gcorrq, &phaseOffset);
+    CalibrateIQImbalance(LMS7002M::Rx, &gcorri, &gcorrq, &phaseOffset, seed.valid ? &seed : nullptr);
 
     dcoffi = Get_SPI_Reg_bits(LMS7param(DCOFFI_RFE), true);
     dcoffq = Get_SPI_Reg_bits(LMS7param(DCOFFQ_RFE), true);
@@ -1968,6 +2034,7 @@ RxCalibrationEndStage:
     Modify_SPI_Reg_bits(LMS7param(IQCORR_RXTSP), phaseOffset);
     Modify_SPI_Reg_bits(0x040C, 2, 0, 0); //DC_BYP 0, GC_BYP 0, PH_BYP 0
     Modify_SPI_Reg_bits(0x040C, 8, 8, 0); //DCLOOP_STOP
+    StoreCalibrationResult(Rx, dcoffi, dcoffq, gcorri, gcorrq, phaseOffset, true);
     Log("Rx calibration finished", LOG_INFO);
 #ifdef LMS_VERBOSE_OUTPUT
     verbose_printf("#####Rx calibration RESULTS:###########################\n");
@@ -2826,7 +2893,7 @@ int LMS7002M::LoadDC_REG_IQ(bool tx, int16_t I, int16_t Q)
     return 0;
 }
 
-void LMS7002M::CalibrateIQImbalance(const bool tx, uint16_t *gainI, uint16_t *gainQ, int16_t *phase)
+void LMS7002M::CalibrateIQImbalance(const bool tx, uint16_t *gainI, uint16_t *gainQ, int16_t *phase, const CalibrationValues *seed)
 {
     const char *dirName = tx ? "Tx" : "Rx";
 #ifdef DRAW_GNU_PLOTS
@@ -2842,14 +2909,36 @@ void LMS7002M::CalibrateIQImbalance(const bool tx, uint16_t *gainI, uint16_t *ga
     BinSearchParam argsGain;
     GridSearchParam gridArgs;
 
+    const int phaseLimit = 128;
+    const int gainMin = 2047-512;
+    const int gainMax = 2047;
+
     argsPhase.param = tx ? LMS7param(IQCORR_TXTSP) : LMS7param(IQCORR_RXTSP);
-    argsPhase.maxValue = 128;
-    argsPhase.minValue = -128;
+    argsPhase.maxValue = phaseLimit;
+    argsPhase.minValue = -phaseLimit;
+    if(seed)
+        seedWindow(argsPhase, seed->phase, 16, -phaseLimit, phaseLimit);
     BinarySearch(&argsPhase);
+    if(seed && seedWindowHit(argsPhase, -phaseLimit, phaseLimit))
+    {
+        verbose_printf("%s IQCORR seed window missed, searching full range\n", dirName);
+        argsPhase.maxValue = phaseLimit;
+        argsPhase.minValue = -phaseLimit;
+        BinarySearch(&argsPhase);
+    }
     phaseOffset = argsPhase.result;
     verbose_printf("Coarse search %s IQCORR: %i\n", dirName, phaseOffset);
 
-    //coarse gain
+    //coarse gain, seed tells which of the gains is reduced
+    const bool gainSeeded = seed && seed->gainI != seed->gainQ;
+    if(gainSeeded)
+    {
+        argsGain.param = seed->gainI < seed->gainQ ? gcorri : gcorrq;
+        Modify_SPI_Reg_bits(gcorri, 2047);
+        Modify_SPI_Reg_bits(gcorrq, 2047);
+    }
+    else
+    {
     uint32_t rssiIgain;
     uint32_t rssiQgain;
     Modify_SPI_Reg_bits(gcorri, 2047 - 64);
@@ -2866,11 +2955,21 @@ void LMS7002M::CalibrateIQImbalance(const bool tx, uint16_t *gainI, uint16_t *ga
         argsGain.param = gcorri;
     else
         argsGain.param = gcorrq;
+    }
     const char* chName = (argsGain.param.address == gcorri.address ? "I" : "Q");
 
-    argsGain.maxValue = 2047;
-    argsGain.minValue = 2047-512;
+    argsGain.maxValue = gainMax;
+    argsGain.minValue = gainMin;
+    if(gainSeeded)
+        seedWindow(argsGain, std::min(seed->gainI, seed->gainQ), 64, gainMin, gainMax);
     BinarySearch(&argsGain);
+    if(gainSeeded && seedWindowHit(argsGain, gainMin, gainMax))
+    {
+        verbose_printf("%s GAIN_%s seed window missed, searching full range\n", dirName, chName);
+        argsGain.maxValue = gainMax;
+        argsGain.minValue = gainMin;
+        BinarySearch(&argsGain);
+    }
     gain = argsGain.result;
     verbose_printf("Coarse search %s GAIN_%s: %i\n", dirName, chName, gain);
 
@@ -111,13 +111,9 @@ int LMS7002M::TuneRxFilter(float_type rx_lpf_freq_RF)
 
     if(mCalibrationByMCU)
     {
-        uint8_t mcuID = mcuControl->ReadMCUProgramID();
-        if(mcuID != MCU_ID_CALIBRATIONS_SINGLE_IMAGE)
-        {
-            status = mcuControl->Program_MCU(mcu_program_lms7_dc_iq_calibration_bin, IConnection::MCU_PROG_MODE::SRAM);
-            if(status != 0)
-                return status;
-        }
+        status = mcuControl->EnsureProgram(mcu_program_lms7_dc_iq_calibration_bin, MCU_ID_CALIBRATIONS_SINGLE_IMAGE);
+        if(status != 0)
+            return status;
 
         //set reference clock parameter inside MCU
         long refClk = GetReferenceClk_SX(false);
@@ -887,13 +883,9 @@ int LMS7002M::TuneTxFilter(const float_type tx_lpf_freq_RF)
 
     if(mCalibrationByMCU)
     {
-        uint8_t mcuID = mcuControl->ReadMCUProgramID();
-        if(mcuID != MCU_ID_CALIBRATIONS_SINGLE_IMAGE)
-        {
-            status = mcuControl->Program_MCU(mcu_program_lms7_dc_iq_calibration_bin, IConnection::MCU_PROG_MODE::SRAM);
-            if(status != 0)
-                return status;
-        }
+        status = mcuControl->EnsureProgram(mcu_program_lms7_dc_iq_calibration_bin, MCU_ID_CALIBRATIONS_SINGLE_IMAGE);
+        if(status != 0)
+            return status;
 
         //set reference clock parameter inside MCU
         long refClk = GetReferenceClk_SX(false);
@@ -14,6 +14,8 @@ using namespace std;
 #include <assert.h>
 #include <thread>
 #include <list>
+#include <algorithm>
+#include <chrono>
 #include "ErrorReporting.h"
 #include "LMS7002M.h"
 
@@ -29,6 +31,7 @@ MCU_BD::MCU_BD()
     aborted = false;
     callback = nullptr;
     mChipID =0;
+    InvalidateProgramState();
     //ctor
     int i=0;
     m_serPort=NULL;
@@ -55,6 +58,7 @@ void MCU_BD::Initialize(IConnection* pSerPort, unsigned chipID, unsigned size)
 {
     m_serPort = pSerPort;
     mChipID = chipID;
+    InvalidateProgramState();
     if (size > 0)
         byte_array_size = size;
 }
@@ -583,6 +587,8 @@ int MCU_BD::Program_MCU(const uint8_t* buffer, const IConnection::MCU_PROG_MODE
     if(!m_serPort)
         return ReportError(ENOLINK, "Device not connected");
 
+    //SRAM contents are replaced or in undefined state after programming
+    InvalidateProgramState();
     if (byte_array_size <= 8192)
         return m_serPort->ProgramMCU(buffer, byte_array_size, mode, callback);
 #ifndef NDEBUG
@@ -663,6 +669,7 @@ int MCU_BD::Program_MCU(const uint8_t* buffer, const IConnection::MCU_PROG_MODE
 
 void MCU_BD::Reset_MCU()
 {
+    InvalidateProgramState();
     unsigned short tempi=0x0000;  // was 0x0000
 	mSPI_write(0x8002, tempi);
 	tempi=0x0000;
@@ -1005,12 +1012,17 @@ std::string MCU_BD::GetProgramFilename() const
 */
 void MCU_BD::RunProcedure(uint8_t id)
 {
-    mSPI_write(0x0006, id != 0);
-    mSPI_write(0x0000, id);
-    uint8_t x0002reg = mSPI_read(0x0002);
-    const uint8_t interupt6 = 0x08;
-    mSPI_write(0x0002, x0002reg | interupt6);
-    mSPI_write(0x0002, x0002reg & ~interupt6);
+    if(m_serPort == nullptr)
+        return;
+    const uint16_t x0002reg = mSPI_read(0x0002) & 0xFF;
+    const uint16_t interupt6 = 0x08;
+    const uint32_t wrdata[] = {
+        0x0006u << 16 | (id != 0),
+        0x0000u << 16 | id,
+        0x0002u << 16 | (x0002reg | interupt6),
+        0x0002u << 16 | (x0002reg & ~interupt6)
+    };
+    m_serPort->WriteLMS7002MSPI(wrdata, sizeof(wrdata)/sizeof(uint32_t), mChipID);
     std::this_thread::sleep_for(std::chrono::microseconds(10));
 }
 
@@ -1023,42 +1035,111 @@ int MCU_BD::WaitForMCU(uint32_t timeout_ms)
     auto t1 = std::chrono::high_resolution_clock::now();
     auto t2 = t1;
     unsigned short value = 0;
-    std::this_thread::sleep_for(std::chrono::microseconds(50));
+    //short procedures finish within tens of microseconds, long calibrations
+    //take hundreds of milliseconds, so poll interval grows up to 1 ms
+    auto pollInterval = std::chrono::microseconds(50);
+    const auto maxPollInterval = std::chrono::microseconds(1000);
+    std::this_thread::sleep_for(pollInterval);
     do {
         value = mSPI_read(0x0001) & 0xFF;
         if (value != 0xFF) //working
             break;
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        std::this_thread::sleep_for(pollInterval);
+        pollInterval = std::min(pollInterval*2, maxPollInterval);
         t2 = std::chrono::high_resolution_clock::now();
     }while (std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() < timeout_ms);
     mSPI_write(0x0006, 0); //return SPI control to PC
+    //program did not respond, it could have been lost by chip power cycle
+    if(value == 0xFF)
+        InvalidateProgramState();
     //if((value & 0x7f) != 0)
         std::printf("MCU algorithm time: %li ms\n", std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count());
     return value & 0x7F;
 }
 
+/** @brief Passes parameter to resident MCU program
+    Each parameter byte and its interrupt are sent as one SPI batch, followed by
+    a wait for MCU to fetch the byte. Value is not resent if resident program
+    already holds it.
+*/
 void MCU_BD::SetParameter(MCU_Parameter param, float value)
 {
+    if(m_serPort == nullptr)
+        return;
+    if(mResidentProgramID >= 0 && mParameterValid[param] && mParameterValues[param] == value)
+        return;
+
     uint8_t inputRegs[3];
-    value /= 1e6;
-    inputRegs[0] = (uint8_t)value; //frequency integer part
+    const float valueMHz = value / 1e6;
+    inputRegs[0] = (uint8_t)valueMHz; //frequency integer part
 
-    uint16_t fracPart = value * 1000.0 - inputRegs[0]*1000.0;
+    uint16_t fracPart = valueMHz * 1000.0 - inputRegs[0]*1000.0;
     inputRegs[1] = (fracPart >> 8) & 0xFF;
     inputRegs[2] = fracPart & 0xFF;
-    const uint8_t x0002reg = mSPI_read(0x0002);
-    const uint8_t interupt7 = 0x04;
+    const uint16_t x0002reg = mSPI_read(0x0002) & 0xFF;
+    const uint16_t interupt6 = 0x08;
+    const uint16_t interupt7 = 0x04;
+    const uint8_t procedureID = param == MCU_REF_CLK ? 4 : 3;
+
+    mParameterValid[param] = false;
     for(uint8_t i = 0; i < 3; ++i)
     {
-        mSPI_write(0, inputRegs[2-i]);
-        mSPI_write(0x0002, x0002reg | interupt7);
-        mSPI_write(0x0002, x0002reg & ~interupt7);
+        const uint32_t wrdata[] = {
+            0x0000u << 16 | inputRegs[2-i],
+            0x0002u << 16 | (x0002reg | interupt7),
+            0x0002u << 16 | (x0002reg & ~interupt7)
+        };
+        if(m_serPort->WriteLMS7002MSPI(wrdata, sizeof(wrdata)/sizeof(uint32_t), mChipID) != 0)
+            return;
+        //MCU must fetch the byte before next one overwrites input register
         this_thread::sleep_for(chrono::microseconds(5));
     }
-    if(param==MCU_REF_CLK)
-        RunProcedure(4);
-    if(param == MCU_BW)
-        RunProcedure(3);
+    const uint32_t wrdata[] = {
+        0x0006u << 16 | 1,
+        0x0000u << 16 | procedureID,
+        0x0002u << 16 | (x0002reg | interupt6),
+        0x0002u << 16 | (x0002reg & ~interupt6)
+    };
+    if(m_serPort->WriteLMS7002MSPI(wrdata, sizeof(wrdata)/sizeof(uint32_t), mChipID) != 0)
+        return;
+    std::this_thread::sleep_for(std::chrono::microseconds(10));
+    mParameterValues[param] = value;
+    mParameterValid[param] = true;
+}
+
+/** @brief Uploads program to MCU only if it is not already resident
+    Program residency is tracked host side and verified by reading program ID
+    only when it is unknown (after chip reset, MCU reset or failed procedure).
+    @param binArray program code
+    @param programID ID reported by program once it is running
+    @param mode MCU memory initialization mode
+    @return 0-success, other-failure
+*/
+int MCU_BD::EnsureProgram(const uint8_t* binArray, uint8_t programID, const IConnection::MCU_PROG_MODE mode)
+{
+    if(!m_serPort)
+        return ReportError(ENOLINK, "Device not connected");
+    if(mResidentProgramID == programID)
+        return 0;
+
+    if(ReadMCUProgramID() != programID)
+    {
+        int status = Program_MCU(binArray, mode);
+        if(status != 0)
+            return status;
+    }
+    mResidentProgramID = programID;
+    return 0;
+}
+
+/** @brief Forgets resident program and its parameters,
+    next EnsureProgram() call will verify program ID
+*/
+void MCU_BD::InvalidateProgramState()
+{
+    mResidentProgramID = -1;
+    mParameterValid[MCU_REF_CLK] = false;
+    mParameterValid[MCU_BW] = false;
 }
 
 /** @brief Switches MCU into debug mode, MCU program execution is halted
@@ -47,6 +47,9 @@ class MCU_BD
         };
         void SetParameter(MCU_Parameter param, float value);
         int WaitForMCU(uint32_t timeout_ms);
+        int EnsureProgram(const uint8_t* binArray, uint8_t programID,
+            const IConnection::MCU_PROG_MODE mode = IConnection::MCU_PROG_MODE::SRAM);
+        void InvalidateProgramState();
 
         static const int cMaxFWSize = 1024 * 16;
 
@@ -65,6 +68,11 @@ class MCU_BD
         int m_bLoadedProd;
         int byte_array_size;
         unsigned mChipID;
+        ///ID of program known to be resident in MCU SRAM, -1 if unknown
+        int mResidentProgramID;
+        ///last parameter values written to resident program
+        float mParameterValues[2];
+        bool mParameterValid[2];
 
     public:
         uint8_t ReadMCUProgramID();
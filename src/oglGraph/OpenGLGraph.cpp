@@ -68,6 +68,7 @@ initialDisplayArea(-100, 100, -100, 100),
 m_MouseCoord(0, 0, 0, 0)
 {
     m_font = NULL;
+    m_staticList = 0;
     m_glContext = new wxGLContext(this);
     SetBackgroundStyle(wxBG_STYLE_CUSTOM);
     int w, h;
@@ -493,6 +494,109 @@ void OpenGLGraph::DrawStaticElements()
 
 }
 
+/**
+	@brief Checks if settings used by static elements differ from ones they were last drawn with
+*/
+bool OpenGLGraph::StaticElementsChanged() const
+{
+	const GLG_settings &a = settings;
+	const GLG_settings &b = m_staticListSettings;
+	GLG_color ca[] = {a.dataViewBackgroundColor, a.titlesColor, a.gridColor};
+	GLG_color cb[] = {b.dataViewBackgroundColor, b.titlesColor, b.gridColor};
+	for(int i=0; i<3; ++i)
+		if(ca[i].getColor4b() != cb[i].getColor4b())
+			return true;
+	return viewChanged
+		|| a.windowWidth != b.windowWidth || a.windowHeight != b.windowHeight
+		|| a.marginLeft != b.marginLeft || a.marginRight != b.marginRight
+		|| a.marginTop != b.marginTop || a.marginBottom != b.marginBottom
+		|| a.visibleArea.x1 != b.visibleArea.x1 || a.visibleArea.x2 != b.visibleArea.x2
+		|| a.visibleArea.y1 != b.visibleArea.y1 || a.visibleArea.y2 != b.visibleArea.y2
+		|| a.gridXstart != b.gridXstart || a.gridYstart != b.gridYstart
+		|| a.gridXspacing != b.gridXspacing || a.gridYspacing != b.gridYspacing
+		|| a.gridXprec != b.gridXprec || a.gridYprec != b.gridYprec
+		|| a.gridXoffset != b.gridXoffset || a.staticGrid != b.staticGrid
+		|| a.title != b.title || a.titleXaxis != b.titleXaxis || a.titleYaxis != b.titleYaxis
+		|| a.xUnits != b.xUnits || a.yUnits != b.yUnits;
+}
+
+/**
+	@brief Builds min/max envelope of serie's visible part, one pair of vertices per pixel column
+	@return true if serie is denser than data view and lodValues holds decimated vertices
+*/
+bool OpenGLGraph::DecimateSerie(cDataSerie* serie)
+{
+	const int columns = settings.dataViewWidth;
+	const sRect<double> &area = settings.visibleArea;
+	if(serie->lodValid && serie->lodColumns == columns
+		&& serie->lodArea.x1 == area.x1 && serie->lodArea.x2 == area.x2)
+		return !serie->lodValues.empty();
+	serie->lodValid = true;
+	serie->lodModified = true;
+	serie->lodColumns = columns;
+	serie->lodArea = area;
+	serie->lodValues.clear();
+
+	const float *v = serie->values;
+	const unsigned int n = serie->size;
+	if(n < 4*(unsigned)columns || area.x2 <= area.x1)
+		return false;
+	//envelope only makes sense for data sorted by x (time, frequency)
+	for(unsigned int i=1; i<n; ++i)
+		if(v[2*i] < v[2*i-2])
+			return false;
+
+	//first and last samples inside visible area, with one neighbour outside
+	unsigned int first = 0;
+	unsigned int last = n-1;
+	{
+		unsigned int lo = 0, hi = n;
+		while(lo < hi)
+		{
+			unsigned int mid = (lo+hi)/2;
+			if(v[2*mid] < area.x1) lo = mid+1; else hi = mid;
+		}
+		first = lo > 0 ? lo-1 : 0;
+		lo = first; hi = n;
+		while(lo < hi)
+		{
+			unsigned int mid = (lo+hi)/2;
+			if(v[2*mid] <= area.x2) lo = mid+1; else hi = mid;
+		}
+		last = lo < n ? lo : n-1;
+	}
+	if(last-first+1 < 4*(unsigned)columns)
+		return false;
+
+	serie->lodValues.reserve(4*columns+8);
+	const double pixelWidth = (area.x2 - area.x1)/columns;
+	unsigned int i = first;
+	while(i <= last)
+	{
+		const int column = floor((v[2*i]-area.x1)/pixelWidth);
+		unsigned int minIndex = i;
+		unsigned int maxIndex = i;
+		unsigned int j = i+1;
+		for(; j <= last && floor((v[2*j]-area.x1)/pixelWidth) == column; ++j)
+		{
+			if(v[2*j+1] < v[2*minIndex+1]) minIndex = j;
+			if(v[2*j+1] > v[2*maxIndex+1]) maxIndex = j;
+		}
+		//keep min/max in their sample order, so the strip stays continuous
+		const unsigned int a = minIndex < maxIndex ? minIndex : maxIndex;
+		const unsigned int b = minIndex < maxIndex ? maxIndex : minIndex;
+		serie->lodValues.push_back(v[2*a]);
+		serie->lodValues.push_back(v[2*a+1]);
+		if(b != a)
+		{
+			serie->lodValues.push_back(v[2*b]);
+			serie->lodValues.push_back(v[2*b+1]);
+		}
+		i = j;
+	}
+	return true;
+}
+
 /**
 	@brief Calculates grid position and spacing values
 */
@@ -668,8 +772,17 @@ void OpenGLGraph::Draw()
 				settings.backgroundColor.blue, settings.backgroundColor.alpha);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	//draw static view elements
-	DrawStaticElements();
+	//draw static view elements, recompiled only when their settings change
+	if(m_staticList == 0 || StaticElementsChanged())
+	{
+		if(m_staticList == 0)
+			m_staticList = glGenLists(1);
+		glNewList(m_staticList, GL_COMPILE);
+		DrawStaticElements();
+		glEndList();
+		m_staticListSettings = settings;
+	}
+	glCallList(m_staticList);
 	switchToWindowView();
 	//while zomming in draw selection rectangle
 	if(m_actionState == OGLG_ZOOMIN)
@@ -702,9 +815,38 @@ void OpenGLGraph::Draw()
 				glBindBufferARB(GL_ARRAY_BUFFER_ARB, series[i]->vboIndex);
 				if(series[i]->modified) //check if buffer needs to be modified
 				{
-					glBufferDataARB(GL_ARRAY_BUFFER_ARB, sizeof(float)*series[i]->size*2, NULL, GL_DYNAMIC_DRAW_ARB);
-					glBufferDataARB(GL_ARRAY_BUFFER_ARB, sizeof(float)*series[i]->size*2, series[i]->values, GL_DYNAMIC_DRAW_ARB);
+					const unsigned int floatCount = series[i]->size*2;
+					if(floatCount > series[i]->vboSize) //reallocate only when growing
+					{
+						glBufferDataARB(GL_ARRAY_BUFFER_ARB, sizeof(float)*floatCount, series[i]->values, GL_DYNAMIC_DRAW_ARB);
+						series[i]->vboSize = floatCount;
+					}
+					else
+						glBufferSubDataARB(GL_ARRAY_BUFFER_ARB, 0, sizeof(float)*floatCount, series[i]->values);
 					series[i]->modified = false;
+					series[i]->lodValid = false;
+				}
+				unsigned int vertexCount = series[i]->size;
+				//draw min/max envelope instead of samples, if there are more of them than pixels
+				if(settings.graphType == GLG_LINE && DecimateSerie(series[i]))
+				{
+					if(series[i]->lodVboIndex == 0)
+						glGenBuffersARB(1, &series[i]->lodVboIndex);
+					glBindBufferARB(GL_ARRAY_BUFFER_ARB, series[i]->lodVboIndex);
+					//upload only when data or visible area changed
+					if(series[i]->lodModified)
+					{
+						const unsigned int floatCount = series[i]->lodValues.size();
+						if(floatCount > series[i]->lodVboSize) //reallocate only when growing
+						{
+							glBufferDataARB(GL_ARRAY_BUFFER_ARB, sizeof(float)*floatCount, series[i]->lodValues.data(), GL_DYNAMIC_DRAW_ARB);
+							series[i]->lodVboSize = floatCount;
+						}
+						else
+							glBufferSubDataARB(GL_ARRAY_BUFFER_ARB, 0, sizeof(float)*floatCount, series[i]->lodValues.data());
+						series[i]->lodModified = false;
+					}
+					vertexCount = series[i]->lodValues.size()/2;
 				}
 				glEnableClientState(GL_VERTEX_ARRAY);
 				glEnableClientState(GL_COLOR);
@@ -712,12 +854,12 @@ void OpenGLGraph::Draw()
 				if(settings.graphType == GLG_POINTS)
 				{
 					glPointSize(settings.pointsSize);
-					glDrawArrays(GL_POINTS, 0, series[i]->size);
+					glDrawArrays(GL_POINTS, 0, vertexCount);
 				}
 				else
 				{
 					glPointSize(1);
-					glDrawArrays(GL_LINE_STRIP, 0, series[i]->size);
+					glDrawArrays(GL_LINE_STRIP, 0, vertexCount);
 				}
 				glDisableClientState(GL_VERTEX_ARRAY);
 				glDisableClientState(GL_COLOR);
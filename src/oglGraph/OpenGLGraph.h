@@ -107,7 +107,7 @@ struct GLG_color
 class cDataSerie
 {
 public:
-	cDataSerie() : size(0), allocatedSize(0), vboIndex(0), visible(true), modified(true), values(NULL)
+	cDataSerie() : size(0), allocatedSize(0), vboIndex(0), vboSize(0), lodVboIndex(0), lodVboSize(0), lodArea(0, 0, 0, 0), lodColumns(0), lodValid(false), lodModified(false), visible(true), modified(true), values(NULL)
 	{
 		color = 0x000000FF;
 		Initialize(10);
@@ -189,6 +189,15 @@ public:
 	unsigned int size;
 	unsigned int allocatedSize;
 	unsigned int vboIndex;
+	unsigned int vboSize; //number of floats allocated in vbo
+	//min/max decimated copy of visible data, used when serie is denser than pixels
+	unsigned int lodVboIndex;
+	unsigned int lodVboSize; //number of floats allocated in lod vbo
+	std::vector<float> lodValues;
+	sRect<double> lodArea;
+	int lodColumns;
+	bool lodValid;
+	bool lodModified; //lodValues differ from lod vbo contents
 	GLG_color color;
 	bool visible;
 	bool modified;
@@ -379,7 +388,9 @@ private:
 	void dataViewPixelToValue(int x, int y, float &valX, float &valY);
 
 	void DrawStaticElements();
+	bool StaticElementsChanged() const;
 	void DrawMarkers();
+	bool DecimateSerie(cDataSerie* serie);
 	void CalculateGrid();
 
 	void switchToWindowView();
@@ -399,6 +410,9 @@ private:
 	unsigned m_maxMarkers;
 	int clickedOnMarker(int X, int Y);
 
+	GLuint m_staticList;
+	GLG_settings m_staticListSettings;
+
 	bool m_currentlyDrawing;
 	wxTimer* m_timer;
 	wxGLContext *m_glContext;
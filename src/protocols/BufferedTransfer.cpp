@@ -0,0 +1,127 @@
+/**
+@file BufferedTransfer.cpp
+@author Lime Microsystems
+@brief Stream data transfers performed on a dedicated thread through a ring of buffers
+*/
+
+#include "BufferedTransfer.h"
+#include <chrono>
+
+using namespace lime;
+
+static const int ioTimeout_ms = 100; //I/O thread checks for termination at least this often
+
+BufferedTransfer::BufferedTransfer(const TransferFunction& transfer, const bool isTx, const uint32_t bufferSize, const uint32_t buffersCount,
+    const CompletionCallback& onComplete) :
+    mTransfer(transfer),
+    mOnComplete(onComplete),
+    mIsTx(isTx),
+    mBufferSize(bufferSize),
+    mSlots(buffersCount < 2 ? 2 : buffersCount),
+    mIoIndex(0),
+    mUserIndex(0),
+    mReady(0),
+    mTerminate(false),
+    mFailures(0)
+{
+    for (auto& slot : mSlots)
+    {
+        slot.data.resize(bufferSize);
+        slot.bytes = 0;
+        slot.tag = 0;
+    }
+    mThread = std::thread(&BufferedTransfer::TransferLoop, this);
+}
+
+BufferedTransfer::~BufferedTransfer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mTerminate.store(true);
+    }
+    mIoCond.notify_all();
+    mUserCond.notify_all();
+    mThread.join();
+}
+
+char* BufferedTransfer::Acquire(int* bytes, const int timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(mLock);
+    //Rx waits for received data, Tx for a slot not queued for sending
+    auto available = [this](){ return mIsTx ? mReady < mSlots.size() : mReady > 0; };
+    if (!mUserCond.wait_for(lock, std::chrono::milliseconds(timeout_ms), available))
+        return nullptr;
+    Slot& slot = mSlots[mUserIndex];
+    if (bytes)
+        *bytes = mIsTx ? mBufferSize : slot.bytes;
+    return slot.data.data();
+}
+
+void BufferedTransfer::Release(const int bytes, const uint64_t tag)
+{
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        Slot& slot = mSlots[mUserIndex];
+        slot.bytes = bytes;
+        slot.tag = tag;
+        mUserIndex = (mUserIndex + 1) % mSlots.size();
+        if (mIsTx)
+            ++mReady;
+        else
+            --mReady;
+    }
+    mIoCond.notify_one();
+}
+
+bool BufferedTransfer::WaitIdle(const int timeout_ms)
+{
+    std::unique_lock<std::mutex> lock(mLock);
+    return mUserCond.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this](){ return !mIsTx || mReady == 0; });
+}
+
+uint32_t BufferedTransfer::GetBufferSize() const
+{
+    return mBufferSize;
+}
+
+uint32_t BufferedTransfer::GetFailuresCount() const
+{
+    return mFailures.load();
+}
+
+void BufferedTransfer::TransferLoop()
+{
+    while (!mTerminate.load())
+    {
+        Slot* slot;
+        {
+            //Rx needs a slot not held by user, Tx a slot queued for sending
+            std::unique_lock<std::mutex> lock(mLock);
+            auto available = [this](){ return mTerminate.load() || (mIsTx ? mReady > 0 : mReady < mSlots.size()); };
+            if (!mIoCond.wait_for(lock, std::chrono::milliseconds(ioTimeout_ms), available) || mTerminate.load())
+                continue;
+            slot = &mSlots[mIoIndex];
+        }
+        //slot is owned by I/O thread until it is published
+        const int requested = mIsTx ? slot->bytes : int(mBufferSize);
+        int transferred = mTransfer(slot->data.data(), requested, ioTimeout_ms);
+        if (transferred < 0)
+            transferred = 0;
+        if (transferred != requested)
+            ++mFailures;
+        if (mIsTx && mOnComplete)
+            mOnComplete(requested, transferred, slot->tag);
+        if (!mIsTx && transferred == 0)
+            continue; //nothing received, reuse same slot
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            slot->bytes = transferred;
+            mIoIndex = (mIoIndex + 1) % mSlots.size();
+            if (mIsTx)
+                --mReady;
+            else
+                ++mReady;
+        }
+        mUserCond.notify_one();
+    }
+}
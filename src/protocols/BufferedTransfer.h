@@ -0,0 +1,98 @@
+/**
+@file BufferedTransfer.h
+@author Lime Microsystems
+@brief Stream data transfers performed on a dedicated thread through a ring of buffers
+*/
+
+#ifndef LIMESUITE_BUFFERED_TRANSFER_H
+#define LIMESUITE_BUFFERED_TRANSFER_H
+
+#include <LimeSuiteConfig.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+namespace lime
+{
+
+/** @brief Keeps blocking stream transfers running while the streaming thread processes data.
+
+    For connections without asynchronous transfers (device files, pipes) the
+    I/O thread reads into or writes from a ring of buffers, so the next
+    transfer proceeds while the previous buffer is being parsed or formed.
+    Rx: Acquire() returns the next received buffer, Release() gives it back for reading.
+    Tx: Acquire() returns a free buffer, Release() queues it for sending.
+*/
+class LIME_API BufferedTransfer
+{
+public:
+    /** @brief Transfers data to or from device
+        @return number of bytes transferred, negative on error
+    */
+    typedef std::function<int(char* buffer, int length, int timeout_ms)> TransferFunction;
+
+    /** @brief Called by I/O thread when Tx buffer is sent
+        @param requested number of bytes queued
+        @param transferred number of bytes sent
+        @param tag value given to Release()
+    */
+    typedef std::function<void(int requested, int transferred, uint64_t tag)> CompletionCallback;
+
+    BufferedTransfer(const TransferFunction& transfer, const bool isTx, const uint32_t bufferSize, const uint32_t buffersCount,
+        const CompletionCallback& onComplete = nullptr);
+    ~BufferedTransfer();
+
+    /** @brief Waits for received data (Rx) or for a free buffer (Tx)
+        @param bytes (Rx) number of bytes in returned buffer
+        @param timeout_ms wait timeout
+        @return buffer, nullptr on timeout
+    */
+    char* Acquire(int* bytes, const int timeout_ms);
+
+    /** @brief Returns buffer for reading (Rx) or queues buffer for sending (Tx)
+        @param bytes (Tx) number of bytes to send
+        @param tag (Tx) value passed to completion callback
+    */
+    void Release(const int bytes = 0, const uint64_t tag = 0);
+
+    /** @brief Waits until all queued Tx buffers are sent
+        @return true if queue is empty
+    */
+    bool WaitIdle(const int timeout_ms);
+
+    uint32_t GetBufferSize() const;
+    //! number of transfers which returned less data than requested
+    uint32_t GetFailuresCount() const;
+
+private:
+    struct Slot
+    {
+        std::vector<char> data;
+        int bytes;
+        uint64_t tag;
+    };
+    void TransferLoop();
+
+    TransferFunction mTransfer;
+    CompletionCallback mOnComplete;
+    const bool mIsTx;
+    const uint32_t mBufferSize;
+    std::vector<Slot> mSlots;
+    size_t mIoIndex; //next slot processed by I/O thread
+    size_t mUserIndex; //next slot given to user
+    size_t mReady; //Rx: received slots not yet released, Tx: slots queued for sending
+    std::mutex mLock;
+    std::condition_variable mUserCond;
+    std::condition_variable mIoCond;
+    std::atomic<bool> mTerminate;
+    std::atomic<uint32_t> mFailures;
+    std::thread mThread;
+};
+
+}
+
+#endif
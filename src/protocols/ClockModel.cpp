@@ -0,0 +1,128 @@
+/**
+@file ClockModel.cpp
+@author Lime Microsystems
+@brief Host monotonic clock to device timestamp correlation
+*/
+
+#include "ClockModel.h"
+#include <cmath>
+
+using namespace lime;
+
+static const double timeConstant_s = 2.0; //weight of older measurements decays with this time constant
+static const double minRateSpan_s = 0.05; //measurements span required before estimating rate
+static const double maxResidual_s = 0.1; //larger jumps mean counter was reset
+
+static int64_t ToNanoseconds(const ClockModel::clock::time_point t)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+ClockModel::ClockModel() :
+    mSequence(0),
+    mHostTime_ns(0),
+    mTicks(0),
+    mOffset(0),
+    mRate(0),
+    mValid(false)
+{
+    Reset(0);
+}
+
+void ClockModel::Reset(const double nominalRate)
+{
+    mNominalRate = nominalRate;
+    mEstimatedRate = nominalRate;
+    mHasLast = false;
+    mLastHost_ns = 0;
+    mLastTicks = 0;
+    W = Sx = Sy = Sxx = Sxy = 0;
+    mValid.store(false);
+}
+
+void ClockModel::Update(const clock::time_point hostTime, const uint64_t ticks)
+{
+    const int64_t host_ns = ToNanoseconds(hostTime);
+    const double rate = mEstimatedRate;
+    if (mHasLast)
+    {
+        const double dx = (host_ns - mLastHost_ns)*1e-9;
+        const double dy = double(int64_t(ticks - mLastTicks));
+        if (ticks < mLastTicks || (rate > 0 && std::fabs(dy - rate*dx) > maxResidual_s*rate))
+            Reset(mNominalRate);
+        else
+        {
+            //forget older measurements and move origin to the new measurement
+            const double lambda = std::exp(-dx/timeConstant_s);
+            W *= lambda; Sx *= lambda; Sy *= lambda; Sxx *= lambda; Sxy *= lambda;
+            Sxx += -2*dx*Sx + dx*dx*W;
+            Sxy += -dx*Sy - dy*Sx + dx*dy*W;
+            Sx -= dx*W;
+            Sy -= dy*W;
+        }
+    }
+    W += 1;
+    mHasLast = true;
+    mLastHost_ns = host_ns;
+    mLastTicks = ticks;
+
+    double slope = rate;
+    const double variance = W*Sxx - Sx*Sx;
+    if (W > 2 && Sxx/W > minRateSpan_s*minRateSpan_s/4 && variance > 0)
+        slope = (W*Sxy - Sx*Sy)/variance;
+    const double intercept = (Sy - slope*Sx)/W;
+    mEstimatedRate = slope;
+
+    //publish, readers retry while sequence is odd or changed
+    const uint32_t seq = mSequence.load(std::memory_order_relaxed);
+    mSequence.store(seq+1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    mHostTime_ns.store(host_ns, std::memory_order_relaxed);
+    mTicks.store(ticks, std::memory_order_relaxed);
+    mOffset.store(intercept, std::memory_order_relaxed);
+    mRate.store(slope, std::memory_order_relaxed);
+    mSequence.store(seq+2, std::memory_order_release);
+    mValid.store(true, std::memory_order_release);
+}
+
+ClockModel::Parameters ClockModel::Load() const
+{
+    Parameters p;
+    uint32_t seq;
+    do
+    {
+        seq = mSequence.load(std::memory_order_acquire);
+        p.hostTime_ns = mHostTime_ns.load(std::memory_order_relaxed);
+        p.ticks = mTicks.load(std::memory_order_relaxed);
+        p.offset = mOffset.load(std::memory_order_relaxed);
+        p.rate = mRate.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) || seq != mSequence.load(std::memory_order_relaxed));
+    return p;
+}
+
+bool ClockModel::IsValid() const
+{
+    return mValid.load(std::memory_order_acquire);
+}
+
+uint64_t ClockModel::GetTicks(const clock::time_point hostTime) const
+{
+    const Parameters p = Load();
+    const double ticks = p.offset + p.rate*(ToNanoseconds(hostTime) - p.hostTime_ns)*1e-9;
+    return p.ticks + int64_t(std::floor(ticks + 0.5));
+}
+
+ClockModel::clock::time_point ClockModel::GetHostTime(const uint64_t ticks) const
+{
+    const Parameters p = Load();
+    if (p.rate <= 0)
+        return clock::time_point(std::chrono::nanoseconds(p.hostTime_ns));
+    const double dt_s = (double(int64_t(ticks - p.ticks)) - p.offset)/p.rate;
+    return clock::time_point(std::chrono::nanoseconds(p.hostTime_ns + int64_t(dt_s*1e9)));
+}
+
+double ClockModel::GetRate() const
+{
+    return Load().rate;
+}
@@ -0,0 +1,83 @@
+/**
+@file ClockModel.h
+@author Lime Microsystems
+@brief Host monotonic clock to device timestamp correlation
+*/
+
+#ifndef LIMESUITE_CLOCK_MODEL_H
+#define LIMESUITE_CLOCK_MODEL_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace lime
+{
+
+/** @brief Linear model of device timestamp counter against host steady clock.
+
+    Streaming thread feeds timestamps of received packets together with their
+    arrival time. Offset and tick rate are estimated by exponentially weighted
+    least squares, so the model follows slow clock drift. Readers convert
+    between host time and device ticks without locking or device I/O.
+*/
+class ClockModel
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    ClockModel();
+
+    /** @brief Forgets all measurements
+        @param nominalRate expected tick rate, used until rate can be estimated
+    */
+    void Reset(const double nominalRate);
+
+    /** @brief Adds measurement, called only from one thread
+        @param hostTime arrival time of data
+        @param ticks device timestamp of the data
+    */
+    void Update(const clock::time_point hostTime, const uint64_t ticks);
+
+    //! true when at least one measurement is available
+    bool IsValid() const;
+
+    //! estimated device timestamp at given host time
+    uint64_t GetTicks(const clock::time_point hostTime = clock::now()) const;
+
+    //! estimated host time of given device timestamp
+    clock::time_point GetHostTime(const uint64_t ticks) const;
+
+    //! estimated tick rate in Hz
+    double GetRate() const;
+
+private:
+    struct Parameters
+    {
+        int64_t hostTime_ns;
+        uint64_t ticks;
+        double offset; //ticks at hostTime, relative to ticks
+        double rate;
+    };
+    Parameters Load() const;
+
+    //regression state, used only by updating thread
+    double mNominalRate;
+    double mEstimatedRate;
+    bool mHasLast;
+    int64_t mLastHost_ns;
+    uint64_t mLastTicks;
+    double W, Sx, Sy, Sxx, Sxy;
+
+    //published model, written under sequence counter
+    std::atomic<uint32_t> mSequence;
+    std::atomic<int64_t> mHostTime_ns;
+    std::atomic<uint64_t> mTicks;
+    std::atomic<double> mOffset;
+    std::atomic<double> mRate;
+    std::atomic<bool> mValid;
+};
+
+}
+
+#endif
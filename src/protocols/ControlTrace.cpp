@@ -0,0 +1,356 @@
+/**
+@file ControlTrace.cpp
+@author Lime Microsystems
+@brief Binary trace of control packet transfers
+*/
+
+#include "ControlTrace.h"
+#include "ErrorReporting.h"
+#include "Logger.h"
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+
+using namespace lime;
+
+namespace
+{
+
+const char traceMagic[4] = {'L', 'C', 'T', 'R'};
+const uint32_t traceVersion = 1;
+const size_t threadBufferSize = 1 << 20;
+
+//fixed part of each record, followed by label, out and in data
+struct RecordHeader
+{
+    uint32_t size; //!< whole record size in bytes
+    uint32_t threadId;
+    uint64_t timestamp;
+    uint32_t duration;
+    uint32_t callId;
+    uint8_t cmd;
+    uint8_t status;
+    uint8_t periphID;
+    uint8_t labelLength;
+    uint16_t outLength;
+    uint16_t inLength;
+};
+
+/** Records are written only by owning thread. Readers take the lock and
+    consume [flushed, used), owner takes the lock only to rewind full buffer.
+*/
+struct ThreadBuffer
+{
+    ThreadBuffer(uint32_t id) : data(threadBufferSize), used(0), flushed(0), threadId(id), exited(false) {}
+    std::mutex lock;
+    std::vector<char> data;
+    std::atomic<size_t> used;
+    size_t flushed;
+    uint32_t threadId;
+    bool exited; //!< owning thread has ended, buffer is removed once flushed
+};
+
+std::atomic<bool> traceEnabled(false);
+std::atomic<uint32_t> callCounter(0);
+std::atomic<uint32_t> threadCounter(0);
+std::atomic<uint64_t> droppedRecords(0);
+std::mutex registryLock;
+std::vector<std::shared_ptr<ThreadBuffer>> registry;
+std::mutex outputLock;
+std::ofstream output;
+
+//caller holds buffer lock
+void WriteBuffer(ThreadBuffer& buf, std::ofstream& file)
+{
+    const size_t used = buf.used.load(std::memory_order_acquire);
+    if (used > buf.flushed)
+        file.write(&buf.data[buf.flushed], used - buf.flushed);
+}
+
+//caller holds buffer lock
+void FlushBuffer(ThreadBuffer& buf)
+{
+    std::lock_guard<std::mutex> lock(outputLock);
+    if (output.is_open())
+        WriteBuffer(buf, output);
+    buf.flushed = buf.used.load(std::memory_order_acquire);
+}
+
+//removes buffers of ended threads which have no records left in memory
+void PruneRegistry()
+{
+    std::lock_guard<std::mutex> lock(registryLock);
+    registry.erase(std::remove_if(registry.begin(), registry.end(), [](const std::shared_ptr<ThreadBuffer>& buf)
+    {
+        std::lock_guard<std::mutex> bufLock(buf->lock);
+        return buf->exited && buf->flushed == buf->used.load(std::memory_order_acquire);
+    }), registry.end());
+}
+
+//marks buffer of ending thread, its records are written out if trace has output file
+struct LocalBuffer
+{
+    ~LocalBuffer()
+    {
+        if (!buffer)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(buffer->lock);
+            buffer->exited = true;
+            std::lock_guard<std::mutex> outLock(outputLock);
+            if (output.is_open())
+            {
+                WriteBuffer(*buffer, output);
+                buffer->flushed = buffer->used.load(std::memory_order_acquire);
+            }
+        }
+        buffer.reset();
+        PruneRegistry();
+    }
+    std::shared_ptr<ThreadBuffer> buffer;
+};
+
+thread_local LocalBuffer localBuffer;
+thread_local const char* scopeLabel = nullptr;
+thread_local uint32_t scopeCallId = 0;
+
+ThreadBuffer* GetThreadBuffer()
+{
+    if (!localBuffer.buffer)
+    {
+        localBuffer.buffer = std::make_shared<ThreadBuffer>(++threadCounter);
+        std::lock_guard<std::mutex> lock(registryLock);
+        registry.push_back(localBuffer.buffer);
+    }
+    return localBuffer.buffer.get();
+}
+
+void WriteFileHeader(std::ofstream& file)
+{
+    file.write(traceMagic, sizeof(traceMagic));
+    file.write((const char*)&traceVersion, sizeof(traceVersion));
+}
+
+//starts tracing from environment, remaining records are written at exit
+struct EnvironmentTrace
+{
+    EnvironmentTrace()
+    {
+        const char* filename = std::getenv("LIMESUITE_CONTROL_TRACE");
+        if (filename != nullptr && filename[0] != 0)
+            ControlTrace::Start(filename);
+    }
+    ~EnvironmentTrace()
+    {
+        if (ControlTrace::IsEnabled())
+            ControlTrace::Stop();
+    }
+} environmentTrace;
+
+}
+
+ControlTrace::Scope::Scope(const char* label) :
+    mOwner(false)
+{
+    if (scopeLabel != nullptr || !traceEnabled.load(std::memory_order_relaxed))
+        return;
+    mOwner = true;
+    scopeLabel = label;
+    scopeCallId = ++callCounter;
+}
+
+ControlTrace::Scope::~Scope()
+{
+    if (!mOwner)
+        return;
+    scopeLabel = nullptr;
+    scopeCallId = 0;
+}
+
+int ControlTrace::Start(const std::string& filename)
+{
+    {
+        std::lock_guard<std::mutex> lock(outputLock);
+        if (output.is_open())
+            output.close();
+        if (!filename.empty())
+        {
+            output.open(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!output.good())
+                return ReportError(EIO, "Failed to create control trace %s", filename.c_str());
+            WriteFileHeader(output);
+        }
+    }
+    //records of previous trace are skipped
+    {
+        std::lock_guard<std::mutex> lock(registryLock);
+        for (auto& buf : registry)
+        {
+            std::lock_guard<std::mutex> bufLock(buf->lock);
+            buf->flushed = buf->used.load(std::memory_order_acquire);
+        }
+    }
+    PruneRegistry();
+    droppedRecords.store(0);
+    traceEnabled.store(true);
+    return 0;
+}
+
+int ControlTrace::Stop()
+{
+    traceEnabled.store(false);
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(registryLock);
+        buffers = registry;
+    }
+    for (auto& buf : buffers)
+    {
+        std::lock_guard<std::mutex> lock(buf->lock);
+        FlushBuffer(*buf);
+    }
+    buffers.clear();
+    PruneRegistry();
+    std::lock_guard<std::mutex> lock(outputLock);
+    if (output.is_open())
+        output.close();
+    if (droppedRecords.load() > 0)
+        lime::warning("Control trace: %llu records discarded, buffer was full", (unsigned long long)droppedRecords.load());
+    return 0;
+}
+
+bool ControlTrace::IsEnabled()
+{
+    return traceEnabled.load(std::memory_order_relaxed);
+}
+
+int ControlTrace::Dump(const std::string& filename)
+{
+    std::ofstream file(filename, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.good())
+        return ReportError(EIO, "Failed to create %s", filename.c_str());
+    WriteFileHeader(file);
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(registryLock);
+        buffers = registry;
+    }
+    for (auto& buf : buffers)
+    {
+        std::lock_guard<std::mutex> lock(buf->lock);
+        WriteBuffer(*buf, file);
+    }
+    return file.good() ? 0 : ReportError(EIO, "Failed to write %s", filename.c_str());
+}
+
+void ControlTrace::Add(const uint8_t cmd, const uint8_t status, const uint8_t periphID,
+    const uint8_t* out, const size_t outLength, const uint8_t* in, const size_t inLength,
+    const uint64_t startTime, const uint64_t endTime)
+{
+    if (!traceEnabled.load(std::memory_order_relaxed))
+        return;
+    RecordHeader hdr;
+    hdr.labelLength = scopeLabel ? std::min<size_t>(strlen(scopeLabel), 255) : 0;
+    hdr.outLength = std::min<size_t>(outLength, 0xFFFF);
+    hdr.inLength = std::min<size_t>(inLength, 0xFFFF);
+    hdr.size = sizeof(RecordHeader) + hdr.labelLength + hdr.outLength + hdr.inLength;
+    if (hdr.size > threadBufferSize)
+        return;
+
+    ThreadBuffer* buf = GetThreadBuffer();
+    hdr.threadId = buf->threadId;
+    hdr.timestamp = startTime;
+    hdr.duration = std::min<uint64_t>(endTime - startTime, 0xFFFFFFFF);
+    hdr.callId = scopeCallId;
+    hdr.cmd = cmd;
+    hdr.status = status;
+    hdr.periphID = periphID;
+
+    size_t used = buf->used.load(std::memory_order_relaxed);
+    if (used + hdr.size > buf->data.size())
+    {
+        //rewind, records are written to file or discarded
+        std::lock_guard<std::mutex> lock(buf->lock);
+        bool toFile;
+        {
+            std::lock_guard<std::mutex> outLock(outputLock);
+            toFile = output.is_open();
+        }
+        if (!toFile)
+        {
+            //count discarded records
+            for (size_t pos = buf->flushed; pos < used; pos += ((const RecordHeader*)&buf->data[pos])->size)
+                ++droppedRecords;
+        }
+        FlushBuffer(*buf);
+        buf->flushed = 0;
+        buf->used.store(0, std::memory_order_release);
+        used = 0;
+    }
+    char* dest = &buf->data[used];
+    memcpy(dest, &hdr, sizeof(hdr));
+    dest += sizeof(hdr);
+    if (hdr.labelLength)
+        memcpy(dest, scopeLabel, hdr.labelLength);
+    dest += hdr.labelLength;
+    memcpy(dest, out, hdr.outLength);
+    dest += hdr.outLength;
+    memcpy(dest, in, hdr.inLength);
+    buf->used.store(used + hdr.size, std::memory_order_release);
+}
+
+uint64_t ControlTrace::Now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int ControlTrace::Load(const std::string& filename, std::vector<Record>& records)
+{
+    records.clear();
+    std::ifstream file(filename, std::ios::in | std::ios::binary);
+    if (!file.good())
+        return ReportError(ENOENT, "Failed to open %s", filename.c_str());
+    char magic[4];
+    uint32_t version = 0;
+    file.read(magic, sizeof(magic));
+    file.read((char*)&version, sizeof(version));
+    if (!file.good() || memcmp(magic, traceMagic, sizeof(magic)) != 0)
+        return ReportError(EINVAL, "%s is not a control trace", filename.c_str());
+    if (version != traceVersion)
+        return ReportError(EINVAL, "Unsupported control trace version %u", version);
+
+    RecordHeader hdr;
+    while (file.read((char*)&hdr, sizeof(hdr)))
+    {
+        if (hdr.size != sizeof(hdr) + hdr.labelLength + hdr.outLength + hdr.inLength)
+            return ReportError(EINVAL, "Corrupted control trace record at %llu", (unsigned long long)records.size());
+        Record rec;
+        rec.timestamp = hdr.timestamp;
+        rec.duration = hdr.duration;
+        rec.threadId = hdr.threadId;
+        rec.callId = hdr.callId;
+        rec.cmd = hdr.cmd;
+        rec.status = hdr.status;
+        rec.periphID = hdr.periphID;
+        rec.label.resize(hdr.labelLength);
+        rec.out.resize(hdr.outLength);
+        rec.in.resize(hdr.inLength);
+        file.read(&rec.label[0], hdr.labelLength);
+        file.read((char*)rec.out.data(), hdr.outLength);
+        file.read((char*)rec.in.data(), hdr.inLength);
+        if (!file.good())
+            return ReportError(EINVAL, "Truncated control trace record at %llu", (unsigned long long)records.size());
+        records.push_back(std::move(rec));
+    }
+    std::stable_sort(records.begin(), records.end(), [](const Record& a, const Record& b)
+    {
+        return a.timestamp < b.timestamp;
+    });
+    return 0;
+}
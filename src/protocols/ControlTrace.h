@@ -0,0 +1,92 @@
+/**
+@file ControlTrace.h
+@author Lime Microsystems
+@brief Binary trace of control packet transfers
+*/
+
+#ifndef LIMESUITE_CONTROL_TRACE_H
+#define LIMESUITE_CONTROL_TRACE_H
+
+#include <LimeSuiteConfig.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace lime
+{
+
+/** @brief Records every control packet transfer into binary trace.
+
+    Each transfer is stored with command, status, outgoing and returned payload,
+    start time, duration and name of API call that caused it. Records are
+    appended to buffer of calling thread without locking, buffers are written
+    to file when full, on Stop() or on Dump(). Without output file full buffer
+    discards its older records. Buffer of ended thread is freed once its
+    records are written out, at thread exit when tracing to file, otherwise
+    on the next Start() or Stop().
+
+    Tracing can also be started by setting LIMESUITE_CONTROL_TRACE environment
+    variable to output file name, trace is then written at program exit.
+*/
+class LIME_API ControlTrace
+{
+public:
+    struct Record
+    {
+        uint64_t timestamp; //!< transfer start, steady clock nanoseconds
+        uint32_t duration; //!< transfer duration in nanoseconds
+        uint32_t threadId; //!< sequential id of calling thread
+        uint32_t callId; //!< API call instance, 0 when issued outside of API call
+        uint8_t cmd;
+        uint8_t status;
+        uint8_t periphID;
+        std::string label; //!< API call name
+        std::vector<uint8_t> out; //!< data sent to device
+        std::vector<uint8_t> in; //!< data returned by device
+    };
+
+    /** @brief Names API call for transfers issued in its lifetime,
+        transfers of nested scopes belong to outermost one
+    */
+    class LIME_API Scope
+    {
+    public:
+        Scope(const char* label);
+        ~Scope();
+    private:
+        bool mOwner;
+    };
+
+    /** @brief Starts tracing
+        @param filename output file, empty to keep records only in memory
+        @return 0 on success, -1 on failure
+    */
+    static int Start(const std::string& filename = "");
+
+    /** @brief Stops tracing, remaining records are written to output file */
+    static int Stop();
+
+    static bool IsEnabled();
+
+    /** @brief Writes records which are still in memory to given file */
+    static int Dump(const std::string& filename);
+
+    /** @brief Appends transfer record to calling thread buffer */
+    static void Add(const uint8_t cmd, const uint8_t status, const uint8_t periphID,
+        const uint8_t* out, const size_t outLength, const uint8_t* in, const size_t inLength,
+        const uint64_t startTime, const uint64_t endTime);
+
+    /** @brief Timestamp for records, steady clock nanoseconds */
+    static uint64_t Now();
+
+    /** @brief Reads trace file, records are sorted by start time
+        @return 0 on success, -1 on failure
+    */
+    static int Load(const std::string& filename, std::vector<Record>& records);
+};
+
+}
+
+#define LIME_TRACE_SCOPE() lime::ControlTrace::Scope limeTraceScope(__func__)
+
+#endif
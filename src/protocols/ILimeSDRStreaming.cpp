@@ -5,18 +5,31 @@
 #include "LMS7002M.h"
 #include <ciso646>
 #include "Logger.h"
+#include "WaveformFile.h"
+#include "StreamChannelizer.h"
+#include <algorithm>
 
 using namespace lime;
 
+static const uint32_t defaultBufferTime_ms = 200;
+static const size_t defaultBufferLength = 1024*8*SamplesPacket::maxSamplesInPacket; //when sample rate is not known
+static const size_t minBufferPackets = 64;
+static const size_t defaultStreamMemoryBudget = 512 << 20;
+
 static const int MAX_CHANNEL_COUNT = 4;
 
-ILimeSDRStreaming::ILimeSDRStreaming()
+ILimeSDRStreaming::ILimeSDRStreaming() :
+    mExpectedSampleRate(0),
+    mStreamMemoryBudget(defaultStreamMemoryBudget),
+    mStreamMemoryUsed(0)
 {
     for (int i = 0; i < MAX_CHANNEL_COUNT/2; i++)
     	mStreamers.push_back(new Streamer(this));
 }
 ILimeSDRStreaming::~ILimeSDRStreaming()
 {
+    for (auto channelizer : mChannelizers)
+        delete channelizer;
     for (unsigned i = 0; i < mStreamers.size() ; i++)
         delete mStreamers[i];
 }
@@ -25,19 +38,95 @@ int ILimeSDRStreaming::SetupStream(size_t& streamID, const StreamConfig& config)
 {
     if ( config.channelID >= MAX_CHANNEL_COUNT)
         return -1;
+    if (config.channelizerRate > 0)
+    {
+        StreamChannelizer* channelizer = nullptr;
+        for (auto c : mChannelizers)
+            if (c->GetChannel() == config.channelID)
+                channelizer = c;
+        if (channelizer == nullptr)
+        {
+            channelizer = new StreamChannelizer(this, config.channelID);
+            mChannelizers.push_back(channelizer);
+        }
+        IStreamChannel* output = channelizer->AddOutput(config);
+        if (output == nullptr)
+        {
+            if (channelizer->IsEmpty())
+            {
+                mChannelizers.erase(std::find(mChannelizers.begin(), mChannelizers.end(), channelizer));
+                delete channelizer;
+            }
+            return -1;
+        }
+        streamID = size_t(output);
+        return 0;
+    }
     unsigned index = config.channelID/2;
     while (index >= mStreamers.size())
        mStreamers.push_back(new Streamer(this));
     return mStreamers[index]->SetupStream(streamID,config);
 }
 
+StreamChannelizer* ILimeSDRStreaming::FindChannelizer(const size_t streamID) const
+{
+    for (auto channelizer : mChannelizers)
+        if (channelizer->HasOutput(streamID))
+            return channelizer;
+    return nullptr;
+}
+
+int ILimeSDRStreaming::SetStreamMemoryBudget(const size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mStreamMemoryLock);
+    mStreamMemoryBudget = bytes;
+    if (mStreamMemoryUsed > bytes)
+        lime::warning("Existing streams use %zu bytes, over the new budget", mStreamMemoryUsed);
+    return 0;
+}
+
+int ILimeSDRStreaming::ReserveStreamMemory(size_t& packets, const size_t minPackets, const size_t packetMemory)
+{
+    std::lock_guard<std::mutex> lock(mStreamMemoryLock);
+    const size_t available = mStreamMemoryBudget > mStreamMemoryUsed ? (mStreamMemoryBudget - mStreamMemoryUsed)/packetMemory : 0;
+    if (packets > available)
+    {
+        if (available < minPackets)
+            return ReportError(ENOMEM, "Stream memory budget exhausted (%zu bytes in use)", mStreamMemoryUsed);
+        lime::warning("Stream buffer reduced to %zu samples to fit memory budget", available*SamplesPacket::maxSamplesInPacket);
+        packets = available;
+    }
+    mStreamMemoryUsed += packets*packetMemory;
+    return 0;
+}
+
+void ILimeSDRStreaming::ReleaseStreamMemory(const size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mStreamMemoryLock);
+    mStreamMemoryUsed -= std::min(bytes, mStreamMemoryUsed);
+}
+
 int ILimeSDRStreaming::CloseStream(const size_t streamID)
 {
+    StreamChannelizer* channelizer = FindChannelizer(streamID);
+    if (channelizer != nullptr)
+    {
+        const int status = channelizer->RemoveOutput(streamID);
+        if (channelizer->IsEmpty())
+        {
+            mChannelizers.erase(std::find(mChannelizers.begin(), mChannelizers.end(), channelizer));
+            delete channelizer;
+        }
+        return status;
+    }
     auto *stream = (StreamChannel* )streamID;
     return stream->mStreamer->CloseStream(streamID);
 }
 size_t ILimeSDRStreaming::GetStreamSize(const size_t streamID)
 {
+    StreamChannelizer* channelizer = FindChannelizer(streamID);
+    if (channelizer != nullptr)
+        return GetStreamSize(channelizer->GetStreamID());
     auto *stream = (StreamChannel* )streamID;
     return stream->mStreamer->GetStreamSize();
 }
@@ -74,6 +163,7 @@ int ILimeSDRStreaming::WriteStream(const size_t streamID, const void* buffs, con
     lime::IStreamChannel::Metadata meta;
     meta.flags = 0;
     meta.flags |= metadata.hasTimestamp ? lime::IStreamChannel::Metadata::SYNC_TIMESTAMP : 0;
+    meta.flags |= metadata.endOfBurst ? lime::IStreamChannel::Metadata::END_BURST : 0;
     meta.timestamp = metadata.timestamp;
     int status = channel->Write(buffs, length, &meta, timeout_ms);
     return status;
@@ -82,27 +172,36 @@ int ILimeSDRStreaming::WriteStream(const size_t streamID, const void* buffs, con
 int ILimeSDRStreaming::ReadStreamStatus(const size_t streamID, const long timeout_ms, StreamMetadata& metadata)
 {
     assert(streamID != 0);
-    StreamChannel* channel = (StreamChannel*)streamID;
+    //channelizer outputs report events of their device stream
+    StreamChannelizer* channelizer = FindChannelizer(streamID);
+    StreamChannel* channel = (StreamChannel*)(channelizer ? channelizer->GetStreamID() : streamID);
 
-    //support late timestamp reporting
-    auto txLastLateTime = channel->mStreamer->txLastLateTime.exchange(0);
-    if (txLastLateTime != 0)
+    StreamEventFIFO& events = channel->config.isTx ? channel->mStreamer->txEvents : channel->mStreamer->rxEvents;
+    StreamEvent event;
+    if (!events.pop(event, timeout_ms))
     {
-        metadata.hasTimestamp = true;
-        metadata.timestamp = txLastLateTime;
-        metadata.lateTimestamp = true;
-        metadata.packetDropped = true;
-        return 0;
+        ReportError(ETIMEDOUT, "No stream status events");
+        return -1;
     }
 
-    IStreamChannel::Info info = channel->GetInfo();
     metadata.hasTimestamp = true;
-    metadata.timestamp = info.timestamp;
-    metadata.lateTimestamp = info.underrun > 0;
-    metadata.packetDropped = info.droppedPackets > 0;
+    metadata.timestamp = event.timestamp;
+    metadata.endOfBurst = event.type == StreamEvent::END_BURST;
+    metadata.lateTimestamp = event.type == StreamEvent::LATE;
+    metadata.underflow = event.type == StreamEvent::TX_UNDERFLOW;
+    metadata.packetDropped = event.type == StreamEvent::LATE
+                          || event.type == StreamEvent::RX_OVERFLOW
+                          || event.type == StreamEvent::PACKET_LOSS;
     return 0;
 }
 
+int ILimeSDRStreaming::ReadStreamMeters(const size_t streamID, StreamMeters& meters)
+{
+    assert(streamID != 0);
+    IStreamChannel* channel = (IStreamChannel*)streamID;
+    return channel->GetMeters(meters);
+}
+
 void ILimeSDRStreaming::EnterSelfCalibration(const size_t channel)
 {
     if (mStreamers.size() > channel/2)
@@ -140,8 +239,59 @@ int ILimeSDRStreaming::SendData(const char* buffer, int length, int epIndex, int
     return ReportError("Function not supported");
 }
 
+int ILimeSDRStreaming::SendDataAsync(const char* buffer, int length, int epIndex)
+{
+    return -1; //not supported, transfers are done by SendData
+}
+
+int ILimeSDRStreaming::WaitDataSent(const char* buffer, int length, int handle, int timeout_ms)
+{
+    return ReportError("Function not supported");
+}
+
 int ILimeSDRStreaming::UploadWFM(const void* const* samples, uint8_t chCount, size_t sample_count, StreamConfig::StreamDataFormat format, int epIndex)
 {
+    auto convert = [samples, chCount, format](size_t offset, size_t count, complex16_t* const* dest)
+    {
+        for (uint8_t ch = 0; ch < chCount; ++ch)
+        {
+            int16_t* dst = reinterpret_cast<int16_t*>(dest[ch]);
+            if (format == StreamConfig::STREAM_COMPLEX_FLOAT32)
+            {
+                const float* src = reinterpret_cast<const float*>(samples[ch]) + 2*offset;
+                for (size_t i = 0; i < 2*count; ++i)
+                    dst[i] = src[i]*2047.0f;
+            }
+            else
+                memcpy(dst, reinterpret_cast<const complex16_t*>(samples[ch]) + offset, count*sizeof(complex16_t));
+        }
+    };
+    return UploadWFMPackets(chCount, sample_count, epIndex, convert);
+}
+
+int ILimeSDRStreaming::UploadWFMFile(const std::string& filename, uint8_t chCount, int epIndex)
+{
+    WaveformFile file;
+    if (file.Open(filename) != 0)
+        return -1;
+    auto convert = [&file, chCount](size_t offset, size_t count, complex16_t* const* dest)
+    {
+        file.Convert(offset, count, dest[0]);
+        for (uint8_t ch = 1; ch < chCount; ++ch)
+        {
+            if (file.GetChannelsCount() > ch)
+                file.Convert(offset, count, dest[ch], ch);
+            else
+                memcpy(dest[ch], dest[0], count*sizeof(complex16_t));
+        }
+    };
+    return UploadWFMPackets(chCount, file.GetSamplesCount(), epIndex, convert);
+}
+
+int ILimeSDRStreaming::UploadWFMPackets(uint8_t chCount, size_t sample_count, int epIndex, const std::function<void(size_t, size_t, complex16_t* const*)>& convert)
+{
+    if (chCount < 1 || chCount > 2)
+        return ReportError(EINVAL, "Waveform supports 1 or 2 channels");
     WriteRegister(0x000C, chCount == 2 ? 0x3 : 0x1); //channels 0,1
     WriteRegister(0x000E, 0x2); //12bit samples
 
@@ -150,70 +300,167 @@ int ILimeSDRStreaming::UploadWFM(const void* const* samples, uint8_t chCount, si
     regValue |= 0x4 << (epIndex*2);
     WriteRegister(0x000D, regValue);
 
-    lime::FPGA_DataPacket pkt;
+    //packets are formed directly in transfer buffers, several transfers are kept in flight
+    const int samplesInPacket = 1360/chCount;
+    const int packetsToBatch = 16;
+    const int transfersCount = 8;
+    const size_t transferSize = packetsToBatch*sizeof(FPGA_DataPacket);
+    std::vector<char> buffers(transfersCount*transferSize);
+    std::vector<int> handles(transfersCount, -1);
+    std::vector<int> lengths(transfersCount, 0);
+    std::vector<complex16_t> staging(chCount*samplesInPacket);
+    complex16_t* dest[2] = {staging.data(), staging.data() + samplesInPacket};
+
+    bool async = true;
+    bool failed = false;
     size_t samplesUsed = 0;
-    lime::complex16_t** samplesShort = new lime::complex16_t*[chCount];
-    for(unsigned i=0; i<chCount; ++i)
-        samplesShort[i] = nullptr;
-
-    const complex16_t* const* src = format == StreamConfig::STREAM_COMPLEX_FLOAT32 ? samplesShort :(const complex16_t* const*)samples;
-    int cnt = sample_count;
-    const lime::complex16_t** batch = new const lime::complex16_t*[chCount];
-
-    if(format == StreamConfig::STREAM_COMPLEX_FLOAT32)
+    int ti = 0;
+    while (samplesUsed < sample_count && !failed)
     {
-        for(unsigned i=0; i<chCount; ++i)
-            samplesShort[i] = new lime::complex16_t[sample_count];
-
-        const float* const* samplesFloat = (const float* const*)samples;
-        for (int ch = 0; ch < chCount; ch++)
-            for(size_t i=0; i < sample_count; ++i)
+        //reuse transfer buffer when its previous transfer completes
+        if (handles[ti] >= 0)
+        {
+            if (WaitDataSent(&buffers[ti*transferSize], lengths[ti], handles[ti], 1000) != lengths[ti])
+                failed = true;
+            handles[ti] = -1;
+        }
+        char* transfer = &buffers[ti*transferSize];
+        int length = 0;
+        for (int p = 0; p < packetsToBatch && samplesUsed < sample_count; ++p)
+        {
+            const int samplesToSend = std::min<size_t>(samplesInPacket, sample_count - samplesUsed);
+            convert(samplesUsed, samplesToSend, dest);
+            samplesUsed += samplesToSend;
+
+            FPGA_DataPacket* pkt = reinterpret_cast<FPGA_DataPacket*>(transfer + length);
+            pkt->counter = 0;
+            size_t bufPos = 0;
+            fpga::Samples2FPGAPacketPayload(dest, samplesToSend, chCount, StreamConfig::STREAM_12_BIT_COMPRESSED, pkt->data, &bufPos);
+            int payloadSize = (bufPos / 4) * 4;
+            if(bufPos % 4 != 0)
+                lime::error("Packet samples count not multiple of 4");
+            memset(pkt->reserved, 0, sizeof(pkt->reserved));
+            pkt->reserved[2] = (payloadSize >> 8) & 0xFF; //WFM loading
+            pkt->reserved[1] = payloadSize & 0xFF; //WFM loading
+            pkt->reserved[0] = 0x1 << 5; //WFM loading
+            length += 16+payloadSize;
+            if (payloadSize+16 != sizeof(FPGA_DataPacket))
+                break; //short packet can only be the last one in transfer
+        }
+        //some backends reconfigure the pipe when transfer size changes,
+        //so finish pending transfers before sending the shorter last one
+        if (async && length != int(transferSize))
+        {
+            for (int i = 0; i < transfersCount; ++i)
             {
-                samplesShort[ch][i].i = samplesFloat[ch][2*i]*2047.0f;
-                samplesShort[ch][i].q = samplesFloat[ch][2*i+1]*2047.0f;
+                if (handles[i] < 0)
+                    continue;
+                if (WaitDataSent(&buffers[i*transferSize], lengths[i], handles[i], 1000) != lengths[i])
+                    failed = true;
+                handles[i] = -1;
             }
+        }
+        if (async)
+        {
+            handles[ti] = SendDataAsync(transfer, length, epIndex);
+            lengths[ti] = length;
+            if (handles[ti] < 0)
+                async = false; //backend without asynchronous transfers
+        }
+        if (!async && SendData(transfer, length, epIndex, 500) != length)
+            failed = true;
+        ti = (ti + 1) % transfersCount;
     }
 
-    while(cnt > 0)
+    //upload is complete when device acknowledges all transfers
+    for (int i = 0; i < transfersCount; ++i)
     {
-        pkt.counter = 0;
-        pkt.reserved[0] = 0;
-        int samplesToSend = cnt > 1360/chCount ? 1360/chCount : cnt;
-        cnt -= samplesToSend;
-
-        for(unsigned i=0; i<chCount; ++i)
-            batch[i] = &src[i][samplesUsed];
-        samplesUsed += samplesToSend;
-
-        size_t bufPos = 0;
-        lime::fpga::Samples2FPGAPacketPayload(batch, samplesToSend, chCount, StreamConfig::STREAM_12_BIT_COMPRESSED, pkt.data, &bufPos);
-        int payloadSize = (bufPos / 4) * 4;
-        if(bufPos % 4 != 0)
-            lime::error("Packet samples count not multiple of 4");
-        pkt.reserved[2] = (payloadSize >> 8) & 0xFF; //WFM loading
-        pkt.reserved[1] = payloadSize & 0xFF; //WFM loading
-        pkt.reserved[0] = 0x1 << 5; //WFM loading
-
-        long bToSend = 16+payloadSize;
-        if (SendData((const char*)&pkt,bToSend,epIndex,500)!=bToSend)
-            break;
+        if (handles[i] < 0)
+            continue;
+        if (WaitDataSent(&buffers[i*transferSize], lengths[i], handles[i], 1000) != lengths[i])
+            failed = true;
     }
-    delete[] batch;
-    for(unsigned i=0; i<chCount; ++i)
-        if (samplesShort[i])
-            delete [] samplesShort[i];
-    delete[] samplesShort;
-
-    /*Give FX3 some time to load samples to FPGA*/
-    std::this_thread::sleep_for(std::chrono::milliseconds(300));
-    if(cnt == 0)
-        return 0;
-    else
+    if (failed)
         return ReportError(-1, "Failed to upload waveform");
+    return 0;
 }
 
-
 //-----------------------------------------------------------------------------
+static bool IsPackedFormat(const int format)
+{
+    return format == StreamConfig::STREAM_12_BIT_PACKED || format == StreamConfig::STREAM_8_BIT;
+}
+
+/** @brief Format of samples kept in channel's FIFO
+    Packed host formats are stored as delivered to user, Tx packets forming
+    and Rx packets parsing use 16 bit values otherwise.
+*/
+static int StorageFormat(const StreamConfig& config)
+{
+    if (IsPackedFormat(config.format))
+        return config.format;
+    if (config.packedStorage)
+        return StreamConfig::STREAM_12_BIT_PACKED;
+    return StreamConfig::STREAM_12_BIT_IN_16;
+}
+
+static uint8_t SampleSize(const int format)
+{
+    if (format == StreamConfig::STREAM_12_BIT_PACKED)
+        return 3;
+    if (format == StreamConfig::STREAM_8_BIT)
+        return 2;
+    return sizeof(complex16_t);
+}
+
+static void PackSamples(const complex16_t* src, uint8_t* dest, const size_t count, const int format)
+{
+    if (format == StreamConfig::STREAM_8_BIT)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            dest[2*i] = src[i].i >> 4;
+            dest[2*i+1] = src[i].q >> 4;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            dest[3*i] = src[i].i & 0xFF;
+            dest[3*i+1] = ((src[i].i >> 8) & 0x0F) | ((src[i].q << 4) & 0xF0);
+            dest[3*i+2] = (src[i].q >> 4) & 0xFF;
+        }
+    }
+}
+
+//! @brief Expands packed samples to 16 bit values, going backwards allows in place conversion
+static void UnpackSamples(const uint8_t* src, complex16_t* dest, const size_t count, const int format)
+{
+    if (format == StreamConfig::STREAM_8_BIT)
+    {
+        const int8_t* values = reinterpret_cast<const int8_t*>(src);
+        for (size_t i = count; i-- > 0;)
+        {
+            const int8_t iValue = values[2*i];
+            const int8_t qValue = values[2*i+1];
+            dest[i].i = iValue * 16;
+            dest[i].q = qValue * 16;
+        }
+    }
+    else
+    {
+        for (size_t i = count; i-- > 0;)
+        {
+            const uint8_t b0 = src[3*i];
+            const uint8_t b1 = src[3*i+1];
+            const uint8_t b2 = src[3*i+2];
+            dest[i].i = int16_t((b0 | (b1 << 8)) << 4) >> 4;
+            dest[i].q = int16_t((b1 | (b2 << 8)) & 0xFFF0) >> 4;
+        }
+    }
+}
+
 ILimeSDRStreaming::StreamChannel::StreamChannel(Streamer* streamer, StreamConfig conf) :
     mActive(false)
 {
@@ -223,64 +470,114 @@ ILimeSDRStreaming::StreamChannel::StreamChannel(Streamer* streamer, StreamConfig
     underflow = 0;
     pktLost = 0;
 
-    if (this->config.bufferLength == 0) //default size
-        this->config.bufferLength = 1024*8*SamplesPacket::maxSamplesInPacket;
-    else
-    {
-        size_t fifoSize = 64;
-        while(fifoSize < conf.bufferLength/SamplesPacket::maxSamplesInPacket)
-            fifoSize <<= 1;
-        this->config.bufferLength = fifoSize*SamplesPacket::maxSamplesInPacket;
-    }
-    fifo = new RingFIFO(this->config.bufferLength);
+    //buffer length is already fitted to memory budget by Streamer
+    mStorageFormat = StorageFormat(config);
+    fifo = new RingFIFO(this->config.bufferLength, SampleSize(mStorageFormat));
+    mReservedMemory = RingFIFO::MemoryRequired(this->config.bufferLength, SampleSize(mStorageFormat));
+
+    uint32_t metersWindow = config.metersWindow;
+    if (metersWindow == 0)
+        metersWindow = uint32_t(mStreamer->dataPort->mExpectedSampleRate/100);
+    mMeter.SetWindow(metersWindow);
+    //otherwise measuring starts with the first GetMeters()
+    if (config.metersWindow != 0)
+        mMeter.Enable();
 }
 
 ILimeSDRStreaming::StreamChannel::~StreamChannel()
 {
     delete fifo;
+    mStreamer->dataPort->ReleaseStreamMemory(mReservedMemory);
 }
 
 int ILimeSDRStreaming::StreamChannel::Read(void* samples, const uint32_t count, Metadata* meta, const int32_t timeout_ms)
 {
     int popped = 0;
-    if(config.format == StreamConfig::STREAM_COMPLEX_FLOAT32 && !config.isTx)
+    //skip older samples inside FIFO instead of reading and discarding them
+    int32_t remaining_ms = timeout_ms;
+    if ((meta->flags & Metadata::SYNC_TIMESTAMP) && !config.isTx)
+    {
+        auto t1 = std::chrono::high_resolution_clock::now();
+        if (!fifo->seek_timestamp(meta->timestamp, timeout_ms))
+            return 0;
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - t1);
+        remaining_ms = std::max<int32_t>(0, timeout_ms - elapsed.count());
+    }
+    popped = fifo->pop_samples(samples, count, 1, &meta->timestamp, remaining_ms, &meta->flags);
+
+    //Tx samples are read for packets forming as 16 bit values
+    const int format = config.isTx ? StreamConfig::STREAM_12_BIT_IN_16 : config.format;
+    if (format == mStorageFormat)
+        return popped;
+    //in place conversion, samples only grow in size
+    if (IsPackedFormat(mStorageFormat))
+        UnpackSamples((const uint8_t*)samples, (complex16_t*)samples, popped, mStorageFormat);
+    if (format == StreamConfig::STREAM_COMPLEX_FLOAT32)
     {
-        //in place conversion
-        complex16_t* ptr = (complex16_t*)samples;
         int16_t* samplesShort = (int16_t*)samples;
         float* samplesFloat = (float*)samples;
-        popped = fifo->pop_samples(ptr, count, 1, &meta->timestamp, timeout_ms, &meta->flags);
         for(int i=2*popped-1; i>=0; --i)
             samplesFloat[i] = (float)samplesShort[i]/2048.0;
     }
-    else
-    {
-        complex16_t* ptr = (complex16_t*)samples;
-        popped = fifo->pop_samples(ptr, count, 1, &meta->timestamp, timeout_ms, &meta->flags);
-    }
     return popped;
 }
 
 int ILimeSDRStreaming::StreamChannel::Write(const void* samples, const uint32_t count, const Metadata *meta, const int32_t timeout_ms)
 {
-    int pushed = 0;
-    if(config.format == StreamConfig::STREAM_COMPLEX_FLOAT32 && config.isTx)
+    //Rx samples are written from packets parsing as 16 bit values
+    const int format = config.isTx ? config.format : StreamConfig::STREAM_12_BIT_IN_16;
+    const void* src = samples;
+    if(format == StreamConfig::STREAM_COMPLEX_FLOAT32)
     {
         const float* samplesFloat = (const float*)samples;
-        int16_t* samplesShort = new int16_t[2*count];
+        mConvertSamples.resize(count);
+        int16_t* samplesShort = (int16_t*)mConvertSamples.data();
         for(size_t i=0; i<2*count; ++i)
             samplesShort[i] = samplesFloat[i]*2047;
-        const complex16_t* ptr = (const complex16_t*)samplesShort ;
-        pushed = fifo->push_samples(ptr, count, 1, meta->timestamp, timeout_ms, meta->flags);
-        delete[] samplesShort;
+        src = mConvertSamples.data();
     }
-    //else if(config.format == StreamConfig::STREAM_12_BIT_IN_16)
-    else
+    else if(IsPackedFormat(format) && format != mStorageFormat)
+    {
+        mConvertSamples.resize(count);
+        memcpy(mConvertSamples.data(), samples, count*SampleSize(format));
+        UnpackSamples((const uint8_t*)mConvertSamples.data(), mConvertSamples.data(), count, format);
+        src = mConvertSamples.data();
+    }
+    if(IsPackedFormat(mStorageFormat) && format != mStorageFormat)
     {
-        const complex16_t* ptr = (const complex16_t*)samples;
-        pushed = fifo->push_samples(ptr, count, 1, meta->timestamp, timeout_ms, meta->flags);
+        mConvertBytes.resize(count*SampleSize(mStorageFormat));
+        PackSamples((const complex16_t*)src, mConvertBytes.data(), count, mStorageFormat);
+        src = mConvertBytes.data();
     }
-    return pushed;
+    return fifo->push_samples(src, count, 1, meta->timestamp, timeout_ms, meta->flags);
+}
+
+int ILimeSDRStreaming::StreamChannel::WritePayload(const uint8_t* payload, const uint32_t payloadSize, const uint8_t chIndex, const uint8_t chCount, const Metadata* meta, const int32_t timeout_ms)
+{
+    const int link = config.linkFormat;
+    size_t samplesCount = 0;
+    const uint8_t maxChannelCount = 2;
+    complex16_t* dest[maxChannelCount] = {nullptr, nullptr};
+    dest[chIndex] = mPayloadSamples;
+    if(IsPackedFormat(mStorageFormat))
+    {
+        //packed samples are stored without expanding, meters need them unpacked
+        if(mMeter.IsEnabled())
+        {
+            fpga::FPGAPacketPayload2Samples(payload, payloadSize, chCount, link, dest, &samplesCount);
+            mMeter.Accumulate(mPayloadSamples, samplesCount, meta->timestamp);
+        }
+        //single channel is stored directly from the wire
+        if(mStorageFormat == StreamConfig::STREAM_12_BIT_PACKED && link == StreamConfig::STREAM_12_BIT_COMPRESSED && chCount == 1)
+            return fifo->push_samples(payload, payloadSize/3, 1, meta->timestamp, timeout_ms, meta->flags);
+        uint8_t* packed = reinterpret_cast<uint8_t*>(mPayloadSamples);
+        fpga::FPGAPacketPayload2Packed(payload, payloadSize, chCount, chIndex, link, mStorageFormat, packed, &samplesCount);
+        return fifo->push_samples(packed, samplesCount, 1, meta->timestamp, timeout_ms, meta->flags);
+    }
+    fpga::FPGAPacketPayload2Samples(payload, payloadSize, chCount, link, dest, &samplesCount);
+    if(mMeter.IsEnabled())
+        mMeter.Accumulate(mPayloadSamples, samplesCount, meta->timestamp);
+    return fifo->push_samples(mPayloadSamples, samplesCount, 1, meta->timestamp, timeout_ms, meta->flags);
 }
 
 IStreamChannel::Info ILimeSDRStreaming::StreamChannel::GetInfo()
@@ -293,7 +590,7 @@ IStreamChannel::Info ILimeSDRStreaming::StreamChannel::GetInfo()
     stats.active = mActive;
     stats.droppedPackets = pktLost;
     stats.overrun = overflow;
-    stats.overrun = underflow;
+    stats.underrun = underflow;
     pktLost = 0;
     overflow = 0;
     underflow = 0;
@@ -304,6 +601,16 @@ IStreamChannel::Info ILimeSDRStreaming::StreamChannel::GetInfo()
     return stats;
 }
 
+int ILimeSDRStreaming::StreamChannel::GetMeters(StreamMeters& meters)
+{
+    if(config.isTx)
+        return ReportError(EINVAL, "Meters are available only for Rx streams");
+    mMeter.Enable();
+    if(!mMeter.Get(meters))
+        return ReportError(EAGAIN, "Meters window is not completed yet");
+    return 0;
+}
+
 bool ILimeSDRStreaming::StreamChannel::IsActive() const
 {
     return mActive;
@@ -345,9 +652,9 @@ ILimeSDRStreaming::Streamer::Streamer(ILimeSDRStreaming* port)
 ILimeSDRStreaming::Streamer::~Streamer()
 {
     for(auto i : mTxStreams)
-        CloseStream((size_t)i);
+        delete i;
     for(auto i : mRxStreams)
-        CloseStream((size_t)i);
+        delete i;
 }
 
 int ILimeSDRStreaming::Streamer::SetupStream(size_t& streamID, const StreamConfig& config)
@@ -355,7 +662,23 @@ int ILimeSDRStreaming::Streamer::SetupStream(size_t& streamID, const StreamConfi
     if(rxRunning.load() == true || txRunning.load() == true)
         return ReportError(EPERM, "All streams must be stopped before doing setups");
     streamID = ~0;
-    StreamChannel* stream = new StreamChannel(this,config);
+
+    //size FIFO by buffering time at current rate, within device memory budget
+    StreamConfig streamConfig = config;
+    size_t samples = config.bufferLength;
+    if (samples == 0)
+    {
+        const double rate = dataPort->mExpectedSampleRate;
+        const uint32_t time_ms = config.bufferTime_ms != 0 ? config.bufferTime_ms : defaultBufferTime_ms;
+        samples = rate > 0 ? size_t(rate*time_ms/1000) : defaultBufferLength;
+    }
+    const size_t packetSamples = SamplesPacket::maxSamplesInPacket;
+    const size_t packetMemory = RingFIFO::MemoryRequired(packetSamples, SampleSize(StorageFormat(config)));
+    size_t packets = std::max((samples + packetSamples - 1)/packetSamples, minBufferPackets);
+    if (dataPort->ReserveStreamMemory(packets, minBufferPackets, packetMemory) != 0)
+        return -1;
+    streamConfig.bufferLength = packets*packetSamples;
+    StreamChannel* stream = new StreamChannel(this, streamConfig);
     //TODO check for duplicate streams
     if(config.isTx)
         mTxStreams.push_back(stream);
@@ -428,6 +751,9 @@ void ILimeSDRStreaming::Streamer::ExitSelfCalibration()
 
 uint64_t ILimeSDRStreaming::Streamer::GetHardwareTimestamp(void)
 {
+    //estimate from clock model, does not require device access
+    if(clock.IsValid())
+        return clock.GetTicks()+mTimestampOffset;
     if(not rxRunning.load() and not txRunning.load())
     {
         //stop streaming just in case the board has not been configured
@@ -444,7 +770,8 @@ uint64_t ILimeSDRStreaming::Streamer::GetHardwareTimestamp(void)
 
 void ILimeSDRStreaming::Streamer::SetHardwareTimestamp(const uint64_t now)
 {
-    mTimestampOffset = now - rxLastTimestamp.load();
+    const uint64_t ticks = clock.IsValid() ? clock.GetTicks() : rxLastTimestamp.load();
+    mTimestampOffset = now - ticks;
 }
 
 int ILimeSDRStreaming::Streamer::UpdateThreads(bool stopAll)
@@ -492,6 +819,9 @@ int ILimeSDRStreaming::Streamer::UpdateThreads(bool stopAll)
         fpga::StopStreaming(dataPort, mChipID);
         fpga::ResetTimestamp(dataPort, mChipID);
         rxLastTimestamp.store(0);
+        clock.Reset(dataPort->mExpectedSampleRate);
+        txEvents.clear();
+        rxEvents.clear();
         //Clear device stream buffers
         dataPort->ResetStreamBuffers();
 
@@ -6,14 +6,19 @@
 #include <mutex>
 #include <condition_variable>
 #include <vector>
+#include <functional>
 
 #include "dataTypes.h"
 #include "fifo.h"
+#include "ClockModel.h"
+#include "SignalMeter.h"
 #include "LMS64CProtocol.h"
 
 namespace lime
 {
 
+class StreamChannelizer;
+
 class ILimeSDRStreaming : public LMS64CProtocol
 {
 public:
@@ -34,7 +39,12 @@ public:
 
         int Read(void* samples, const uint32_t count, Metadata* meta, const int32_t timeout_ms = 100);
         int Write(const void* samples, const uint32_t count, const Metadata* meta, const int32_t timeout_ms = 100);
+        /** @brief Parses this channel's samples from FPGA packet payload into FIFO
+            @return number of samples stored
+        */
+        int WritePayload(const uint8_t* payload, const uint32_t payloadSize, const uint8_t chIndex, const uint8_t chCount, const Metadata* meta, const int32_t timeout_ms = 100);
         StreamChannel::Info GetInfo();
+        int GetMeters(StreamMeters& meters);
 
         bool IsActive() const;
         int Start();
@@ -47,6 +57,12 @@ public:
     protected:
         RingFIFO* fifo;
         bool mActive;
+        complex16_t mPayloadSamples[SamplesPacket::maxSamplesInPacket];
+        int mStorageFormat; //!< format of samples kept in FIFO
+        size_t mReservedMemory; //!< bytes taken from device's stream memory budget
+        std::vector<complex16_t> mConvertSamples;
+        std::vector<uint8_t> mConvertBytes;
+        SignalMeter mMeter; //!< Rx signal statistics, updated in WritePayload
     private:
         StreamChannel() = default;
     };
@@ -83,8 +99,10 @@ public:
         std::vector<StreamChannel*> mRxStreams;
         std::vector<StreamChannel*> mTxStreams;
         std::atomic<uint64_t> rxLastTimestamp;
-        std::atomic<uint64_t> txLastLateTime;
+        StreamEventFIFO txEvents;
+        StreamEventFIFO rxEvents;
         uint64_t mTimestampOffset;
+        ClockModel clock; //!< host time to Rx timestamp correlation, fed by Rx thread
         int mChipID;
     };
 
@@ -98,6 +116,8 @@ public:
     virtual int ReadStream(const size_t streamID, void* buffs, const size_t length, const long timeout_ms, StreamMetadata& metadata);
     virtual int WriteStream(const size_t streamID, const void* buffs, const size_t length, const long timeout_ms, const StreamMetadata& metadata);
     virtual int ReadStreamStatus(const size_t streamID, const long timeout_ms, StreamMetadata& metadata);
+    virtual int ReadStreamMeters(const size_t streamID, StreamMeters& meters);
+    int SetStreamMemoryBudget(const size_t bytes) override;
 
     virtual int UpdateExternalDataRate(const size_t channel, const double txRate_Hz, const double rxRate_Hz) = 0;
     virtual void EnterSelfCalibration(const size_t channel);
@@ -107,20 +127,47 @@ public:
     virtual double GetHardwareTimestampRate(void);
 
     int UploadWFM(const void* const* samples, uint8_t chCount, size_t sample_count, StreamConfig::StreamDataFormat format, int epIndex) override;
+    int UploadWFMFile(const std::string& filename, uint8_t chCount, int epIndex) override;
 
 protected:
     virtual int ReceiveData(char* buffer, int length, int epIndex, int timeout = 100);
     virtual int SendData(const char* buffer, int length, int epIndex, int timeout = 100);
+    /** @brief Starts asynchronous data transfer
+        @return transfer handle, -1 if asynchronous transfers are not supported
+    */
+    virtual int SendDataAsync(const char* buffer, int length, int epIndex);
+    /** @brief Waits for asynchronous transfer to complete
+        @return number of bytes sent
+    */
+    virtual int WaitDataSent(const char* buffer, int length, int handle, int timeout_ms);
+    int UploadWFMPackets(uint8_t chCount, size_t sample_count, int epIndex, const std::function<void(size_t, size_t, complex16_t* const*)>& convert);
     virtual void ReceivePacketsLoop(Streamer* args) = 0;
     virtual void TransmitPacketsLoop(Streamer* args) = 0;
     std::vector<Streamer*> mStreamers;
+    std::vector<StreamChannelizer*> mChannelizers; //!< Rx channels split on host
+    //! @return channelizer which has the stream as output, nullptr if none
+    StreamChannelizer* FindChannelizer(const size_t streamID) const;
     std::condition_variable safeToConfigInterface;
     double mExpectedSampleRate; //rate used for generating data
 
+    /** @brief Takes FIFO memory from stream memory budget
+        @param packets requested FIFO length in packets, reduced if budget is short
+        @param minPackets smallest acceptable FIFO length
+        @param packetMemory bytes used by single packet
+        @return 0 on success, -1 if less than minPackets fit into budget
+    */
+    int ReserveStreamMemory(size_t& packets, const size_t minPackets, const size_t packetMemory);
+    void ReleaseStreamMemory(const size_t bytes);
+    size_t mStreamMemoryBudget;
+    size_t mStreamMemoryUsed;
+    std::mutex mStreamMemoryLock;
+
     std::function<void(Streamer* args)> RxLoopFunction;
     std::function<void(Streamer* args)> TxLoopFunction;
 
     virtual int ResetStreamBuffers(){return 0;};
+
+    friend class LimeSuiteServer; //forwards raw data transfers to remote clients
 };
 
 } //lime
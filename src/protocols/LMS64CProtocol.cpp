@@ -7,6 +7,7 @@
 #include "ErrorReporting.h"
 #include "LMS64CProtocol.h"
 #include "Si5351C.h"
+#include "ControlTrace.h"
 #include <chrono>
 #include <iostream>
 #include <assert.h>
@@ -147,7 +148,11 @@ int LMS64CProtocol::SetReferenceClockRate(const double rate)
  **********************************************************************/
 int LMS64CProtocol::WriteLMS7002MSPI(const uint32_t *writeData, size_t size, unsigned periphID)
 {
-    GenericPacket pkt;
+    std::lock_guard<std::mutex> lock(mRegistersPacketLock);
+    GenericPacket& pkt = mRegistersPacket;
+    pkt.outBuffer.clear();
+    pkt.inBuffer.clear();
+    pkt.status = STATUS_UNDEFINED;
     pkt.cmd = CMD_LMS7002_WR;
     pkt.periphID = periphID;
     for (size_t i = 0; i < size; ++i)
@@ -167,7 +172,11 @@ int LMS64CProtocol::WriteLMS7002MSPI(const uint32_t *writeData, size_t size, uns
 
 int LMS64CProtocol::ReadLMS7002MSPI(const uint32_t *writeData, uint32_t *readData, size_t size, unsigned periphID)
 {
-    GenericPacket pkt;
+    std::lock_guard<std::mutex> lock(mRegistersPacketLock);
+    GenericPacket& pkt = mRegistersPacket;
+    pkt.outBuffer.clear();
+    pkt.inBuffer.clear();
+    pkt.status = STATUS_UNDEFINED;
     pkt.cmd = CMD_LMS7002_RD;
     pkt.periphID = periphID;
     for (size_t i = 0; i < size; ++i)
@@ -258,7 +267,12 @@ int LMS64CProtocol::ReadADF4002SPI(const uint32_t *writeData, uint32_t *readData
  **********************************************************************/
 int LMS64CProtocol::WriteRegisters(const uint32_t *addrs, const uint32_t *data, const size_t size)
 {
-    GenericPacket pkt;
+    std::lock_guard<std::mutex> lock(mRegistersPacketLock);
+    GenericPacket& pkt = mRegistersPacket;
+    pkt.outBuffer.clear();
+    pkt.inBuffer.clear();
+    pkt.status = STATUS_UNDEFINED;
+    pkt.periphID = 0;
     pkt.cmd = CMD_BRDSPI_WR;
     for (size_t i = 0; i < size; ++i)
     {
@@ -275,7 +289,12 @@ int LMS64CProtocol::WriteRegisters(const uint32_t *addrs, const uint32_t *data,
 
 int LMS64CProtocol::ReadRegisters(const uint32_t *addrs, uint32_t *data, const size_t size)
 {
-    GenericPacket pkt;
+    std::lock_guard<std::mutex> lock(mRegistersPacketLock);
+    GenericPacket& pkt = mRegistersPacket;
+    pkt.outBuffer.clear();
+    pkt.inBuffer.clear();
+    pkt.status = STATUS_UNDEFINED;
+    pkt.periphID = 0;
     pkt.cmd = CMD_BRDSPI_RD;
     for (size_t i = 0; i < size; ++i)
     {
@@ -386,6 +405,8 @@ LMS64CProtocol::FPGAinfo LMS64CProtocol::GetFPGAInfo()
 int LMS64CProtocol::TransferPacket(GenericPacket& pkt)
 {
     std::lock_guard<std::mutex> lock(mControlPortLock);
+    const uint64_t traceStart = ControlTrace::IsEnabled() ? ControlTrace::Now() : 0;
+    const eCMD_LMS traceCmd = pkt.cmd; //parsing may replace command
     int status = 0;
     if(IsOpen() == false) ReportError(ENOTCONN, "connection is not open");
 
@@ -409,19 +430,20 @@ int LMS64CProtocol::TransferPacket(GenericPacket& pkt)
         packetLen = 0;
         return ReportError("Unknown protocol type %d", int(protocol));
     }
-    int outLen = 0;
-    unsigned char* outBuffer = NULL;
-    outBuffer = PreparePacket(pkt, outLen, protocol);
-    unsigned char* inBuffer = new unsigned char[outLen];
-    memset(inBuffer, 0, outLen);
-
-    int outBufPos = 0;
-    int inDataPos = 0;
+    int outLen = PreparePacket(pkt, mOutPacketBuffer, protocol);
     if(outLen == 0)
     {
         //printf("packet outlen = 0\n");
         outLen = 1;
+        mOutPacketBuffer.resize(outLen, 0);
     }
+    //assign keeps capacity, buffers stop growing after first large transfer
+    mInPacketBuffer.assign(outLen, 0);
+    unsigned char* outBuffer = mOutPacketBuffer.data();
+    unsigned char* inBuffer = mInPacketBuffer.data();
+
+    int outBufPos = 0;
+    int inDataPos = 0;
 
     if(protocol == LMS_PROTOCOL_NOVENA)
     {
@@ -493,22 +515,29 @@ int LMS64CProtocol::TransferPacket(GenericPacket& pkt)
         }
         ParsePacket(pkt, inBuffer, inDataPos, protocol);
     }
-    delete[] outBuffer;
-    delete[] inBuffer;
+    if(traceStart != 0)
+    {
+        //replies are padded to whole packets, reads need address and value pairs only
+        size_t inLength = pkt.inBuffer.size();
+        if(traceCmd == CMD_LMS7002_RD || traceCmd == CMD_BRDSPI_RD)
+            inLength = std::min(inLength, 2*pkt.outBuffer.size());
+        ControlTrace::Add(traceCmd, pkt.status, pkt.periphID, pkt.outBuffer.data(), pkt.outBuffer.size(),
+            pkt.inBuffer.data(), inLength, traceStart, ControlTrace::Now());
+    }
     return convertStatus(status, pkt);
 }
 
 /** @brief Takes generic packet and converts to specific protocol buffer
     @param pkt generic data packet to convert
-    @param length returns length of returned buffer
+    @param buffer destination buffer, resized to packet length
     @param protocol which protocol to use for data
-    @return pointer to data buffer, must be manually deleted after use
+    @return length of prepared data
 */
-unsigned char* LMS64CProtocol::PreparePacket(const GenericPacket& pkt, int& length, const eLMS_PROTOCOL protocol)
+int LMS64CProtocol::PreparePacket(const GenericPacket& pkt, std::vector<unsigned char>& buffer, const eLMS_PROTOCOL protocol)
 {
-    unsigned char* buffer = NULL;
+    int length = 0;
     if(protocol == LMS_PROTOCOL_UNDEFINED)
-        return NULL;
+        return 0;
 
     if(protocol == LMS_PROTOCOL_LMS64C)
     {
@@ -556,8 +585,7 @@ unsigned char* LMS64CProtocol::PreparePacket(const GenericPacket& pkt, int& leng
         bufLen *= packet.pktLength;
         if(bufLen == 0)
             bufLen = packet.pktLength;
-        buffer = new unsigned char[bufLen];
-        memset(buffer, 0, bufLen);
+        buffer.assign(bufLen, 0);
         unsigned int srcPos = 0;
         for(int j=0; j*packet.pktLength<bufLen; ++j)
         {
@@ -583,7 +611,7 @@ unsigned char* LMS64CProtocol::PreparePacket(const GenericPacket& pkt, int& leng
     {
         if(pkt.cmd == CMD_LMS7002_RST)
         {
-            buffer = new unsigned char[8];
+            buffer.resize(8);
             buffer[0] = 0x88;
             buffer[1] = 0x06;
             buffer[2] = 0x00;
@@ -596,8 +624,7 @@ unsigned char* LMS64CProtocol::PreparePacket(const GenericPacket& pkt, int& leng
         }
         else
         {
-            buffer = new unsigned char[pkt.outBuffer.size()];
-            memcpy(buffer, &pkt.outBuffer[0], pkt.outBuffer.size());
+            buffer.assign(pkt.outBuffer.begin(), pkt.outBuffer.end());
             if (pkt.cmd == CMD_LMS7002_WR)
             {
                 for(size_t i=0; i<pkt.outBuffer.size(); i+=4)
@@ -606,7 +633,7 @@ unsigned char* LMS64CProtocol::PreparePacket(const GenericPacket& pkt, int& leng
             length = pkt.outBuffer.size();
         }
     }
-    return buffer;
+    return length;
 }
 
 /** @brief Parses given data buffer into generic packet
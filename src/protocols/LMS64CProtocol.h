@@ -200,9 +200,15 @@ private:
     int WriteADF4002SPI(const uint32_t *writeData, const size_t size);
     int ReadADF4002SPI(const uint32_t *writeData, uint32_t *readData, const size_t size);
 
-    unsigned char* PreparePacket(const GenericPacket &pkt, int &length, const eLMS_PROTOCOL protocol);
+    int PreparePacket(const GenericPacket &pkt, std::vector<unsigned char> &buffer, const eLMS_PROTOCOL protocol);
     int ParsePacket(GenericPacket &pkt, const unsigned char* buffer, const int length, const eLMS_PROTOCOL protocol);
     std::mutex mControlPortLock;
+    //protocol buffers are reused between transfers, guarded by mControlPortLock
+    std::vector<unsigned char> mOutPacketBuffer;
+    std::vector<unsigned char> mInPacketBuffer;
+    //packet reused by register access functions
+    GenericPacket mRegistersPacket;
+    std::mutex mRegistersPacketLock;
     double _cachedRefClockRate;
 };
 }
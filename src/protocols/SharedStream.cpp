@@ -0,0 +1,562 @@
+/**
+@file SharedStream.cpp
+@author Lime Microsystems
+@brief Publishing Rx streams to other processes through shared memory
+*/
+
+#include "SharedStream.h"
+#include "IConnection.h"
+#include "ErrorReporting.h"
+#include "Logger.h"
+#include <cstring>
+#include <cerrno>
+#include <new>
+#include <chrono>
+#include <algorithm>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <climits>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+namespace lime
+{
+
+static const uint32_t sharedStreamMagic = 0x5253534C; //"LSSR"
+static const uint32_t sharedStreamVersion = 1;
+
+struct SharedBlockInfo
+{
+    std::atomic<uint64_t> sequence; //!< 2*index+1 while written, 2*index+2 when published
+    std::atomic<uint64_t> timestamp;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint32_t> samples;
+    uint32_t reserved;
+};
+
+/** Ring layout: header, block infos, then block data. Each block contains
+    blockSamples of every channel, one channel after another.
+*/
+struct SharedStreamHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t channelsCount;
+    uint32_t blockSamples;
+    uint32_t blocksCount;
+    uint32_t reserved;
+    double sampleRate;
+    uint64_t dataOffset;
+    std::atomic<uint64_t> writeIndex; //!< number of published blocks
+    std::atomic<uint32_t> wakeCounter; //!< futex word, changes on every publish
+    std::atomic<uint32_t> closed;
+
+    SharedBlockInfo* Blocks()
+    {
+        return reinterpret_cast<SharedBlockInfo*>(this+1);
+    }
+    complex16_t* BlockData(const uint64_t index, const uint32_t ch)
+    {
+        char* data = reinterpret_cast<char*>(this) + dataOffset;
+        const size_t slot = index & (blocksCount-1);
+        return reinterpret_cast<complex16_t*>(data) + (slot*channelsCount + ch)*blockSamples;
+    }
+};
+
+static void WakeReaders(SharedStreamHeader* header)
+{
+    header->wakeCounter.fetch_add(1, std::memory_order_release);
+#ifdef __linux__
+    syscall(SYS_futex, &header->wakeCounter, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+static void WaitWake(SharedStreamHeader* header, const uint32_t counter, const int timeout_ms)
+{
+#ifdef __linux__
+    timespec ts;
+    ts.tv_sec = timeout_ms/1000;
+    ts.tv_nsec = (timeout_ms%1000)*1000000L;
+    //read only mapping is sufficient for waiting on shared futex
+    if (syscall(SYS_futex, &header->wakeCounter, FUTEX_WAIT, counter, &ts, nullptr, 0) == 0
+        || errno == EAGAIN || errno == ETIMEDOUT || errno == EINTR)
+        return;
+#endif
+    if (header->wakeCounter.load(std::memory_order_acquire) == counter)
+        std::this_thread::sleep_for(std::chrono::milliseconds(std::min(timeout_ms, 1)));
+}
+
+SharedStreamPublisher::Config::Config() :
+    sampleRate(0),
+    blockSamples(4080),
+    blocksCount(256)
+{
+}
+
+SharedStreamPublisher::SharedStreamPublisher(IConnection* port) :
+    mPort(port),
+    mHeader(nullptr),
+    mMappedSize(0),
+    mTerminate(false),
+    mRunning(false),
+    mSamplesPublished(0),
+    mSamplesDropped(0)
+{
+}
+
+SharedStreamPublisher::~SharedStreamPublisher()
+{
+    Stop();
+}
+
+int SharedStreamPublisher::Start(const std::string& name, const Config& config)
+{
+#ifdef _WIN32
+    return ReportError(ENOTSUP, "Shared memory streams are not supported on this platform");
+#else
+    if (mRunning.load())
+        return ReportError(EBUSY, "Shared stream is already running");
+    if (mPort == nullptr)
+        return ReportError(ENODEV, "Shared stream: device not connected");
+    if (config.channels.empty())
+        return ReportError(EINVAL, "Shared stream: no channels selected");
+    if (config.blockSamples == 0 || config.blocksCount < 2)
+        return ReportError(EINVAL, "Shared stream: invalid ring size");
+
+    mConfig = config;
+    uint32_t blocksCount = 2;
+    while (blocksCount < mConfig.blocksCount)
+        blocksCount <<= 1;
+    mConfig.blocksCount = blocksCount;
+
+    const size_t infoSize = sizeof(SharedStreamHeader) + blocksCount*sizeof(SharedBlockInfo);
+    const size_t dataOffset = (infoSize + 4095) & ~size_t(4095);
+    const size_t blockBytes = size_t(mConfig.blockSamples)*mConfig.channels.size()*sizeof(complex16_t);
+    mMappedSize = dataOffset + blocksCount*blockBytes;
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST)
+    {
+        //left behind by publisher that did not stop cleanly
+        lime::warning("Shared stream: replacing existing %s", name.c_str());
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (fd < 0)
+        return ReportError(errno, "Shared stream: failed to create %s", name.c_str());
+    if (ftruncate(fd, mMappedSize) != 0)
+    {
+        const int err = errno;
+        close(fd);
+        shm_unlink(name.c_str());
+        return ReportError(err, "Shared stream: failed to allocate ring");
+    }
+    void* mem = mmap(nullptr, mMappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+    {
+        const int err = errno;
+        shm_unlink(name.c_str());
+        return ReportError(err, "Shared stream: failed to map ring");
+    }
+    mName = name;
+
+    mHeader = new (mem) SharedStreamHeader;
+    mHeader->channelsCount = mConfig.channels.size();
+    mHeader->blockSamples = mConfig.blockSamples;
+    mHeader->blocksCount = blocksCount;
+    mHeader->reserved = 0;
+    mHeader->sampleRate = mConfig.sampleRate;
+    mHeader->dataOffset = dataOffset;
+    mHeader->writeIndex.store(0);
+    mHeader->wakeCounter.store(0);
+    mHeader->closed.store(0);
+    for (uint32_t i = 0; i < blocksCount; ++i)
+    {
+        SharedBlockInfo* info = new (&mHeader->Blocks()[i]) SharedBlockInfo;
+        info->sequence.store(0);
+        info->timestamp.store(0);
+        info->dropped.store(0);
+        info->samples.store(0);
+        info->reserved = 0;
+    }
+    mHeader->version = sharedStreamVersion;
+    std::atomic_thread_fence(std::memory_order_release);
+    mHeader->magic = sharedStreamMagic;
+
+    for (auto ch : mConfig.channels)
+    {
+        StreamConfig streamConfig;
+        streamConfig.isTx = false;
+        streamConfig.channelID = ch;
+        streamConfig.format = StreamConfig::STREAM_12_BIT_IN_16;
+        streamConfig.linkFormat = StreamConfig::STREAM_12_BIT_COMPRESSED;
+        size_t streamID = 0;
+        if (mPort->SetupStream(streamID, streamConfig) != 0)
+        {
+            Stop();
+            return -1;
+        }
+        mStreams.push_back(streamID);
+    }
+
+    mSamplesPublished.store(0);
+    mSamplesDropped.store(0);
+    mTerminate.store(false);
+    mRunning.store(true);
+    for (auto streamID : mStreams)
+        mPort->ControlStream(streamID, true);
+    mThread = std::thread(&SharedStreamPublisher::PublishLoop, this);
+    return 0;
+#endif
+}
+
+int SharedStreamPublisher::Stop()
+{
+    mTerminate.store(true);
+    if (mThread.joinable())
+        mThread.join();
+
+    for (auto streamID : mStreams)
+    {
+        mPort->ControlStream(streamID, false);
+        mPort->CloseStream(streamID);
+    }
+    mStreams.clear();
+
+#ifndef _WIN32
+    if (mHeader)
+    {
+        //attached readers keep their mapping until they close
+        mHeader->closed.store(1, std::memory_order_release);
+        WakeReaders(mHeader);
+        munmap(mHeader, mMappedSize);
+        mHeader = nullptr;
+        shm_unlink(mName.c_str());
+    }
+#endif
+    mRunning.store(false);
+    return 0;
+}
+
+bool SharedStreamPublisher::IsRunning() const
+{
+    return mRunning.load();
+}
+
+SharedStreamPublisher::Stats SharedStreamPublisher::GetStats() const
+{
+    Stats stats;
+    stats.samplesPublished = mSamplesPublished.load();
+    stats.samplesDropped = mSamplesDropped.load();
+    return stats;
+}
+
+void SharedStreamPublisher::PublishLoop()
+{
+    const size_t chCount = mStreams.size();
+    const uint32_t blockSamples = mConfig.blockSamples;
+    SharedBlockInfo* blocks = mHeader->Blocks();
+
+    bool first = true;
+    uint64_t expectedTimestamp = 0;
+    //samples that followed a discontinuity, already in previous slot
+    uint32_t carried = 0;
+    uint64_t carriedTimestamp = 0;
+    uint64_t carriedDropped = 0;
+    uint64_t index = 0;
+    while (!mTerminate.load())
+    {
+        SharedBlockInfo& info = blocks[index & (mConfig.blocksCount-1)];
+        info.sequence.store(2*index+1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        uint64_t timestamp = carriedTimestamp;
+        uint64_t dropped = carriedDropped;
+        const uint32_t start = carried;
+        for (size_t ch = 0; ch < chCount && carried; ++ch)
+            memcpy(mHeader->BlockData(index, ch), mHeader->BlockData(index-1, ch)+blockSamples-carried, carried*sizeof(complex16_t));
+        uint32_t count = carried;
+        carried = 0;
+        carriedDropped = 0;
+
+        //first channel decides block length, block is cut at timestamp discontinuity
+        bool failed = false;
+        complex16_t* dest = mHeader->BlockData(index, 0);
+        while (count < blockSamples && !mTerminate.load())
+        {
+            StreamMetadata meta;
+            int ret = mPort->ReadStream(mStreams[0], dest+count, blockSamples-count, 100, meta);
+            if (ret < 0)
+            {
+                failed = true;
+                break;
+            }
+            if (ret == 0)
+                continue;
+            uint64_t missing = 0;
+            if (!first && meta.timestamp != expectedTimestamp)
+                missing = meta.timestamp > expectedTimestamp ? meta.timestamp - expectedTimestamp : 0;
+            first = false;
+            expectedTimestamp = meta.timestamp + ret;
+            if (missing)
+                mSamplesDropped += missing;
+            if (count == 0)
+            {
+                timestamp = meta.timestamp;
+                dropped += missing;
+            }
+            else if (missing || meta.timestamp != timestamp + count)
+            {
+                //move following samples to next block
+                carried = ret;
+                carriedTimestamp = meta.timestamp;
+                carriedDropped = missing;
+                if (count + carried != blockSamples)
+                    memmove(dest+blockSamples-carried, dest+count, carried*sizeof(complex16_t));
+                break;
+            }
+            count += ret;
+        }
+        //other channels are read at the same timestamps as the first one
+        for (size_t ch = 1; ch < chCount && !failed; ++ch)
+        {
+            dest = mHeader->BlockData(index, ch);
+            if (ReadAligned(mStreams[ch], dest+start, timestamp+start, count-start) != 0
+                || ReadAligned(mStreams[ch], dest+blockSamples-carried, carriedTimestamp, carried) != 0)
+                failed = true;
+        }
+        if (failed)
+        {
+            lime::error("Shared stream: failed to read samples");
+            break;
+        }
+        if (mTerminate.load())
+            break;
+
+        info.timestamp.store(timestamp, std::memory_order_relaxed);
+        info.dropped.store(dropped, std::memory_order_relaxed);
+        info.samples.store(count, std::memory_order_relaxed);
+        info.sequence.store(2*index+2, std::memory_order_release);
+        ++index;
+        mHeader->writeIndex.store(index, std::memory_order_release);
+        WakeReaders(mHeader);
+        mSamplesPublished += count;
+    }
+}
+
+int SharedStreamPublisher::ReadAligned(const size_t streamID, complex16_t* dest, const uint64_t timestamp, const uint32_t count)
+{
+    uint32_t filled = 0;
+    while (filled < count && !mTerminate.load())
+    {
+        StreamMetadata meta;
+        meta.hasTimestamp = true; //skips older samples
+        meta.timestamp = timestamp + filled;
+        int ret = mPort->ReadStream(streamID, dest+filled, count-filled, 100, meta);
+        if (ret < 0)
+            return -1;
+        if (ret == 0)
+            continue;
+        if (meta.timestamp > timestamp + filled)
+        {
+            //samples lost only on this channel are left as zeros
+            const uint32_t gap = std::min<uint64_t>(meta.timestamp - timestamp - filled, count - filled);
+            const uint32_t kept = std::min<uint32_t>(ret, count - filled - gap);
+            memmove(dest+filled+gap, dest+filled, kept*sizeof(complex16_t));
+            memset(dest+filled, 0, gap*sizeof(complex16_t));
+            mSamplesDropped += gap;
+            ret = gap + kept;
+        }
+        filled += ret;
+    }
+    return 0;
+}
+
+SharedStreamReader::SharedStreamReader() :
+    mHeader(nullptr),
+    mMappedSize(0),
+    mCursor(0),
+    mOffset(0),
+    mOverrun(0)
+{
+}
+
+SharedStreamReader::~SharedStreamReader()
+{
+    Close();
+}
+
+int SharedStreamReader::Open(const std::string& name)
+{
+#ifdef _WIN32
+    return ReportError(ENOTSUP, "Shared memory streams are not supported on this platform");
+#else
+    Close();
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return ReportError(errno, "Shared stream: failed to open %s", name.c_str());
+    struct stat st;
+    if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(SharedStreamHeader))
+    {
+        close(fd);
+        return ReportError(EINVAL, "Shared stream: %s is not a stream ring", name.c_str());
+    }
+    void* mem = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED)
+        return ReportError(errno, "Shared stream: failed to map %s", name.c_str());
+
+    SharedStreamHeader* header = reinterpret_cast<SharedStreamHeader*>(mem);
+    const size_t blockBytes = size_t(header->blockSamples)*header->channelsCount*sizeof(complex16_t);
+    if (header->magic != sharedStreamMagic || header->version != sharedStreamVersion
+        || header->blocksCount == 0 || (header->blocksCount & (header->blocksCount-1)) != 0
+        || header->dataOffset + header->blocksCount*blockBytes > size_t(st.st_size))
+    {
+        munmap(mem, st.st_size);
+        return ReportError(EINVAL, "Shared stream: %s has incompatible format", name.c_str());
+    }
+    mHeader = header;
+    mMappedSize = st.st_size;
+    mCursor = mHeader->writeIndex.load(std::memory_order_acquire);
+    mOffset = 0;
+    mOverrun = 0;
+    return 0;
+#endif
+}
+
+void SharedStreamReader::Close()
+{
+#ifndef _WIN32
+    if (mHeader)
+        munmap(mHeader, mMappedSize);
+#endif
+    mHeader = nullptr;
+    mMappedSize = 0;
+}
+
+bool SharedStreamReader::IsOpen() const
+{
+    return mHeader != nullptr;
+}
+
+size_t SharedStreamReader::GetChannelsCount() const
+{
+    return mHeader ? mHeader->channelsCount : 0;
+}
+
+double SharedStreamReader::GetSampleRate() const
+{
+    return mHeader ? mHeader->sampleRate : 0;
+}
+
+bool SharedStreamReader::WaitBlock(const uint64_t index, const int timeout_ms)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (true)
+    {
+        const uint32_t counter = mHeader->wakeCounter.load(std::memory_order_acquire);
+        if (mHeader->writeIndex.load(std::memory_order_acquire) > index)
+            return true;
+        if (mHeader->closed.load(std::memory_order_acquire))
+            return false;
+        const int remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0)
+            return false;
+        WaitWake(mHeader, counter, remaining);
+    }
+}
+
+int SharedStreamReader::Read(complex16_t* const* samples, const uint32_t count, Metadata* meta, const int timeout_ms)
+{
+    if (mHeader == nullptr)
+        return ReportError(ENOTCONN, "Shared stream is not opened");
+
+    const uint32_t blocksCount = mHeader->blocksCount;
+    const uint32_t channels = mHeader->channelsCount;
+    const uint32_t blockSamples = mHeader->blockSamples;
+    SharedBlockInfo* blocks = mHeader->Blocks();
+    uint32_t filled = 0;
+    if (meta)
+        memset(meta, 0, sizeof(Metadata));
+
+    while (filled < count)
+    {
+        const uint64_t written = mHeader->writeIndex.load(std::memory_order_acquire);
+        if (mCursor >= written)
+        {
+            if (filled > 0)
+                break;
+            if (!WaitBlock(mCursor, timeout_ms))
+            {
+                if (mHeader->closed.load(std::memory_order_acquire) && mHeader->writeIndex.load() <= mCursor)
+                    return -1;
+                return 0;
+            }
+            continue;
+        }
+        if (written - mCursor > blocksCount)
+        {
+            //fell behind producer, continue with some margin from write position
+            const uint64_t next = written - blocksCount*3/4;
+            mOverrun += (next - mCursor)*blockSamples - mOffset;
+            mCursor = next;
+            mOffset = 0;
+            continue;
+        }
+
+        SharedBlockInfo& info = blocks[mCursor & (blocksCount-1)];
+        const uint64_t sequence = info.sequence.load(std::memory_order_acquire);
+        if (sequence != 2*mCursor+2)
+        {
+            mOverrun += blockSamples - mOffset;
+            ++mCursor;
+            mOffset = 0;
+            continue;
+        }
+        const uint64_t timestamp = info.timestamp.load(std::memory_order_relaxed);
+        const uint64_t dropped = info.dropped.load(std::memory_order_relaxed);
+        const uint32_t blockCount = info.samples.load(std::memory_order_relaxed);
+        //returned samples are always continuous
+        if (filled > 0 && (mOverrun > 0 || (mOffset == 0 && dropped > 0)))
+            break;
+
+        const uint32_t n = std::min(count-filled, blockCount-mOffset);
+        for (uint32_t ch = 0; ch < channels; ++ch)
+            memcpy(samples[ch]+filled, mHeader->BlockData(mCursor, ch)+mOffset, n*sizeof(complex16_t));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (info.sequence.load(std::memory_order_relaxed) != sequence)
+        {
+            //overwritten while copying
+            mOverrun += blockCount - mOffset;
+            ++mCursor;
+            mOffset = 0;
+            continue;
+        }
+
+        if (filled == 0 && meta)
+        {
+            meta->timestamp = timestamp + mOffset;
+            meta->overrun = mOverrun;
+            meta->dropped = mOffset == 0 ? dropped : 0;
+        }
+        if (filled == 0)
+            mOverrun = 0;
+        filled += n;
+        mOffset += n;
+        if (mOffset >= blockCount)
+        {
+            ++mCursor;
+            mOffset = 0;
+        }
+    }
+    return filled;
+}
+
+}
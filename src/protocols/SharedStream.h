@@ -0,0 +1,140 @@
+/**
+@file SharedStream.h
+@author Lime Microsystems
+@brief Publishing Rx streams to other processes through shared memory
+*/
+
+#ifndef LIMESUITE_SHARED_STREAM_H
+#define LIMESUITE_SHARED_STREAM_H
+
+#include <LimeSuiteConfig.h>
+#include "dataTypes.h"
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+namespace lime
+{
+
+class IConnection;
+struct SharedStreamHeader;
+
+/** @brief Publishes Rx channels into POSIX shared memory ring.
+
+    Samples are read from device streams directly into ring blocks, each block
+    holds the same time span of all channels together with its timestamp and
+    number of samples lost before it. Channels are aligned by timestamps of
+    the first channel. Any number of SharedStreamReader
+    instances, in this or other processes, read the ring with their own
+    cursors, producer does not wait for them and does no per reader work.
+*/
+class LIME_API SharedStreamPublisher
+{
+public:
+    struct Config
+    {
+        Config();
+        std::vector<size_t> channels; //!< Rx channels to publish
+        double sampleRate; //!< written to ring header for readers
+        uint32_t blockSamples; //!< samples of each channel per block
+        uint32_t blocksCount; //!< ring length in blocks, rounded up to power of two
+    };
+
+    struct Stats
+    {
+        uint64_t samplesPublished;
+        uint64_t samplesDropped; //!< timestamp discontinuities of device streams
+    };
+
+    SharedStreamPublisher(IConnection* port);
+    ~SharedStreamPublisher();
+
+    /** @brief Creates shared memory ring and starts publishing
+        @param name shared memory object name, e.g. "/limesuite-rx"
+        @param config stream configuration
+        @return 0 on success, -1 on failure
+    */
+    int Start(const std::string& name, const Config& config);
+
+    /** @brief Stops publishing and removes shared memory name,
+        attached readers are notified and can still read remaining data
+    */
+    int Stop();
+
+    bool IsRunning() const;
+    Stats GetStats() const;
+
+private:
+    void PublishLoop();
+    /** @brief Reads samples of a channel starting exactly at given timestamp,
+        samples missing from the channel stream are filled with zeros
+        @return 0 on success, -1 on stream failure
+    */
+    int ReadAligned(const size_t streamID, complex16_t* dest, const uint64_t timestamp, const uint32_t count);
+
+    IConnection* mPort;
+    Config mConfig;
+    std::string mName;
+    std::vector<size_t> mStreams;
+    SharedStreamHeader* mHeader;
+    size_t mMappedSize;
+    std::thread mThread;
+    std::atomic<bool> mTerminate;
+    std::atomic<bool> mRunning;
+    std::atomic<uint64_t> mSamplesPublished;
+    std::atomic<uint64_t> mSamplesDropped;
+};
+
+/** @brief Attaches to ring created by SharedStreamPublisher.
+
+    Reader keeps independent cursor, when it falls behind by more than ring
+    length the skipped samples are reported as overrun and reading continues
+    from recent data.
+*/
+class LIME_API SharedStreamReader
+{
+public:
+    struct Metadata
+    {
+        uint64_t timestamp; //!< timestamp of the first returned sample
+        uint64_t overrun; //!< samples skipped since previous read, reader was too slow, counted in whole blocks
+        uint64_t dropped; //!< samples lost by producer just before returned data
+    };
+
+    SharedStreamReader();
+    ~SharedStreamReader();
+
+    /** @brief Maps shared memory ring, reading starts from newest block
+        @return 0 on success, -1 on failure
+    */
+    int Open(const std::string& name);
+    void Close();
+    bool IsOpen() const;
+
+    size_t GetChannelsCount() const;
+    double GetSampleRate() const;
+
+    /** @brief Reads continuous samples of all channels
+        @param samples destination buffers, one per channel
+        @param count number of samples to read per channel
+        @param meta returned timestamp and loss information
+        @param timeout_ms time to wait for new data
+        @return number of samples read per channel, 0 on timeout,
+            -1 if stream has ended or is not opened
+    */
+    int Read(complex16_t* const* samples, const uint32_t count, Metadata* meta, const int timeout_ms = 100);
+
+private:
+    bool WaitBlock(const uint64_t index, const int timeout_ms);
+
+    SharedStreamHeader* mHeader;
+    size_t mMappedSize;
+    uint64_t mCursor; //!< next block to read
+    uint32_t mOffset; //!< samples already read from cursor block
+    uint64_t mOverrun;
+};
+
+}
+
+#endif
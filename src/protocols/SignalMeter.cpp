@@ -0,0 +1,87 @@
+/**
+@file SignalMeter.cpp
+@author Lime Microsystems
+@brief Signal level statistics accumulated while unpacking Rx samples
+*/
+
+#include "SignalMeter.h"
+#include <cmath>
+
+using namespace lime;
+
+static const uint32_t defaultWindow = 65536;
+static const float floordBFS = -200;
+
+static float TodBFS(const double power)
+{
+    const double fullScalePower = double(SignalMeter::fullScale)*SignalMeter::fullScale;
+    return power > 0 ? 10*std::log10(power/fullScalePower) : floordBFS;
+}
+
+SignalMeter::SignalMeter() :
+    mWindow(defaultWindow),
+    mEnabled(false),
+    mSequence(0),
+    mPower(floordBFS),
+    mPeakPower(floordBFS),
+    mDCI(0),
+    mDCQ(0),
+    mClippedCount(0),
+    mSamplesCount(0),
+    mWindowTimestamp(0)
+{
+    mTimestamp = 0;
+    SetWindow(defaultWindow);
+}
+
+void SignalMeter::SetWindow(const uint32_t samples)
+{
+    mWindow = samples > 0 ? samples : defaultWindow;
+    mCount = 0;
+    mSumI = mSumQ = mSumPower = 0;
+    mPeak = 0;
+    mClipped = 0;
+}
+
+void SignalMeter::Publish()
+{
+    const double count = mCount;
+    const uint32_t seq = mSequence.load(std::memory_order_relaxed);
+    mSequence.store(seq+1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    mPower.store(TodBFS(mSumPower/count), std::memory_order_relaxed);
+    mPeakPower.store(TodBFS(mPeak), std::memory_order_relaxed);
+    mDCI.store(mSumI/count/fullScale, std::memory_order_relaxed);
+    mDCQ.store(mSumQ/count/fullScale, std::memory_order_relaxed);
+    mClippedCount.store(mClipped, std::memory_order_relaxed);
+    mSamplesCount.store(mCount, std::memory_order_relaxed);
+    mWindowTimestamp.store(mTimestamp, std::memory_order_relaxed);
+    mSequence.store(seq+2, std::memory_order_release);
+
+    mCount = 0;
+    mSumI = mSumQ = mSumPower = 0;
+    mPeak = 0;
+    mClipped = 0;
+}
+
+bool SignalMeter::Get(StreamMeters& meters) const
+{
+    uint32_t seq;
+    StreamMeters values;
+    do
+    {
+        seq = mSequence.load(std::memory_order_acquire);
+        values.power = mPower.load(std::memory_order_relaxed);
+        values.peak = mPeakPower.load(std::memory_order_relaxed);
+        values.dcI = mDCI.load(std::memory_order_relaxed);
+        values.dcQ = mDCQ.load(std::memory_order_relaxed);
+        values.clipped = mClippedCount.load(std::memory_order_relaxed);
+        values.samplesCount = mSamplesCount.load(std::memory_order_relaxed);
+        values.timestamp = mWindowTimestamp.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) || seq != mSequence.load(std::memory_order_relaxed));
+    if (values.samplesCount == 0)
+        return false;
+    meters = values;
+    return true;
+}
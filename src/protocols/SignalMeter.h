@@ -0,0 +1,114 @@
+/**
+@file SignalMeter.h
+@author Lime Microsystems
+@brief Signal level statistics accumulated while unpacking Rx samples
+*/
+
+#ifndef LIMESUITE_SIGNAL_METER_H
+#define LIMESUITE_SIGNAL_METER_H
+
+#include "dataTypes.h"
+#include "IConnection.h"
+#include <atomic>
+
+namespace lime
+{
+
+/** @brief Accumulates power, peak, DC and clipping over a window of samples.
+
+    Accumulate() is called by the streaming thread for every unpacked packet,
+    completed windows are published under sequence counter, so Get() can be
+    called from any thread without locking.
+    Measuring is off until Enable() is called, so streams that nobody meters
+    do not pay for it (packed storage would have to unpack every packet).
+*/
+class SignalMeter
+{
+public:
+    SignalMeter();
+
+    //! Sets window length in samples and restarts measurement
+    void SetWindow(const uint32_t samples);
+
+    //! Starts measuring, can be called from any thread
+    void Enable()
+    {
+        mEnabled.store(true, std::memory_order_relaxed);
+    }
+
+    //! Returns true if the streaming thread should call Accumulate()
+    bool IsEnabled() const
+    {
+        return mEnabled.load(std::memory_order_relaxed);
+    }
+
+    /** @brief Adds samples to current window, called only from one thread
+        @param samples 12 bit samples
+        @param count number of samples
+        @param timestamp timestamp of the first sample
+    */
+    inline void Accumulate(const complex16_t* samples, const uint32_t count, const uint64_t timestamp)
+    {
+        if (mCount == 0)
+            mTimestamp = timestamp;
+        int32_t sumI = 0;
+        int32_t sumQ = 0;
+        int64_t sumPower = 0;
+        int32_t peak = 0;
+        uint32_t clipped = 0;
+        for (uint32_t n = 0; n < count; ++n)
+        {
+            const int32_t i = samples[n].i;
+            const int32_t q = samples[n].q;
+            const int32_t power = i*i + q*q;
+            sumI += i;
+            sumQ += q;
+            sumPower += power;
+            peak = power > peak ? power : peak;
+            clipped += (i >= fullScale-1 || i <= -fullScale || q >= fullScale-1 || q <= -fullScale);
+        }
+        mSumI += sumI;
+        mSumQ += sumQ;
+        mSumPower += sumPower;
+        mPeak = peak > mPeak ? peak : mPeak;
+        mClipped += clipped;
+        mCount += count;
+        if (mCount >= mWindow)
+            Publish();
+    }
+
+    /** @brief Returns statistics of the last completed window
+        @param meters filled only when a window was completed
+        @return false when no window was completed
+    */
+    bool Get(StreamMeters& meters) const;
+
+    static const int32_t fullScale = 2048;
+private:
+    void Publish();
+
+    //accumulators, used only by streaming thread
+    uint32_t mWindow;
+    uint32_t mCount;
+    uint64_t mTimestamp;
+    int64_t mSumI;
+    int64_t mSumQ;
+    int64_t mSumPower;
+    int32_t mPeak;
+    uint32_t mClipped;
+
+    //published values
+    std::atomic<bool> mEnabled;
+    std::atomic<uint32_t> mSequence;
+    std::atomic<float> mPower;
+    std::atomic<float> mPeakPower;
+    std::atomic<float> mDCI;
+    std::atomic<float> mDCQ;
+    std::atomic<uint32_t> mClippedCount;
+    std::atomic<uint32_t> mSamplesCount;
+    std::atomic<uint64_t> mWindowTimestamp;
+};
+
+}
+
+#endif
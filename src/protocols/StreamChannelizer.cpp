@@ -0,0 +1,650 @@
+/**
+@file StreamChannelizer.cpp
+@author Lime Microsystems
+@brief Host side channelizer and rational resampler of Rx stream
+*/
+
+#include "StreamChannelizer.h"
+#include "IConnection.h"
+#include "ErrorReporting.h"
+#include "Logger.h"
+#include "fifo.h"
+#include "windowFunction.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <chrono>
+
+using namespace lime;
+
+static const size_t blockLength = 8192; //samples received and processed at once
+static const uint32_t maxInterpolation = 1024;
+static const uint32_t maxDecimation = 65536;
+static const size_t maxFilterTaps = 1 << 21;
+static const uint32_t tapsAlignment = 8; //taps of each phase are processed in groups of this size
+static const double transitionLength = 8; //filter length times transition width, about 100 dB stopband with Blackman-Harris window
+
+//find L/M close to ratio, with L and M within limits
+static void ApproximateRatio(const double inputRate, const double outputRate, uint32_t& L, uint32_t& M)
+{
+    //exact ratio of integer rates
+    const double in = std::floor(inputRate + 0.5);
+    const double out = std::floor(outputRate + 0.5);
+    if (in == inputRate && out == outputRate)
+    {
+        uint64_t a = uint64_t(in), b = uint64_t(out);
+        while (b != 0)
+        {
+            const uint64_t t = a % b;
+            a = b;
+            b = t;
+        }
+        if (out/a <= maxInterpolation && in/a <= maxDecimation)
+        {
+            L = uint32_t(out/a);
+            M = uint32_t(in/a);
+            return;
+        }
+    }
+
+    //best continued fraction convergent within limits
+    const double ratio = outputRate/inputRate;
+    double x = ratio;
+    uint64_t h1 = 1, h2 = 0, k1 = 0, k2 = 1;
+    L = std::max(1u, uint32_t(ratio + 0.5));
+    M = 1;
+    for (int i = 0; i < 64; ++i)
+    {
+        const double a = std::floor(x);
+        const uint64_t h = uint64_t(a)*h1 + h2;
+        const uint64_t k = uint64_t(a)*k1 + k2;
+        if (h > maxInterpolation || k > maxDecimation)
+            break;
+        if (h > 0)
+        {
+            L = uint32_t(h);
+            M = uint32_t(k);
+        }
+        h2 = h1; h1 = h;
+        k2 = k1; k1 = k;
+        if (x - a < 1e-12)
+            break;
+        x = 1.0/(x - a);
+    }
+}
+
+//decimates by 2, passes band below passEdge and keeps aliases out of it
+class HalfBandDecimator
+{
+public:
+    /** @param passEdge passband edge relative to input rate, below 0.25
+        @param maxInput largest number of samples processed at once
+    */
+    HalfBandDecimator(const double passEdge, const size_t maxInput)
+    {
+        //every second tap is zero, K nonzero taps on each side of center
+        const double transition = 0.5 - 2*passEdge;
+        const size_t length = size_t(std::ceil(transitionLength/transition));
+        const size_t K = std::max<size_t>(1, (length + 2)/4);
+        mHistory = 4*K - 2;
+
+        std::vector<float> window;
+        GenerateWindowCoefficients(1, mHistory + 1, window, 0);
+        const size_t center = mHistory/2;
+        std::vector<double> taps(K);
+        const double centerTap = 0.5*window[center];
+        double sum = centerTap;
+        for (size_t k = 0; k < K; ++k)
+        {
+            const double t = (2*k + 1)/2.0;
+            taps[k] = 0.5*std::sin(M_PI*t)/(M_PI*t)*window[center + 2*k + 1];
+            sum += 2*taps[k];
+        }
+        mCenter = centerTap/sum;
+        mTaps.resize(K);
+        for (size_t k = 0; k < K; ++k)
+            mTaps[k] = taps[k]/sum;
+
+        mReal.resize(mHistory + maxInput);
+        mImag.resize(mHistory + maxInput);
+        Reset();
+    }
+
+    void Reset()
+    {
+        std::fill(mReal.begin(), mReal.end(), 0);
+        std::fill(mImag.begin(), mImag.end(), 0);
+        mIndex = 0;
+    }
+
+    //! Destination for input samples
+    float* InputReal() {return &mReal[mHistory];}
+    float* InputImag() {return &mImag[mHistory];}
+
+    /** @brief Filters samples written to inputs
+        @return number of output samples
+    */
+    size_t Process(const size_t count, float* outReal, float* outImag)
+    {
+        const size_t K = mTaps.size();
+        const size_t center = mHistory/2;
+        size_t produced = 0;
+        size_t index = mIndex;
+        while (index < count)
+        {
+            const float* xr = &mReal[index + center];
+            const float* xi = &mImag[index + center];
+            float sumR = mCenter*xr[0];
+            float sumI = mCenter*xi[0];
+            for (size_t k = 0; k < K; ++k)
+            {
+                const ptrdiff_t offset = 2*k + 1;
+                sumR += mTaps[k]*(xr[-offset] + xr[offset]);
+                sumI += mTaps[k]*(xi[-offset] + xi[offset]);
+            }
+            outReal[produced] = sumR;
+            outImag[produced] = sumI;
+            ++produced;
+            index += 2;
+        }
+        mIndex = index - count;
+        memmove(mReal.data(), mReal.data() + count, mHistory*sizeof(float));
+        memmove(mImag.data(), mImag.data() + count, mHistory*sizeof(float));
+        return produced;
+    }
+
+private:
+    std::vector<float> mTaps; //taps at odd offsets from center
+    float mCenter;
+    size_t mHistory;
+    std::vector<float> mReal; //filter history followed by input
+    std::vector<float> mImag;
+    size_t mIndex;
+};
+
+class StreamChannelizer::Resampler
+{
+public:
+    Resampler(const StreamConfig& config, const double inputRate);
+    ~Resampler();
+    void Process(const Block& block);
+    double GetRate() const {return mOutputRate;}
+
+    RingFIFO* fifo;
+    std::atomic<uint32_t> gaps;
+    std::atomic<uint32_t> overflows;
+    std::atomic<uint64_t> lastTimestamp;
+private:
+    void Reset(const uint64_t timestamp);
+
+    std::vector<std::unique_ptr<HalfBandDecimator>> mStages;
+    uint32_t L;
+    uint32_t M;
+    uint32_t mTapsCount; //taps per phase
+    double mOutputRate;
+    std::vector<float> mTaps; //each phase in reversed order
+    std::vector<std::complex<float>> mMixer; //frequency shift of one block
+    double mMixerStep; //cycles per sample
+    double mMixerPhase;
+    std::vector<float> mReal; //filter history followed by decimated block
+    std::vector<float> mImag;
+    std::vector<std::complex<float>> mOut;
+    uint32_t mPhase;
+    size_t mIndex;
+    uint64_t mOutTimestamp;
+    uint64_t mNextTimestamp;
+    bool mStarted;
+};
+
+StreamChannelizer::Resampler::Resampler(const StreamConfig& config, const double inputRate) :
+    fifo(nullptr),
+    gaps(0),
+    overflows(0),
+    lastTimestamp(0),
+    mMixerPhase(0),
+    mPhase(0),
+    mIndex(0),
+    mOutTimestamp(0),
+    mNextTimestamp(0),
+    mStarted(false)
+{
+    const double outputRate = config.channelizerRate;
+    double bandwidth = config.channelizerBandwidth > 0 ? config.channelizerBandwidth : 0.8*outputRate;
+    bandwidth = std::min(bandwidth, 0.9*std::min(inputRate, outputRate));
+
+    //half-band stages do the bulk of large ratios with short filters
+    double rate = inputRate;
+    size_t stageInput = blockLength;
+    while (rate/2 >= 2*outputRate && bandwidth/2 <= 0.1*rate)
+    {
+        mStages.push_back(std::unique_ptr<HalfBandDecimator>(new HalfBandDecimator(bandwidth/2/rate, stageInput)));
+        stageInput = stageInput/2 + 1;
+        rate /= 2;
+    }
+
+    ApproximateRatio(rate, outputRate, L, M);
+    mOutputRate = rate*L/M;
+
+    //low pass prototype at upsampled rate, aliases fall only into transition band
+    const double upsampledRate = rate*L;
+    const double minRate = std::min(rate, mOutputRate);
+    bandwidth = std::min(bandwidth, 0.9*minRate);
+    const double passEdge = bandwidth/2;
+    const double stopEdge = minRate - bandwidth/2;
+    size_t length = size_t(std::ceil(transitionLength*upsampledRate/(stopEdge - passEdge)));
+    mTapsCount = uint32_t((length + L - 1)/L);
+    mTapsCount = (mTapsCount + tapsAlignment - 1)/tapsAlignment*tapsAlignment;
+    if (size_t(mTapsCount)*L > maxFilterTaps)
+    {
+        mTapsCount = maxFilterTaps/L/tapsAlignment*tapsAlignment;
+        lime::warning("Channelizer: filter length limited, stopband attenuation is reduced");
+    }
+    length = size_t(mTapsCount)*L;
+
+    std::vector<float> window;
+    GenerateWindowCoefficients(1, length, window, 0);
+    std::vector<double> prototype(length);
+    const double cutoff = (passEdge + stopEdge)/2/upsampledRate;
+    double sum = 0;
+    for (size_t n = 0; n < length; ++n)
+    {
+        const double t = 2*cutoff*(n - (length - 1)/2.0);
+        const double sinc = t == 0 ? 1 : std::sin(M_PI*t)/(M_PI*t);
+        prototype[n] = 2*cutoff*sinc*window[n];
+        sum += prototype[n];
+    }
+    mTaps.resize(length);
+    for (uint32_t p = 0; p < L; ++p)
+        for (uint32_t u = 0; u < mTapsCount; ++u)
+            mTaps[p*mTapsCount + u] = prototype[p + (mTapsCount - 1 - u)*L]*L/sum;
+
+    //shift output center to DC
+    mMixerStep = -config.channelizerOffset/inputRate;
+    mMixer.resize(blockLength);
+    for (size_t n = 0; n < blockLength; ++n)
+        mMixer[n] = std::polar(1.0, 2*M_PI*std::fmod(mMixerStep*n, 1.0));
+
+    mReal.resize(mTapsCount - 1 + stageInput);
+    mImag.resize(mTapsCount - 1 + stageInput);
+    mOut.reserve(size_t(double(stageInput)*L/M) + 2);
+
+    uint32_t bufferLength = config.bufferLength;
+    if (bufferLength == 0)
+        bufferLength = std::max<uint32_t>(mOutputRate/10, 4*SamplesPacket::maxSamplesInPacket);
+    fifo = new RingFIFO(bufferLength, sizeof(std::complex<float>));
+}
+
+StreamChannelizer::Resampler::~Resampler()
+{
+    delete fifo;
+}
+
+void StreamChannelizer::Resampler::Reset(const uint64_t timestamp)
+{
+    for (auto& stage : mStages)
+        stage->Reset();
+    std::fill(mReal.begin(), mReal.end(), 0);
+    std::fill(mImag.begin(), mImag.end(), 0);
+    mPhase = 0;
+    mIndex = 0;
+    const uint64_t decimation = uint64_t(M) << mStages.size();
+    mOutTimestamp = (timestamp/decimation)*L + (timestamp%decimation)*L/decimation;
+    mMixerPhase = std::fmod(mMixerStep*double(timestamp), 1.0);
+    mStarted = true;
+}
+
+void StreamChannelizer::Resampler::Process(const Block& block)
+{
+    if (!mStarted || block.timestamp != mNextTimestamp)
+    {
+        if (mStarted)
+            ++gaps;
+        Reset(block.timestamp);
+    }
+    mNextTimestamp = block.timestamp + block.count;
+
+    //mix into the first stage input, I and Q kept apart for vectorized filtering
+    const size_t history = mTapsCount - 1;
+    float* re = mStages.empty() ? mReal.data() + history : mStages[0]->InputReal();
+    float* im = mStages.empty() ? mImag.data() + history : mStages[0]->InputImag();
+    const std::complex<float> start(std::polar(1.0, 2*M_PI*mMixerPhase));
+    const std::complex<float>* in = block.samples.data();
+    for (size_t n = 0; n < block.count; ++n)
+    {
+        const std::complex<float> x = in[n]*(mMixer[n]*start);
+        re[n] = x.real();
+        im[n] = x.imag();
+    }
+    mMixerPhase = std::fmod(mMixerPhase + mMixerStep*block.count, 1.0);
+
+    size_t count = block.count;
+    for (size_t i = 0; i < mStages.size(); ++i)
+    {
+        const bool last = i + 1 == mStages.size();
+        float* outRe = last ? mReal.data() + history : mStages[i + 1]->InputReal();
+        float* outIm = last ? mImag.data() + history : mStages[i + 1]->InputImag();
+        count = mStages[i]->Process(count, outRe, outIm);
+    }
+
+    //polyphase filter, output k uses phase (k*M)%L ending at input (k*M)/L
+    re = mReal.data();
+    im = mImag.data();
+    mOut.clear();
+    size_t index = mIndex;
+    uint32_t phase = mPhase;
+    while (index < count)
+    {
+        const float* taps = &mTaps[phase*mTapsCount];
+        const float* xr = re + index;
+        const float* xi = im + index;
+        float accR[tapsAlignment] = {0};
+        float accI[tapsAlignment] = {0};
+        for (uint32_t t = 0; t < mTapsCount; t += tapsAlignment)
+            for (uint32_t j = 0; j < tapsAlignment; ++j)
+            {
+                accR[j] += taps[t + j]*xr[t + j];
+                accI[j] += taps[t + j]*xi[t + j];
+            }
+        float sumR = 0, sumI = 0;
+        for (uint32_t j = 0; j < tapsAlignment; ++j)
+        {
+            sumR += accR[j];
+            sumI += accI[j];
+        }
+        mOut.push_back(std::complex<float>(sumR, sumI));
+        phase += M;
+        index += phase/L;
+        phase %= L;
+    }
+    mIndex = index - count;
+    mPhase = phase;
+    memmove(re, re + count, history*sizeof(float));
+    memmove(im, im + count, history*sizeof(float));
+
+    if (mOut.empty())
+        return;
+    const RingFIFO::BufferInfo info = fifo->GetInfo();
+    if (info.itemsFilled + mOut.size() > info.size)
+        ++overflows;
+    fifo->push_samples(mOut.data(), mOut.size(), 1, mOutTimestamp, 100, RingFIFO::OVERWRITE_OLD);
+    mOutTimestamp += mOut.size();
+    lastTimestamp.store(mOutTimestamp);
+}
+
+StreamChannelizer::Output::Output(StreamChannelizer* owner, const StreamConfig& config) :
+    config(config),
+    mOwner(owner),
+    mResampler(nullptr),
+    mActive(false)
+{
+}
+
+int StreamChannelizer::Output::Start()
+{
+    return mOwner->StartOutput(this);
+}
+
+int StreamChannelizer::Output::Stop()
+{
+    return mOwner->StopOutput(this);
+}
+
+int StreamChannelizer::Output::Read(void* samples, const uint32_t count, Metadata* meta, const int32_t timeout_ms)
+{
+    if (mResampler == nullptr)
+        return ReportError(EPERM, "Channelizer output is not started");
+    RingFIFO* fifo = mResampler->fifo;
+    int32_t remaining_ms = timeout_ms;
+    if (meta->flags & Metadata::SYNC_TIMESTAMP)
+    {
+        auto t1 = std::chrono::high_resolution_clock::now();
+        if (!fifo->seek_timestamp(meta->timestamp, timeout_ms))
+            return 0;
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - t1);
+        remaining_ms = std::max<int32_t>(0, timeout_ms - elapsed.count());
+    }
+    return fifo->pop_samples(samples, count, 1, &meta->timestamp, remaining_ms, &meta->flags);
+}
+
+int StreamChannelizer::Output::Write(const void* samples, const uint32_t count, const Metadata* meta, const int32_t timeout_ms)
+{
+    return ReportError(EPERM, "Channelizer outputs are receive only");
+}
+
+IStreamChannel::Info StreamChannelizer::Output::GetInfo()
+{
+    Info info;
+    memset(&info, 0, sizeof(info));
+    info.active = mActive;
+    if (mResampler == nullptr)
+        return info;
+    const RingFIFO::BufferInfo fifoInfo = mResampler->fifo->GetInfo();
+    info.fifoSize = fifoInfo.size;
+    info.fifoItemsCount = fifoInfo.itemsFilled;
+    info.overrun = mResampler->overflows.load();
+    info.droppedPackets = mResampler->gaps.load();
+    info.sampleRate = mResampler->GetRate();
+    info.timestamp = mResampler->lastTimestamp.load();
+    return info;
+}
+
+StreamChannelizer::StreamChannelizer(IConnection* port, const size_t channel) :
+    mPort(port),
+    mChannel(channel),
+    mStreamID(0),
+    mCurrentBlock(nullptr),
+    mPendingTasks(0),
+    mTerminateWorkers(false),
+    mTerminate(false),
+    mRunning(false)
+{
+}
+
+StreamChannelizer::~StreamChannelizer()
+{
+    std::lock_guard<std::mutex> lck(mControlLock);
+    StopCapture();
+    if (!mOutputs.empty())
+        mPort->CloseStream(mStreamID);
+}
+
+StreamChannelizer::Output* StreamChannelizer::AddOutput(const StreamConfig& config)
+{
+    std::lock_guard<std::mutex> lck(mControlLock);
+    if (mRunning)
+    {
+        ReportError(EPERM, "All streams must be stopped before doing setups");
+        return nullptr;
+    }
+    if (config.isTx || config.format != StreamConfig::STREAM_COMPLEX_FLOAT32)
+    {
+        ReportError(EINVAL, "Channelizer outputs are Rx streams of complex float samples");
+        return nullptr;
+    }
+    if (mOutputs.empty())
+    {
+        StreamConfig streamConfig;
+        streamConfig.isTx = false;
+        streamConfig.channelID = mChannel;
+        streamConfig.format = StreamConfig::STREAM_COMPLEX_FLOAT32;
+        streamConfig.linkFormat = config.linkFormat;
+        streamConfig.performanceLatency = config.performanceLatency;
+        if (mPort->SetupStream(mStreamID, streamConfig) != 0)
+            return nullptr;
+    }
+    mOutputs.push_back(std::unique_ptr<Output>(new Output(this, config)));
+    return mOutputs.back().get();
+}
+
+int StreamChannelizer::RemoveOutput(const size_t streamID)
+{
+    std::lock_guard<std::mutex> lck(mControlLock);
+    for (auto it = mOutputs.begin(); it != mOutputs.end(); ++it)
+    {
+        if (size_t(it->get()) != streamID)
+            continue;
+        if (mRunning)
+            return ReportError(EPERM, "All streams must be stopped before closing");
+        for (auto r = mResamplers.begin(); r != mResamplers.end(); ++r)
+            if (r->get() == (*it)->mResampler)
+            {
+                mResamplers.erase(r);
+                break;
+            }
+        mOutputs.erase(it);
+        if (mOutputs.empty())
+            return mPort->CloseStream(mStreamID);
+        return 0;
+    }
+    return ReportError(EINVAL, "Stream is not channelizer output");
+}
+
+bool StreamChannelizer::HasOutput(const size_t streamID) const
+{
+    for (const auto& output : mOutputs)
+        if (size_t(output.get()) == streamID)
+            return true;
+    return false;
+}
+
+bool StreamChannelizer::IsEmpty() const
+{
+    return mOutputs.empty();
+}
+
+size_t StreamChannelizer::GetChannel() const
+{
+    return mChannel;
+}
+
+size_t StreamChannelizer::GetStreamID() const
+{
+    return mStreamID;
+}
+
+int StreamChannelizer::StartOutput(Output* output)
+{
+    std::lock_guard<std::mutex> lck(mControlLock);
+    if (!mRunning)
+    {
+        const double inputRate = mPort->GetHardwareTimestampRate();
+        if (inputRate <= 0)
+            return ReportError(EINVAL, "Channelizer input sample rate not set");
+        for (const auto& out : mOutputs)
+            if (out->config.channelizerRate <= 0 || std::fabs(out->config.channelizerOffset) > inputRate/2)
+                return ReportError(EINVAL, "Channelizer output outside of input band");
+
+        //filters are designed for the current rate
+        mResamplers.clear();
+        for (auto& out : mOutputs)
+        {
+            mResamplers.push_back(std::unique_ptr<Resampler>(new Resampler(out->config, inputRate)));
+            out->mResampler = mResamplers.back().get();
+        }
+        for (auto& block : mBlocks)
+        {
+            block.samples.resize(blockLength);
+            block.count = 0;
+            block.timestamp = 0;
+        }
+        if (mPort->ControlStream(mStreamID, true) != 0)
+            return -1;
+
+        unsigned workers = std::min<unsigned>(mResamplers.size(), std::max(1u, std::thread::hardware_concurrency()));
+        mTerminateWorkers = false;
+        mPendingTasks = 0;
+        for (unsigned i = 0; i < workers; ++i)
+            mWorkers.push_back(std::thread(&StreamChannelizer::WorkerLoop, this));
+        mTerminate.store(false);
+        mCaptureThread = std::thread(&StreamChannelizer::CaptureLoop, this);
+        mRunning = true;
+    }
+    output->mActive = true;
+    return 0;
+}
+
+int StreamChannelizer::StopOutput(Output* output)
+{
+    std::lock_guard<std::mutex> lck(mControlLock);
+    output->mActive = false;
+    for (const auto& out : mOutputs)
+        if (out->mActive)
+            return 0;
+    StopCapture();
+    return 0;
+}
+
+//resamplers are kept, so samples already buffered can still be read
+void StreamChannelizer::StopCapture()
+{
+    if (!mRunning)
+        return;
+    mTerminate.store(true);
+    if (mCaptureThread.joinable())
+        mCaptureThread.join();
+    {
+        std::lock_guard<std::mutex> lck(mTasksLock);
+        mTerminateWorkers = true;
+    }
+    mTasksReady.notify_all();
+    for (auto& worker : mWorkers)
+        worker.join();
+    mWorkers.clear();
+    mPort->ControlStream(mStreamID, false);
+    mRunning = false;
+}
+
+void StreamChannelizer::WaitWorkers()
+{
+    std::unique_lock<std::mutex> lck(mTasksLock);
+    while (mPendingTasks > 0)
+        mTasksDone.wait(lck);
+}
+
+void StreamChannelizer::CaptureLoop()
+{
+    //next block is received while workers process previous one
+    int b = 0;
+    while (!mTerminate.load())
+    {
+        Block& block = mBlocks[b];
+        StreamMetadata meta;
+        const int ret = mPort->ReadStream(mStreamID, block.samples.data(), blockLength, 500, meta);
+        if (ret <= 0)
+            continue;
+        block.count = ret;
+        block.timestamp = meta.timestamp;
+
+        WaitWorkers();
+        {
+            std::lock_guard<std::mutex> lck(mTasksLock);
+            mCurrentBlock = &block;
+            for (auto& resampler : mResamplers)
+                mTasks.push_back(resampler.get());
+            mPendingTasks = mTasks.size();
+        }
+        mTasksReady.notify_all();
+        b ^= 1;
+    }
+    WaitWorkers();
+}
+
+void StreamChannelizer::WorkerLoop()
+{
+    std::unique_lock<std::mutex> lck(mTasksLock);
+    while (true)
+    {
+        while (mTasks.empty() && !mTerminateWorkers)
+            mTasksReady.wait(lck);
+        if (mTasks.empty())
+            return;
+        Resampler* resampler = mTasks.front();
+        mTasks.pop_front();
+        const Block* block = mCurrentBlock;
+        lck.unlock();
+        resampler->Process(*block);
+        lck.lock();
+        if (--mPendingTasks == 0)
+            mTasksDone.notify_all();
+    }
+}
@@ -0,0 +1,123 @@
+/**
+@file StreamChannelizer.h
+@author Lime Microsystems
+@brief Host side channelizer and rational resampler of Rx stream
+*/
+
+#ifndef LIMESUITE_STREAM_CHANNELIZER_H
+#define LIMESUITE_STREAM_CHANNELIZER_H
+
+#include "IConnection.h"
+#include <complex>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+namespace lime
+{
+
+class RingFIFO;
+
+/** @brief Splits one wideband Rx channel into several narrowband streams.
+
+    Rx streams set up with StreamConfig::channelizerRate become outputs of
+    their channel's channelizer, which receives the channel at device rate.
+    Each output shifts its center frequency to DC, decimates by half-band
+    stages while the rate stays well above the output rate, and resamples the
+    rest by rational factor with polyphase filter, so output rates are not
+    limited to power of two decimation of the RF chip. Blocks of received
+    samples are processed by a pool of worker threads. The device stream runs
+    while any of the outputs is started.
+*/
+class StreamChannelizer
+{
+private:
+    class Resampler;
+public:
+    //! Narrowband Rx stream in complex float format
+    class Output : public IStreamChannel
+    {
+    public:
+        Output(StreamChannelizer* owner, const StreamConfig& config);
+        int Start() override;
+        int Stop() override;
+        /** @brief Reads resampled samples, timestamps count output samples
+        */
+        int Read(void* samples, const uint32_t count, Metadata* meta, const int32_t timeout_ms = 100) override;
+        int Write(const void* samples, const uint32_t count, const Metadata* meta, const int32_t timeout_ms = 100) override;
+        Info GetInfo() override;
+
+        const StreamConfig config;
+    private:
+        friend class StreamChannelizer;
+        StreamChannelizer* mOwner;
+        Resampler* mResampler; //!< created when device stream is started
+        bool mActive;
+    };
+
+    /** @param port connection used for device stream
+        @param channel Rx channel to split
+    */
+    StreamChannelizer(IConnection* port, const size_t channel);
+    ~StreamChannelizer();
+
+    /** @brief Adds output, device stream is set up with the first one
+        @return output stream, nullptr on failure
+    */
+    Output* AddOutput(const StreamConfig& config);
+
+    /** @brief Removes output, device stream is closed with the last one
+        @return 0 on success, -1 on failure
+    */
+    int RemoveOutput(const size_t streamID);
+
+    bool HasOutput(const size_t streamID) const;
+    bool IsEmpty() const;
+    size_t GetChannel() const;
+    //! Device stream, for status events
+    size_t GetStreamID() const;
+
+private:
+    struct Block
+    {
+        std::vector<std::complex<float>> samples;
+        uint64_t timestamp;
+        size_t count;
+    };
+
+    int StartOutput(Output* output);
+    int StopOutput(Output* output);
+    void StopCapture();
+    void CaptureLoop();
+    void WorkerLoop();
+    void WaitWorkers();
+
+    IConnection* mPort;
+    size_t mChannel;
+    size_t mStreamID;
+    std::vector<std::unique_ptr<Output>> mOutputs;
+    std::vector<std::unique_ptr<Resampler>> mResamplers;
+    Block mBlocks[2];
+    std::mutex mControlLock; //!< outputs start and stop
+
+    std::vector<std::thread> mWorkers;
+    std::deque<Resampler*> mTasks;
+    const Block* mCurrentBlock;
+    size_t mPendingTasks;
+    bool mTerminateWorkers;
+    std::mutex mTasksLock;
+    std::condition_variable mTasksReady;
+    std::condition_variable mTasksDone;
+
+    std::thread mCaptureThread;
+    std::atomic<bool> mTerminate;
+    bool mRunning;
+};
+
+}
+
+#endif
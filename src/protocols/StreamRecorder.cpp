@@ -0,0 +1,469 @@
+/**
+@file StreamRecorder.cpp
+@author Lime Microsystems
+@brief Lossless capture of Rx streams to SigMF recordings
+*/
+
+#include "StreamRecorder.h"
+#include "IConnection.h"
+#include "ErrorReporting.h"
+#include "Logger.h"
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#include <malloc.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace lime;
+
+static const uint32_t directIOAlignment = 4096;
+
+static char* AllocAligned(size_t size)
+{
+#ifdef _WIN32
+    return (char*)_aligned_malloc(size, directIOAlignment);
+#else
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, directIOAlignment, size) != 0)
+        return nullptr;
+    return (char*)ptr;
+#endif
+}
+
+static void FreeAligned(char* ptr)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+StreamRecorder::Config::Config() :
+    sampleRate(0),
+    frequency(0),
+    pack12(false),
+    preallocateSamples(0),
+    blockSize(4 << 20),
+    blocksCount(16)
+{
+}
+
+StreamRecorder::StreamRecorder(IConnection* port) :
+    mPort(port),
+    mTerminate(false),
+    mCaptureDone(false),
+    mRunning(false),
+    mWriteFailed(false),
+    mSamplesRecorded(0),
+    mSamplesDropped(0),
+    mFirstTimestamp(0),
+    mBytesWritten(0),
+    mFd(-1),
+    mDirectIO(false)
+{
+}
+
+StreamRecorder::~StreamRecorder()
+{
+    Stop();
+}
+
+int StreamRecorder::Start(const std::string& filename, const Config& config)
+{
+    Stop();
+    if (mPort == nullptr)
+        return ReportError(EINVAL, "Device not connected");
+    if (config.channels.empty())
+        return ReportError(EINVAL, "No channels selected for recording");
+    if (config.blockSize == 0 || config.blockSize % directIOAlignment != 0 || config.blocksCount < 2)
+        return ReportError(EINVAL, "Recording block size must be multiple of %i", directIOAlignment);
+    mConfig = config;
+
+    mBaseName = filename;
+    for (const char* ext : {".sigmf-data", ".sigmf-meta", ".sigmf"})
+    {
+        const std::string suffix(ext);
+        if (mBaseName.size() > suffix.size() && mBaseName.compare(mBaseName.size()-suffix.size(), suffix.size(), suffix) == 0)
+        {
+            mBaseName.resize(mBaseName.size()-suffix.size());
+            break;
+        }
+    }
+
+    const std::string dataFilename = mBaseName + ".sigmf-data";
+#ifdef _WIN32
+    mFd = _open(dataFilename.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+#else
+#ifdef O_DIRECT
+    //bypass page cache, some file systems do not support it
+    mFd = open(dataFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    mDirectIO = mFd >= 0;
+    if (mFd < 0)
+#endif
+        mFd = open(dataFilename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    if (mFd < 0)
+        return ReportError(EIO, "Failed to create %s", dataFilename.c_str());
+
+#ifdef __linux__
+    const uint64_t frameBytes = mConfig.channels.size()*(mConfig.pack12 ? 3 : 4);
+    if (mConfig.preallocateSamples > 0 && posix_fallocate(mFd, 0, mConfig.preallocateSamples*frameBytes) != 0)
+        lime::warning("Recorder: failed to preallocate file space");
+#endif
+
+    mBlocks.resize(mConfig.blocksCount);
+    for (auto& block : mBlocks)
+    {
+        block.data = AllocAligned(mConfig.blockSize);
+        block.used = 0;
+        if (block.data == nullptr)
+        {
+            Stop();
+            return ReportError(ENOMEM, "Failed to allocate recording buffers");
+        }
+        mFreeBlocks.push_back(&block);
+    }
+
+    for (auto ch : mConfig.channels)
+    {
+        StreamConfig streamConfig;
+        streamConfig.isTx = false;
+        streamConfig.channelID = ch;
+        //packed samples are delivered as they come from the wire
+        streamConfig.format = mConfig.pack12 ? StreamConfig::STREAM_12_BIT_PACKED : StreamConfig::STREAM_12_BIT_IN_16;
+        streamConfig.linkFormat = StreamConfig::STREAM_12_BIT_COMPRESSED;
+        size_t streamID = 0;
+        if (mPort->SetupStream(streamID, streamConfig) != 0)
+        {
+            Stop();
+            return -1;
+        }
+        mStreams.push_back(streamID);
+    }
+
+    mAnnotations.clear();
+    mBytesWritten = 0;
+    mSamplesRecorded.store(0);
+    mSamplesDropped.store(0);
+    mWriteFailed.store(false);
+    mTerminate.store(false);
+    mCaptureDone.store(false);
+    mRunning.store(true);
+    for (auto streamID : mStreams)
+        mPort->ControlStream(streamID, true);
+    mWriteThread = std::thread(&StreamRecorder::WriteLoop, this);
+    mCaptureThread = std::thread(&StreamRecorder::CaptureLoop, this);
+    return 0;
+}
+
+int StreamRecorder::Stop()
+{
+    mTerminate.store(true);
+    if (mCaptureThread.joinable())
+        mCaptureThread.join();
+    mCaptureDone.store(true);
+    mBlockReady.notify_all();
+    if (mWriteThread.joinable())
+        mWriteThread.join();
+
+    for (auto streamID : mStreams)
+    {
+        mPort->ControlStream(streamID, false);
+        mPort->CloseStream(streamID);
+    }
+    mStreams.clear();
+
+    for (auto& block : mBlocks)
+        FreeAligned(block.data);
+    mBlocks.clear();
+    mFreeBlocks.clear();
+    mFullBlocks.clear();
+
+    int status = 0;
+    if (mFd >= 0)
+    {
+        //drop unused preallocated space
+#ifdef _WIN32
+        _chsize_s(mFd, mBytesWritten);
+        _close(mFd);
+#else
+        if (ftruncate(mFd, mBytesWritten) != 0)
+            lime::warning("Recorder: failed to truncate recording");
+        close(mFd);
+#endif
+        mFd = -1;
+        status = WriteMetadata();
+        if (mWriteFailed.load())
+            status = ReportError(EIO, "Failed to write recording data");
+    }
+    mRunning.store(false);
+    return status;
+}
+
+bool StreamRecorder::IsRunning() const
+{
+    return mRunning.load();
+}
+
+StreamRecorder::Stats StreamRecorder::GetStats() const
+{
+    Stats stats;
+    stats.samplesRecorded = mSamplesRecorded.load();
+    stats.samplesDropped = mSamplesDropped.load();
+    std::lock_guard<std::mutex> lck(mAnnotationsLock);
+    stats.annotations = mAnnotations.size();
+    return stats;
+}
+
+void StreamRecorder::Annotate(uint64_t start, const std::string& comment)
+{
+    std::lock_guard<std::mutex> lck(mAnnotationsLock);
+    mAnnotations.push_back({start, comment});
+}
+
+void StreamRecorder::CaptureLoop()
+{
+    const size_t chCount = mStreams.size();
+    const size_t frameBytes = chCount*(mConfig.pack12 ? 3 : 4);
+    const size_t chunk = 4*SamplesPacket::maxSamplesInPacket;
+    const size_t sampleSize = mConfig.pack12 ? 3 : sizeof(complex16_t);
+    std::vector<std::vector<char> > samples(chCount, std::vector<char>(chunk*sampleSize));
+    std::vector<char> frames(chunk*frameBytes);
+
+    Block* block = nullptr;
+    bool first = true;
+    uint64_t expectedTimestamp = 0;
+    while (!mTerminate.load())
+    {
+        //read same number of samples from every channel
+        const uint64_t index = mSamplesRecorded.load();
+        size_t count = chunk;
+        bool failed = false;
+        for (size_t ch = 0; ch < chCount; ++ch)
+        {
+            size_t filled = 0;
+            while (filled < chunk && !mTerminate.load())
+            {
+                StreamMetadata meta;
+                int ret = mPort->ReadStream(mStreams[ch], samples[ch].data()+filled*sampleSize, chunk-filled, 100, meta);
+                if (ret < 0)
+                {
+                    failed = true;
+                    break;
+                }
+                if (ch == 0 && ret > 0)
+                {
+                    if (first)
+                    {
+                        mFirstTimestamp = meta.timestamp;
+                        first = false;
+                    }
+                    else if (meta.timestamp != expectedTimestamp)
+                    {
+                        const uint64_t missing = meta.timestamp > expectedTimestamp ? meta.timestamp - expectedTimestamp : 0;
+                        mSamplesDropped += missing;
+                        Annotate(index + filled, std::to_string(missing) + " samples missing, timestamp discontinuity");
+                    }
+                    expectedTimestamp = meta.timestamp + ret;
+                }
+                filled += ret;
+            }
+            count = std::min(count, filled);
+        }
+        if (failed)
+        {
+            lime::error("Recorder: failed to read samples");
+            break;
+        }
+        if (count == 0)
+            continue;
+
+        //device reported losses
+        StreamMetadata event;
+        while (mPort->ReadStreamStatus(mStreams[0], 0, event) == 0)
+        {
+            if (event.packetDropped)
+                Annotate(index, "device reported dropped packets");
+            event.packetDropped = false;
+        }
+
+        //interleave channels into stored sample format
+        char* dst = frames.data();
+        if (mConfig.pack12)
+        {
+            for (size_t i = 0; i < count; ++i)
+                for (size_t ch = 0; ch < chCount; ++ch, dst += 3)
+                    memcpy(dst, samples[ch].data() + 3*i, 3);
+        }
+        else
+        {
+            //12 bit values scaled to full int16 range
+            int16_t* values = reinterpret_cast<int16_t*>(dst);
+            for (size_t ch = 0; ch < chCount; ++ch)
+            {
+                const int16_t* src = reinterpret_cast<const int16_t*>(samples[ch].data());
+                for (size_t i = 0; i < count; ++i)
+                {
+                    values[2*(i*chCount + ch)] = src[2*i]*16;
+                    values[2*(i*chCount + ch)+1] = src[2*i+1]*16;
+                }
+            }
+        }
+
+        //take all blocks needed for this chunk at once, so frames are never split by a drop
+        const size_t bytes = count*frameBytes;
+        const size_t used = block ? block->used : mConfig.blockSize;
+        const size_t blocksNeeded = (used + bytes - 1)/mConfig.blockSize;
+        std::vector<Block*> acquired;
+        {
+            std::lock_guard<std::mutex> lck(mBlocksLock);
+            if (mFreeBlocks.size() >= blocksNeeded)
+            {
+                for (size_t b = 0; b < blocksNeeded; ++b)
+                {
+                    acquired.push_back(mFreeBlocks.front());
+                    mFreeBlocks.pop_front();
+                }
+            }
+        }
+        if (acquired.size() != blocksNeeded)
+        {
+            mSamplesDropped += count;
+            Annotate(index, std::to_string(count) + " samples dropped, storage too slow");
+            continue;
+        }
+        size_t offset = 0;
+        while (offset < bytes)
+        {
+            if (block == nullptr || block->used == mConfig.blockSize)
+            {
+                if (block)
+                {
+                    std::lock_guard<std::mutex> lck(mBlocksLock);
+                    mFullBlocks.push_back(block);
+                    mBlockReady.notify_one();
+                }
+                block = acquired.front();
+                acquired.erase(acquired.begin());
+                block->used = 0;
+            }
+            const size_t toCopy = std::min(bytes - offset, size_t(mConfig.blockSize - block->used));
+            memcpy(block->data + block->used, frames.data() + offset, toCopy);
+            block->used += toCopy;
+            offset += toCopy;
+        }
+        mSamplesRecorded += count;
+    }
+
+    if (block && block->used > 0)
+    {
+        std::lock_guard<std::mutex> lck(mBlocksLock);
+        mFullBlocks.push_back(block);
+    }
+    mCaptureDone.store(true);
+    mBlockReady.notify_all();
+}
+
+int StreamRecorder::WriteBlock(const Block& block)
+{
+#ifdef _WIN32
+    const int written = _write(mFd, block.data, block.used);
+    if (written != int(block.used))
+        return -1;
+#else
+#ifdef O_DIRECT
+    //only whole aligned blocks can be written with direct I/O, last one is partial
+    if (mDirectIO && block.used % directIOAlignment != 0)
+    {
+        fcntl(mFd, F_SETFL, fcntl(mFd, F_GETFL) & ~O_DIRECT);
+        mDirectIO = false;
+    }
+#endif
+    size_t offset = 0;
+    while (offset < block.used)
+    {
+        const ssize_t written = write(mFd, block.data + offset, block.used - offset);
+        if (written <= 0)
+            return -1;
+        offset += written;
+    }
+#endif
+    mBytesWritten += block.used;
+    return 0;
+}
+
+void StreamRecorder::WriteLoop()
+{
+    while (true)
+    {
+        Block* block = nullptr;
+        {
+            std::unique_lock<std::mutex> lck(mBlocksLock);
+            while (mFullBlocks.empty() && !mCaptureDone.load())
+                mBlockReady.wait_for(lck, std::chrono::milliseconds(100));
+            if (mFullBlocks.empty())
+                break;
+            block = mFullBlocks.front();
+            mFullBlocks.pop_front();
+        }
+        if (!mWriteFailed.load() && WriteBlock(*block) != 0)
+        {
+            lime::error("Recorder: failed to write data to disk");
+            mWriteFailed.store(true);
+        }
+        std::lock_guard<std::mutex> lck(mBlocksLock);
+        block->used = 0;
+        mFreeBlocks.push_back(block);
+    }
+}
+
+int StreamRecorder::WriteMetadata()
+{
+    const std::string metaFilename = mBaseName + ".sigmf-meta";
+    std::ofstream meta(metaFilename);
+    if (!meta.is_open())
+        return ReportError(EIO, "Failed to create %s", metaFilename.c_str());
+
+    std::lock_guard<std::mutex> lck(mAnnotationsLock);
+    std::sort(mAnnotations.begin(), mAnnotations.end(),
+        [](const Annotation& a, const Annotation& b){return a.sampleStart < b.sampleStart;});
+
+    meta.precision(15);
+    meta << "{\n";
+    meta << "  \"global\": {\n";
+    meta << "    \"core:datatype\": \"ci16_le\",\n";
+    meta << "    \"core:version\": \"1.0.0\",\n";
+    meta << "    \"core:num_channels\": " << mConfig.channels.size() << ",\n";
+    if (mConfig.sampleRate > 0)
+        meta << "    \"core:sample_rate\": " << mConfig.sampleRate << ",\n";
+    if (mConfig.pack12)
+    {
+        meta << "    \"core:extensions\": [{\"name\": \"lime\", \"version\": \"1.0.0\", \"optional\": false}],\n";
+        meta << "    \"lime:packing\": \"12bit\",\n";
+    }
+    meta << "    \"core:recorder\": \"LimeSuite\"\n";
+    meta << "  },\n";
+    meta << "  \"captures\": [\n";
+    meta << "    {\"core:sample_start\": 0, \"core:global_index\": " << mFirstTimestamp;
+    if (mConfig.frequency > 0)
+        meta << ", \"core:frequency\": " << mConfig.frequency;
+    meta << "}\n";
+    meta << "  ],\n";
+    meta << "  \"annotations\": [";
+    for (size_t i = 0; i < mAnnotations.size(); ++i)
+    {
+        const Annotation& a = mAnnotations[i];
+        meta << (i ? ",\n" : "\n") << "    {\"core:sample_start\": " << a.sampleStart
+             << ", \"core:comment\": \"" << a.comment << "\"}";
+    }
+    meta << (mAnnotations.empty() ? "]\n" : "\n  ]\n");
+    meta << "}\n";
+    return meta.good() ? 0 : ReportError(EIO, "Failed to write %s", metaFilename.c_str());
+}
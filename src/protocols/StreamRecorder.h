@@ -0,0 +1,119 @@
+/**
+@file StreamRecorder.h
+@author Lime Microsystems
+@brief Lossless capture of Rx streams to SigMF recordings
+*/
+
+#ifndef LIMESUITE_STREAM_RECORDER_H
+#define LIMESUITE_STREAM_RECORDER_H
+
+#include <LimeSuiteConfig.h>
+#include "dataTypes.h"
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+namespace lime
+{
+
+class IConnection;
+
+/** @brief Records Rx channels into SigMF recording (.sigmf-data and .sigmf-meta).
+
+    Samples of all channels are interleaved and written in large aligned blocks
+    by dedicated I/O thread, using O_DIRECT where available. When storage can
+    not keep up, or device reports lost packets, the gap is recorded as SigMF
+    annotation instead of silently shifting the following samples.
+*/
+class LIME_API StreamRecorder
+{
+public:
+    struct Config
+    {
+        Config();
+        std::vector<size_t> channels; //!< Rx channels to record
+        double sampleRate; //!< written to metadata
+        double frequency; //!< written to metadata
+        bool pack12; //!< store samples as packed 12 bit values (LimeSuite extension)
+        uint64_t preallocateSamples; //!< reserve file space up front, 0 to disable
+        uint32_t blockSize; //!< bytes per write, multiple of 4096
+        uint32_t blocksCount; //!< number of blocks buffered in memory
+    };
+
+    struct Stats
+    {
+        uint64_t samplesRecorded;
+        uint64_t samplesDropped;
+        uint32_t annotations;
+    };
+
+    StreamRecorder(IConnection* port);
+    ~StreamRecorder();
+
+    /** @brief Starts recording
+        @param filename recording base name, SigMF extensions are appended
+        @param config recording configuration
+        @return 0 on success, -1 on failure
+    */
+    int Start(const std::string& filename, const Config& config);
+
+    /** @brief Stops recording, flushes data and writes metadata
+        @return 0 on success, -1 on failure
+    */
+    int Stop();
+
+    bool IsRunning() const;
+    Stats GetStats() const;
+
+private:
+    struct Annotation
+    {
+        uint64_t sampleStart;
+        std::string comment;
+    };
+    struct Block
+    {
+        char* data;
+        uint32_t used;
+    };
+
+    void CaptureLoop();
+    void WriteLoop();
+    void Annotate(uint64_t start, const std::string& comment);
+    int WriteMetadata();
+    int WriteBlock(const Block& block);
+
+    IConnection* mPort;
+    Config mConfig;
+    std::string mBaseName;
+    std::vector<size_t> mStreams;
+    std::vector<Annotation> mAnnotations;
+    mutable std::mutex mAnnotationsLock;
+
+    std::vector<Block> mBlocks;
+    std::deque<Block*> mFreeBlocks;
+    std::deque<Block*> mFullBlocks;
+    std::mutex mBlocksLock;
+    std::condition_variable mBlockReady;
+
+    std::thread mCaptureThread;
+    std::thread mWriteThread;
+    std::atomic<bool> mTerminate;
+    std::atomic<bool> mCaptureDone;
+    std::atomic<bool> mRunning;
+    std::atomic<bool> mWriteFailed;
+    std::atomic<uint64_t> mSamplesRecorded;
+    std::atomic<uint64_t> mSamplesDropped;
+    uint64_t mFirstTimestamp;
+    uint64_t mBytesWritten;
+    int mFd;
+    bool mDirectIO;
+};
+
+}
+
+#endif
@@ -0,0 +1,346 @@
+/**
+@file WaveformFile.cpp
+@author Lime Microsystems
+@brief Memory mapped waveform files for uploading and playback
+*/
+
+#include "WaveformFile.h"
+#include "IConnection.h"
+#include "ErrorReporting.h"
+#include "Logger.h"
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace lime;
+
+static bool EndsWith(const std::string& str, const std::string& suffix)
+{
+    if (str.size() < suffix.size())
+        return false;
+    std::string tail = str.substr(str.size() - suffix.size());
+    std::transform(tail.begin(), tail.end(), tail.begin(), ::tolower);
+    return tail == suffix;
+}
+
+WaveformFile::WaveformFile() :
+    mFormat(CS16_LE), mSamplesCount(0), mChannelsCount(1), mData(nullptr), mMappedSize(0)
+{
+#ifdef _WIN32
+    mFileHandle = INVALID_HANDLE_VALUE;
+    mMappingHandle = nullptr;
+#else
+    mFd = -1;
+#endif
+}
+
+WaveformFile::~WaveformFile()
+{
+    Close();
+}
+
+int WaveformFile::ParseSigMF(const std::string& metaFilename)
+{
+    std::ifstream meta(metaFilename);
+    if (!meta.is_open())
+        return ReportError(ENOENT, "SigMF metadata not found: %s", metaFilename.c_str());
+    std::stringstream content;
+    content << meta.rdbuf();
+    const std::string json = content.str();
+
+    //only the sample format is needed, avoid full JSON parser
+    mChannelsCount = 1;
+    size_t pos = json.find("\"core:num_channels\"");
+    if (pos != std::string::npos)
+    {
+        pos = json.find(':', pos + 19);
+        if (pos != std::string::npos)
+            mChannelsCount = std::max(1, atoi(json.c_str() + pos + 1));
+    }
+
+    pos = json.find("\"core:datatype\"");
+    if (pos != std::string::npos)
+        pos = json.find(':', pos + 15);
+    const size_t valueStart = pos == std::string::npos ? pos : json.find('"', pos);
+    const size_t valueEnd = valueStart == std::string::npos ? valueStart : json.find('"', valueStart + 1);
+    if (valueEnd == std::string::npos)
+        return ReportError(EINVAL, "SigMF core:datatype not found");
+    const std::string datatype = json.substr(valueStart + 1, valueEnd - valueStart - 1);
+    if (datatype == "ci16_le")
+        mFormat = CS16_LE;
+    else if (datatype == "ci16_be")
+        mFormat = CS16_BE;
+    else if (datatype == "cf32_le")
+        mFormat = CF32_LE;
+    else
+        return ReportError(EINVAL, "SigMF datatype %s not supported", datatype.c_str());
+    if (mFormat == CS16_LE && json.find("\"lime:packing\": \"12bit\"") != std::string::npos)
+        mFormat = CS12_PACKED;
+    return 0;
+}
+
+int WaveformFile::Open(const std::string& filename)
+{
+    Close();
+    mChannelsCount = 1;
+    std::string dataFilename = filename;
+    if (EndsWith(filename, ".sigmf-meta") || EndsWith(filename, ".sigmf-data"))
+    {
+        const std::string base = filename.substr(0, filename.size() - 11);
+        if (ParseSigMF(base + ".sigmf-meta") != 0)
+            return -1;
+        dataFilename = base + ".sigmf-data";
+    }
+    else if (EndsWith(filename, ".wfm"))
+        mFormat = CS16_BE;
+    else if (EndsWith(filename, ".cf32") || EndsWith(filename, ".fc32"))
+        mFormat = CF32_LE;
+    else
+        mFormat = CS16_LE;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(dataFilename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return ReportError(ENOENT, "Failed to open waveform file %s", dataFilename.c_str());
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    mFileHandle = file;
+    mMappedSize = size.QuadPart;
+    if (mMappedSize == 0)
+    {
+        Close();
+        return ReportError(EINVAL, "Waveform file is empty");
+    }
+    mMappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mMappingHandle)
+        mData = MapViewOfFile(mMappingHandle, FILE_MAP_READ, 0, 0, 0);
+#else
+    mFd = open(dataFilename.c_str(), O_RDONLY);
+    if (mFd < 0)
+        return ReportError(ENOENT, "Failed to open waveform file %s", dataFilename.c_str());
+    struct stat st;
+    if (fstat(mFd, &st) != 0 || st.st_size == 0)
+    {
+        Close();
+        return ReportError(EINVAL, "Waveform file is empty");
+    }
+    mMappedSize = st.st_size;
+    void* data = mmap(nullptr, mMappedSize, PROT_READ, MAP_PRIVATE, mFd, 0);
+    if (data != MAP_FAILED)
+    {
+        mData = data;
+        madvise(data, mMappedSize, MADV_SEQUENTIAL | MADV_WILLNEED);
+    }
+#endif
+    if (mData == nullptr)
+    {
+        Close();
+        return ReportError(EIO, "Failed to map waveform file %s", dataFilename.c_str());
+    }
+    size_t sampleSize = 2*sizeof(int16_t);
+    if (mFormat == CF32_LE)
+        sampleSize = 2*sizeof(float);
+    else if (mFormat == CS12_PACKED)
+        sampleSize = 3;
+    mSamplesCount = mMappedSize / (sampleSize*mChannelsCount);
+    return 0;
+}
+
+void WaveformFile::Close()
+{
+#ifdef _WIN32
+    if (mData)
+        UnmapViewOfFile(mData);
+    if (mMappingHandle)
+        CloseHandle(mMappingHandle);
+    if (mFileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(mFileHandle);
+    mMappingHandle = nullptr;
+    mFileHandle = INVALID_HANDLE_VALUE;
+#else
+    if (mData)
+        munmap(const_cast<void*>(mData), mMappedSize);
+    if (mFd >= 0)
+        close(mFd);
+    mFd = -1;
+#endif
+    mData = nullptr;
+    mMappedSize = 0;
+    mSamplesCount = 0;
+}
+
+bool WaveformFile::IsOpen() const
+{
+    return mData != nullptr;
+}
+
+void WaveformFile::Convert(size_t offset, size_t count, complex16_t* dest, size_t channel) const
+{
+    const size_t stride = mChannelsCount;
+    const size_t first = offset*stride + channel;
+    if (mFormat == CS12_PACKED)
+    {
+        //b0 = I[7:0], b1 = Q[3:0]:I[11:8], b2 = Q[11:4]
+        const uint8_t* src = reinterpret_cast<const uint8_t*>(mData) + 3*first;
+        for (size_t i = 0; i < count; ++i, src += 3*stride)
+        {
+            dest[i].i = int16_t((src[0] | (src[1] << 8)) << 4) >> 4;
+            dest[i].q = int16_t((src[1] | (src[2] << 8)) & 0xFFF0) >> 4;
+        }
+    }
+    else if (stride > 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+            ConvertInterleaved(first + i*stride, 1, dest + i);
+    }
+    else
+        ConvertInterleaved(first, count, dest);
+}
+
+void WaveformFile::ConvertInterleaved(size_t offset, size_t count, complex16_t* dest) const
+{
+    //plain loops over interleaved values, so that compiler can vectorize them
+    int16_t* dst = reinterpret_cast<int16_t*>(dest);
+    const size_t valuesCount = 2*count;
+    if (mFormat == CF32_LE)
+    {
+        const float* src = reinterpret_cast<const float*>(mData) + 2*offset;
+        for (size_t i = 0; i < valuesCount; ++i)
+            dst[i] = src[i]*2047.0f;
+    }
+    else if (mFormat == CS16_BE)
+    {
+        const uint16_t* src = reinterpret_cast<const uint16_t*>(mData) + 2*offset;
+        for (size_t i = 0; i < valuesCount; ++i)
+            dst[i] = int16_t(uint16_t((src[i] << 8) | (src[i] >> 8))) >> 4;
+    }
+    else
+    {
+        const int16_t* src = reinterpret_cast<const int16_t*>(mData) + 2*offset;
+        for (size_t i = 0; i < valuesCount; ++i)
+            dst[i] = src[i] >> 4;
+    }
+}
+
+//-----------------------------------------------------------------------------
+WaveformPlayer::WaveformPlayer(IConnection* port) :
+    mPort(port), mLoop(false), mTerminate(false), mRunning(false)
+{
+}
+
+WaveformPlayer::~WaveformPlayer()
+{
+    Stop();
+}
+
+int WaveformPlayer::Start(const std::string& filename, const std::vector<size_t>& channels, bool loop)
+{
+    Stop();
+    if (mPort == nullptr)
+        return ReportError(EINVAL, "Device not connected");
+    if (channels.empty())
+        return ReportError(EINVAL, "No channels selected for playback");
+    if (mFile.Open(filename) != 0)
+        return -1;
+
+    for (auto ch : channels)
+    {
+        StreamConfig config;
+        config.isTx = true;
+        config.channelID = ch;
+        config.format = StreamConfig::STREAM_12_BIT_IN_16;
+        config.linkFormat = StreamConfig::STREAM_12_BIT_COMPRESSED;
+        size_t streamID = 0;
+        if (mPort->SetupStream(streamID, config) != 0)
+        {
+            Stop();
+            return -1;
+        }
+        mStreams.push_back(streamID);
+    }
+    for (auto streamID : mStreams)
+        mPort->ControlStream(streamID, true);
+
+    mLoop = loop;
+    mTerminate.store(false);
+    mRunning.store(true);
+    mThread = std::thread(&WaveformPlayer::PlaybackLoop, this);
+    return 0;
+}
+
+void WaveformPlayer::Stop()
+{
+    mTerminate.store(true);
+    if (mThread.joinable())
+        mThread.join();
+    for (auto streamID : mStreams)
+    {
+        mPort->ControlStream(streamID, false);
+        mPort->CloseStream(streamID);
+    }
+    mStreams.clear();
+    mFile.Close();
+    mRunning.store(false);
+}
+
+bool WaveformPlayer::IsRunning() const
+{
+    return mRunning.load();
+}
+
+void WaveformPlayer::PlaybackLoop()
+{
+    const size_t chunkSize = 16*SamplesPacket::maxSamplesInPacket;
+    std::vector<complex16_t> buffer(chunkSize);
+    const size_t total = mFile.GetSamplesCount();
+    size_t offset = 0;
+    while (!mTerminate.load())
+    {
+        const size_t count = std::min(chunkSize, total - offset);
+        const bool lastChunk = offset + count >= total && !mLoop;
+
+        StreamMetadata meta;
+        meta.endOfBurst = false;
+        for (size_t i = 0; i < mStreams.size(); ++i)
+        {
+            const size_t streamID = mStreams[i];
+            if (i == 0 || mFile.GetChannelsCount() > 1)
+                mFile.Convert(offset, count, buffer.data(), std::min(i, mFile.GetChannelsCount()-1));
+            size_t written = 0;
+            while (written < count && !mTerminate.load())
+            {
+                int ret = mPort->WriteStream(streamID, buffer.data() + written, count - written, 100, meta);
+                if (ret < 0)
+                {
+                    lime::error("Waveform playback: failed to write samples");
+                    mTerminate.store(true);
+                    break;
+                }
+                written += ret;
+            }
+            //partial writes must not end the burst, it is ended after the last sample
+            if (lastChunk && written == count)
+            {
+                StreamMetadata endMeta = meta;
+                endMeta.endOfBurst = true;
+                if (mPort->WriteStream(streamID, buffer.data(), 0, 100, endMeta) < 0)
+                    lime::error("Waveform playback: failed to end burst");
+            }
+        }
+        offset += count;
+        if (lastChunk)
+            break;
+        if (offset >= total)
+            offset = 0;
+    }
+    mRunning.store(false);
+}
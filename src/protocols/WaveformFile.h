@@ -0,0 +1,116 @@
+/**
+@file WaveformFile.h
+@author Lime Microsystems
+@brief Memory mapped waveform files for uploading and playback
+*/
+
+#ifndef LIMESUITE_WAVEFORM_FILE_H
+#define LIMESUITE_WAVEFORM_FILE_H
+
+#include <LimeSuiteConfig.h>
+#include "dataTypes.h"
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+namespace lime
+{
+
+class IConnection;
+
+/** @brief Read only, memory mapped waveform file.
+
+    Supported files are raw interleaved IQ samples:
+    - .cs16, .sc16, .iq : 16 bit little endian integers
+    - .wfm : 16 bit big endian integers (Agilent Signal Studio)
+    - .cf32, .fc32 : 32 bit little endian floats
+    - .sigmf-meta, .sigmf-data : SigMF recording with ci16_le, ci16_be or cf32_le datatype,
+      multiple channels and 12 bit packing written by StreamRecorder
+*/
+class LIME_API WaveformFile
+{
+public:
+    enum Format
+    {
+        CS16_LE,
+        CS16_BE,
+        CF32_LE,
+        CS12_PACKED, //!< 3 bytes per IQ sample, written by StreamRecorder
+    };
+
+    WaveformFile();
+    ~WaveformFile();
+
+    /** @brief Maps file into memory
+        @return 0 on success, -1 on failure
+    */
+    int Open(const std::string& filename);
+    void Close();
+    bool IsOpen() const;
+
+    Format GetFormat() const {return mFormat;};
+    size_t GetSamplesCount() const {return mSamplesCount;};
+    size_t GetChannelsCount() const {return mChannelsCount;};
+
+    /** @brief Converts samples to 12 bit values used by FPGA
+        @param offset index of first sample
+        @param count number of samples to convert
+        @param dest destination array
+        @param channel channel index in multi channel file
+    */
+    void Convert(size_t offset, size_t count, complex16_t* dest, size_t channel = 0) const;
+
+private:
+    WaveformFile(const WaveformFile&) = delete;
+    WaveformFile& operator=(const WaveformFile&) = delete;
+    int ParseSigMF(const std::string& metaFilename);
+    void ConvertInterleaved(size_t offset, size_t count, complex16_t* dest) const;
+
+    Format mFormat;
+    size_t mSamplesCount;
+    size_t mChannelsCount;
+    const void* mData;
+    size_t mMappedSize;
+#ifdef _WIN32
+    void* mFileHandle;
+    void* mMappingHandle;
+#else
+    int mFd;
+#endif
+};
+
+/** @brief Streams waveform file to Tx channels from the host, for waveforms
+    that do not fit into on board memory.
+*/
+class LIME_API WaveformPlayer
+{
+public:
+    WaveformPlayer(IConnection* port);
+    ~WaveformPlayer();
+
+    /** @brief Starts transmitting the waveform
+        @param filename waveform file, see WaveformFile for supported formats
+        @param channels Tx channels to transmit on, single channel file is sent to all of them
+        @param loop repeat waveform until stopped
+        @return 0 on success, -1 on failure
+    */
+    int Start(const std::string& filename, const std::vector<size_t>& channels, bool loop);
+    void Stop();
+    bool IsRunning() const;
+
+private:
+    void PlaybackLoop();
+
+    IConnection* mPort;
+    WaveformFile mFile;
+    std::vector<size_t> mStreams;
+    bool mLoop;
+    std::thread mThread;
+    std::atomic<bool> mTerminate;
+    std::atomic<bool> mRunning;
+};
+
+}
+
+#endif
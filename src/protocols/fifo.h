@@ -10,6 +10,8 @@
 #include <condition_variable>
 #include "dataTypes.h"
 #include <cmath>
+#include <cstring>
+#include <algorithm>
 #include <assert.h>
 
 namespace lime{
@@ -20,6 +22,7 @@ public:
     enum FLAGS
     {
         OVERWRITE_OLD = 1,
+        END_BURST = 2, //same value as IStreamChannel::Metadata::END_BURST
     };
 
     struct BufferInfo
@@ -33,21 +36,38 @@ public:
     {
         std::unique_lock<std::mutex> lck(lock);
         BufferInfo stats;
-        stats.size = mBufferSize*mBuffer->maxSamplesInPacket;
-        stats.itemsFilled = mElementsFilled*mBuffer->maxSamplesInPacket;
+        stats.size = mBufferSize*SamplesPacket::maxSamplesInPacket;
+        stats.itemsFilled = mElementsFilled*SamplesPacket::maxSamplesInPacket;
         return stats;
     }
 
-    //!    @brief Initializes FIFO memory
-    RingFIFO(const uint32_t bufLength) : mBufferSize(1+(bufLength-1)/mBuffer->maxSamplesInPacket)
+    //! @brief Returns number of bytes FIFO allocates for given size
+    static size_t MemoryRequired(const uint32_t bufLength, const uint8_t sampleSize = sizeof(complex16_t))
     {
-        mBuffer = new SamplesPacket[mBufferSize];
+        const size_t packets = 1+(bufLength-1)/SamplesPacket::maxSamplesInPacket;
+        return packets*(sizeof(PacketHeader) + SamplesPacket::maxSamplesInPacket*sampleSize);
+    }
+
+    /** @brief Initializes FIFO memory
+        @param bufLength FIFO size in samples, rounded up to whole packets
+        @param sampleSize size of single sample in bytes, samples can be stored in packed formats
+    */
+    RingFIFO(const uint32_t bufLength, const uint8_t sampleSize = sizeof(complex16_t)) :
+        mBufferSize(1+(bufLength-1)/SamplesPacket::maxSamplesInPacket),
+        mSampleSize(sampleSize),
+        mPacketBytes(SamplesPacket::maxSamplesInPacket*sampleSize)
+    {
+        assert(sampleSize > 0);
+        //packets headers are kept apart, so sample storage is not padded
+        mHeaders = new PacketHeader[mBufferSize];
+        mSamples = new uint8_t[size_t(mBufferSize)*mPacketBytes];
         Clear();
     }
 
     ~RingFIFO()
     {
-        delete []mBuffer;
+        delete []mHeaders;
+        delete []mSamples;
     };
 
     /** @brief inserts samples to FIFO, operation is thread-safe
@@ -58,11 +78,33 @@ public:
     @param flags optional flags associated with the samples
     @return number of items inserted
     */
-    uint32_t push_samples(const complex16_t *buffer, const uint32_t samplesCount, const uint8_t channelsCount, uint64_t timestamp, const uint32_t timeout_ms, const uint32_t flags = 0)
+    uint32_t push_samples(const void *buffer, const uint32_t samplesCount, const uint8_t channelsCount, uint64_t timestamp, const uint32_t timeout_ms, const uint32_t flags = 0)
     {
-        assert(buffer != nullptr);
+        assert(buffer != nullptr || samplesCount == 0);
+        const uint8_t* src = static_cast<const uint8_t*>(buffer);
         uint32_t samplesTaken = 0;
         std::unique_lock<std::mutex> lck(lock);
+        //burst terminated without samples, mark end of already written data
+        if (samplesCount == 0 && (flags & END_BURST) && mBurstOpen)
+        {
+            if (mElementsFilled > 0)
+                mHeaders[Advance(mTail, mBufferSize - 1)].flags |= END_BURST;
+            else
+            {
+                //consumer may hold popped samples, queue marker without samples
+                PacketHeader &pkt = mHeaders[mTail];
+                pkt.timestamp = mBurstEnd;
+                pkt.first = 0;
+                pkt.last = 0;
+                pkt.flags = END_BURST;
+                mTail = Advance(mTail, 1);
+                ++mElementsFilled;
+            }
+            mBurstOpen = false;
+            lck.unlock();
+            hasItems.notify_one();
+            return 0;
+        }
         auto t1 = std::chrono::high_resolution_clock::now();
         while (samplesTaken < samplesCount)
         {
@@ -74,10 +116,9 @@ public:
 
                 if(flags & OVERWRITE_OLD)
                 {
-                    int dropElements = ceil(((float)samplesCount-samplesTaken)/mBuffer[mTail].maxSamplesInPacket);
-                    if(dropElements == 0)
-                        dropElements = 1;
-                    mHead = (mHead + dropElements) & (mBufferSize - 1);//advance to next one
+                    uint32_t dropElements = ceil(((float)samplesCount-samplesTaken)/SamplesPacket::maxSamplesInPacket);
+                    dropElements = std::min(std::max(dropElements, 1u), mElementsFilled);
+                    mHead = Advance(mHead, dropElements);
                     mElementsFilled -= dropElements;
                 }
 
@@ -90,20 +131,21 @@ public:
 
             while (mElementsFilled < mBufferSize && samplesTaken < samplesCount)
             {
-                mBuffer[mTail].timestamp = timestamp + samplesTaken;
-                mBuffer[mTail].first = 0;
-                mBuffer[mTail].last = 0;
-                mBuffer[mTail].flags = flags;
-                while (mBuffer[mTail].last < mBuffer[mTail].maxSamplesInPacket && samplesTaken < samplesCount)
-                {
-                    const int sampleIndex = mBuffer[mTail].last;
-                    mBuffer[mTail].samples[sampleIndex] = buffer[samplesTaken];
-                    ++samplesTaken;
-                    ++mBuffer[mTail].last;
-                }
-                mTail = (mTail + 1) & (mBufferSize - 1);//advance to next one
-                mTail = mTail;
+                PacketHeader &pkt = mHeaders[mTail];
+                const uint32_t toCopy = std::min<uint32_t>(SamplesPacket::maxSamplesInPacket, samplesCount - samplesTaken);
+                memcpy(Samples(mTail), src + samplesTaken*mSampleSize, toCopy*mSampleSize);
+                pkt.timestamp = timestamp + samplesTaken;
+                pkt.first = 0;
+                pkt.last = toCopy;
+                pkt.flags = flags & ~END_BURST;
+                samplesTaken += toCopy;
+                //only the packet holding last sample ends the burst
+                if (samplesTaken == samplesCount)
+                    pkt.flags |= (flags & END_BURST);
+                mTail = Advance(mTail, 1);
                 ++mElementsFilled;
+                mBurstEnd = pkt.timestamp + toCopy;
+                mBurstOpen = (pkt.flags & END_BURST) == 0;
             }
         }
         lck.unlock();
@@ -118,11 +160,13 @@ public:
         @param timestamp returns timestamp of the first sample in buffer
         @param timeout_ms timeout duration for operation
         @param flags optional flags associated with the samples
-        @return number of samples popped
+        @return number of samples popped, less than requested if burst has ended,
+            zero with END_BURST flag if burst was ended by a write without samples
     */
-    uint32_t pop_samples(complex16_t* buffer, const uint32_t samplesCount, const uint8_t channelsCount, uint64_t *timestamp, const uint32_t timeout_ms, uint32_t *flags = nullptr)
+    uint32_t pop_samples(void* buffer, const uint32_t samplesCount, const uint8_t channelsCount, uint64_t *timestamp, const uint32_t timeout_ms, uint32_t *flags = nullptr)
     {
         assert(buffer != nullptr);
+        uint8_t* dst = static_cast<uint8_t*>(buffer);
         uint32_t samplesFilled = 0;
         if (flags != nullptr) *flags = 0;
         std::unique_lock<std::mutex> lck(lock);
@@ -136,47 +180,127 @@ public:
                     return samplesFilled;
             }
             if(samplesFilled == 0 && timestamp != nullptr)
-                *timestamp = mBuffer[mHead].timestamp + mBuffer[mHead].first;
+                *timestamp = mHeaders[mHead].timestamp + mHeaders[mHead].first;
 
-            while(mElementsFilled > 0 && samplesFilled < samplesCount)
+            bool burstEnded = false;
+            while(mElementsFilled > 0 && samplesFilled < samplesCount && !burstEnded)
             {
-                if (flags != nullptr) *flags |= mBuffer[mHead].flags;
-                while (mBuffer[mHead].first < mBuffer[mHead].last && samplesFilled < samplesCount)
+                PacketHeader &pkt = mHeaders[mHead];
+                if (flags != nullptr) *flags |= (pkt.flags & ~END_BURST);
+                const uint32_t toCopy = std::min<uint32_t>(pkt.last - pkt.first, samplesCount - samplesFilled);
+                memcpy(dst + samplesFilled*mSampleSize, Samples(mHead) + pkt.first*mSampleSize, toCopy*mSampleSize);
+                pkt.first += toCopy;
+                samplesFilled += toCopy;
+                if (pkt.first == pkt.last) //packet depleated
                 {
-                    buffer[samplesFilled] = mBuffer[mHead].samples[mBuffer[mHead].first];
-                    ++mBuffer[mHead].first;
-                    ++samplesFilled;
-                }
-                if (mBuffer[mHead].first == mBuffer[mHead].last) //packet depleated
-                {
-                    mBuffer[mHead].first = 0;
-                    mBuffer[mHead].last = 0;
-                    mBuffer[mHead].timestamp = 0;
-                    mHead = (mHead + 1) & (mBufferSize - 1);//advance to next one
-                    mHead = mHead;
+                    //do not merge samples of different bursts
+                    if (pkt.flags & END_BURST)
+                    {
+                        burstEnded = true;
+                        if (flags != nullptr) *flags |= END_BURST;
+                    }
+                    pkt.first = 0;
+                    pkt.last = 0;
+                    pkt.timestamp = 0;
+                    mHead = Advance(mHead, 1);
                     --mElementsFilled;
                 }
             }
+            if (burstEnded)
+                break;
         }
         lck.unlock();
         hasItems.notify_one();
         return samplesFilled;
     }
 
+    /** @brief Discards samples older than given timestamp without copying them,
+        waits until the sample with given timestamp arrives, operation is thread-safe
+        @param timestamp timestamp of the sample to position FIFO output at
+        @param timeout_ms timeout duration for operation
+        @param headTimestamp returns timestamp of the first sample available in FIFO,
+            greater than requested if the sample has already been discarded or lost
+        @return true if FIFO output is positioned at or after the timestamp, false on timeout
+    */
+    bool seek_timestamp(const uint64_t timestamp, const uint32_t timeout_ms, uint64_t *headTimestamp = nullptr)
+    {
+        std::unique_lock<std::mutex> lck(lock);
+        auto t1 = std::chrono::high_resolution_clock::now();
+        while (true)
+        {
+            bool discarded = false;
+            while (mElementsFilled > 0)
+            {
+                PacketHeader &pkt = mHeaders[mHead];
+                if (pkt.timestamp + pkt.last > timestamp) //requested sample is in this or earlier packet
+                {
+                    if (pkt.timestamp + pkt.first < timestamp)
+                        pkt.first = timestamp - pkt.timestamp;
+                    if (headTimestamp != nullptr)
+                        *headTimestamp = pkt.timestamp + pkt.first;
+                    lck.unlock();
+                    hasItems.notify_one();
+                    return true;
+                }
+                //whole packet is older, drop it
+                pkt.first = 0;
+                pkt.last = 0;
+                pkt.timestamp = 0;
+                mHead = Advance(mHead, 1);
+                --mElementsFilled;
+                discarded = true;
+            }
+            //let producer refill freed slots while waiting
+            if (discarded)
+                hasItems.notify_one();
+            auto elapsed = std::chrono::high_resolution_clock::now() - t1;
+            if (elapsed >= std::chrono::milliseconds(timeout_ms))
+                return false;
+            hasItems.wait_for(lck, std::chrono::milliseconds(timeout_ms) - elapsed);
+        }
+    }
+
     void Clear()
     {
         std::unique_lock<std::mutex> lck(lock);
         mHead = 0;
         mTail = 0;
         mElementsFilled = 0;
+        mBurstOpen = false;
+        mBurstEnd = 0;
     }
 
 protected:
+    struct PacketHeader
+    {
+        PacketHeader() : timestamp(0), first(0), last(0), flags(0) {}
+        uint64_t timestamp; //timestamp of the packet
+        uint16_t first; //index of first unused sample
+        uint16_t last; //end index of samples
+        uint32_t flags;
+    };
+
+    //! @brief wraps around packets index, size does not have to be power of two
+    uint32_t Advance(const uint32_t index, const uint32_t count) const
+    {
+        return (index + count) % mBufferSize;
+    }
+
+    uint8_t* Samples(const uint32_t index)
+    {
+        return mSamples + size_t(index)*mPacketBytes;
+    }
+
     const uint32_t mBufferSize;
-    SamplesPacket* mBuffer;
+    const uint8_t mSampleSize;
+    const uint32_t mPacketBytes;
+    PacketHeader* mHeaders;
+    uint8_t* mSamples;
     uint32_t mHead;
     uint32_t mTail;
     uint32_t mElementsFilled;
+    bool mBurstOpen; //!< samples were written after the last end of burst
+    uint64_t mBurstEnd; //!< timestamp following the last written sample
     std::mutex lock;
     std::condition_variable hasItems;
 };
@@ -241,5 +365,150 @@ public:
     }
 };
 
+
+/** @brief Stream status event, reported by streaming threads
+*/
+struct StreamEvent
+{
+    enum Type : uint8_t
+    {
+        LATE, //!< Tx packet timestamp was late
+        TX_UNDERFLOW, //!< Tx ran out of samples in the middle of burst
+        RX_OVERFLOW, //!< Rx samples were dropped because FIFO was full
+        PACKET_LOSS, //!< Rx packets missing in the data stream
+        END_BURST, //!< last packet of Tx burst was sent
+    };
+    Type type;
+    uint64_t timestamp;
+};
+
+/** @brief Bounded multiple producer/consumer queue for stream events.
+    Push and pop are lock-free, the mutex is only used to sleep while waiting
+    for events. When full, the oldest event is discarded.
+*/
+class StreamEventFIFO
+{
+public:
+    StreamEventFIFO() : mHead(0), mTail(0), mWaiters(0), mDropped(0)
+    {
+        for (uint32_t i = 0; i < mSize; ++i)
+            mCells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    //! @brief Adds event to the queue, wakes up waiting consumers
+    void push(const StreamEvent& event)
+    {
+        while (!try_push(event))
+        {
+            StreamEvent oldest;
+            if (try_pop(oldest))
+                ++mDropped;
+        }
+        //order the push before checking for sleeping consumers
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (mWaiters.load() > 0)
+        {
+            std::lock_guard<std::mutex> lck(mLock);
+            mHasItems.notify_all();
+        }
+    }
+
+    /** @brief Takes event from the queue
+        @param event returned event
+        @param timeout_ms time to wait for event, 0 returns immediately
+        @return true if event was returned
+    */
+    bool pop(StreamEvent& event, const int32_t timeout_ms)
+    {
+        if (try_pop(event))
+            return true;
+        if (timeout_ms <= 0)
+            return false;
+        std::unique_lock<std::mutex> lck(mLock);
+        ++mWaiters;
+        const bool popped = mHasItems.wait_for(lck, std::chrono::milliseconds(timeout_ms),
+            [this, &event](){return try_pop(event);});
+        --mWaiters;
+        return popped;
+    }
+
+    //! @brief Discards all queued events
+    void clear()
+    {
+        StreamEvent event;
+        while (try_pop(event));
+        mDropped.store(0);
+    }
+
+    //! @brief Returns number of events discarded because queue was full
+    uint32_t dropped() const
+    {
+        return mDropped.load();
+    }
+
+private:
+    bool try_push(const StreamEvent& event)
+    {
+        uint32_t pos = mTail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = mCells[pos & (mSize - 1)];
+            const uint32_t seq = cell.sequence.load(std::memory_order_acquire);
+            const int32_t diff = int32_t(seq - pos);
+            if (diff == 0)
+            {
+                if (mTail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.event = event;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false; //full
+            else
+                pos = mTail.load(std::memory_order_relaxed);
+        }
+    }
+
+    bool try_pop(StreamEvent& event)
+    {
+        uint32_t pos = mHead.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = mCells[pos & (mSize - 1)];
+            const uint32_t seq = cell.sequence.load(std::memory_order_acquire);
+            const int32_t diff = int32_t(seq - (pos + 1));
+            if (diff == 0)
+            {
+                if (mHead.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    event = cell.event;
+                    cell.sequence.store(pos + mSize, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false; //empty
+            else
+                pos = mHead.load(std::memory_order_relaxed);
+        }
+    }
+
+    struct Cell
+    {
+        std::atomic<uint32_t> sequence;
+        StreamEvent event;
+    };
+    static const uint32_t mSize = 64; // must be power of 2
+    Cell mCells[mSize];
+    std::atomic<uint32_t> mHead;
+    std::atomic<uint32_t> mTail;
+    std::atomic<int> mWaiters;
+    std::atomic<uint32_t> mDropped;
+    std::mutex mLock;
+    std::condition_variable mHasItems;
+};
+
 }
 #endif
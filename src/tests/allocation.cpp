@@ -0,0 +1,139 @@
+#include "gtest/gtest.h"
+#include "XillybusEmulator.h"
+#include "IConnection.h"
+#include "ConnectionRegistry.h"
+#include <unistd.h>
+#include <cstdlib>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+
+using namespace std;
+using namespace lime;
+
+//all heap allocations of the process pass through these, counted while armed
+extern "C" void* __libc_malloc(size_t size);
+extern "C" void* __libc_calloc(size_t count, size_t size);
+extern "C" void* __libc_realloc(void* ptr, size_t size);
+
+static std::atomic<bool> countAllocations(false);
+static std::atomic<uint64_t> allocationsCount(0);
+
+extern "C" void* malloc(size_t size)
+{
+    if (countAllocations.load(std::memory_order_relaxed))
+        allocationsCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size)
+{
+    if (countAllocations.load(std::memory_order_relaxed))
+        allocationsCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size)
+{
+    if (countAllocations.load(std::memory_order_relaxed))
+        allocationsCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+static int16_t TxPattern(const uint64_t timestamp)
+{
+    return int16_t(timestamp % 2000) - 1000;
+}
+
+TEST(Allocation, SteadyStateStreamingAndControl)
+{
+    char dirTemplate[] = "/tmp/limeAllocationXXXXXX";
+    ASSERT_NE(mkdtemp(dirTemplate), nullptr);
+    const std::string deviceDir = dirTemplate;
+    //emulator thread answers control packets and produces Rx from preallocated buffers
+    XillybusEmulator emulator(deviceDir, 2.5e6);
+    ASSERT_EQ(emulator.Start(), 0);
+    ConnectionHandle hint;
+    hint.module = "PCIEXillybus";
+    hint.addr = deviceDir;
+    auto handles = ConnectionRegistry::findConnections(hint);
+    ASSERT_EQ(handles.size(), 1u);
+    IConnection* conn = ConnectionRegistry::makeConnection(handles[0]);
+    ASSERT_NE(conn, nullptr);
+
+    StreamConfig config;
+    config.channelID = 0;
+    config.format = StreamConfig::STREAM_COMPLEX_FLOAT32;
+    config.linkFormat = StreamConfig::STREAM_12_BIT_COMPRESSED;
+    size_t rxStream, txStream;
+    config.isTx = false;
+    ASSERT_EQ(conn->SetupStream(rxStream, config), 0);
+    config.isTx = true;
+    ASSERT_EQ(conn->SetupStream(txStream, config), 0);
+    ASSERT_EQ(conn->ControlStream(rxStream, true), 0);
+    ASSERT_EQ(conn->ControlStream(txStream, true), 0);
+
+    const int samplesInPacket = 1360;
+    std::vector<float> rxBuffer(2*samplesInPacket*4);
+    std::vector<float> txBuffer(2*samplesInPacket);
+    uint64_t txTimestamp = 1000000;
+    uint64_t rxTotal = 0;
+    int controlMismatches = 0;
+    uint32_t iteration = 0;
+    const auto t0 = chrono::steady_clock::now();
+    //first half a second lets buffers and register maps reach their final size
+    while (chrono::steady_clock::now() - t0 < chrono::milliseconds(1500))
+    {
+        if (!countAllocations.load() && chrono::steady_clock::now() - t0 > chrono::milliseconds(500))
+            countAllocations.store(true);
+
+        StreamMetadata rxMeta;
+        const int count = conn->ReadStream(rxStream, rxBuffer.data(), rxBuffer.size()/2, 1000, rxMeta);
+        if (count > 0)
+            rxTotal += count;
+
+        for (int n = 0; n < 4; ++n)
+        {
+            for (int i = 0; i < samplesInPacket; ++i)
+            {
+                txBuffer[2*i] = TxPattern(txTimestamp+i)/2048.0f;
+                txBuffer[2*i+1] = 0;
+            }
+            StreamMetadata txMeta;
+            txMeta.timestamp = txTimestamp;
+            txMeta.hasTimestamp = true;
+            txMeta.endOfBurst = false;
+            conn->WriteStream(txStream, txBuffer.data(), samplesInPacket, 1000, txMeta);
+            txTimestamp += samplesInPacket;
+        }
+
+        //control transfers alongside streaming
+        uint32_t value = 0;
+        conn->WriteRegister(0x0123, iteration & 0xFFFF);
+        conn->ReadRegister(0x0123, value);
+        const uint32_t spiWrite[] = {(1u << 31) | (0x0092u << 16) | (iteration & 0xFFFF), (1u << 31) | (0x0093u << 16) | 0x1234};
+        const uint32_t spiRead[] = {0x0092u << 16, 0x0093u << 16};
+        uint32_t spiValues[2] = {0, 0};
+        conn->WriteLMS7002MSPI(spiWrite, 2);
+        conn->ReadLMS7002MSPI(spiRead, spiValues, 2);
+        if (value != (iteration & 0xFFFF) || spiValues[0] != (iteration & 0xFFFF) || spiValues[1] != 0x1234)
+            ++controlMismatches;
+        ++iteration;
+    }
+    countAllocations.store(false);
+    const uint64_t allocations = allocationsCount.load();
+
+    conn->ControlStream(rxStream, false);
+    conn->ControlStream(txStream, false);
+    conn->CloseStream(rxStream);
+    conn->CloseStream(txStream);
+    ConnectionRegistry::freeConnection(conn);
+    emulator.Stop();
+    rmdir(deviceDir.c_str());
+
+    EXPECT_GT(rxTotal, 1000000u);
+    EXPECT_GT(emulator.GetTxPacketsCount(), 0u);
+    EXPECT_EQ(controlMismatches, 0);
+    EXPECT_EQ(allocations, 0u);
+}
@@ -0,0 +1,258 @@
+#include "gtest/gtest.h"
+#include "XillybusEmulator.h"
+#include "IConnection.h"
+#include "ConnectionRegistry.h"
+#include "LimeSuiteServer.h"
+#include <unistd.h>
+#include <cstdlib>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+
+using namespace std;
+using namespace lime;
+
+/** Emulated PCIe device shared by LimeSuiteServer on loopback,
+    accessed through Remote connection from the registry.
+*/
+class LimeSuiteServerFixture : public ::testing::Test
+{
+public:
+    LimeSuiteServerFixture() : device(nullptr), conn(nullptr), port(0) {}
+
+    void SetUp()
+    {
+        char dirTemplate[] = "/tmp/limeRemoteXXXXXX";
+        ASSERT_NE(mkdtemp(dirTemplate), nullptr);
+        deviceDir = dirTemplate;
+        emulator.reset(new XillybusEmulator(deviceDir, sampleRate));
+        ASSERT_EQ(emulator->Start(), 0);
+
+        ConnectionHandle hint;
+        hint.module = "PCIEXillybus";
+        hint.addr = deviceDir;
+        auto handles = ConnectionRegistry::findConnections(hint);
+        ASSERT_EQ(handles.size(), 1u);
+        device = ConnectionRegistry::makeConnection(handles[0]);
+        ASSERT_NE(device, nullptr);
+
+        //first free port from a range, tests may run in parallel
+        server.reset(new LimeSuiteServer(device));
+        for (uint16_t p = 55200; p < 55300 && port == 0; ++p)
+            if (server->Start(p) == 0)
+                port = p;
+        ASSERT_NE(port, 0);
+    }
+
+    void TearDown()
+    {
+        if (conn != nullptr)
+            ConnectionRegistry::freeConnection(conn);
+        if (server)
+            server->Stop();
+        if (device != nullptr)
+            ConnectionRegistry::freeConnection(device);
+        if (emulator)
+            emulator->Stop();
+        rmdir(deviceDir.c_str());
+    }
+
+    void Connect(const std::string &scheme)
+    {
+        ConnectionHandle hint;
+        hint.addr = scheme + "://127.0.0.1:" + std::to_string(port);
+        auto handles = ConnectionRegistry::findConnections(hint);
+        ASSERT_EQ(handles.size(), 1u);
+        EXPECT_EQ(handles[0].module, "Remote");
+        EXPECT_EQ(handles[0].name, "LimeSDR-PCIe");
+        conn = ConnectionRegistry::makeConnection(handles[0]);
+        ASSERT_NE(conn, nullptr);
+        ASSERT_TRUE(conn->IsOpen());
+    }
+
+    void CheckControl();
+    void CheckStreaming();
+
+    static constexpr double sampleRate = 2.5e6;
+    std::string deviceDir;
+    std::unique_ptr<XillybusEmulator> emulator;
+    std::unique_ptr<LimeSuiteServer> server;
+    IConnection* device;
+    IConnection* conn;
+    uint16_t port;
+};
+constexpr double LimeSuiteServerFixture::sampleRate;
+
+void LimeSuiteServerFixture::CheckControl()
+{
+    ASSERT_EQ(conn->WriteRegister(0x0123, 0x5A5A), 0);
+    uint32_t value = 0;
+    ASSERT_EQ(conn->ReadRegister(0x0123, value), 0);
+    EXPECT_EQ(value, 0x5A5Au);
+    EXPECT_EQ(emulator->GetFPGARegister(0x0123), 0x5A5A);
+
+    const uint32_t spiWrite[] = {(1u << 31) | (0x0092u << 16) | 0x1234, (1u << 31) | (0x0093u << 16) | 0x4321};
+    const uint32_t spiRead[] = {0x0092u << 16, 0x0093u << 16};
+    uint32_t spiValues[2] = {0, 0};
+    ASSERT_EQ(conn->WriteLMS7002MSPI(spiWrite, 2), 0);
+    ASSERT_EQ(conn->ReadLMS7002MSPI(spiRead, spiValues, 2), 0);
+    EXPECT_EQ(spiValues[0], 0x1234u);
+    EXPECT_EQ(spiValues[1], 0x4321u);
+    EXPECT_EQ(emulator->GetLMS7002MRegister(0, 0x0092), 0x1234);
+}
+
+void LimeSuiteServerFixture::CheckStreaming()
+{
+    const uint64_t txStart = 1000000;
+    const int samplesInPacket = 1020; //12 bit samples in 16 bit link
+    const int txPackets = 1024; //more than client keeps in flight, needs credits
+    auto txPattern = [](uint64_t ts){ return int16_t((ts*3) & 0x7FF); };
+
+    std::mutex lock;
+    int txMatched = 0;
+    int txMismatched = 0;
+    uint64_t txExpected = txStart;
+    emulator->SetTxCallback([&](uint64_t timestamp, bool syncTimestamp, const complex16_t* const* samples, int chCount, int count){
+        if (!syncTimestamp)
+            return;
+        std::lock_guard<std::mutex> lck(lock);
+        bool match = timestamp == txExpected && count == samplesInPacket;
+        for (int i = 0; i < count && match; ++i)
+            match = samples[0][i].i == txPattern(timestamp+i) && samples[0][i].q == -txPattern(timestamp+i);
+        match ? ++txMatched : ++txMismatched;
+        txExpected = timestamp + count;
+    });
+
+    StreamConfig config;
+    config.channelID = 0;
+    config.format = StreamConfig::STREAM_12_BIT_IN_16;
+    config.linkFormat = StreamConfig::STREAM_12_BIT_IN_16;
+    size_t rxStream, txStream;
+    config.isTx = false;
+    ASSERT_EQ(conn->SetupStream(rxStream, config), 0);
+    config.isTx = true;
+    ASSERT_EQ(conn->SetupStream(txStream, config), 0);
+    ASSERT_EQ(conn->ControlStream(rxStream, true), 0);
+    ASSERT_EQ(conn->ControlStream(txStream, true), 0);
+
+    std::vector<complex16_t> txBuffer(txPackets*samplesInPacket);
+    for (size_t i = 0; i < txBuffer.size(); ++i)
+    {
+        txBuffer[i].i = txPattern(txStart+i);
+        txBuffer[i].q = -txBuffer[i].i;
+    }
+    std::thread txThread([&]{
+        StreamMetadata txMeta;
+        txMeta.timestamp = txStart;
+        txMeta.hasTimestamp = true;
+        txMeta.endOfBurst = true;
+        EXPECT_EQ(conn->WriteStream(txStream, txBuffer.data(), txBuffer.size(), 2000, txMeta), int(txBuffer.size()));
+    });
+
+    //ramp continues across reads, except for packets skipped in the middle,
+    //reads are one packet long so the gap falls between them
+    const int skippedPackets = 4;
+    std::vector<complex16_t> rxBuffer(samplesInPacket);
+    uint64_t rxExpected = 0;
+    uint64_t rxTotal = 0;
+    int rxGaps = 0;
+    int rxMismatched = 0;
+    bool skipped = false;
+    uint64_t skippedSamples = 0;
+    auto t0 = chrono::steady_clock::now();
+    while (chrono::steady_clock::now() - t0 < chrono::milliseconds(600))
+    {
+        if (!skipped && chrono::steady_clock::now() - t0 > chrono::milliseconds(300))
+        {
+            emulator->SkipRxPackets(skippedPackets);
+            skipped = true;
+        }
+        StreamMetadata rxMeta;
+        const int count = conn->ReadStream(rxStream, rxBuffer.data(), rxBuffer.size(), 1000, rxMeta);
+        if (count <= 0)
+        {
+            ADD_FAILURE() << "Rx stream stalled";
+            break; //Tx thread is still joined below
+        }
+        if (rxTotal > 0 && rxMeta.timestamp != rxExpected)
+        {
+            ++rxGaps;
+            skippedSamples += rxMeta.timestamp - rxExpected;
+        }
+        for (int i = 0; i < count; ++i)
+        {
+            const int expectedI = XillybusEmulator::RampI(rxMeta.timestamp+i);
+            if (rxBuffer[i].i != expectedI || rxBuffer[i].q != -expectedI)
+            {
+                ++rxMismatched;
+                break;
+            }
+        }
+        rxExpected = rxMeta.timestamp + count;
+        rxTotal += count;
+    }
+    const uint64_t rxDropped = emulator->GetRxPacketsDropped();
+
+    bool packetLossReported = false;
+    StreamMetadata event;
+    while (!packetLossReported && conn->ReadStreamStatus(rxStream, 0, event) == 0)
+        packetLossReported = event.packetDropped;
+
+    txThread.join();
+    t0 = chrono::steady_clock::now();
+    while (chrono::steady_clock::now() - t0 < chrono::seconds(2))
+    {
+        {
+            std::lock_guard<std::mutex> lck(lock);
+            if (txMatched + txMismatched >= txPackets)
+                break;
+        }
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+
+    conn->ControlStream(rxStream, false);
+    conn->ControlStream(txStream, false);
+    conn->CloseStream(rxStream);
+    conn->CloseStream(txStream);
+    emulator->SetTxCallback(nullptr);
+
+    EXPECT_GT(rxTotal, uint64_t(sampleRate*0.4));
+    EXPECT_EQ(rxMismatched, 0);
+    EXPECT_EQ(rxDropped, 0u);
+    EXPECT_EQ(rxGaps, 1);
+    EXPECT_EQ(skippedSamples, uint64_t(skippedPackets*samplesInPacket));
+    EXPECT_TRUE(packetLossReported);
+    std::lock_guard<std::mutex> lck(lock);
+    EXPECT_EQ(txMatched, txPackets);
+    EXPECT_EQ(txMismatched, 0);
+}
+
+TEST_F(LimeSuiteServerFixture, ControlUDP)
+{
+    Connect("udp");
+    if (HasFatalFailure()) return;
+    CheckControl();
+}
+
+TEST_F(LimeSuiteServerFixture, ControlTCP)
+{
+    Connect("tcp");
+    if (HasFatalFailure()) return;
+    CheckControl();
+}
+
+TEST_F(LimeSuiteServerFixture, StreamUDP)
+{
+    Connect("udp");
+    if (HasFatalFailure()) return;
+    CheckStreaming();
+}
+
+TEST_F(LimeSuiteServerFixture, StreamTCP)
+{
+    Connect("tcp");
+    if (HasFatalFailure()) return;
+    CheckStreaming();
+}
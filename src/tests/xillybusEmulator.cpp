@@ -0,0 +1,412 @@
+#include "gtest/gtest.h"
+#include "XillybusEmulator.h"
+#include "IConnection.h"
+#include "ConnectionRegistry.h"
+#include "SharedStream.h"
+#include "LMS7002M.h"
+#include <unistd.h>
+#include <sys/wait.h>
+#include <cstdlib>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <complex>
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+using namespace lime;
+
+class XillybusEmulatorFixture : public ::testing::Test
+{
+public:
+    XillybusEmulatorFixture() : conn(nullptr) {}
+
+    void SetUp()
+    {
+        char dirTemplate[] = "/tmp/limeXillybusXXXXXX";
+        ASSERT_NE(mkdtemp(dirTemplate), nullptr);
+        deviceDir = dirTemplate;
+        //low enough rate for receiving without drops on a loaded single core
+        emulator.reset(new XillybusEmulator(deviceDir, sampleRate));
+        ASSERT_EQ(emulator->Start(), 0);
+
+        ConnectionHandle hint;
+        hint.module = "PCIEXillybus";
+        hint.addr = deviceDir;
+        auto handles = ConnectionRegistry::findConnections(hint);
+        ASSERT_EQ(handles.size(), 1u);
+        EXPECT_EQ(handles[0].name, "LimeSDR-PCIe");
+        conn = ConnectionRegistry::makeConnection(handles[0]);
+        ASSERT_NE(conn, nullptr);
+        ASSERT_TRUE(conn->IsOpen());
+    }
+
+    void TearDown()
+    {
+        if (conn != nullptr)
+            ConnectionRegistry::freeConnection(conn);
+        if (emulator)
+            emulator->Stop();
+        rmdir(deviceDir.c_str());
+    }
+
+    static constexpr double sampleRate = 2.5e6;
+    std::string deviceDir;
+    std::unique_ptr<XillybusEmulator> emulator;
+    IConnection* conn;
+};
+constexpr double XillybusEmulatorFixture::sampleRate;
+
+TEST_F(XillybusEmulatorFixture, ControlRegisters)
+{
+    ASSERT_EQ(conn->WriteRegister(0x0123, 0x5A5A), 0);
+    uint32_t value = 0;
+    ASSERT_EQ(conn->ReadRegister(0x0123, value), 0);
+    EXPECT_EQ(value, 0x5A5Au);
+    EXPECT_EQ(emulator->GetFPGARegister(0x0123), 0x5A5A);
+    EXPECT_EQ(conn->GetDeviceInfo().deviceName, "LimeSDR-PCIe");
+}
+
+TEST_F(XillybusEmulatorFixture, ProfileRoundTrip)
+{
+    LMS7002M lms;
+    lms.SetConnection(conn);
+    const std::string filename = deviceDir + "/profile.bin";
+    //MCU control registers have no parameters, they are kept once written
+    ASSERT_EQ(lms.SPI_write(0x0002, 0x0000), 0);
+    ASSERT_EQ(lms.SaveProfile(filename.c_str()), 0);
+    const uint16_t saved0002 = lms.SPI_read(0x0002);
+    const uint16_t saved0100 = lms.SPI_read(0x0100);
+
+    //one register handled by MCU control and one register of both channels,
+    //SaveProfile() leaves MAC selecting both
+    ASSERT_EQ(lms.SPI_write(0x0002, saved0002 ^ 0x0003), 0);
+    ASSERT_EQ(lms.SPI_write(0x0100, saved0100 ^ 0x1234), 0);
+    uint64_t writes = emulator->GetLMS7002MWritesCount();
+    ASSERT_EQ(lms.LoadProfile(filename.c_str()), 0);
+    //select A, 0x0002, 0x0100, select B, 0x0100, channel select restore
+    EXPECT_EQ(emulator->GetLMS7002MWritesCount() - writes, 6u);
+    EXPECT_EQ(lms.SPI_read(0x0002), saved0002);
+    EXPECT_EQ(lms.SPI_read(0x0100), saved0100);
+    EXPECT_EQ(emulator->GetLMS7002MRegister(0, 0x0002), saved0002);
+    EXPECT_EQ(emulator->GetLMS7002MRegister(0, 0x0100), saved0100);
+    EXPECT_EQ(emulator->GetLMS7002MRegister(1, 0x0100), saved0100);
+
+    //nothing differs from cache, nothing is written
+    writes = emulator->GetLMS7002MWritesCount();
+    ASSERT_EQ(lms.LoadProfile(filename.c_str()), 0);
+    EXPECT_EQ(emulator->GetLMS7002MWritesCount(), writes);
+    remove(filename.c_str());
+}
+
+TEST_F(XillybusEmulatorFixture, StreamRxTx)
+{
+    const uint64_t txStart = 1000000;
+    const int samplesInPacket = 1020; //12 bit samples in 16 bit link
+    const int txPackets = 256;
+    auto txPattern = [](uint64_t ts){ return int16_t((ts*3) & 0x7FF); };
+
+    std::mutex lock;
+    int txMatched = 0;
+    int txMismatched = 0;
+    uint64_t txExpected = txStart;
+    emulator->SetTxCallback([&](uint64_t timestamp, bool syncTimestamp, const complex16_t* const* samples, int chCount, int count){
+        //padding is sent without timestamp while Tx FIFO is empty
+        if (!syncTimestamp)
+            return;
+        std::lock_guard<std::mutex> lck(lock);
+        bool match = timestamp == txExpected && count == samplesInPacket;
+        for (int i = 0; i < count && match; ++i)
+            match = samples[0][i].i == txPattern(timestamp+i) && samples[0][i].q == -txPattern(timestamp+i);
+        match ? ++txMatched : ++txMismatched;
+        txExpected = timestamp + count;
+    });
+
+    StreamConfig config;
+    config.channelID = 0;
+    config.format = StreamConfig::STREAM_12_BIT_IN_16;
+    config.linkFormat = StreamConfig::STREAM_12_BIT_IN_16;
+    size_t rxStream, txStream;
+    config.isTx = false;
+    ASSERT_EQ(conn->SetupStream(rxStream, config), 0);
+    config.isTx = true;
+    ASSERT_EQ(conn->SetupStream(txStream, config), 0);
+    ASSERT_EQ(conn->ControlStream(rxStream, true), 0);
+    ASSERT_EQ(conn->ControlStream(txStream, true), 0);
+
+    //whole burst is queued at once, Tx loop must not run out of samples
+    std::vector<complex16_t> txBuffer(txPackets*samplesInPacket);
+    for (size_t i = 0; i < txBuffer.size(); ++i)
+    {
+        txBuffer[i].i = txPattern(txStart+i);
+        txBuffer[i].q = -txBuffer[i].i;
+    }
+    StreamMetadata txMeta;
+    txMeta.timestamp = txStart;
+    txMeta.hasTimestamp = true;
+    txMeta.endOfBurst = true;
+    EXPECT_EQ(conn->WriteStream(txStream, txBuffer.data(), txBuffer.size(), 1000, txMeta), int(txBuffer.size()));
+
+    //meters are off until requested, the output stays untouched
+    StreamMeters meters;
+    meters.power = 1;
+    EXPECT_NE(conn->ReadStreamMeters(rxStream, meters), 0);
+    EXPECT_EQ(meters.power, 1);
+
+    std::vector<complex16_t> rxBuffer(samplesInPacket*8);
+    uint64_t rxExpected = 0;
+    uint64_t rxTotal = 0;
+    int rxGaps = 0;
+    int rxMismatched = 0;
+    auto t0 = chrono::steady_clock::now();
+    while (chrono::steady_clock::now() - t0 < chrono::milliseconds(500))
+    {
+        StreamMetadata rxMeta;
+        const int count = conn->ReadStream(rxStream, rxBuffer.data(), rxBuffer.size(), 1000, rxMeta);
+        ASSERT_GT(count, 0);
+        if (rxTotal > 0 && rxMeta.timestamp != rxExpected)
+            ++rxGaps;
+        for (int i = 0; i < count; ++i)
+        {
+            const int expectedI = XillybusEmulator::RampI(rxMeta.timestamp+i);
+            if (rxBuffer[i].i != expectedI || rxBuffer[i].q != -expectedI)
+            {
+                ++rxMismatched;
+                break;
+            }
+        }
+        rxExpected = rxMeta.timestamp + count;
+        rxTotal += count;
+    }
+    //Rx is not read below, packets dropped from then on are expected
+    const uint64_t rxDropped = emulator->GetRxPacketsDropped();
+
+    //burst is sent while receiving, wait for the rest of it
+    t0 = chrono::steady_clock::now();
+    while (chrono::steady_clock::now() - t0 < chrono::seconds(2))
+    {
+        {
+            std::lock_guard<std::mutex> lck(lock);
+            if (txMatched + txMismatched >= txPackets)
+                break;
+        }
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    StreamMetadata event;
+    bool burstEnded = false;
+    while (!burstEnded && conn->ReadStreamStatus(txStream, 100, event) == 0)
+        burstEnded = event.endOfBurst;
+
+    EXPECT_EQ(conn->ReadStreamMeters(rxStream, meters), 0);
+    EXPECT_GT(meters.samplesCount, 0u);
+    EXPECT_GT(meters.power, -10); //ramp over most of the full scale
+
+    conn->ControlStream(rxStream, false);
+    conn->ControlStream(txStream, false);
+    conn->CloseStream(rxStream);
+    conn->CloseStream(txStream);
+
+    EXPECT_GT(rxTotal, uint64_t(sampleRate*0.4)); //half a second of samples
+    EXPECT_EQ(rxGaps, 0);
+    EXPECT_EQ(rxMismatched, 0);
+    EXPECT_EQ(rxDropped, 0u);
+    std::lock_guard<std::mutex> lck(lock);
+    EXPECT_EQ(txMatched, txPackets);
+    EXPECT_EQ(txMismatched, 0);
+    EXPECT_TRUE(burstEnded);
+}
+
+TEST_F(XillybusEmulatorFixture, Channelizer)
+{
+    //two tones repeating every 500 samples, at 61/500 and -119/500 of sample rate
+    const int period = 500;
+    const double amplitude = 600;
+    std::vector<complex16_t> tones(period);
+    for (int n = 0; n < period; ++n)
+    {
+        const std::complex<double> x = amplitude*(std::polar(1.0, 2*M_PI*n*61/period) + std::polar(1.0, -2*M_PI*n*119/period));
+        tones[n].i = int16_t(std::lround(x.real()));
+        tones[n].q = int16_t(std::lround(x.imag()));
+    }
+    emulator->SetRxCallback([&tones, period](uint64_t timestamp, complex16_t* samples, int count){
+        for (int n = 0; n < count; ++n)
+            samples[n] = tones[(timestamp + n) % period];
+    });
+    const double toneA = sampleRate*61/period;
+    const double toneB = -sampleRate*119/period;
+    //channelizer takes input rate from the interface clock setup
+    conn->UpdateExternalDataRate(0, sampleRate, sampleRate, 0, 0);
+    ASSERT_EQ(conn->GetHardwareTimestampRate(), sampleRate);
+
+    struct Channel
+    {
+        double offset;
+        double rate;
+        double toneFrequency; //!< expected tone in output, NAN if none
+    };
+    const Channel channels[] = {
+        {toneA - 5e3, 50e3, 5e3}, //large ratio, half-band stages
+        {toneB - 5e3, 50e3, 5e3},
+        {toneA, 48e3, 0}, //not a power of two fraction
+        {0, 100e3, NAN}, //no tone in band
+    };
+    const int channelsCount = sizeof(channels)/sizeof(channels[0]);
+    std::vector<size_t> streams(channelsCount);
+    for (int c = 0; c < channelsCount; ++c)
+    {
+        StreamConfig config;
+        config.channelID = 0;
+        config.isTx = false;
+        config.format = StreamConfig::STREAM_COMPLEX_FLOAT32;
+        config.channelizerOffset = channels[c].offset;
+        config.channelizerRate = channels[c].rate;
+        ASSERT_EQ(conn->SetupStream(streams[c], config), 0);
+    }
+    for (int c = 0; c < channelsCount; ++c)
+        ASSERT_EQ(conn->ControlStream(streams[c], true), 0);
+
+    //contiguous samples after filters settle, read in turns so no output overflows
+    const size_t settle = 1000;
+    const size_t length = 5000;
+    std::vector<std::vector<std::complex<float>>> samples(channelsCount);
+    std::vector<uint64_t> nextTimestamp(channelsCount, 0);
+    std::vector<size_t> received(channelsCount, 0);
+    std::complex<float> buffer[512];
+    bool complete = false;
+    auto t0 = chrono::steady_clock::now();
+    while (!complete && chrono::steady_clock::now() - t0 < chrono::seconds(5))
+    {
+        complete = true;
+        for (int c = 0; c < channelsCount; ++c)
+        {
+            if (samples[c].size() >= length)
+                continue;
+            complete = false;
+            StreamMetadata meta;
+            const int count = conn->ReadStream(streams[c], buffer, 512, 1000, meta);
+            ASSERT_GE(count, 0);
+            if (received[c] > 0 && meta.timestamp != nextTimestamp[c])
+            {
+                received[c] = 0;
+                samples[c].clear();
+            }
+            for (int n = 0; n < count && samples[c].size() < length; ++n)
+                if (received[c] + n >= settle)
+                    samples[c].push_back(buffer[n]);
+            received[c] += count;
+            nextTimestamp[c] = meta.timestamp + count;
+        }
+    }
+    for (int c = 0; c < channelsCount; ++c)
+        conn->ControlStream(streams[c], false);
+    for (int c = 0; c < channelsCount; ++c)
+        EXPECT_EQ(conn->CloseStream(streams[c]), 0);
+    ASSERT_TRUE(complete);
+
+    //tone at full input level, everything else is rejected
+    const double tonePower = std::pow(amplitude/2048, 2);
+    for (int c = 0; c < channelsCount; ++c)
+    {
+        SCOPED_TRACE(c);
+        const double frequency = std::isnan(channels[c].toneFrequency) ? 0 : channels[c].toneFrequency;
+        std::complex<double> tone = 0;
+        for (size_t n = 0; n < length; ++n)
+            tone += std::complex<double>(samples[c][n])*std::polar(1.0, -2*M_PI*frequency*n/channels[c].rate);
+        tone /= double(length);
+        if (std::isnan(channels[c].toneFrequency))
+            tone = 0;
+        double residualPower = 0;
+        for (size_t n = 0; n < length; ++n)
+            residualPower += std::norm(std::complex<double>(samples[c][n]) - tone*std::polar(1.0, 2*M_PI*frequency*n/channels[c].rate));
+        residualPower /= length;
+        if (!std::isnan(channels[c].toneFrequency))
+        {
+            EXPECT_NEAR(10*std::log10(std::norm(tone)/tonePower), 0, 0.5);
+        }
+        EXPECT_LT(10*std::log10(residualPower/tonePower), -60);
+    }
+}
+
+/** Reads ramp published by SharedStreamPublisher, runs in a forked process.
+    @return 0 on success, otherwise the first failed check
+*/
+static int ReadSharedStream(const std::string& name, std::vector<complex16_t>* buffers, const size_t bufferSize, const int ringMs)
+{
+    SharedStreamReader reader;
+    if (reader.Open(name) != 0 || reader.GetChannelsCount() != 2)
+        return 1;
+    complex16_t* samples[2] = {buffers[0].data(), buffers[1].data()};
+    uint64_t expected = 0;
+    uint64_t total = 0;
+    uint64_t overrun = 0;
+    bool stalled = false;
+    while (total < bufferSize*200)
+    {
+        //falling behind by more than ring length must be reported as overrun
+        if (!stalled && total >= bufferSize*100)
+        {
+            std::this_thread::sleep_for(chrono::milliseconds(ringMs*3));
+            stalled = true;
+        }
+        SharedStreamReader::Metadata meta;
+        const int count = reader.Read(samples, bufferSize, &meta, 1000);
+        if (count <= 0)
+            return 2;
+        //every sample is either returned or accounted for as loss
+        if (total > 0 && meta.timestamp != expected + meta.overrun + meta.dropped)
+            return 3;
+        if (meta.overrun > 0 && !stalled)
+            return 4;
+        overrun += meta.overrun;
+        for (int i = 0; i < count; ++i)
+        {
+            const int expectedI = XillybusEmulator::RampI(meta.timestamp+i);
+            if (samples[0][i].i != expectedI || samples[0][i].q != -expectedI)
+                return 5;
+            if (samples[1][i].i != expectedI || samples[1][i].q != -expectedI)
+                return 6; //channels not aligned
+        }
+        expected = meta.timestamp + count;
+        total += count;
+    }
+    return overrun > 0 ? 0 : 7;
+}
+
+TEST_F(XillybusEmulatorFixture, SharedStream)
+{
+    const std::string name = "/limeSharedStreamTest" + std::to_string(getpid());
+    SharedStreamPublisher::Config config;
+    config.channels = {0, 1};
+    config.sampleRate = sampleRate;
+    config.blockSamples = 1000;
+    config.blocksCount = 256;
+    const int ringMs = config.blockSamples*config.blocksCount*1000/sampleRate;
+    SharedStreamPublisher publisher(conn);
+    ASSERT_EQ(publisher.Start(name, config), 0);
+
+    //reader process only touches buffers allocated before fork
+    const size_t bufferSize = 2500;
+    std::vector<complex16_t> buffers[2];
+    buffers[0].resize(bufferSize);
+    buffers[1].resize(bufferSize);
+    const pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0)
+        _exit(ReadSharedStream(name, buffers, bufferSize, ringMs));
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    const auto stats = publisher.GetStats();
+    EXPECT_EQ(publisher.Stop(), 0);
+
+    ASSERT_TRUE(WIFEXITED(status));
+    //1 open, 2 read timeout, 3 unaccounted gap, 4 unexpected overrun,
+    //5 wrong samples, 6 channels not aligned, 7 overrun not reported
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    EXPECT_GT(stats.samplesPublished, bufferSize*200);
+    //name is removed on stop
+    SharedStreamReader reader;
+    EXPECT_NE(reader.Open(name), 0);
+}
@@ -0,0 +1,405 @@
+/**
+    @file XillybusEmulator.cpp
+    @author Lime Microsystems
+    @brief Imitates LimeSDR-PCIe Xillybus device files for testing without hardware
+*/
+
+#include "XillybusEmulator.h"
+#include <LMS64CCommands.h>
+#include <LMSBoards.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <cstring>
+
+using namespace std;
+using namespace lime;
+
+static const char* ctrlInFile = "xillybus_write_8";
+static const char* ctrlOutFile = "xillybus_read_8";
+static const char* streamInFile = "xillybus_write_32";
+static const char* streamOutFile = "xillybus_read_32";
+static const int ctrlPacketSize = 64;
+static const int maxPacketsPerPoll = 64; //catch up limit when thread was delayed
+
+XillybusEmulator::XillybusEmulator(const std::string &deviceDir, const double sampleRate) :
+    mDeviceDir(deviceDir),
+    mSampleRate(sampleRate),
+    mTerminate(false),
+    mCtrlIn(-1),
+    mCtrlOut(-1),
+    mStreamIn(-1),
+    mStreamOut(-1),
+    mRxEnabled(false),
+    mRxTimestamp(0),
+    mRxPackets(0),
+    mRxDropped(0),
+    mTxPackets(0),
+    mLMS7002MWrites(0),
+    mRxSkip(0)
+{
+    mChannelA[0x0020] = 0xFFFD;
+    mChannelA[0x002F] = 0x3841; //LMS7002Mr3
+}
+
+XillybusEmulator::~XillybusEmulator(void)
+{
+    Stop();
+}
+
+std::string XillybusEmulator::FilePath(const char* name) const
+{
+    return mDeviceDir + "/" + name;
+}
+
+int XillybusEmulator::Start(void)
+{
+    Stop();
+    mkdir(mDeviceDir.c_str(), 0755);
+    int* fds[] = {&mCtrlIn, &mCtrlOut, &mStreamIn, &mStreamOut};
+    const char* names[] = {ctrlInFile, ctrlOutFile, streamInFile, streamOutFile};
+    for (int i = 0; i < 4; ++i)
+    {
+        const std::string path = FilePath(names[i]);
+        unlink(path.c_str());
+        if (mkfifo(path.c_str(), 0666) != 0)
+        {
+            Stop();
+            return -1;
+        }
+        //emulator keeps both ends open, so host side can open and close them in any order
+        *fds[i] = open(path.c_str(), O_RDWR | O_NONBLOCK);
+        if (*fds[i] < 0)
+        {
+            Stop();
+            return -1;
+        }
+    }
+#ifdef F_SETPIPE_SZ
+    fcntl(mStreamOut, F_SETPIPE_SZ, 1 << 20);
+    fcntl(mStreamIn, F_SETPIPE_SZ, 1 << 20);
+#endif
+    mTerminate.store(false);
+    mThread = std::thread(&XillybusEmulator::Run, this);
+    return 0;
+}
+
+void XillybusEmulator::Stop(void)
+{
+    mTerminate.store(true);
+    if (mThread.joinable())
+        mThread.join();
+    int* fds[] = {&mCtrlIn, &mCtrlOut, &mStreamIn, &mStreamOut};
+    const char* names[] = {ctrlInFile, ctrlOutFile, streamInFile, streamOutFile};
+    for (int i = 0; i < 4; ++i)
+    {
+        if (*fds[i] < 0)
+            continue;
+        close(*fds[i]);
+        *fds[i] = -1;
+        unlink(FilePath(names[i]).c_str());
+    }
+}
+
+void XillybusEmulator::SetTxCallback(TxCallback callback)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    mTxCallback = callback;
+}
+
+void XillybusEmulator::SetRxCallback(RxCallback callback)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    mRxCallback = callback;
+}
+
+uint64_t XillybusEmulator::GetRxPacketsCount(void) const
+{
+    return mRxPackets.load();
+}
+
+uint64_t XillybusEmulator::GetRxPacketsDropped(void) const
+{
+    return mRxDropped.load();
+}
+
+uint64_t XillybusEmulator::GetTxPacketsCount(void) const
+{
+    return mTxPackets.load();
+}
+
+uint16_t XillybusEmulator::GetFPGARegister(const uint16_t addr)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return mFPGARegisters[addr];
+}
+
+uint16_t XillybusEmulator::GetLMS7002MRegister(const int ch, const uint16_t addr)
+{
+    std::lock_guard<std::mutex> lock(mLock);
+    return (ch == 0 || addr < 0x0100) ? mChannelA[addr] : mChannelB[addr];
+}
+
+uint64_t XillybusEmulator::GetLMS7002MWritesCount(void) const
+{
+    return mLMS7002MWrites.load();
+}
+
+void XillybusEmulator::SkipRxPackets(const uint32_t count)
+{
+    mRxSkip.fetch_add(count);
+}
+
+int XillybusEmulator::Channels(void) const
+{
+    auto iter = mFPGARegisters.find(0x0007);
+    return (iter != mFPGARegisters.end() && (iter->second & 0x3) == 0x3) ? 2 : 1;
+}
+
+bool XillybusEmulator::Compressed(void) const
+{
+    auto iter = mFPGARegisters.find(0x0008);
+    return iter == mFPGARegisters.end() || (iter->second & 0x3) == 0x2;
+}
+
+void XillybusEmulator::Run(void)
+{
+    uint8_t reply[ctrlPacketSize];
+    while (!mTerminate.load())
+    {
+        struct pollfd fds[2];
+        fds[0].fd = mCtrlIn;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd = mStreamIn;
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        poll(fds, 2, mRxEnabled ? 1 : 10);
+
+        if (fds[0].revents & POLLIN)
+        {
+            uint8_t buf[ctrlPacketSize*4];
+            const int bytesRead = read(mCtrlIn, buf, sizeof(buf));
+            if (bytesRead > 0)
+                mCtrlBuffer.insert(mCtrlBuffer.end(), buf, buf + bytesRead);
+            while (mCtrlBuffer.size() >= size_t(ctrlPacketSize))
+            {
+                ProcessControl(mCtrlBuffer.data(), reply);
+                mCtrlBuffer.erase(mCtrlBuffer.begin(), mCtrlBuffer.begin() + ctrlPacketSize);
+                if (write(mCtrlOut, reply, ctrlPacketSize) != ctrlPacketSize)
+                    continue; //host is not reading replies
+            }
+        }
+        if (fds[1].revents & POLLIN)
+            ConsumeTx();
+        ProduceRx();
+    }
+}
+
+void XillybusEmulator::ProcessControl(const uint8_t* input, uint8_t* output)
+{
+    const int hs = 8; //header size
+    std::lock_guard<std::mutex> lock(mLock);
+    memcpy(output, input, ctrlPacketSize);
+    output[1] = STATUS_COMPLETED_CMD;
+    const int blockCount = input[2];
+    switch (input[0])
+    {
+    case CMD_GET_INFO:
+        memset(output + hs, 0, ctrlPacketSize - hs);
+        output[hs+0] = 255; //firmware
+        output[hs+1] = LMS_DEV_LIMESDR_PCIE; //device
+        output[hs+2] = 255; //protocol
+        output[hs+3] = 255; //hardware
+        output[hs+4] = EXP_BOARD_UNSUPPORTED; //expansion board
+        break;
+    case CMD_LMS7002_RST:
+        mChannelA.clear();
+        mChannelB.clear();
+        mChannelA[0x0020] = 0xFFFD;
+        mChannelA[0x002F] = 0x3841;
+        break;
+    case CMD_LMS7002_WR:
+    case CMD_BRDSPI_WR:
+        for (int i = 0; i < blockCount; ++i)
+        {
+            const uint8_t* block = &input[hs+i*4];
+            const uint16_t addr = ((block[0] << 8) | block[1]) & 0x7FFF;
+            const uint16_t data = (block[2] << 8) | block[3];
+            if (input[0] == CMD_BRDSPI_WR)
+                mFPGARegisters[addr] = data;
+            else
+            {
+                ++mLMS7002MWrites;
+                //register 0x0020 selects channels, others are shared below 0x0100
+                if ((mChannelA[0x0020] & 0x1) != 0 || addr < 0x0100)
+                    mChannelA[addr] = data;
+                if ((mChannelA[0x0020] & 0x2) != 0 && addr >= 0x0100)
+                    mChannelB[addr] = data;
+            }
+        }
+        break;
+    case CMD_LMS7002_RD:
+    case CMD_BRDSPI_RD:
+        memset(output + hs, 0, ctrlPacketSize - hs);
+        //replies are written from the end, as they take more space than requests
+        for (int i = blockCount-1; i >= 0; --i)
+        {
+            const uint8_t* block = &input[hs+i*2];
+            const uint16_t addr = ((block[0] << 8) | block[1]) & 0x7FFF;
+            uint16_t data = 0;
+            if (input[0] == CMD_BRDSPI_RD)
+                data = mFPGARegisters[addr];
+            else
+            {
+                if ((mChannelA[0x0020] & 0x1) != 0 || addr < 0x0100)
+                    data |= mChannelA[addr];
+                if ((mChannelA[0x0020] & 0x2) != 0 && addr >= 0x0100)
+                    data |= mChannelB[addr];
+            }
+            output[hs+i*4] = block[0];
+            output[hs+i*4+1] = block[1];
+            output[hs+i*4+2] = data >> 8;
+            output[hs+i*4+3] = data & 0xFF;
+        }
+        break;
+    case CMD_SI5351_WR:
+    case CMD_SI5351_RD:
+    case CMD_USB_FIFO_RST:
+    case CMD_ANALOG_VAL_WR:
+        break;
+    default:
+        output[1] = STATUS_UNKNOWN_CMD;
+        break;
+    }
+}
+
+void XillybusEmulator::ProduceRx(void)
+{
+    int chCount;
+    bool compressed;
+    bool enabled;
+    RxCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        enabled = (mFPGARegisters[0x000A] & 0x1) != 0;
+        chCount = Channels();
+        compressed = Compressed();
+        callback = mRxCallback;
+    }
+    if (enabled && !mRxEnabled)
+    {
+        //discard packets left from previous run, timestamps start from zero
+        uint8_t buf[4096];
+        while (read(mStreamOut, buf, sizeof(buf)) > 0)
+            ;
+        mRxStart = std::chrono::steady_clock::now();
+        mRxTimestamp = 0;
+    }
+    mRxEnabled = enabled;
+    if (!enabled)
+        return;
+
+    const int samplesInPacket = (compressed ? 1360 : 1020)/chCount;
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - mRxStart).count();
+    const uint64_t dueTimestamp = elapsed*mSampleRate;
+    FPGA_DataPacket pkt;
+    for (int n = 0; n < maxPacketsPerPoll && mRxTimestamp + samplesInPacket <= dueTimestamp; ++n)
+    {
+        memset(pkt.reserved, 0, sizeof(pkt.reserved));
+        pkt.counter = mRxTimestamp;
+        if (callback)
+        {
+            mRxSamples.resize(samplesInPacket);
+            callback(mRxTimestamp, mRxSamples.data(), samplesInPacket);
+        }
+        uint8_t* dest = pkt.data;
+        for (int s = 0; s < samplesInPacket; ++s)
+        {
+            const int16_t i = callback ? mRxSamples[s].i : RampI(mRxTimestamp + s);
+            const int16_t q = callback ? mRxSamples[s].q : -i;
+            for (int ch = 0; ch < chCount; ++ch)
+            {
+                if (compressed)
+                {
+                    *dest++ = i & 0xFF;
+                    *dest++ = ((i >> 8) & 0x0F) | ((q << 4) & 0xF0);
+                    *dest++ = (q >> 4) & 0xFF;
+                }
+                else
+                {
+                    *dest++ = i & 0xFF;
+                    *dest++ = (i >> 8) & 0xFF;
+                    *dest++ = q & 0xFF;
+                    *dest++ = (q >> 8) & 0xFF;
+                }
+            }
+        }
+        //packet is not larger than PIPE_BUF, so it is written whole or not at all
+        if (mRxSkip.load() > 0)
+            --mRxSkip;
+        else if (write(mStreamOut, &pkt, sizeof(pkt)) == sizeof(pkt))
+            ++mRxPackets;
+        else
+            ++mRxDropped;
+        mRxTimestamp += samplesInPacket;
+    }
+}
+
+void XillybusEmulator::ConsumeTx(void)
+{
+    uint8_t buf[16*sizeof(FPGA_DataPacket)];
+    int bytesRead;
+    while ((bytesRead = read(mStreamIn, buf, sizeof(buf))) > 0)
+        mTxBuffer.insert(mTxBuffer.end(), buf, buf + bytesRead);
+
+    int chCount;
+    bool compressed;
+    TxCallback callback;
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        chCount = Channels();
+        compressed = Compressed();
+        callback = mTxCallback;
+    }
+    const int samplesInPacket = (compressed ? 1360 : 1020)/chCount;
+    for (int ch = 0; ch < chCount; ++ch)
+        mTxSamples[ch].resize(samplesInPacket);
+
+    size_t offset = 0;
+    for (; offset + sizeof(FPGA_DataPacket) <= mTxBuffer.size(); offset += sizeof(FPGA_DataPacket))
+    {
+        FPGA_DataPacket pkt;
+        memcpy(&pkt, &mTxBuffer[offset], sizeof(pkt));
+        ++mTxPackets;
+        if (!callback)
+            continue;
+        const uint8_t* src = pkt.data;
+        for (int s = 0; s < samplesInPacket; ++s)
+        {
+            for (int ch = 0; ch < chCount; ++ch)
+            {
+                complex16_t &sample = mTxSamples[ch][s];
+                if (compressed)
+                {
+                    //12 bit values are sign extended
+                    sample.i = int16_t((src[0] | (src[1] << 8)) << 4) >> 4;
+                    sample.q = int16_t(((src[1] >> 4) | (src[2] << 4)) << 4) >> 4;
+                    src += 3;
+                }
+                else
+                {
+                    sample.i = int16_t(src[0] | (src[1] << 8));
+                    sample.q = int16_t(src[2] | (src[3] << 8));
+                    src += 4;
+                }
+            }
+        }
+        const complex16_t* samples[2] = {mTxSamples[0].data(), mTxSamples[1].data()};
+        const bool syncTimestamp = (pkt.reserved[0] & (1 << 4)) == 0;
+        callback(pkt.counter, syncTimestamp, samples, chCount, samplesInPacket);
+    }
+    mTxBuffer.erase(mTxBuffer.begin(), mTxBuffer.begin() + offset);
+}
@@ -0,0 +1,124 @@
+/**
+    @file XillybusEmulator.h
+    @author Lime Microsystems
+    @brief Imitates LimeSDR-PCIe Xillybus device files for testing without hardware
+*/
+
+#pragma once
+#include <dataTypes.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <functional>
+
+namespace lime{
+
+/** @brief Creates named pipes in place of LimeSDR-PCIe device files and serves them
+    from a background thread.
+
+    Control packets (LMS64C) are answered from register maps of the FPGA and
+    LMS7002M. While Rx streaming is enabled in FPGA register 0x000A, FPGA data
+    packets are produced at the emulated sample rate. Samples form a ramp derived
+    from their timestamp: I = timestamp modulo 2048, Q = -I, unless the samples
+    callback is set. Packets that do not
+    fit into the pipe are dropped like on FPGA overrun, timestamps keep counting.
+    Tx packets are decoded and given to the samples callback.
+
+    Connection is made by passing the directory in ConnectionHandle addr.
+*/
+class XillybusEmulator
+{
+public:
+    /** @brief Called from emulator thread for each received Tx packet
+        @param timestamp packet timestamp
+        @param syncTimestamp false if packet is sent without waiting for its timestamp
+        @param samples channel samples, one array per enabled channel
+        @param chCount number of channels
+        @param samplesCount number of samples in each channel
+    */
+    typedef std::function<void(uint64_t timestamp, bool syncTimestamp, const complex16_t* const* samples, int chCount, int samplesCount)> TxCallback;
+
+    /** @brief Called from emulator thread to generate Rx samples of each packet
+        @param timestamp timestamp of the first sample
+        @param samples destination, same samples are sent on all channels
+        @param samplesCount number of samples
+    */
+    typedef std::function<void(uint64_t timestamp, complex16_t* samples, int samplesCount)> RxCallback;
+
+    /** @param deviceDir directory for device files, created if it does not exist
+        @param sampleRate emulated Rx sample rate
+    */
+    XillybusEmulator(const std::string &deviceDir, const double sampleRate = 5e6);
+    ~XillybusEmulator(void);
+
+    /** @brief Creates device files and starts serving them
+        @return 0 on success
+    */
+    int Start(void);
+    //! Stops emulator thread and removes device files
+    void Stop(void);
+
+    void SetTxCallback(TxCallback callback);
+    void SetRxCallback(RxCallback callback);
+
+    uint64_t GetRxPacketsCount(void) const;
+    uint64_t GetRxPacketsDropped(void) const;
+    uint64_t GetTxPacketsCount(void) const;
+    uint16_t GetFPGARegister(const uint16_t addr);
+    //! Register value of LMS7002M channel A (0) or B (1)
+    uint16_t GetLMS7002MRegister(const int ch, const uint16_t addr);
+    //! Number of LMS7002M register writes received
+    uint64_t GetLMS7002MWritesCount(void) const;
+    //! Following Rx packets are not sent, as if lost on the way to host
+    void SkipRxPackets(const uint32_t count);
+
+    static int RampI(const uint64_t timestamp)
+    {
+        return int(timestamp & 0x7FF);
+    }
+
+private:
+    void Run(void);
+    void ProcessControl(const uint8_t* input, uint8_t* output);
+    void ProduceRx(void);
+    void ConsumeTx(void);
+    std::string FilePath(const char* name) const;
+    int Channels(void) const;
+    bool Compressed(void) const;
+
+    std::string mDeviceDir;
+    double mSampleRate;
+    std::thread mThread;
+    std::atomic<bool> mTerminate;
+    std::mutex mLock; //!< registers and callback
+
+    std::map<uint16_t, uint16_t> mFPGARegisters;
+    std::map<uint16_t, uint16_t> mChannelA;
+    std::map<uint16_t, uint16_t> mChannelB;
+    TxCallback mTxCallback;
+    RxCallback mRxCallback;
+
+    int mCtrlIn;
+    int mCtrlOut;
+    int mStreamIn;
+    int mStreamOut;
+    std::vector<uint8_t> mCtrlBuffer;
+    std::vector<uint8_t> mTxBuffer;
+    std::vector<complex16_t> mTxSamples[2];
+    std::vector<complex16_t> mRxSamples;
+
+    bool mRxEnabled;
+    uint64_t mRxTimestamp;
+    std::chrono::steady_clock::time_point mRxStart;
+    std::atomic<uint64_t> mRxPackets;
+    std::atomic<uint64_t> mRxDropped;
+    std::atomic<uint64_t> mTxPackets;
+    std::atomic<uint64_t> mLMS7002MWrites;
+    std::atomic<uint32_t> mRxSkip;
+};
+
+}
@@ -0,0 +1,61 @@
+/**
+    @file main.cpp
+    @author Lime Microsystems
+    @brief Runs LimeSDR-PCIe emulator behind device files in given directory
+*/
+
+#include "XillybusEmulator.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+using namespace lime;
+
+static std::atomic<bool> stopApplication(false);
+
+static void ApplicationStopHandler(int s)
+{
+    stopApplication.store(true);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("Usage: %s <device directory> [sample rate]\n", argv[0]);
+        printf("Find it with LimeUtil --find=\"LimeSDR-PCIe, addr=<device directory>\"\n");
+        return -1;
+    }
+    struct sigaction sigIntHandler;
+    sigIntHandler.sa_handler = ApplicationStopHandler;
+    sigemptyset(&sigIntHandler.sa_mask);
+    sigIntHandler.sa_flags = 0;
+    sigaction(SIGINT, &sigIntHandler, NULL);
+    sigaction(SIGTERM, &sigIntHandler, NULL);
+
+    const double sampleRate = argc > 2 ? atof(argv[2]) : 5e6;
+    XillybusEmulator emulator(argv[1], sampleRate);
+    if (emulator.Start() != 0)
+    {
+        printf("Failed to create device files in %s\n", argv[1]);
+        return -1;
+    }
+    printf("LimeSDR-PCIe emulator started in %s, Rx sample rate %g\n", argv[1], sampleRate);
+    uint64_t rxPackets = 0, txPackets = 0;
+    while (!stopApplication.load())
+    {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        const uint64_t rx = emulator.GetRxPacketsCount();
+        const uint64_t tx = emulator.GetTxPacketsCount();
+        if (rx != rxPackets || tx != txPackets)
+            printf("Rx packets: %llu (dropped %llu), Tx packets: %llu\n", (unsigned long long)rx,
+                (unsigned long long)emulator.GetRxPacketsDropped(), (unsigned long long)tx);
+        rxPackets = rx;
+        txPackets = tx;
+    }
+    emulator.Stop();
+    return 0;
+}